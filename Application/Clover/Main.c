@@ -54,45 +54,131 @@
 BOOLEAN   gThemeNeedInit = TRUE;
 
 // Splash -->
-CHAR16    **gLoadMessages, *gMessageDots = L"...";
+// Messages are rendered once into a retained surface that scrolls up a row per
+// message, a periodic timer puts it on screen, so the boot path never waits for it.
+#define LOAD_MESSAGE_REFRESH    EFI_TIMER_PERIOD_MILLISECONDS (40)
+
 UINTN     gMessageNow = 0, gMessageClearWidth = 0, gRowHeight = 20;
+
+STATIC EG_IMAGE   *mLoadMessageSurface = NULL;
+STATIC EFI_EVENT  mLoadMessageEvent = NULL;
+STATIC BOOLEAN    mLoadMessageDirty = FALSE;
 // Splash <--
 
+STATIC
+VOID
+FlushLoadMessage () {
+  UINTN   Rows, Height;
+
+  if (!mLoadMessageDirty || (mLoadMessageSurface == NULL)) {
+    return;
+  }
+
+  // only rows holding a message, the rest of the column stays untouched
+  Rows = MIN (gMessageNow, (UINTN)mLoadMessageSurface->Height / gRowHeight);
+  Height = Rows * gRowHeight;
+
+  DrawImageArea (
+    mLoadMessageSurface,
+    0, mLoadMessageSurface->Height - Height,
+    mLoadMessageSurface->Width, Height,
+    0, GlobalConfig.UGAHeight - Height
+  );
+
+  mLoadMessageDirty = FALSE;
+}
+
+STATIC
+VOID
+EFIAPI
+LoadMessageNotify (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+) {
+  FlushLoadMessage ();
+}
+
 VOID
 DrawLoadMessage (
   CHAR16  *Msg
 ) {
-  if (!gSettings.NoEarlyProgress) {
-    UINTN   i, Size, Index;
+  EG_IMAGE    *TextBuffer;
+  EFI_TPL     OldTpl;
+  CHAR16      *Text;
+  UINTN       RowSize, Rows, Moved;
 
-    gMessageNow++;
+  if (gSettings.NoEarlyProgress || (mLoadMessageSurface == NULL)) {
+    return;
+  }
 
-    Size = gMessageNow * sizeof (CHAR16 *);
+  Text = PoolPrint (L"%s ...", Msg);
+  TextBuffer = CreateFilledImage (mLoadMessageSurface->Width, gTextHeight, TRUE, &gTransparentBackgroundPixel);
+  if ((Text == NULL) || (TextBuffer == NULL)) {
+    goto Finish;
+  }
 
-    gLoadMessages = ReallocatePool (Size, Size + sizeof (CHAR16 *), gLoadMessages);
-    gLoadMessages[gMessageNow - 1] = EfiStrDuplicate (Msg);
+  RenderText (Text, TextBuffer, 0, 0, 0xFFFF, FALSE);
 
-    for (i = 0; i < gMessageNow; i++) {
-      Index = (gMessageNow - i);
-      DrawTextXY (gLoadMessages[i], 0, GlobalConfig.UGAHeight - (Index * gRowHeight), X_IS_LEFT, gMessageClearWidth);
-    }
+  // keep the notify out while the surface is scrolled
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
 
-    i = 3;
-    while (i) {
-      DrawTextXY (PoolPrint (L"%s %s", gLoadMessages[gMessageNow - 1], &gMessageDots[--i]), 0, GlobalConfig.UGAHeight - (Index * gRowHeight), X_IS_LEFT, gMessageClearWidth);
-      gBS->Stall (10000);
-    }
+  // only rows holding a message move up, the top one drops off once the column is full
+  RowSize = mLoadMessageSurface->Width * gRowHeight;
+  Rows = (UINTN)mLoadMessageSurface->Height / gRowHeight;
+  Moved = (Rows > 0) ? MIN (gMessageNow, Rows - 1) : 0;
+
+  if (Moved > 0) {
+    CopyMem (
+      mLoadMessageSurface->PixelData + (Rows - Moved - 1) * RowSize,
+      mLoadMessageSurface->PixelData + (Rows - Moved) * RowSize,
+      Moved * RowSize * sizeof (EG_PIXEL)
+    );
+  }
+
+  gMessageNow++;
+
+  FillImageArea (
+    mLoadMessageSurface,
+    0, mLoadMessageSurface->Height - gRowHeight,
+    mLoadMessageSurface->Width, gRowHeight,
+    &gTransparentBackgroundPixel
+  );
+
+  ComposeImage (mLoadMessageSurface, TextBuffer, 0, mLoadMessageSurface->Height - gRowHeight);
+
+  mLoadMessageDirty = TRUE;
+
+  gBS->RestoreTPL (OldTpl);
+
+  if (mLoadMessageEvent == NULL) {
+    FlushLoadMessage ();
+  }
+
+  Finish:
+
+  if (TextBuffer != NULL) {
+    FreeImage (TextBuffer);
+  }
+
+  if (Text != NULL) {
+    FreePool (Text);
   }
 }
 
 VOID
 FreeLoadMessage () {
-  if (gMessageNow && !gSettings.NoEarlyProgress) {
-    UINTN   i;
+  if (mLoadMessageEvent != NULL) {
+    gBS->SetTimer (mLoadMessageEvent, TimerCancel, 0);
+    gBS->CloseEvent (mLoadMessageEvent);
+    mLoadMessageEvent = NULL;
+  }
 
-    for (i = 0; (i < gMessageNow) && gLoadMessages[i]; i++) {
-      FreePool (gLoadMessages[i]);
-    }
+  // last message may still be pending
+  FlushLoadMessage ();
+
+  if (mLoadMessageSurface != NULL) {
+    FreeImage (mLoadMessageSurface);
+    mLoadMessageSurface = NULL;
   }
 }
 
@@ -106,10 +192,35 @@ InitSplash () {
     gSettings.NoEarlyProgress = TRUE;
     FreePool (NvramConfig);
   } else {
-    EG_IMAGE  *SplashLogo = BuiltinIcon (BUILTIN_ICON_BANNER_BLACK);
+    EG_IMAGE    *SplashLogo = BuiltinIcon (BUILTIN_ICON_BANNER_BLACK);
+    EFI_STATUS  Status;
 
     gMessageClearWidth = (GlobalConfig.UGAWidth - SplashLogo->Width) >> 1;
     DrawImageArea (SplashLogo, 0, 0, 0, 0, gMessageClearWidth, (GlobalConfig.UGAHeight - SplashLogo->Height) >> 1);
+
+    if (gMessageClearWidth == 0) {
+      return;
+    }
+
+    mLoadMessageSurface = CreateFilledImage (
+                            gMessageClearWidth,
+                            (GlobalConfig.UGAHeight / gRowHeight) * gRowHeight,
+                            FALSE,
+                            &gTransparentBackgroundPixel
+                          );
+
+    if (mLoadMessageSurface == NULL) {
+      return;
+    }
+
+    Status = gBS->CreateEvent (EVT_TIMER | EVT_NOTIFY_SIGNAL, TPL_CALLBACK, LoadMessageNotify, NULL, &mLoadMessageEvent);
+    if (!EFI_ERROR (Status)) {
+      Status = gBS->SetTimer (mLoadMessageEvent, TimerPeriodic, LOAD_MESSAGE_REFRESH);
+      if (EFI_ERROR (Status)) {
+        gBS->CloseEvent (mLoadMessageEvent);
+        mLoadMessageEvent = NULL;
+      }
+    }
   }
 }
 
@@ -175,6 +286,8 @@ RefitMain (
 
   InitializeSettings ();
 
+  MpTaskInit ();
+
   InitScreen ();
 
   InitSplash ();
@@ -200,6 +313,9 @@ RefitMain (
 
   SyncDefaultSettings ();
 
+  // SMBus reads run on an AP while settings load, ScanSPD () collects them
+  StartScanSPD ();
+
   DrawLoadMessage (L"Load Settings");
   DbgHeader ("LoadSettings");
 
@@ -315,13 +431,16 @@ RefitMain (
       FillInputs (TRUE);
     }
 
-    // Add custom entries
-    AddCustomEntries ();
+    // FastBoot: last default entry only, full scan if it is gone or not the default anymore
+    if (!gSettings.FastBoot || gSettings.DisableEntryScan || !ScanLoaderCache ()) {
+      // Add custom entries
+      AddCustomEntries ();
 
-    if (gSettings.DisableEntryScan) {
-      DBG ("Entry scan disabled\n");
-    } else {
-      ScanLoader ();
+      if (gSettings.DisableEntryScan) {
+        DBG ("Entry scan disabled\n");
+      } else {
+        ScanLoader ();
+      }
     }
 
     if (!gSettings.FastBoot) {
@@ -351,6 +470,7 @@ RefitMain (
 
     if (gSettings.FastBoot && DefaultEntry) {
       if (DefaultEntry->Tag == TAG_LOADER) {
+        SaveLoaderCache ((LOADER_ENTRY *)DefaultEntry);
         StartLoader ((LOADER_ENTRY *)DefaultEntry);
       }
 
@@ -380,6 +500,7 @@ RefitMain (
 
       if ((DefaultEntry != NULL) && (MenuExit == MENU_EXIT_TIMEOUT)) {
         if (DefaultEntry->Tag == TAG_LOADER) {
+          SaveLoaderCache ((LOADER_ENTRY *)DefaultEntry);
           StartLoader ((LOADER_ENTRY *)DefaultEntry);
         }
         break;
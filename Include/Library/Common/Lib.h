@@ -335,6 +335,7 @@ typedef struct KERNEL_AND_KEXT_PATCHES {
 
   UINTN                       NrKexts;
   KEXT_PATCH                  *KextPatches;
+  struct KEXT_PATCH_INDEX     *KextPatchIndex; // Private
 
   UINTN                       NrForceKexts;
   CHAR16                      **ForceKexts;
@@ -371,6 +372,7 @@ typedef struct {
   //UINT8                     KernelRevision;
   KERNEL_AND_KEXT_PATCHES   *KernelAndKextPatches;
   CHAR16                    *Settings;
+  BOOLEAN                   Scanned;      // added by ScanLoader (), can go to the boot entry cache
 } LOADER_ENTRY;
 
 typedef struct CUSTOM_LOADER_ENTRY {
@@ -13,6 +13,11 @@
 #define MEM_LOG_MAX_SIZE        (2 * 1024 * 1024)
 #define MEM_LOG_MAX_LINE_SIZE   1024
 
+//
+// NVRAM variable (gEfiAppleBootGuid) with calibrated TSC frequency
+//
+#define MEM_LOG_TSC_VARIABLE    L"Clover.TscFrequency"
+
 /** Callback that can be installed to be called when some message is printed with MemLog() or MemLogVA(). **/
 typedef VOID (EFIAPI *MEM_LOG_CALLBACK) (IN INTN DebugMode, IN CHAR8 *LastMessage);
 
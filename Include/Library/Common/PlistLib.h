@@ -36,6 +36,7 @@ typedef enum {
 
 typedef struct Symbol {
           UINTN   refCount;
+          UINT32  hash;
           CHAR8   *string;
   struct  Symbol  *next;
 } Symbol , *SymbolPtr;
@@ -62,8 +63,67 @@ typedef struct {
   INT32   id;
   sREF    *ref_strings;
   sREF    *ref_integer;
+  VOID    *index;       // private, children lookup table
 } TagStruct, *TagPtr;
 
+//
+// Parsed plist owning all of its tags, strings and data in one arena.
+// Its tags must not be passed to FreeTag (), use FreeXMLDocument ().
+//
+typedef struct PLIST_ARENA_BLOCK PLIST_ARENA_BLOCK;
+
+typedef struct {
+  TagPtr              Root;
+  PLIST_ARENA_BLOCK   *Blocks;
+} PLIST_DOCUMENT;
+
+//
+// Streaming parser, see ParseXMLStream ().
+//
+#define kPlistStreamMaxDepth  (32)
+
+typedef enum {
+  kPlistEventValue,       // string / integer / data / date / true / false
+  kPlistEventListStart,   // dict / array opened
+  kPlistEventListEnd      // dict / array closed
+} PLIST_EVENT_TYPE;
+
+typedef enum {
+  kPlistStreamContinue,
+  kPlistStreamSkip,       // on kPlistEventListStart: no events until the list is closed
+  kPlistStreamStop
+} PLIST_STREAM_ACTION;
+
+typedef struct {
+  UINTN         Type;     // kTagTypeDict / kTagTypeArray
+  CONST CHAR8   *Key;     // key of the list in its parent dict, NULL in arrays
+  UINTN         KeyLen;
+  UINTN         Count;    // values / lists seen in it so far, current one included
+  CONST CHAR8   *Start;   // '<' of the opening tag
+} PLIST_STREAM_FRAME;
+
+typedef struct {
+  PLIST_EVENT_TYPE      Event;
+  UINTN                 Type;     // TAG_TYPE of the value / list
+  CONST CHAR8           *Key;     // key in the parent dict, NULL in arrays
+  UINTN                 KeyLen;
+  CONST CHAR8           *Value;   // raw value text (not decoded, not terminated)
+  UINTN                 ValueLen;
+  INT32                 Id;       // ID="" attribute or -1
+  INT32                 IdRef;    // IDREF="" attribute or -1
+  CONST CHAR8           *Start;   // '<' of the element (opening tag for lists)
+  CONST CHAR8           *End;     // past the element, NULL on kPlistEventListStart
+  UINTN                 Depth;    // number of enclosing lists
+  PLIST_STREAM_FRAME    *Path;    // enclosing lists, Path[0] is the outermost
+} PLIST_EVENT;
+
+typedef
+PLIST_STREAM_ACTION
+(EFIAPI *PLIST_STREAM_CALLBACK) (
+  IN PLIST_EVENT  *Event,
+  IN VOID         *Context
+);
+
 CHAR8 *
 EFIAPI
 XMLDecode (
@@ -78,6 +138,44 @@ ParseXML (
   TagPtr  *Dict
 );
 
+EFI_STATUS
+EFIAPI
+ParseXMLDocument (
+  CHAR8           *Buffer,
+  UINT32          BufSize,
+  PLIST_DOCUMENT  **Document
+);
+
+VOID
+EFIAPI
+FreeXMLDocument (
+  PLIST_DOCUMENT  *Document
+);
+
+EFI_STATUS
+EFIAPI
+ExportBinaryPlist (
+  IN  TagPtr  Dict,
+  OUT UINT8   **Buffer,
+  OUT UINTN   *BufSize
+);
+
+EFI_STATUS
+EFIAPI
+ParseXMLStream (
+  IN CONST CHAR8            *Buffer,
+  IN UINTN                  BufSize,
+  IN PLIST_STREAM_CALLBACK  Callback,
+  IN VOID                   *Context
+);
+
+BOOLEAN
+EFIAPI
+PlistEventKeyIs (
+  IN PLIST_EVENT  *Event,
+  IN CONST CHAR8  *Key
+);
+
 TagPtr
 EFIAPI
 GetProperty (
@@ -83,6 +83,19 @@ typedef struct compressed_kernel_header {
 } compressed_kernel_header;
 #endif
 
+//
+// Mach-O symbol index, see MachOBuildSymbolIndex ().
+//
+typedef struct {
+  struct nlist_64       *Symbols;
+  UINT32                NSyms;
+  CHAR8                 *StrBin;
+  UINT32                StrSize;
+  UINT32                *Slots;   // symbol index + 1, 0 == empty
+  UINT32                Size;     // power of 2
+  UINT32                Count;
+} MACH_SYMBOL_INDEX;
+
 typedef struct KERNEL_INFO {
   UINT32                Slide;
   UINT32                KldAddr;
@@ -153,6 +166,8 @@ typedef struct KERNEL_INFO {
   UINT32                KernelSize;
 
   VOID                  *Bin;
+
+  MACH_SYMBOL_INDEX     Symbols;  // Slots built on demand by GetKernelSymbolLocation ()
 } KERNEL_INFO;
 
 extern CHAR8            *gDtRoot;
@@ -200,6 +215,32 @@ STATIC KERNEL_PATCH_SYMBOL_LOOKUP KernelPatchSymbolLookup[] = {
 
 STATIC CONST UINTN KernelPatchSymbolLookupCount = ARRAY_SIZE (KernelPatchSymbolLookup);
 
+EFI_STATUS
+MachOBuildSymbolIndex (
+  OUT MACH_SYMBOL_INDEX   *Index,
+  IN  UINT8               *SymBin,
+  IN  UINT32              NSyms,
+  IN  UINT8               *StrBin,
+  IN  UINT32              StrSize
+);
+
+VOID
+MachOFreeSymbolIndex (
+  IN OUT MACH_SYMBOL_INDEX   *Index
+);
+
+struct nlist_64 *
+MachOSymbolLookup (
+  IN MACH_SYMBOL_INDEX   *Index,
+  IN CHAR8               *Name
+);
+
+UINT32
+GetKernelSymbolLocation (
+  IN CHAR8  *Name,
+  IN UINT8  SectIndex
+);
+
 
 /////////////////////
 //
@@ -316,6 +357,30 @@ IsPatchNameMatch (
   INT32   *isBundle
 );
 
+//
+// Builds / frees CFBundleIdentifier dispatch for Patches->KextPatches,
+// called whenever KextsToPatch list is (re)loaded.
+//
+VOID
+BuildKextPatchIndex (
+  IN OUT KERNEL_AND_KEXT_PATCHES  *Patches
+);
+
+VOID
+FreeKextPatchIndex (
+  IN OUT KERNEL_AND_KEXT_PATCHES  *Patches
+);
+
+VOID
+ApplyKextPatches (
+  CHAR8                     *BundleIdentifier,
+  UINT8                     *Driver,
+  UINT32                    DriverSize,
+  CHAR8                     *InfoPlist,
+  UINT32                    InfoPlistSize,
+  KERNEL_AND_KEXT_PATCHES   *Patches
+);
+
 BOOT_EFI_HEADER *
 ParseBooterHeader (
   IN  VOID  *FileBuffer
@@ -39,6 +39,7 @@ Headers collection for procedures
 #include <Protocol/EdidDiscovered.h>
 #include <Protocol/EdidOverride.h>
 #include <Protocol/LoadedImage.h>
+#include <Protocol/MpService.h>
 #include <Protocol/PciIo.h>
 #include <Protocol/SimpleFileSystem.h>
 #include <Protocol/Smbios.h>
@@ -153,6 +154,7 @@ Headers collection for procedures
 
 #define PREBOOT_LOG                     DIR_MISC L"\\preboot.log"
 #define DEBUG_LOG                       DIR_MISC L"\\debug.log"
+#define ACPI_PATCH_CACHE                DIR_MISC L"\\acpi.cache"
 
 #define DATAHUB_LOG                     "boot-log"
 
@@ -253,7 +255,9 @@ typedef enum {
   kNvRecoveryBootMode,
   kNvCloverConfig,
   kNvCloverTheme,
-  kNvCloverNoEarlyProgress
+  kNvCloverNoEarlyProgress,
+  kNvCloverTscFrequency,
+  kNvCloverBootEntry
 } NVRAM_KEY;
 
 typedef struct NVRAM_DATA {
@@ -659,6 +663,50 @@ typedef struct PATCH_DSDT {
   struct  PATCH_DSDT  *Next;
 } PATCH_DSDT;
 
+#define PATTERN_MATCHER_HASH_BITS     12
+#define PATTERN_MATCHER_HASH_SIZE     (1 << PATTERN_MATCHER_HASH_BITS)
+#define PATTERN_MATCHER_MAX_ENTRIES   0xFFFE
+#define PATTERN_MATCHER_NO_WILDCARD   0xFF
+
+typedef struct {
+  UINT8     *Find;
+  UINT32    Len;
+  UINT8     Wildcard;
+  UINT32    AnchorOff;
+  UINT32    AnchorLen;
+  UINT32    Anchor;
+  UINT16    Next;
+  BOOLEAN   Retired;
+  VOID      *Context;
+} PATTERN_MATCHER_ENTRY;
+
+typedef struct {
+  UINTN                   Count;
+  UINTN                   Capacity;
+  UINTN                   Active;
+  PATTERN_MATCHER_ENTRY   *Entries;
+  UINT16                  WordHeads[PATTERN_MATCHER_HASH_SIZE];
+  UINT16                  ByteHeads[256];
+  UINT16                  Unanchored;
+} PATTERN_MATCHER;
+
+typedef
+BOOLEAN
+(*PATTERN_MATCHER_CALLBACK) (
+  IN VOID   *Context,
+  IN UINTN  Index,
+  IN VOID   *EntryContext,
+  IN UINT8  *Buffer,
+  IN UINTN  Offset
+);
+
+typedef struct {
+  EFI_AP_PROCEDURE  Procedure;
+  VOID              *Context;
+  EFI_EVENT         Event;            // NULL once done / when run on the BSP
+  UINTN             ProcessorNumber;
+} MP_TASK;
+
 typedef struct AML_CHUNK {
           UINT8       Type;
           UINT16      Length;
@@ -1151,7 +1199,9 @@ extern REFIT_MENU_SCREEN                gMainMenu;
 
 extern EFI_GUID                         *gEfiBootDeviceGuid;
 extern EFI_DEVICE_PATH_PROTOCOL         *gEfiBootDeviceData;
+extern EFI_DEVICE_PATH_PROTOCOL         *gBootCampHD;
 extern SETTINGS_DATA                    gSettings;
+extern UINT32                           gConfigCrc;
 extern LANGUAGES                        gLanguage;
 extern UINT32                           gmPropSize;
 extern UINT8                            *gmProperties;
@@ -1206,6 +1256,12 @@ extern CHAR16                           *gSupportedOsType[3];
 // loader
 VOID ScanLoader ();
 VOID AddCustomEntries ();
+BOOLEAN ScanLoaderCache ();
+
+VOID
+SaveLoaderCache (
+  IN LOADER_ENTRY   *Entry
+);
 
 // tool
 VOID ScanTool ();
@@ -1476,6 +1532,9 @@ SetDevices (
   LOADER_ENTRY  *Entry
 );
 
+VOID
+StartScanSPD ();
+
 VOID
 ScanSPD ();
 
@@ -1522,6 +1581,20 @@ PatchBinACPI (
   UINT32  Len
 );
 
+VOID
+PatchBinACPIFree ();
+
+UINT32
+GetPatchBinACPIKey (
+  UINT8   *Ptr,
+  UINT32  Len
+);
+
+UINT32
+GetFixBiosDsdtKey (
+  UINT8   *Temp
+);
+
 EFI_STATUS
 PatchACPI (
   UINT8   OSType
@@ -1638,6 +1711,78 @@ IsHDMIAudio (
   EFI_HANDLE  PciDevHandle
 );
 
+//
+// MpTask.c
+//
+
+VOID
+MpTaskInit ();
+
+EFI_STATUS
+MpTaskStart (
+  IN OUT MP_TASK            *Task,
+  IN     EFI_AP_PROCEDURE   Procedure,
+  IN     VOID               *Context
+);
+
+VOID
+MpTaskWait (
+  IN OUT MP_TASK  *Task
+);
+
+//
+// PatternMatcher.c
+//
+
+PATTERN_MATCHER *
+PatternMatcherCreate (
+  IN UINTN  Capacity
+);
+
+VOID
+PatternMatcherFree (
+  IN PATTERN_MATCHER  *Matcher
+);
+
+INTN
+PatternMatcherAdd (
+  IN PATTERN_MATCHER  *Matcher,
+  IN UINT8            *Find,
+  IN UINTN            Len,
+  IN UINT8            Wildcard,
+  IN VOID             *Context
+);
+
+BOOLEAN
+PatternMatcherCompare (
+  IN UINT8  *Source,
+  IN UINT8  *Find,
+  IN UINTN  Len,
+  IN UINT8  Wildcard
+);
+
+VOID
+PatternMatcherReplace (
+  IN OUT UINT8  *Dest,
+  IN     UINT8  *Replace,
+  IN     UINTN  Len,
+  IN     UINT8  Wildcard
+);
+
+UINTN
+PatternMatcherScan (
+  IN PATTERN_MATCHER            *Matcher,
+  IN UINT8                      *Buffer,
+  IN UINTN                      Size,
+  IN PATTERN_MATCHER_CALLBACK   Callback,
+  IN VOID                       *Context
+);
+
+VOID
+PatternMatcherReset (
+  IN PATTERN_MATCHER  *Matcher
+);
+
 //
 // PlatformDriverOverride.c
 //
@@ -146,6 +146,17 @@ lodepng_decode32(unsigned char** out, unsigned* w, unsigned* h,
 unsigned lodepng_decode24(unsigned char** out, unsigned* w, unsigned* h,
                           const unsigned char* in, size_t insize);
 
+/*
+Decodes into a buffer given by the caller, as 32-bit BGRA (EFI_GRAPHICS_OUTPUT_BLT_PIXEL order).
+out: w * h * 4 bytes, w and h must be the image size (see lodepng_inspect).
+premultiply: if true, color channels are multiplied by alpha.
+Non-interlaced 8-bit RGBA images are reordered while unfiltering, without any extra buffer.
+*/
+unsigned
+EFIAPI
+lodepng_decode_bgra(unsigned char* out, unsigned w, unsigned h,
+                    const unsigned char* in, size_t insize, unsigned premultiply);
+
 #ifdef LODEPNG_COMPILE_DISK
 /*
 Load PNG from disk, from file with given name.
@@ -193,6 +193,7 @@ typedef struct {
   INTN        Height;
   EG_PIXEL    *PixelData;
   BOOLEAN     HasAlpha;
+  UINTN       RefCount;   // FreeImage drops one, the last one frees
 } EG_IMAGE;
 
 typedef struct REFIT_MENU_SCREEN REFIT_MENU_SCREEN;
@@ -455,6 +456,11 @@ GetSmallHover (
   IN UINTN    Id
 );
 
+EG_IMAGE *
+ButtonImage (
+  IN INTN     Id
+);
+
 EG_IMAGE *
 LoadBuiltinIcon (
   IN CHAR16   *IconName
@@ -599,6 +605,16 @@ LoadImage (
   IN CHAR16             *FileName
 );
 
+EG_IMAGE *
+LoadThemeImage (
+  IN CHAR16   *Path,
+  IN INTN     Width,
+  IN INTN     Height
+);
+
+VOID
+FreeThemeImages ();
+
 VOID
 FillImage (
   IN OUT  EG_IMAGE    *CompImage,
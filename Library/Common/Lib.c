@@ -74,9 +74,6 @@ UINTN                             gVolumesCount = 0;
 
 EFI_UNICODE_COLLATION_PROTOCOL    *mUnicodeCollation = NULL;
 
-REFIT_VOLUME_GUID                 **gVolumesGUID = NULL;
-UINTN                             gVolumesGUIDCount = 0;
-
 EFI_GUID                          **gVenMediaGUID = NULL;
 UINTN                             gVenMediaGUIDCount = 0;
 
@@ -192,6 +189,139 @@ FreeList (
 // volume functions
 //
 
+//
+// Legacy boot code recognition. Signatures at a fixed offset are compared in
+// place, floating ones are found in a single pass over the sector buffer that
+// only tries the patterns starting with the current byte. Classes are listed
+// in priority order, the first one with any matching signature wins.
+//
+
+enum {
+  BOOT_CODE_LINUX,
+  BOOT_CODE_GRUB,
+  BOOT_CODE_CLOVER,
+  BOOT_CODE_FREEBSD,
+  BOOT_CODE_OPENBSD,
+  BOOT_CODE_NETBSD,
+  BOOT_CODE_NTLDR,
+  BOOT_CODE_BOOTMGR,
+  BOOT_CODE_FREEDOS,
+  BOOT_CODE_CLASS_COUNT,
+  BOOT_CODE_NON_SYSTEM = BOOT_CODE_CLASS_COUNT  // dummy FAT boot sector, not a class
+};
+
+#define BOOT_CODE_BIT(Class)    ((UINT32)1 << (Class))
+#define BOOT_CODE_FLOATING      0xFFFF
+#define BOOT_CODE_SECTOR_SIZE   2048
+
+typedef struct {
+  UINT8         Type;       // 0 keeps LegacyOS->Type
+  CHAR16        *IconName;
+  CHAR16        *Name;
+} BOOT_CODE_CLASS;
+
+typedef struct {
+  UINT8         Class;
+  UINT16        Offset;     // fixed offset, or BOOT_CODE_FLOATING
+  UINT16        Limit;      // floating: search window from sector start, as FindMem ()
+  BOOLEAN       Signed;     // fixed: sector must also end with 55 AA
+  UINT8         Length;
+  CONST CHAR8   *Pattern;
+} BOOT_CODE_SIGNATURE;
+
+STATIC BOOT_CODE_CLASS mBootCodeClasses[BOOT_CODE_CLASS_COUNT] = {
+  { OSTYPE_LIN, L"linux",       OSTYPE_LINUX_STR },
+  { 0,          L"grub,linux",  OSTYPE_LINUX_STR },
+  { OSTYPE_VAR, L"clover",      L"Clover" },
+  { OSTYPE_VAR, L"freebsd",     L"FreeBSD" },
+  { OSTYPE_VAR, L"openbsd",     L"OpenBSD" },
+  { OSTYPE_VAR, L"netbsd",      L"NetBSD" },
+  { OSTYPE_WIN, L"win",         OSTYPE_WINDOWS_STR },
+  { OSTYPE_WIN, L"vista,win",   OSTYPE_WINDOWS_STR },
+  { OSTYPE_VAR, L"freedos",     L"FreeDOS" },
+};
+
+// at most 32 entries, MatchBootCode () keeps them in a bit mask
+STATIC CONST BOOT_CODE_SIGNATURE mBootCodeSignatures[] = {
+  { BOOT_CODE_LINUX,      2,                  0,    FALSE, 4,  "LILO" },
+  { BOOT_CODE_LINUX,      6,                  0,    FALSE, 4,  "LILO" },
+  { BOOT_CODE_LINUX,      3,                  0,    FALSE, 8,  "SYSLINUX" },
+  { BOOT_CODE_LINUX,      BOOT_CODE_FLOATING, 2048, FALSE, 8,  "ISOLINUX" },
+  { BOOT_CODE_GRUB,       BOOT_CODE_FLOATING, 512,  FALSE, 26, "Geom\0Hard Disk\0Read\0 Error" },
+  { BOOT_CODE_CLOVER,     0,                  0,    TRUE,  4,  "\xE9\x62\x00\x4D" },
+  { BOOT_CODE_CLOVER,     BOOT_CODE_FLOATING, 2048, FALSE, 10, "BOOT      " },
+  { BOOT_CODE_FREEBSD,    502,                0,    TRUE,  8,  "\x00\x00\x00\x00\x50\xC3\x00\x00" },
+  { BOOT_CODE_FREEBSD,    BOOT_CODE_FLOATING, 2048, FALSE, 23, "Starting the BTX loader" },
+  { BOOT_CODE_OPENBSD,    BOOT_CODE_FLOATING, 512,  FALSE, 8,  "!Loading" },
+  { BOOT_CODE_OPENBSD,    BOOT_CODE_FLOATING, 2048, FALSE, 16, "/cdboot\0/CDBOOT\0" },
+  { BOOT_CODE_NETBSD,     BOOT_CODE_FLOATING, 512,  FALSE, 18, "Not a bootxx image" },
+  { BOOT_CODE_NETBSD,     1028,               0,    FALSE, 4,  "\xD1\xB6\x86\x78" },
+  { BOOT_CODE_NTLDR,      BOOT_CODE_FLOATING, 2048, FALSE, 5,  "NTLDR" },
+  { BOOT_CODE_BOOTMGR,    BOOT_CODE_FLOATING, 2048, FALSE, 7,  "BOOTMGR" },
+  { BOOT_CODE_FREEDOS,    BOOT_CODE_FLOATING, 512,  FALSE, 11, "CPUBOOT SYS" },
+  { BOOT_CODE_FREEDOS,    BOOT_CODE_FLOATING, 512,  FALSE, 11, "KERNEL  SYS" },
+  { BOOT_CODE_NON_SYSTEM, BOOT_CODE_FLOATING, 512,  FALSE, 15, "Non-system disk" },
+};
+
+/** Returns BOOT_CODE_BIT () of every class with a signature in Buffer (BOOT_CODE_SECTOR_SIZE bytes). */
+STATIC
+UINT32
+MatchBootCode (
+  IN UINT8    *Buffer
+) {
+  STATIC UINT32               FirstByte[256];
+  STATIC BOOLEAN              FirstByteReady = FALSE;
+  CONST BOOT_CODE_SIGNATURE   *Sig;
+  UINT32                      Found = 0, Pending = 0, Mask;
+  UINTN                       Index, Offset, Limit = 0;
+
+  if (!FirstByteReady) {
+    for (Index = 0; Index < ARRAY_SIZE (mBootCodeSignatures); Index++) {
+      if (mBootCodeSignatures[Index].Offset == BOOT_CODE_FLOATING) {
+        FirstByte[(UINT8)mBootCodeSignatures[Index].Pattern[0]] |= (UINT32)1 << Index;
+      }
+    }
+
+    FirstByteReady = TRUE;
+  }
+
+  for (Index = 0; Index < ARRAY_SIZE (mBootCodeSignatures); Index++) {
+    Sig = &mBootCodeSignatures[Index];
+
+    if (Sig->Offset == BOOT_CODE_FLOATING) {
+      Pending |= (UINT32)1 << Index;
+      Limit = MAX (Limit, Sig->Limit);
+    } else if (
+      (CompareMem (Buffer + Sig->Offset, Sig->Pattern, Sig->Length) == 0) &&
+      (!Sig->Signed || (*((UINT16 *)(Buffer + 510)) == 0xaa55))
+    ) {
+      Found |= BOOT_CODE_BIT (Sig->Class);
+    }
+  }
+
+  for (Offset = 0; (Offset < Limit) && (Pending != 0); Offset++) {
+    Mask = FirstByte[Buffer[Offset]] & Pending;
+
+    while (Mask != 0) {
+      Index = (UINTN)LowBitSet32 (Mask);
+      Mask &= Mask - 1;
+      Sig = &mBootCodeSignatures[Index];
+
+      if (BIT_ISSET (Found, BOOT_CODE_BIT (Sig->Class))) {
+        Pending &= ~((UINT32)1 << Index);
+      } else if (
+        ((Offset + Sig->Length) < Sig->Limit) &&
+        (CompareMem (Buffer + Offset, Sig->Pattern, Sig->Length) == 0)
+      ) {
+        Found |= BOOT_CODE_BIT (Sig->Class);
+        Pending &= ~((UINT32)1 << Index);
+      }
+    }
+  }
+
+  return Found;
+}
+
 STATIC
 VOID
 ScanVolumeBootCode (
@@ -206,7 +336,8 @@ ScanVolumeBootCode (
   UINTN         BlockSize = 0;
   CHAR16        VolumeName[255];
   CHAR8         Tmp[64];
-  UINT32        VCrc32;
+  UINT32        VCrc32, Found;
+  BOOT_CODE_CLASS   *Class;
   //CHAR16      *kind = NULL;
 
   Volume->HasBootCode = FALSE;
@@ -224,19 +355,19 @@ ScanVolumeBootCode (
   ZeroMem ((CHAR8 *)&Tmp[0], 64);
   BlockSize = Volume->BlockIO->Media->BlockSize;
 
-  if (BlockSize > 2048) {
+  if (BlockSize > BOOT_CODE_SECTOR_SIZE) {
     return;   // our buffer is too small... the bred of thieve of cable
   }
 
-  SectorBuffer = AllocateAlignedPages (EFI_SIZE_TO_PAGES (2048), 16); //align to 16 byte?! Poher
-  ZeroMem ((CHAR8 *)&SectorBuffer[0], 2048);
+  SectorBuffer = AllocateAlignedPages (EFI_SIZE_TO_PAGES (BOOT_CODE_SECTOR_SIZE), 16); //align to 16 byte?! Poher
+  ZeroMem ((CHAR8 *)&SectorBuffer[0], BOOT_CODE_SECTOR_SIZE);
 
   // look at the boot sector (this is used for both hard disks and El Torito images!)
   Status = Volume->BlockIO->ReadBlocks (
                               Volume->BlockIO,
                               Volume->BlockIO->Media->MediaId,
                               Volume->BlockIOOffset /* start lba */,
-                              2048,
+                              BOOT_CODE_SECTOR_SIZE,
                               SectorBuffer
                             );
 
@@ -311,94 +442,24 @@ ScanVolumeBootCode (
           }
         }
       }
+    }
 
-    } else { //HDD
+    Found = MatchBootCode (SectorBuffer);
+
+    if ((Volume->DiskKind != DISK_KIND_OPTICAL) && ((Found & (BOOT_CODE_BIT (BOOT_CODE_CLASS_COUNT) - 1)) != 0)) { //HDD
       // detect specific boot codes
-      if (
-        (CompareMem (SectorBuffer + 2, "LILO", 4) == 0) ||
-        (CompareMem (SectorBuffer + 6, "LILO", 4) == 0) ||
-        (CompareMem (SectorBuffer + 3, "SYSLINUX", 8) == 0) ||
-        (FindMem (SectorBuffer, 2048, "ISOLINUX", 8) >= 0)
-      ) {
-        Volume->HasBootCode = TRUE;
-        Volume->LegacyOS->IconName = L"linux";
-        Volume->LegacyOS->Name = OSTYPE_LINUX_STR;
-        Volume->LegacyOS->Type = OSTYPE_LIN;
-        Volume->BootType = BOOTING_BY_PBR;
-      } else if (FindMem (SectorBuffer, 512, "Geom\0Hard Disk\0Read\0 Error", 26) >= 0) {   // GRUB
-        Volume->HasBootCode = TRUE;
-        Volume->LegacyOS->IconName = L"grub,linux";
-        Volume->LegacyOS->Name = OSTYPE_LINUX_STR;
-        Volume->BootType = BOOTING_BY_PBR;
-      } else if (
-          (
-            (*((UINT32 *)(SectorBuffer)) == 0x4d0062e9) &&
-            (*((UINT16 *)(SectorBuffer + 510)) == 0xaa55)
-          ) ||
-          (FindMem (SectorBuffer, 2048, "BOOT      ", 10) >= 0)
-        ) { //reboot Clover
-        Volume->HasBootCode = TRUE;
-        Volume->LegacyOS->IconName = L"clover";
-        Volume->LegacyOS->Name = L"Clover";
-        Volume->LegacyOS->Type = OSTYPE_VAR;
-        Volume->BootType = BOOTING_BY_PBR;
-        //DBG ("Detected Clover FAT32 bootCode\n");
-      } else if (
-          (
-            (*((UINT32 *)(SectorBuffer + 502)) == 0) &&
-            (*((UINT32 *)(SectorBuffer + 506)) == 50000) &&
-            (*((UINT16 *)(SectorBuffer + 510)) == 0xaa55)
-          ) ||
-          (FindMem (SectorBuffer, 2048, "Starting the BTX loader", 23) >= 0)
-        ) {
-        Volume->HasBootCode = TRUE;
-        Volume->LegacyOS->IconName = L"freebsd";
-        Volume->LegacyOS->Name = L"FreeBSD";
-        Volume->LegacyOS->Type = OSTYPE_VAR;
-        Volume->BootType = BOOTING_BY_PBR;
-      } else if (
-          (FindMem (SectorBuffer, 512, "!Loading", 8) >= 0) ||
-          (FindMem (SectorBuffer, 2048, "/cdboot\0/CDBOOT\0", 16) >= 0)
-        ) {
-        Volume->HasBootCode = TRUE;
-        Volume->LegacyOS->IconName = L"openbsd";
-        Volume->LegacyOS->Name = L"OpenBSD";
-        Volume->LegacyOS->Type = OSTYPE_VAR;
-        Volume->BootType = BOOTING_BY_PBR;
-      } else if (
-          (FindMem (SectorBuffer, 512, "Not a bootxx image", 18) >= 0) ||
-          (*((UINT32 *)(SectorBuffer + 1028)) == 0x7886b6d1)
-        ) {
-        Volume->HasBootCode = TRUE;
-        Volume->LegacyOS->IconName = L"netbsd";
-        Volume->LegacyOS->Name = L"NetBSD";
-        Volume->LegacyOS->Type = OSTYPE_VAR;
-        Volume->BootType = BOOTING_BY_PBR;
-      } else if (FindMem (SectorBuffer, 2048, "NTLDR", 5) >= 0) {
-        Volume->HasBootCode = TRUE;
-        Volume->LegacyOS->IconName = L"win";
-        Volume->LegacyOS->Name = OSTYPE_WINDOWS_STR;
-        Volume->LegacyOS->Type = OSTYPE_WIN;
-        Volume->BootType = BOOTING_BY_PBR;
-      } else if (FindMem (SectorBuffer, 2048, "BOOTMGR", 7) >= 0) {
-        Volume->HasBootCode = TRUE;
-        Volume->LegacyOS->IconName = L"vista,win";
-        Volume->LegacyOS->Name = OSTYPE_WINDOWS_STR;
-        Volume->LegacyOS->Type = OSTYPE_WIN;
-        Volume->BootType = BOOTING_BY_PBR;
-      } else if (
-          (FindMem (SectorBuffer, 512, "CPUBOOT SYS", 11) >= 0) ||
-          (FindMem (SectorBuffer, 512, "KERNEL  SYS", 11) >= 0)
-        ) {
-        Volume->HasBootCode = TRUE;
-        Volume->LegacyOS->IconName = L"freedos";
-        Volume->LegacyOS->Name = L"FreeDOS";
-        Volume->LegacyOS->Type = OSTYPE_VAR;
-        Volume->BootType = BOOTING_BY_PBR;
+      Class = &mBootCodeClasses[LowBitSet32 (Found & (BOOT_CODE_BIT (BOOT_CODE_CLASS_COUNT) - 1))];
+
+      Volume->HasBootCode = TRUE;
+      Volume->LegacyOS->IconName = Class->IconName;
+      Volume->LegacyOS->Name = Class->Name;
+      if (Class->Type != 0) {
+        Volume->LegacyOS->Type = Class->Type;
       }
+      Volume->BootType = BOOTING_BY_PBR;
     }
 
-    if (FindMem (SectorBuffer, 512, "Non-system disk", 15) >= 0) { // dummy FAT boot sector
+    if (BIT_ISSET (Found, BOOT_CODE_BIT (BOOT_CODE_NON_SYSTEM))) { // dummy FAT boot sector
       Volume->HasBootCode = FALSE;
     }
   }
@@ -406,10 +467,86 @@ ScanVolumeBootCode (
   gBS->FreePages ((EFI_PHYSICAL_ADDRESS)(UINTN)SectorBuffer, 1);
 }
 
+//
+// Physical disks seen by ScanVolumes (), keyed by whole disk handle (the handle
+// ScanVolume () resolves from the device path before the partition node).
+// GPT of each disk is read once, partitions find their entry by number.
+//
+typedef struct {
+  EFI_HANDLE          DeviceHandle;
+  EFI_BLOCK_IO        *BlockIO;
+  REFIT_VOLUME        *Volume;      // whole disk volume, if it has one
+  BOOLEAN             GptRead;
+  UINT32              EntryCount;
+  REFIT_VOLUME_GUID   *Entries;     // in partition table order
+} REFIT_DISK;
+
+STATIC REFIT_DISK   **mDisks = NULL;
+STATIC UINTN        mDisksCount = 0;
+
+STATIC
+VOID
+FreeDisks () {
+  UINTN   Index;
+
+  for (Index = 0; Index < mDisksCount; Index++) {
+    if (mDisks[Index]->Entries != NULL) {
+      FreePool (mDisks[Index]->Entries);
+    }
+  }
+
+  FreeList ((VOID ***)&mDisks, &mDisksCount);
+}
+
+STATIC
+REFIT_DISK *
+GetDisk (
+  IN EFI_HANDLE     DeviceHandle,
+  IN EFI_BLOCK_IO   *BlockIO
+) {
+  REFIT_DISK    *Disk;
+  UINTN         Index;
+
+  for (Index = 0; Index < mDisksCount; Index++) {
+    if (mDisks[Index]->DeviceHandle == DeviceHandle) {
+      return mDisks[Index];
+    }
+  }
+
+  Disk = AllocateZeroPool (sizeof (REFIT_DISK));
+  if (Disk != NULL) {
+    Disk->DeviceHandle = DeviceHandle;
+    Disk->BlockIO = BlockIO;
+    AddListElement ((VOID ***)&mDisks, &mDisksCount, Disk);
+  }
+
+  return Disk;
+}
+
+STATIC
+HARDDRIVE_DEVICE_PATH *
+GetHardDriveDevicePath (
+  IN EFI_DEVICE_PATH    *DevicePath
+) {
+  while ((DevicePath != NULL) && !IsDevicePathEnd (DevicePath)) {
+    if (
+      (DevicePathType (DevicePath) == MEDIA_DEVICE_PATH) &&
+      (DevicePathSubType (DevicePath) == MEDIA_HARDDRIVE_DP)
+    ) {
+      return (HARDDRIVE_DEVICE_PATH *)DevicePath;
+    }
+
+    DevicePath = NextDevicePathNode (DevicePath);
+  }
+
+  return NULL;
+}
+
+/** Reads GPT partition entries of Disk, only on the first call for that disk. */
 STATIC
 EFI_STATUS
 ReadGPT (
-  IN OUT REFIT_VOLUME   *Volume
+  IN OUT REFIT_DISK   *Disk
 ) {
   EFI_STATUS                    Status = EFI_SUCCESS;
   EFI_DISK_IO_PROTOCOL          *DiskIo;
@@ -417,86 +554,161 @@ ReadGPT (
   EFI_PARTITION_ENTRY           *PartEntry, *Entry;
   UINT32                        MediaId, BlockSize, Index;
 
+  if (Disk->GptRead) {
+    return (Disk->Entries != NULL) ? EFI_SUCCESS : EFI_NOT_FOUND;
+  }
+
+  Disk->GptRead = TRUE;
+
   Status = gBS->HandleProtocol (
-                  Volume->DeviceHandle,
+                  Disk->DeviceHandle,
                   &gEfiDiskIoProtocolGuid,
                   (VOID **) &(DiskIo)
                 );
 
-  if (!EFI_ERROR (Status)) {
-    BlockSize = Volume->BlockIO->Media->BlockSize;
-    MediaId = Volume->BlockIO->Media->MediaId;
-    PartHdr = AllocateZeroPool (BlockSize);
-
-    Status = DiskIo->ReadDisk (
-                       DiskIo,
-                       MediaId,
-                       MultU64x32 (PRIMARY_PART_HEADER_LBA, BlockSize),
-                       BlockSize,
-                       PartHdr
-                     );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
 
-    if (!EFI_ERROR (Status)) {
-      if (
-        (PartHdr->Header.Signature != EFI_PTAB_HEADER_ID) ||
-        (PartHdr->MyLBA != PRIMARY_PART_HEADER_LBA) ||
-        (PartHdr->SizeOfPartitionEntry < sizeof (EFI_PARTITION_ENTRY))
-      ) {
-        DBG ("         Invalid EFI partition table header\n");
-        FreePool (PartHdr);
-        return EFI_LOAD_ERROR;
-      }
+  BlockSize = Disk->BlockIO->Media->BlockSize;
+  MediaId = Disk->BlockIO->Media->MediaId;
+  PartHdr = AllocateZeroPool (BlockSize);
 
-      DBG ("         Read partition entries:\n");
+  if (PartHdr == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
 
-      PartEntry = AllocatePool (PartHdr->NumberOfPartitionEntries * PartHdr->SizeOfPartitionEntry);
-      if (PartEntry == NULL) {
-        return EFI_BUFFER_TOO_SMALL;
-      }
+  Status = DiskIo->ReadDisk (
+                     DiskIo,
+                     MediaId,
+                     MultU64x32 (PRIMARY_PART_HEADER_LBA, BlockSize),
+                     BlockSize,
+                     PartHdr
+                   );
 
-      DBG ("         BlockSize                : %d\n", BlockSize);
-      DBG ("         PartitionEntryLBA        : %x\n", PartHdr->PartitionEntryLBA);
-      DBG ("         NumberOfPartitionEntries : %d\n", PartHdr->NumberOfPartitionEntries);
-      DBG ("         SizeOfPartitionEntry     : %d\n", PartHdr->SizeOfPartitionEntry);
-
-      Status = DiskIo->ReadDisk (
-                         DiskIo,
-                         MediaId,
-                         MultU64x32 (PartHdr->PartitionEntryLBA, BlockSize),
-                         PartHdr->NumberOfPartitionEntries * (PartHdr->SizeOfPartitionEntry),
-                         PartEntry
-                       );
-
-      if (EFI_ERROR (Status)) {
-        DBG ("           Partition Entry ReadDisk error\n");
-        return EFI_DEVICE_ERROR;
-      }
+  if (EFI_ERROR (Status)) {
+    FreePool (PartHdr);
+    return Status;
+  }
 
-      for (Index = 0; Index < PartHdr->NumberOfPartitionEntries; Index++) {
-        Entry = (EFI_PARTITION_ENTRY *) ((UINT8 *) PartEntry + Index * PartHdr->SizeOfPartitionEntry);
-        if ((Entry->StartingLBA == 0) && (Entry->EndingLBA == 0)) {
-          break;
-        } else {
-          REFIT_VOLUME_GUID   *TmpVolumesGUID = AllocateZeroPool (sizeof (REFIT_VOLUME_GUID));
+  if (
+    (PartHdr->Header.Signature != EFI_PTAB_HEADER_ID) ||
+    (PartHdr->MyLBA != PRIMARY_PART_HEADER_LBA) ||
+    (PartHdr->SizeOfPartitionEntry < sizeof (EFI_PARTITION_ENTRY))
+  ) {
+    DBG ("         Invalid EFI partition table header\n");
+    FreePool (PartHdr);
+    return EFI_LOAD_ERROR;
+  }
 
-          DBG ("           Partition              : %d\n", Index);
-          DBG ("           PartitionTypeGUID      : %g\n", Entry->PartitionTypeGUID);
-          DBG ("           UniquePartitionGUID    : %g\n", Entry->UniquePartitionGUID);
-          DBG ("           StartingLBA            : %d\n", Entry->StartingLBA);
-          DBG ("           EndingLBA              : %d\n", Entry->EndingLBA);
+  DBG ("         Read partition entries:\n");
 
-          CopyGuid (&TmpVolumesGUID->PartitionTypeGUID, &Entry->PartitionTypeGUID);
-          CopyGuid (&TmpVolumesGUID->UniquePartitionGUID, &Entry->UniquePartitionGUID);
+  PartEntry = AllocatePool (PartHdr->NumberOfPartitionEntries * PartHdr->SizeOfPartitionEntry);
+  Disk->Entries = AllocateZeroPool (PartHdr->NumberOfPartitionEntries * sizeof (REFIT_VOLUME_GUID));
 
-          AddListElement ((VOID ***)&gVolumesGUID, &gVolumesGUIDCount, TmpVolumesGUID);
-        }
-      }
+  if ((PartEntry == NULL) || (Disk->Entries == NULL)) {
+    Status = EFI_BUFFER_TOO_SMALL;
+    goto Finish;
+  }
+
+  DBG ("         BlockSize                : %d\n", BlockSize);
+  DBG ("         PartitionEntryLBA        : %x\n", PartHdr->PartitionEntryLBA);
+  DBG ("         NumberOfPartitionEntries : %d\n", PartHdr->NumberOfPartitionEntries);
+  DBG ("         SizeOfPartitionEntry     : %d\n", PartHdr->SizeOfPartitionEntry);
+
+  Status = DiskIo->ReadDisk (
+                     DiskIo,
+                     MediaId,
+                     MultU64x32 (PartHdr->PartitionEntryLBA, BlockSize),
+                     PartHdr->NumberOfPartitionEntries * (PartHdr->SizeOfPartitionEntry),
+                     PartEntry
+                   );
+
+  if (EFI_ERROR (Status)) {
+    DBG ("           Partition Entry ReadDisk error\n");
+    Status = EFI_DEVICE_ERROR;
+    goto Finish;
+  }
+
+  for (Index = 0; Index < PartHdr->NumberOfPartitionEntries; Index++) {
+    Entry = (EFI_PARTITION_ENTRY *) ((UINT8 *) PartEntry + Index * PartHdr->SizeOfPartitionEntry);
+    if ((Entry->StartingLBA == 0) && (Entry->EndingLBA == 0)) {
+      break;
     }
+
+    DBG ("           Partition              : %d\n", Index);
+    DBG ("           PartitionTypeGUID      : %g\n", Entry->PartitionTypeGUID);
+    DBG ("           UniquePartitionGUID    : %g\n", Entry->UniquePartitionGUID);
+    DBG ("           StartingLBA            : %d\n", Entry->StartingLBA);
+    DBG ("           EndingLBA              : %d\n", Entry->EndingLBA);
+
+    CopyGuid (&Disk->Entries[Index].PartitionTypeGUID, &Entry->PartitionTypeGUID);
+    CopyGuid (&Disk->Entries[Index].UniquePartitionGUID, &Entry->UniquePartitionGUID);
+  }
+
+  Disk->EntryCount = Index;
+
+  Finish:
+
+  if (EFI_ERROR (Status) && (Disk->Entries != NULL)) {
+    FreePool (Disk->Entries);
+    Disk->Entries = NULL;
   }
 
+  if (PartEntry != NULL) {
+    FreePool (PartEntry);
+  }
+
+  FreePool (PartHdr);
+
   return Status;
 }
 
+/** Sets PartitionTypeGUID of a GPT partition volume from its disk's partition table. */
+STATIC
+VOID
+SetPartitionTypeFromGPT (
+  IN OUT REFIT_VOLUME   *Volume
+) {
+  REFIT_DISK              *Disk;
+  HARDDRIVE_DEVICE_PATH   *HdPath;
+  EFI_GUID                *Guid;
+  UINT32                  Index;
+
+  HdPath = GetHardDriveDevicePath (Volume->DevicePath);
+
+  if (
+    (HdPath == NULL) ||
+    (HdPath->SignatureType != SIGNATURE_TYPE_GUID) ||
+    (Volume->WholeDiskDeviceHandle == NULL) ||
+    (Volume->WholeDiskBlockIO == NULL)
+  ) {
+    return;
+  }
+
+  Disk = GetDisk (Volume->WholeDiskDeviceHandle, Volume->WholeDiskBlockIO);
+  if ((Disk == NULL) || EFI_ERROR (ReadGPT (Disk))) {
+    return;
+  }
+
+  Guid = (EFI_GUID *)HdPath->Signature;
+  Index = HdPath->PartitionNumber - 1;
+
+  // partition number is the entry index, search only if the firmware numbers them otherwise
+  if ((HdPath->PartitionNumber == 0) || (Index >= Disk->EntryCount) || !CompareGuid (&Disk->Entries[Index].UniquePartitionGUID, Guid)) {
+    for (Index = 0; Index < Disk->EntryCount; Index++) {
+      if (CompareGuid (&Disk->Entries[Index].UniquePartitionGUID, Guid)) {
+        break;
+      }
+    }
+  }
+
+  if (Index < Disk->EntryCount) {
+    CopyGuid (&Volume->PartitionTypeGUID, &Disk->Entries[Index].PartitionTypeGUID);
+    //DBG (" ---> [PartitionTypeGUID]: %g\n", &Volume->PartitionTypeGUID);
+  }
+}
+
 //at start we have only Volume->DeviceHandle
 STATIC
 EFI_STATUS
@@ -910,15 +1122,16 @@ ScanVolumes () {
   EFI_STATUS                  Status;
   EFI_HANDLE                  *Handles = NULL;
   //EFI_DEVICE_PATH_PROTOCOL  *VolumeDevicePath;
-  EFI_GUID                    *Guid; //for debug only
   //EFI_INPUT_KEY Key;
   UINTN                       HandleCount = 0, HandleIndex,
                               PartitionIndex, i, SectorSum,
-                              VolumeIndex, VolumeIndex2;
+                              VolumeIndex;
   REFIT_VOLUME                *Volume, *WholeDiskVolume;
+  REFIT_DISK                  *Disk;
+  HARDDRIVE_DEVICE_PATH       *HdPath;
   MBR_PARTITION_INFO          *MbrTable;
   UINT8                       *SectorBuffer1, *SectorBuffer2;
-  INT32                       HVi, Index;
+  INT32                       HVi;
 
   //DBG ("Scanning volumes...\n");
   DbgHeader ("ScanVolumes");
@@ -938,7 +1151,7 @@ ScanVolumes () {
     return;
   }
 
-  FreeList ((VOID ***)&gVolumesGUID, &gVolumesGUIDCount);
+  FreeDisks ();
   FreeList ((VOID ***)&gVenMediaGUID, &gVenMediaGUIDCount);
 
   MsgLog ("Found %d volumes with blockIO:\n", HandleCount);
@@ -964,13 +1177,13 @@ ScanVolumes () {
 
     Status = ScanVolume (Volume);
     if (!EFI_ERROR (Status)) {
-      if (ReadGPT (Volume) == EFI_LOAD_ERROR) {
-        Guid = FindGPTPartitionGuidInDevicePath (Volume->DevicePath);
-        for (Index = 0; Index < gVolumesGUIDCount; Index++) {
-          if (CompareGuid (&gVolumesGUID[Index]->UniquePartitionGUID, Guid)) {
-            CopyGuid (&Volume->PartitionTypeGUID, &gVolumesGUID[Index]->PartitionTypeGUID);
-            //DBG (" ---> [PartitionTypeGUID]: %g\n", &Volume->PartitionTypeGUID);
-          }
+      if (Volume->WholeDiskDeviceHandle != NULL) {
+        SetPartitionTypeFromGPT (Volume);
+      } else if ((Volume->BlockIO != NULL) && (Volume->BlockIOOffset == 0)) {
+        // whole disk, partitions of it will find it here in second pass
+        Disk = GetDisk (Volume->DeviceHandle, Volume->BlockIO);
+        if (Disk != NULL) {
+          Disk->Volume = Volume;
         }
       }
 
@@ -1034,15 +1247,12 @@ ScanVolumes () {
     if (
       (Volume->BlockIO != NULL) &&
       (Volume->WholeDiskBlockIO != NULL) &&
-      (Volume->BlockIO != Volume->WholeDiskBlockIO)
+      (Volume->BlockIO != Volume->WholeDiskBlockIO) &&
+      (Volume->WholeDiskDeviceHandle != NULL)
     ) {
-      for (VolumeIndex2 = 0; VolumeIndex2 < gVolumesCount; VolumeIndex2++) {
-        if (
-          (gVolumes[VolumeIndex2]->BlockIO == Volume->WholeDiskBlockIO) &&
-          (gVolumes[VolumeIndex2]->BlockIOOffset == 0)
-        ) {
-          WholeDiskVolume = gVolumes[VolumeIndex2];
-        }
+      Disk = GetDisk (Volume->WholeDiskDeviceHandle, Volume->WholeDiskBlockIO);
+      if ((Disk != NULL) && (Disk->Volume != NULL) && (Disk->Volume->BlockIO == Volume->WholeDiskBlockIO)) {
+        WholeDiskVolume = Disk->Volume;
       }
     }
 
@@ -1052,6 +1262,30 @@ ScanVolumes () {
     ) {
       // check if this volume is one of the partitions in the table
       MbrTable = WholeDiskVolume->MbrPartitionTable;
+
+      // MBR partition node tells which entry it is, no need to compare sectors
+      HdPath = GetHardDriveDevicePath (Volume->DevicePath);
+      if (
+        (HdPath != NULL) &&
+        (HdPath->MBRType == MBR_TYPE_PCAT) &&
+        (HdPath->PartitionNumber >= 1) &&
+        (HdPath->PartitionNumber <= 4) &&
+        (MbrTable[HdPath->PartitionNumber - 1].StartLBA == HdPath->PartitionStart) &&
+        ((UINT64)(MbrTable[HdPath->PartitionNumber - 1].Size) == HdPath->PartitionSize) &&
+        !IS_EXTENDED_PART_TYPE (MbrTable[HdPath->PartitionNumber - 1].Type)
+      ) {
+        PartitionIndex = HdPath->PartitionNumber - 1;
+        Volume->IsMbrPartition = TRUE;
+        Volume->MbrPartitionTable = MbrTable;
+        Volume->MbrPartitionIndex = PartitionIndex;
+
+        if (Volume->VolName == NULL) {
+          Volume->VolName = PoolPrint (L"Partition %d", PartitionIndex + 1);
+        }
+
+        continue;
+      }
+
       SectorBuffer1 = AllocateAlignedPages (EFI_SIZE_TO_PAGES (512), 16);
       SectorBuffer2 = AllocateAlignedPages (EFI_SIZE_TO_PAGES (512), 16);
 
@@ -571,7 +571,8 @@ CheckDarwinVersion (
   EFI_STATUS    Status = EFI_INCOMPATIBLE_VERSION;
   CHAR8         *PlistBuffer = NULL;
   UINTN         PlistLen = 0;
-  TagPtr        Dict = NULL,  Prop = NULL;
+  TagPtr        Prop = NULL;
+  PLIST_DOCUMENT  *Doc = NULL;
 
   if (*OSVersion != NULL) {
     FreePool (*OSVersion);
@@ -592,18 +593,22 @@ CheckDarwinVersion (
   if (
     !EFI_ERROR (Status) &&
     (PlistBuffer != NULL) &&
-    !EFI_ERROR (ParseXML (PlistBuffer, 0, &Dict))
+    !EFI_ERROR (ParseXMLDocument (PlistBuffer, 0, &Doc))
   ) {
-    Prop = GetProperty (Dict, "ProductVersion");
+    Prop = GetProperty (Doc->Root, "ProductVersion");
     if ((Prop != NULL) && (Prop->type == kTagTypeString)) {
       *OSVersion = AllocateCopyPool (AsciiStrSize (Prop->string), Prop->string);
     }
 
-    Prop = GetProperty (Dict, "ProductBuildVersion");
+    Prop = GetProperty (Doc->Root, "ProductBuildVersion");
     if ((Prop != NULL) && (Prop->type == kTagTypeString)) {
       *BuildVersion = AllocateCopyPool (AsciiStrSize (Prop->string), Prop->string);
     }
 
+    FreeXMLDocument (Doc);
+  }
+
+  if (PlistBuffer != NULL) {
     FreePool (PlistBuffer);
   }
 
@@ -1189,6 +1194,8 @@ AddLoaderEntry (
       }
     }
 
+    Entry->Scanned = TRUE;
+
     AddDefaultMenu (Entry);
     AddMenuEntry (&gMainMenu, (REFIT_MENU_ENTRY *)Entry);
     return TRUE;
@@ -1487,6 +1494,232 @@ ScanLoader () {
   }
 }
 
+//
+// Boot entry cache, for FastBoot.
+// The default entry picked on the last boot is kept in NVRAM (kNvCloverBootEntry), so
+// next time only its volume is looked up and its loader checked, instead of probing
+// every volume for every known loader. Key covers config.plist and the startup disk
+// variables, so a change to either falls back to full scan.
+//
+
+#define LOADER_CACHE_SIGNATURE    SIGNATURE_32 ('C', 'L', 'B', 'E')
+
+typedef struct {
+  UINT32    Signature;
+  UINT32    Key;
+  UINT8     LoaderType;
+  UINT8     Reserved;
+  UINT16    Flags;
+  // CHAR16 VolumeDevicePathString[], LoaderPath[], LoadOptions[] follow, NULL terminated
+} LOADER_CACHE_HEADER;
+
+// what kNvCloverBootEntry holds, so SaveLoaderCache () rewrites it only if it changed
+STATIC VOID   *mLoaderCache = NULL;
+STATIC UINTN  mLoaderCacheSize = 0;
+
+STATIC
+UINT32
+GetLoaderCacheKey () {
+  UINT32    Key[3];
+
+  GetEfiBootDeviceFromNvram ();
+
+  Key[0] = gConfigCrc;
+  Key[1] = (gEfiBootDeviceData != NULL) ? GetCrc32 ((UINT8 *)gEfiBootDeviceData, GetDevicePathSize (gEfiBootDeviceData)) : 0;
+  Key[2] = (gBootCampHD != NULL) ? GetCrc32 ((UINT8 *)gBootCampHD, GetDevicePathSize (gBootCampHD)) : 0;
+
+  return GetCrc32 ((UINT8 *)Key, sizeof (Key));
+}
+
+/** Returns next NULL terminated string in cache data, or NULL if there is none within Size. */
+STATIC
+CHAR16 *
+GetLoaderCacheString (
+  IN OUT UINT8    **Ptr,
+  IN OUT UINTN    *Size
+) {
+  CHAR16    *Str = (CHAR16 *)*Ptr;
+  UINTN     Len, Max = *Size / sizeof (CHAR16);
+
+  for (Len = 0; Len < Max; Len++) {
+    if (Str[Len] == L'\0') {
+      *Ptr += (Len + 1) * sizeof (CHAR16);
+      *Size -= (Len + 1) * sizeof (CHAR16);
+      return Str;
+    }
+  }
+
+  return NULL;
+}
+
+/** Adds the cached default entry. TRUE if it is still there and still the default one. */
+BOOLEAN
+ScanLoaderCache () {
+  LOADER_CACHE_HEADER   *Header;
+  REFIT_VOLUME          *Volume = NULL;
+  UINT8                 *Data, *Ptr;
+  UINTN                 Size, Index;
+  CHAR16                *VolumeDevicePathString, *LoaderPath, *LoadOptions;
+  BOOLEAN               Found = FALSE;
+
+  DbgHeader ("ScanLoaderCache");
+
+  Data = GetNvramVariable (gNvramData[kNvCloverBootEntry].VariableName, gNvramData[kNvCloverBootEntry].Guid, NULL, &Size);
+  if (Data == NULL) {
+    DBG ("No cached entry\n");
+    return FALSE;
+  }
+
+  if (mLoaderCache != NULL) {
+    FreePool (mLoaderCache);
+  }
+
+  mLoaderCache = Data;
+  mLoaderCacheSize = Size;
+
+  Header = (LOADER_CACHE_HEADER *)Data;
+
+  if (
+    (Size <= sizeof (LOADER_CACHE_HEADER)) ||
+    (Header->Signature != LOADER_CACHE_SIGNATURE) ||
+    (Header->Key != GetLoaderCacheKey ())
+  ) {
+    DBG ("Cached entry is outdated\n");
+    goto Finish;
+  }
+
+  Ptr = Data + sizeof (LOADER_CACHE_HEADER);
+  Size -= sizeof (LOADER_CACHE_HEADER);
+
+  VolumeDevicePathString = GetLoaderCacheString (&Ptr, &Size);
+  LoaderPath = GetLoaderCacheString (&Ptr, &Size);
+  LoadOptions = GetLoaderCacheString (&Ptr, &Size);
+
+  if ((VolumeDevicePathString == NULL) || (LoaderPath == NULL) || (LoadOptions == NULL)) {
+    goto Finish;
+  }
+
+  for (Index = 0; Index < gVolumesCount; Index++) {
+    if (
+      (gVolumes[Index]->RootDir != NULL) &&
+      (gVolumes[Index]->DevicePathString != NULL) &&
+      (StrCmp (gVolumes[Index]->DevicePathString, VolumeDevicePathString) == 0)
+    ) {
+      Volume = gVolumes[Index];
+      break;
+    }
+  }
+
+  if (Volume == NULL) {
+    DBG ("Cached volume '%s' not found\n", VolumeDevicePathString);
+    goto Finish;
+  }
+
+  if (Volume->VolName == NULL) {
+    Volume->VolName = STR_S_UNKNOWN;
+  }
+
+  MsgLog ("- [%02d]: '%s' (cached)\n", Index, Volume->VolName);
+
+  // AddLoaderEntry () does the only FileExists ()
+  if (
+    AddLoaderEntry (
+      LoaderPath,
+      BIT_ISSET (Header->Flags, OSFLAG_NODEFAULTARGS) ? LoadOptions : NULL,
+      NULL,
+      Volume,
+      NULL,
+      Header->LoaderType,
+      Header->Flags
+    )
+  ) {
+    Found = (FindDefaultEntry () >= 0);
+  }
+
+  if (!Found) {
+    DBG ("Cached entry is not the default one anymore\n");
+    FreeList ((VOID ***)&gMainMenu.Entries, &gMainMenu.EntryCount);
+    gMainMenu.EntryCount = 0;
+  }
+
+  Finish:
+
+  return Found;
+}
+
+/** Remembers Entry for the next ScanLoaderCache (), only entries found by ScanLoader () are kept. */
+VOID
+SaveLoaderCache (
+  IN LOADER_ENTRY   *Entry
+) {
+  LOADER_CACHE_HEADER   *Header;
+  UINTN                 Size, VolumeSize, PathSize, OptionsSize;
+  UINT8                 *Ptr;
+  CHAR16                *LoadOptions;
+
+  if (
+    (Entry == NULL) ||
+    (Entry->me.Tag != TAG_LOADER) ||
+    !Entry->Scanned ||
+    (Entry->Volume == NULL) ||
+    (Entry->Volume->DevicePathString == NULL) ||
+    (Entry->LoaderPath == NULL)
+  ) {
+    return;
+  }
+
+  LoadOptions = (BIT_ISSET (Entry->Flags, OSFLAG_NODEFAULTARGS) && (Entry->LoadOptions != NULL)) ? Entry->LoadOptions : L"";
+
+  VolumeSize = StrSize (Entry->Volume->DevicePathString);
+  PathSize = StrSize (Entry->LoaderPath);
+  OptionsSize = StrSize (LoadOptions);
+  Size = sizeof (LOADER_CACHE_HEADER) + VolumeSize + PathSize + OptionsSize;
+
+  Header = AllocateZeroPool (Size);
+  if (Header == NULL) {
+    return;
+  }
+
+  Header->Signature = LOADER_CACHE_SIGNATURE;
+  Header->Key = GetLoaderCacheKey ();
+  Header->LoaderType = Entry->LoaderType;
+  // only what ScanLoader () passes to AddLoaderEntry (), the rest comes from settings
+  Header->Flags = Entry->Flags & OSFLAG_NODEFAULTARGS;
+
+  Ptr = (UINT8 *)(Header + 1);
+  CopyMem (Ptr, Entry->Volume->DevicePathString, VolumeSize);
+  Ptr += VolumeSize;
+  CopyMem (Ptr, Entry->LoaderPath, PathSize);
+  Ptr += PathSize;
+  CopyMem (Ptr, LoadOptions, OptionsSize);
+
+  // same entry as last boot (the usual case): leave the flash alone
+  if (mLoaderCache == NULL) {
+    mLoaderCache = GetNvramVariable (gNvramData[kNvCloverBootEntry].VariableName, gNvramData[kNvCloverBootEntry].Guid, NULL, &mLoaderCacheSize);
+  }
+
+  if ((mLoaderCache != NULL) && (mLoaderCacheSize == Size) && (CompareMem (mLoaderCache, Header, Size) == 0)) {
+    DBG ("Cached entry unchanged\n");
+    FreePool (Header);
+    return;
+  }
+
+  SetNvramVariable (
+    gNvramData[kNvCloverBootEntry].VariableName,
+    gNvramData[kNvCloverBootEntry].Guid,
+    gNvramData[kNvCloverBootEntry].Attribute,
+    Size,
+    Header
+  );
+
+  if (mLoaderCache != NULL) {
+    FreePool (mLoaderCache);
+  }
+
+  mLoaderCache = Header;
+  mLoaderCacheSize = Size;
+}
+
 STATIC
 VOID
 AddCustomEntry (
@@ -1642,7 +1875,7 @@ AddCustomEntry (
 
       Image = LoadImage (Volume->RootDir, Custom->ImagePath);
       if (Image == NULL) {
-        Image = LoadImage (gThemeDir, Custom->ImagePath);
+        Image = LoadThemeImage (Custom->ImagePath, 0, 0);
         if (Image == NULL) {
           Image = LoadImage (gSelfDir, Custom->ImagePath);
           if (Image == NULL) {
@@ -1654,7 +1887,7 @@ AddCustomEntry (
             ImageHover = LoadImage (gSelfDir, ImageHoverPath);
           }
         } else {
-          ImageHover = LoadImage (gThemeDir, ImageHoverPath);
+          ImageHover = LoadThemeImage (ImageHoverPath, 0, 0);
         }
       } else {
         ImageHover = LoadImage (Volume->RootDir, ImageHoverPath);
@@ -1669,7 +1902,7 @@ AddCustomEntry (
     if ((DriveImage == NULL) && Custom->DriveImagePath) {
       DriveImage = LoadImage (Volume->RootDir, Custom->DriveImagePath);
       if (DriveImage == NULL) {
-        DriveImage = LoadImage (gThemeDir, Custom->DriveImagePath);
+        DriveImage = LoadThemeImage (Custom->DriveImagePath, 0, 0);
         if (DriveImage == NULL) {
           DriveImage = LoadImage (gSelfDir, Custom->DriveImagePath);
           if (DriveImage == NULL) {
@@ -2018,6 +2251,7 @@ DuplicateLoaderEntry (
     DuplicateEntry->OSVersion             = Entry->OSVersion;
     DuplicateEntry->OSBuildVersion        = Entry->OSBuildVersion;
     DuplicateEntry->KernelAndKextPatches  = Entry->KernelAndKextPatches;
+    DuplicateEntry->Scanned               = Entry->Scanned;
   }
 
   return DuplicateEntry;
@@ -265,7 +265,7 @@ AddCustomTool () {
 
         Image = LoadImage (Volume->RootDir, Custom->ImagePath);
         if (Image == NULL) {
-          Image = LoadImage (gThemeDir, Custom->ImagePath);
+          Image = LoadThemeImage (Custom->ImagePath, 0, 0);
           if (Image == NULL) {
             Image = LoadImage (gSelfDir, Custom->ImagePath);
             if (Image == NULL) {
@@ -277,7 +277,7 @@ AddCustomTool () {
               ImageHover = LoadImage (gSelfDir, ImageHoverPath);
             }
           } else {
-            ImageHover = LoadImage (gThemeDir, ImageHoverPath);
+            ImageHover = LoadThemeImage (ImageHoverPath, 0, 0);
           }
         } else {
           ImageHover = LoadImage (Volume->RootDir, ImageHoverPath);
@@ -455,13 +455,193 @@ PatchAllTablesHeaders () {
   }
 }
 
+//
+// Patched DSDT / SSDT kept in Misc, so the next boot with the same OEM tables,
+// patches and hardware installs them without running the patchers again.
+// Only tables used in this boot are written back, stale ones drop out.
+//
+
+#define ACPI_CACHE_SIGNATURE  SIGNATURE_32 ('C','A','C','P')
+#define ACPI_CACHE_VERSION    1
+
+typedef struct {
+  UINT32    Signature;
+  UINT32    Version;
+  UINT32    Count;
+  UINT32    DataCrc;
+  UINT32    DataSize;
+} ACPI_CACHE_HEADER;
+
+typedef struct {
+  UINT32    Key;
+  UINT32    Length;
+} ACPI_CACHE_ENTRY;
+
+STATIC UINT8    *mAcpiCache = NULL;
+STATIC UINTN    mAcpiCacheSize = 0;
+STATIC UINT8    *mAcpiCacheOut = NULL;
+STATIC UINTN    mAcpiCacheOutSize = 0;
+STATIC UINT32   mAcpiCacheOutCount = 0;
+STATIC BOOLEAN  mAcpiCacheDirty = FALSE;
+
+STATIC
+VOID
+AcpiCacheLoad () {
+  EFI_STATUS          Status;
+  ACPI_CACHE_HEADER   *Header;
+
+  Status = LoadFile (gSelfRootDir, ACPI_PATCH_CACHE, &mAcpiCache, &mAcpiCacheSize);
+  if (EFI_ERROR (Status) || (mAcpiCache == NULL)) {
+    mAcpiCache = NULL;
+    mAcpiCacheSize = 0;
+    return;
+  }
+
+  Header = (ACPI_CACHE_HEADER *)mAcpiCache;
+
+  if (
+    (mAcpiCacheSize < sizeof (ACPI_CACHE_HEADER)) ||
+    (Header->Signature != ACPI_CACHE_SIGNATURE) ||
+    (Header->Version != ACPI_CACHE_VERSION) ||
+    (Header->DataSize != (mAcpiCacheSize - sizeof (ACPI_CACHE_HEADER))) ||
+    (Header->DataCrc != GetCrc32 (mAcpiCache + sizeof (ACPI_CACHE_HEADER), Header->DataSize))
+  ) {
+    DBG ("ACPI cache: invalid, ignored\n");
+    FreePool (mAcpiCache);
+    mAcpiCache = NULL;
+    mAcpiCacheSize = 0;
+  }
+}
+
+STATIC
+UINT8 *
+AcpiCacheFind (
+  UINT32    Key,
+  UINT32    *Length
+) {
+  ACPI_CACHE_ENTRY  *Entry;
+  UINTN             Pos;
+  UINT32            Index, Count;
+
+  if (mAcpiCache == NULL) {
+    return NULL;
+  }
+
+  Count = ((ACPI_CACHE_HEADER *)mAcpiCache)->Count;
+  Pos = sizeof (ACPI_CACHE_HEADER);
+
+  for (Index = 0; Index < Count; Index++) {
+    if ((Pos + sizeof (ACPI_CACHE_ENTRY)) > mAcpiCacheSize) {
+      break;
+    }
+
+    Entry = (ACPI_CACHE_ENTRY *)(mAcpiCache + Pos);
+    Pos += sizeof (ACPI_CACHE_ENTRY);
+
+    if (Entry->Length > (mAcpiCacheSize - Pos)) {
+      break;
+    }
+
+    if (Entry->Key == Key) {
+      *Length = Entry->Length;
+      return mAcpiCache + Pos;
+    }
+
+    Pos += Entry->Length;
+  }
+
+  return NULL;
+}
+
+STATIC
+VOID
+AcpiCacheAdd (
+  UINT32    Key,
+  UINT8     *Table,
+  UINT32    Length,
+  BOOLEAN   Hit
+) {
+  ACPI_CACHE_ENTRY  Entry;
+  UINT8             *NewOut;
+  UINTN             NewSize = mAcpiCacheOutSize + sizeof (ACPI_CACHE_ENTRY) + Length;
+
+  NewOut = ReallocatePool (mAcpiCacheOutSize, NewSize, mAcpiCacheOut);
+  if (NewOut == NULL) {
+    // out of memory, the tables not in the file are simply patched again next boot
+    if (mAcpiCacheOut != NULL) {
+      FreePool (mAcpiCacheOut);
+      mAcpiCacheOut = NULL;
+    }
+
+    mAcpiCacheOutSize = 0;
+    mAcpiCacheOutCount = 0;
+    mAcpiCacheDirty = FALSE;
+    return;
+  }
+
+  mAcpiCacheOut = NewOut;
+
+  Entry.Key = Key;
+  Entry.Length = Length;
+  CopyMem (mAcpiCacheOut + mAcpiCacheOutSize, &Entry, sizeof (ACPI_CACHE_ENTRY));
+  CopyMem (mAcpiCacheOut + mAcpiCacheOutSize + sizeof (ACPI_CACHE_ENTRY), Table, Length);
+
+  mAcpiCacheOutSize = NewSize;
+  mAcpiCacheOutCount++;
+
+  if (!Hit) {
+    mAcpiCacheDirty = TRUE;
+  }
+}
+
+STATIC
+VOID
+AcpiCacheFlush () {
+  ACPI_CACHE_HEADER   *Header;
+  UINT8               *Buffer;
+
+  if (mAcpiCacheDirty && (mAcpiCacheOut != NULL)) {
+    Buffer = AllocatePool (sizeof (ACPI_CACHE_HEADER) + mAcpiCacheOutSize);
+    if (Buffer != NULL) {
+      Header = (ACPI_CACHE_HEADER *)Buffer;
+      Header->Signature = ACPI_CACHE_SIGNATURE;
+      Header->Version = ACPI_CACHE_VERSION;
+      Header->Count = mAcpiCacheOutCount;
+      Header->DataCrc = GetCrc32 (mAcpiCacheOut, mAcpiCacheOutSize);
+      Header->DataSize = (UINT32)mAcpiCacheOutSize;
+      CopyMem (Buffer + sizeof (ACPI_CACHE_HEADER), mAcpiCacheOut, mAcpiCacheOutSize);
+
+      DBG ("ACPI cache: save %d tables ... %r\n", mAcpiCacheOutCount,
+        SaveFile (gSelfRootDir, ACPI_PATCH_CACHE, Buffer, sizeof (ACPI_CACHE_HEADER) + mAcpiCacheOutSize)
+      );
+
+      FreePool (Buffer);
+    }
+  }
+
+  if (mAcpiCache != NULL) {
+    FreePool (mAcpiCache);
+    mAcpiCache = NULL;
+  }
+
+  if (mAcpiCacheOut != NULL) {
+    FreePool (mAcpiCacheOut);
+    mAcpiCacheOut = NULL;
+  }
+
+  mAcpiCacheSize = 0;
+  mAcpiCacheOutSize = 0;
+  mAcpiCacheOutCount = 0;
+  mAcpiCacheDirty = FALSE;
+}
+
 VOID
 PatchAllSSDT () {
   EFI_STATUS                      Status = EFI_SUCCESS;
   EFI_ACPI_DESCRIPTION_HEADER     *TableEntry;
   EFI_PHYSICAL_ADDRESS            Ssdt;
-  UINT32                          Index, EntryCount, SsdtLen;
-  UINT8                           *BasePtr, *Ptr;
+  UINT32                          Index, EntryCount, SsdtLen, Key, CachedLen;
+  UINT8                           *BasePtr, *Ptr, *Cached;
   CHAR8                           OemTableId[ACPI_OEM_TABLE_ID_SIZE + 1];
   UINT64                          Entry64;
 
@@ -496,7 +676,18 @@ PatchAllSSDT () {
       Ptr = (UINT8 *)(UINTN)Ssdt;
       CopyMem (Ptr, (VOID *)TableEntry, SsdtLen);
 
-      SsdtLen = PatchBinACPI (Ptr, SsdtLen);
+      Key = GetPatchBinACPIKey (Ptr, SsdtLen);
+      Cached = AcpiCacheFind (Key, &CachedLen);
+
+      if ((Cached != NULL) && (CachedLen <= (SsdtLen + 4096))) {
+        MsgLog (" - cached (key %08x)\n", Key);
+        CopyMem (Ptr, Cached, CachedLen);
+        SsdtLen = CachedLen;
+        AcpiCacheAdd (Key, Ptr, SsdtLen, TRUE);
+      } else {
+        SsdtLen = PatchBinACPI (Ptr, SsdtLen);
+        AcpiCacheAdd (Key, Ptr, SsdtLen, FALSE);
+      }
 
       CopyMem (BasePtr, &Ssdt, sizeof (UINT64));
 
@@ -1291,6 +1482,7 @@ SaveOemDsdt (
 
     if (FullPatch) {
       FixBiosDsdt (Buffer, FALSE);
+      PatchBinACPIFree ();
       DsdtLen = ((EFI_ACPI_DESCRIPTION_HEADER *)Buffer)->Length;
     } else if (!FixedDsdt) {
       goto Finish;
@@ -1553,7 +1745,27 @@ PatchACPI (
 
   DBG ("Drop _DSM mask=0x%04x\n", gSettings.DropOEM_DSM); // dropDSM
 
-  FixBiosDsdt ((UINT8 *)(UINTN)FadtPointer->XDsdt, DsdtLoaded);
+  AcpiCacheLoad ();
+
+  if (DsdtLoaded) {
+    FixBiosDsdt ((UINT8 *)(UINTN)FadtPointer->XDsdt, DsdtLoaded);
+  } else {
+    UINT8   *Cached;
+    UINT32  Key, CachedLen;
+
+    Key = GetFixBiosDsdtKey ((UINT8 *)(UINTN)FadtPointer->XDsdt);
+    Cached = AcpiCacheFind (Key, &CachedLen);
+
+    if ((Cached != NULL) && (CachedLen <= BufferLen)) {
+      MsgLog ("DSDT: cached (key %08x), fixes skipped\n", Key);
+      CopyMem ((VOID *)(UINTN)FadtPointer->XDsdt, Cached, CachedLen);
+      AcpiCacheAdd (Key, Cached, CachedLen, TRUE);
+    } else {
+      FixBiosDsdt ((UINT8 *)(UINTN)FadtPointer->XDsdt, DsdtLoaded);
+      TableHeader = (EFI_ACPI_DESCRIPTION_HEADER *)(UINTN)FadtPointer->XDsdt;
+      AcpiCacheAdd (Key, (UINT8 *)TableHeader, TableHeader->Length, FALSE);
+    }
+  }
 
   // Drop tables
   if (gSettings.ACPIDropTables) {
@@ -1583,6 +1795,9 @@ PatchACPI (
     //DropTableFromXSDT (XXXX_SIGN, 0, 0);
   }
 
+  AcpiCacheFlush ();
+  PatchBinACPIFree ();
+
   InjectSSDT:
 
   if (gACPIUserLoad) {
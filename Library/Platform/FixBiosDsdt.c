@@ -528,6 +528,61 @@ FindCPU (
   return;
 }
 
+//
+// Lightweight AML namespace: scopes, devices, processors, thermal zones,
+// power resources and methods with their byte offsets. It is built on the
+// first lookup and dropped by every edit that moves data.
+//
+
+#define AML_TREE_PROCESSOR      0x83
+#define AML_TREE_POWER_RES      0x84
+#define AML_TREE_THERMAL_ZONE   0x85
+#define AML_TREE_MAX_DEPTH      64
+
+typedef struct AML_TREE_NODE AML_TREE_NODE;
+
+struct AML_TREE_NODE {
+  UINT8           Type;     // AML_CHUNK_SCOPE, AML_CHUNK_METHOD, AML_CHUNK_DEVICE or AML_TREE_*
+  UINT32          SizeAdr;  // PkgLength, what FIX* routines keep as device address
+  UINT32          End;
+  UINT32          NameAdr;  // last NameSeg
+  UINT32          AdrAdr;   // Name (_ADR, ...), 0 if absent
+  UINT32          HidAdr;   // Name (_HID, ...), 0 if absent
+  AML_TREE_NODE   *Parent;
+  AML_TREE_NODE   *First;
+  AML_TREE_NODE   *Last;
+  AML_TREE_NODE   *Next;
+};
+
+STATIC AML_TREE_NODE  *mAmlTree = NULL;
+STATIC UINT8          *mAmlTreeDsdt = NULL;
+STATIC UINT32         mAmlTreeLen = 0;
+
+STATIC
+VOID
+AmlTreeFree (
+  AML_TREE_NODE   *Node
+) {
+  AML_TREE_NODE   *Child = Node->First, *Next;
+
+  while (Child != NULL) {
+    Next = Child->Next;
+    AmlTreeFree (Child);
+    Child = Next;
+  }
+
+  FreePool (Node);
+}
+
+STATIC
+VOID
+AmlTreeInvalidate () {
+  if (mAmlTree != NULL) {
+    AmlTreeFree (mAmlTree);
+    mAmlTree = NULL;
+  }
+}
+
 // Start => move data start address
 // Offset => data move how many byte
 // Len => initial length of the buffer
@@ -542,16 +597,14 @@ MoveData (
   UINT32    Len,
   INT32     Offset
 ) {
-  UINT32    i;
+  AmlTreeInvalidate ();
 
   if (Offset < 0) {
-    for (i = Start; i < Len + Offset; i++) {
-      Buffer[i] = Buffer[i - Offset];
-    }
-  } else { // data move to back
-    for (i = Len - 1; i >= Start; i--) {
-      Buffer[i + Offset] = Buffer[i];
+    if ((INT64)Start < ((INT64)Len + Offset)) {
+      CopyMem (Buffer + Start, Buffer + Start - Offset, Len + Offset - Start);
     }
+  } else if ((Offset > 0) && (Start < Len)) { // data move to back
+    CopyMem (Buffer + Start + Offset, Buffer + Start, Len - Start);
   }
 
   return Len + Offset;
@@ -763,34 +816,6 @@ CmpPNP (
   );
 }
 
-STATIC
-INT32
-CmpDev (
-  UINT8     *Dsdt,
-  UINT32    i,
-  UINT8     *Name
-) {
-  if (
-    (Dsdt[i + 0] == Name[0]) && (Dsdt[i + 1] == Name[1]) &&
-    (Dsdt[i + 2] == Name[2]) && (Dsdt[i + 3] == Name[3]) &&
-    (
-      ((Dsdt[i - 2] == 0x82) && (Dsdt[i - 3] == 0x5B) && (Dsdt[i - 1] < 0x40)) ||
-      ((Dsdt[i - 3] == 0x82) && (Dsdt[i - 4] == 0x5B) && ((Dsdt[i - 2] & 0xF0) == 0x40)) ||
-      ((Dsdt[i - 4] == 0x82) && (Dsdt[i - 5] == 0x5B) && ((Dsdt[i - 3] & 0xF0) == 0x80))
-    )
-  ) {
-    if (Dsdt[i - 5] == 0x5B) {
-      return i - 3;
-    } else if (Dsdt[i - 4] == 0x5B) {
-      return i - 2;
-    } else {
-      return i - 1;
-    }
-  }
-
-  return 0;
-}
-
 //the procedure can find BIN array UNSIGNED CHAR8 sizeof N inside part of large array "Dsdt" size of len
 // return position or -1 if not found
 
@@ -822,56 +847,20 @@ FindBin (
   return -1;
 }
 
-//if (!FindMethod (Dsdt, len, "DTGP"))
-// return address of size field. Assume size not more then 0x0FFF = 4095 bytes
-//assuming only short methods
-
-STATIC
-UINT32
-FindMethod (
-  UINT8     *Dsdt,
-  UINT32    Len,
-  CHAR8     *Name
-) {
-  UINT32  i;
-
-  for (i = 0; i < Len - 7; i++) {
-    if (
-      ((Dsdt[i] == 0x14) || (Dsdt[i + 1] == 0x14) || (Dsdt[i - 1] == 0x14)) &&
-      (Dsdt[i + 3] == Name[0]) && (Dsdt[i + 4] == Name[1]) &&
-      (Dsdt[i + 5] == Name[2]) && (Dsdt[i + 6] == Name[3])
-    ) {
-      if (Dsdt[i - 1] == 0x14) {
-        return i;
-      }
-
-      return (Dsdt[i + 1] == 0x14) ? (i + 2) : (i + 1); //pointer to size field
-    }
-  }
-
-  return 0;
-}
-
-//this procedure corrects size of outer method. Embedded methods is not proposed
+//this procedure finds size field of outer method. Embedded methods is not proposed
 // Adr - a place of changes
-// shift - a size of changes
+// return 0 if there is no outer method
 
 STATIC
 UINT32
-CorrectOuterMethod (
+FindOuterMethod (
   UINT8   *Dsdt,
-  UINT32  Len,
-  UINT32  Adr,
-  INT32   Shift
+  UINT32  Adr
 ) {
-  INT32     i,  k, Offset = 0;
+  INT32     i,  k;
   UINT32    Size = 0;
   CHAR8     Name[5];
 
-  if (Shift == 0) {
-    return Len;
-  }
-
   i = Adr; //usually Adr = @5B - 1 = Sizefield - 3
   while (i-- > 0x20) {  //find method that previous to Adr
     k = i + 1;
@@ -894,38 +883,36 @@ CorrectOuterMethod (
 
       if ((k + Size) > (Adr + 4)) {  //Yes - it is outer
         DBG ("found outer method %a begin=%x end=%x\n", Name, k, k + Size);
-        Offset = WriteSize (k, Dsdt, Len, Shift);  //size corrected to sizeOffset at address j
-        //Shift += Offset;
-        Len += Offset;
+        return k;
       }  //else not an outer method
       break;
     }
   }
 
-  return Len;
+  return 0;
 }
 
-//return final length of Dsdt
+//collect size fields of devices and \_SB scope around Adr, innermost first
+//return number of found
+
+#define DSDT_MAX_OUTERS 64
 
 STATIC
-UINT32
-CorrectOuters (
+UINTN
+FindOuters (
   UINT8     *Dsdt,
   UINT32    Len,
   UINT32    Adr,
-  INT32     Shift
+  UINT32    *Outers,
+  UINTN     MaxOuters
 ) {
-  INT32     i, j, k, Offset = 0;
+  INT32     i, j, k;
   UINT32    SBSIZE = 0, SBADR = 0, Size = 0;
-  BOOLEAN   SBFound = FALSE;
-
-  if (Shift == 0) {
-    return Len;
-  }
+  UINTN     Count = 0;
 
   i = Adr; //usually Adr = @5B - 1 = Sizefield - 3
 
-  while (i > 0x20) {  //find devices that previous to Adr
+  while ((i > 0x20) && (Count < MaxOuters)) {  //find devices that previous to Adr
     //check device
     k = i + 2;
     if (
@@ -937,9 +924,7 @@ CorrectOuters (
       if (Size) {
         if ((k + Size) > (Adr + 4)) {  //Yes - it is outer
           //DBG ("found outer device begin=%x end=%x\n", k, k + Size);
-          Offset = WriteSize (k, Dsdt, Len, Shift);  //Size corrected to SizeOffset at address j
-          Shift += Offset;
-          Len += Offset;
+          Outers[Count++] = k;
         }  //else not an outer device
       } //else wrong Size field - not a device
     } //else not a device
@@ -969,29 +954,339 @@ CorrectOuters (
             //if found
             k = SBADR - 6;
 
-            if ((SBADR + SBSIZE) > Adr + 4) {  //Yes - it is outer
+            if (((SBADR + SBSIZE) > Adr + 4) && (Count < MaxOuters)) {  //Yes - it is outer
               //DBG ("found outer scope begin=%x end=%x\n", SBADR, SBADR + SBSIZE);
-              Offset = WriteSize (SBADR, Dsdt, Len, Shift);
-              Shift += Offset;
-              Len += Offset;
-              SBFound = TRUE;
-              break;  //SB found
+              Outers[Count++] = SBADR;
+              return Count;  //SB found
             }  //else not an outer scope
           }
         }
       }
     } //else not a scope
 
-    if (SBFound) {
-      break;
-    }
-
     i = k - 3;    //if found then search again from found
   }
 
+  return Count;
+}
+
+//return final length of Dsdt
+
+STATIC
+UINT32
+CorrectOuters (
+  UINT8     *Dsdt,
+  UINT32    Len,
+  UINT32    Adr,
+  INT32     Shift
+) {
+  UINT32    Outers[DSDT_MAX_OUTERS];
+  UINTN     Count, Index;
+  INT32     Offset;
+
+  if (Shift == 0) {
+    return Len;
+  }
+
+  Count = FindOuters (Dsdt, Len, Adr, Outers, ARRAY_SIZE (Outers));
+
+  for (Index = 0; Index < Count; Index++) {
+    Offset = WriteSize (Outers[Index], Dsdt, Len, Shift);  //Size corrected to Shift at address Outers[Index]
+    Shift += Offset;
+    Len += Offset;
+  }
+
   return Len;
 }
 
+//
+// Deferred editing. Splices are recorded against the buffer as it is and
+// applied by DsdtEditCommit () in one pass, together with the PkgLength of
+// every outer method / device / scope, instead of MoveData () + CorrectOuters ()
+// per edit. Splices of one batch must not overlap. Only FixAny () / PatchBinACPI ()
+// edit this way, the FIX* passes look up devices in what the pass before wrote
+// and keep editing in place, one insertion each.
+//
+
+typedef struct {
+  UINT32    Adr;      // in the buffer before the edits
+  UINT32    DelLen;
+  UINT8     *Ins;
+  UINT32    InsLen;
+  BOOLEAN   IsSize;   // PkgLength at Adr, DelLen is its width
+  UINT32    OldSize;
+  UINT32    NewSize;
+  INT32     Shift;    // sum of splices inside
+} DSDT_SPLICE;
+
+typedef struct {
+  UINT8         *Dsdt;
+  UINT32        Len;
+  DSDT_SPLICE   *Splices;
+  UINTN         Count;
+  UINTN         Capacity;
+  BOOLEAN       Failed;   // out of memory, Dsdt is left as it was
+} DSDT_EDITOR;
+
+STATIC
+UINT32
+PkgLengthWidth (
+  UINT32  Size
+) {
+  return (Size <= 0x3F) ? 1 : ((Size <= 0xFFF) ? 2 : ((Size <= 0xFFFFF) ? 3 : 4));
+}
+
+STATIC
+VOID
+DsdtEditInit (
+  DSDT_EDITOR   *Editor,
+  UINT8         *Dsdt,
+  UINT32        Len
+) {
+  ZeroMem (Editor, sizeof (DSDT_EDITOR));
+  Editor->Dsdt = Dsdt;
+  Editor->Len = Len;
+}
+
+STATIC
+VOID
+DsdtEditFree (
+  DSDT_EDITOR   *Editor
+) {
+  if (Editor->Splices != NULL) {
+    FreePool (Editor->Splices);
+  }
+
+  ZeroMem (Editor, sizeof (DSDT_EDITOR));
+}
+
+STATIC
+DSDT_SPLICE *
+DsdtEditAdd (
+  DSDT_EDITOR   *Editor
+) {
+  DSDT_SPLICE   *Splice;
+
+  if (Editor->Count == Editor->Capacity) {
+    Splice = ReallocatePool (
+               Editor->Capacity * sizeof (DSDT_SPLICE),
+               (Editor->Capacity + 32) * sizeof (DSDT_SPLICE),
+               Editor->Splices
+             );
+
+    if (Splice == NULL) {
+      Editor->Failed = TRUE;
+      return NULL;
+    }
+
+    Editor->Splices = Splice;
+    Editor->Capacity += 32;
+  }
+
+  Splice = &Editor->Splices[Editor->Count++];
+  ZeroMem (Splice, sizeof (DSDT_SPLICE));
+
+  return Splice;
+}
+
+STATIC
+VOID
+DsdtEditResize (
+  DSDT_EDITOR   *Editor,
+  UINT32        Adr,
+  INT32         Shift
+) {
+  DSDT_SPLICE   *Splice;
+  UINT32        Size;
+  UINTN         Index;
+
+  for (Index = 0; Index < Editor->Count; Index++) {
+    if (Editor->Splices[Index].IsSize && (Editor->Splices[Index].Adr == Adr)) {
+      Editor->Splices[Index].Shift += Shift;
+      return;
+    }
+  }
+
+  Size = AcpiGetSize (Editor->Dsdt, Adr);
+  if (!Size) {
+    return;
+  }
+
+  Splice = DsdtEditAdd (Editor);
+  if (Splice != NULL) {
+    Splice->Adr = Adr;
+    Splice->DelLen = (Editor->Dsdt[Adr] >> 6) + 1;
+    Splice->IsSize = TRUE;
+    Splice->OldSize = Size;
+    Splice->Shift = Shift;
+  }
+}
+
+//replace DelLen bytes at Adr by InsLen bytes of Ins (kept until commit),
+//outer method and devices are found the same way as CorrectOuters does
+
+STATIC
+BOOLEAN
+DsdtEditReplace (
+  DSDT_EDITOR   *Editor,
+  UINT32        Adr,
+  UINT32        DelLen,
+  UINT8         *Ins,
+  UINT32        InsLen
+) {
+  DSDT_SPLICE   *Splice;
+  UINT32        Outers[DSDT_MAX_OUTERS], k;
+  UINTN         Count, Index;
+  INT32         Shift = (INT32)InsLen - (INT32)DelLen;
+
+  Splice = DsdtEditAdd (Editor);
+  if (Splice == NULL) {
+    return FALSE;
+  }
+
+  Splice->Adr = Adr;
+  Splice->DelLen = DelLen;
+  Splice->Ins = Ins;
+  Splice->InsLen = InsLen;
+
+  if (Shift != 0) {
+    k = FindOuterMethod (Editor->Dsdt, Adr - 2);
+    if (k != 0) {
+      DsdtEditResize (Editor, k, Shift);
+    }
+
+    Count = FindOuters (Editor->Dsdt, Editor->Len, Adr - 3, Outers, ARRAY_SIZE (Outers));
+    for (Index = 0; Index < Count; Index++) {
+      DsdtEditResize (Editor, Outers[Index], Shift);
+    }
+  }
+
+  return TRUE;
+}
+
+//return final length of Dsdt
+
+STATIC
+UINT32
+DsdtEditCommit (
+  DSDT_EDITOR   *Editor
+) {
+  DSDT_SPLICE   *Splices = Editor->Splices, Tmp;
+  UINT8         *Out;
+  UINT32        NewLen, Src, Dst, End, Content, Width;
+  INT32         Delta;
+  UINTN         Count = Editor->Count, i, j;
+
+  if ((Count == 0) || Editor->Failed) {
+    return Editor->Len;
+  }
+
+  // sort by address, size fields before splices at the same place
+  for (i = 1; i < Count; i++) {
+    Tmp = Splices[i];
+
+    for (j = i; (j > 0) && (
+           (Splices[j - 1].Adr > Tmp.Adr) ||
+           ((Splices[j - 1].Adr == Tmp.Adr) && !Splices[j - 1].IsSize && Tmp.IsSize)
+         ); j--) {
+      Splices[j] = Splices[j - 1];
+    }
+
+    Splices[j] = Tmp;
+  }
+
+  // a size field cut by a splice cannot be rewritten, drop it
+  for (i = 0, j = 0; i < Count; i++) {
+    if ((j > 0) && ((Splices[j - 1].Adr + Splices[j - 1].DelLen) > Splices[i].Adr)) {
+      if (Splices[i].IsSize) {
+        DBG ("size field at %x overlaps an edit, skipped\n", Splices[i].Adr);
+        continue;
+      }
+
+      if (!Splices[j - 1].IsSize) {
+        DBG ("overlapped edits at %x, nothing changed\n", Splices[i].Adr);
+        Editor->Count = 0;
+        return Editor->Len;
+      }
+
+      DBG ("size field at %x overlaps an edit, skipped\n", Splices[j - 1].Adr);
+      j--;
+    }
+
+    Splices[j++] = Splices[i];
+  }
+
+  Count = j;
+
+  // inner containers first: a PkgLength growing or shrinking resizes its outers too
+  for (i = Count; i-- > 0;) {
+    if (!Splices[i].IsSize) {
+      continue;
+    }
+
+    End = Splices[i].Adr + Splices[i].OldSize;
+    Delta = Splices[i].Shift;
+
+    for (j = i + 1; (j < Count) && (Splices[j].Adr < End); j++) {
+      if (Splices[j].IsSize) {
+        Delta += (INT32)Splices[j].InsLen - (INT32)Splices[j].DelLen;
+      }
+    }
+
+    Content = (UINT32)((INT32)(Splices[i].OldSize - Splices[i].DelLen) + Delta);
+    Width = Splices[i].DelLen;
+
+    for (j = 0; j < 4; j++) {
+      if (PkgLengthWidth (Content + Width) == Width) {
+        break;
+      }
+
+      Width = PkgLengthWidth (Content + Width);
+    }
+
+    Splices[i].NewSize = Content + Width;
+    Splices[i].InsLen = Width;
+  }
+
+  NewLen = Editor->Len;
+  for (i = 0; i < Count; i++) {
+    NewLen += Splices[i].InsLen - Splices[i].DelLen;
+  }
+
+  Out = AllocatePool (NewLen);
+  if (Out == NULL) {
+    Editor->Failed = TRUE;
+    Editor->Count = 0;
+    return Editor->Len;
+  }
+
+  for (i = 0, Src = 0, Dst = 0; i < Count; i++) {
+    CopyMem (Out + Dst, Editor->Dsdt + Src, Splices[i].Adr - Src);
+    Dst += Splices[i].Adr - Src;
+
+    if (Splices[i].IsSize) {
+      AmlWriteSize (Splices[i].NewSize, (CHAR8 *)Out, Dst);
+    } else if (Splices[i].Ins != NULL) {
+      CopyMem (Out + Dst, Splices[i].Ins, Splices[i].InsLen);
+    } else {
+      ZeroMem (Out + Dst, Splices[i].InsLen);
+    }
+
+    Dst += Splices[i].InsLen;
+    Src = Splices[i].Adr + Splices[i].DelLen;
+  }
+
+  CopyMem (Out + Dst, Editor->Dsdt + Src, Editor->Len - Src);
+  CopyMem (Editor->Dsdt, Out, NewLen);
+  FreePool (Out);
+  AmlTreeInvalidate ();
+
+  Editor->Len = NewLen;
+  Editor->Count = 0;
+
+  return NewLen;
+}
+
 //ReplaceName (Dsdt, len, "AZAL", "HDEF");
 
 STATIC
@@ -1041,87 +1336,493 @@ ReplaceName (
   return j; //number of replacement
 }
 
-//the procedure search nearest "Device" code before given address
-//should restrict the search by 6 bytes... OK, 10, .. until Dsdt begin
-//hmmm? will check device name
+//return length of NameString at Adr or 0 if it is not a name,
+//SegAdr gets the last NameSeg
 
 STATIC
 UINT32
-DevFind (
+AmlTreeNameString (
   UINT8     *Dsdt,
-  UINT32    Adr
+  UINT32    Adr,
+  UINT32    End,
+  UINT32    *SegAdr
 ) {
-  UINT32    k = Adr;
-  INT32     Size = 0;
-
-  while (k > 30) {
-    k--;
-
-    if ((Dsdt[k] == 0x82) && (Dsdt[k - 1] == 0x5B)) {
-      Size = AcpiGetSize (Dsdt, k + 1);
-      if (!Size) {
-        continue;
-      }
+  UINT32    i = Adr, Count = 1, j;
+  UINT8     c;
 
-      if ((k + Size + 1) > Adr) {
-        return (k + 1); //pointer to Size
-      } //else continue
+  if ((i < End) && (Dsdt[i] == '\\')) {
+    i++;
+  } else {
+    while ((i < End) && (Dsdt[i] == '^')) {
+      i++;
     }
   }
 
-  DBG ("Device definition before Adr=%x not found\n", Adr);
-
-  return 0; //impossible value for fool proof
-}
-
-STATIC
-BOOLEAN
-AddProperties (
-  AML_CHUNK     *Pack,
-  UINT32        Dev
-) {
-  INT32     i;
-  BOOLEAN   Injected = FALSE;
+  if (i >= End) {
+    return 0;
+  }
 
-  if (gSettings.NrAddProperties == 0xFFFE) {
-    return FALSE; // not do this for Arbitrary properties?
+  if (Dsdt[i] == 0x00) { //NullName, Scope (\)
+    *SegAdr = Adr;
+    return i + 1 - Adr;
   }
 
-  for (i = 0; i < gSettings.NrAddProperties; i++) {
-    if (gSettings.AddProperties[i].Device != Dev) {
-      continue;
+  if (Dsdt[i] == 0x2E) { //DualNamePrefix
+    Count = 2;
+    i++;
+  } else if (Dsdt[i] == 0x2F) { //MultiNamePrefix
+    if ((i + 1) >= End) {
+      return 0;
     }
 
-    Injected = TRUE;
+    Count = Dsdt[i + 1];
+    i += 2;
+  }
 
-    AmlAddString (Pack, gSettings.AddProperties[i].Key);
-    AmlAddByteBuffer (
-      Pack,
-      gSettings.AddProperties[i].Value,
-      (UINT32)gSettings.AddProperties[i].ValueLen
-    );
+  if ((Count == 0) || ((i + Count * 4) > End)) {
+    return 0;
   }
 
-  return Injected;
+  for (j = 0; j < Count * 4; j++) {
+    c = Dsdt[i + j];
+    if (
+      !(((c >= 'A') && (c <= 'Z')) || (c == '_') ||
+      (((j & 3) != 0) && (c >= '0') && (c <= '9')))
+    ) {
+      return 0;
+    }
+  }
+
+  *SegAdr = i + (Count - 1) * 4;
+
+  return i + Count * 4 - Adr;
 }
 
-/*
-//len = DeleteDevice ("AZAL", Dsdt, len);
+//return end of object with PkgLength at SizeAdr or 0 if it does not fit before End,
+//Body gets the first byte after PkgLength
 
 STATIC
 UINT32
-DeleteDevice (
-  CHAR8     *Name,
+AmlTreePkgEnd (
   UINT8     *Dsdt,
-  UINT32    Len
+  UINT32    SizeAdr,
+  UINT32    End,
+  UINT32    *Body
 ) {
-  UINT32    i, j;
-  INT32     Size = 0, SizeOffset;
+  UINT32    Size, Width;
 
-  DBG (" deleting device %a\n", Name);
+  if (SizeAdr >= End) {
+    return 0;
+  }
 
-  for (i = 20; i < Len; i++) {
-    j = CmpDev (Dsdt, i, (UINT8 *)Name);
+  Width = (Dsdt[SizeAdr] >> 6) + 1;
+  if ((SizeAdr + Width) > End) {
+    return 0;
+  }
+
+  Size = AcpiGetSize (Dsdt, SizeAdr);
+  if ((Size <= Width) || (Size > (End - SizeAdr))) {
+    return 0;
+  }
+
+  *Body = SizeAdr + Width;
+
+  return SizeAdr + Size;
+}
+
+//one pass over the term list in [Start, End), data objects and method bodies are skipped
+
+STATIC
+VOID
+AmlTreeParse (
+  UINT8           *Dsdt,
+  AML_TREE_NODE   *Parent,
+  UINT32          Start,
+  UINT32          End,
+  UINTN           Depth
+) {
+  AML_TREE_NODE   *Node;
+  UINT32          i = Start, SizeAdr, Body, PkgEnd, NameLen, SegAdr;
+  UINT8           Type;
+
+  while (i < End) {
+    Type = 0;
+    SizeAdr = 0;
+
+    switch (Dsdt[i]) {
+      case AML_CHUNK_BYTE:
+        i += 2;
+        continue;
+
+      case AML_CHUNK_WORD:
+        i += 3;
+        continue;
+
+      case AML_CHUNK_DWORD:
+        i += 5;
+        continue;
+
+      case AML_CHUNK_QWORD:
+        i += 9;
+        continue;
+
+      case AML_CHUNK_STRING:
+        while ((++i < End) && (Dsdt[i] != 0));
+        i++;
+        continue;
+
+      case AML_CHUNK_NAME:
+        NameLen = AmlTreeNameString (Dsdt, i + 1, End, &SegAdr);
+        if (NameLen == 4) {
+          if (!Parent->AdrAdr && (CompareMem (Dsdt + i + 1, "_ADR", 4) == 0)) {
+            Parent->AdrAdr = i;
+          } else if (!Parent->HidAdr && (CompareMem (Dsdt + i + 1, "_HID", 4) == 0)) {
+            Parent->HidAdr = i;
+          }
+        }
+
+        i += 1 + NameLen;
+        continue;
+
+      case 0x15: //External (Name, Type, Args)
+        NameLen = AmlTreeNameString (Dsdt, i + 1, End, &SegAdr);
+        i += NameLen ? (NameLen + 3) : 1;
+        continue;
+
+      case AML_CHUNK_BUFFER:
+      case AML_CHUNK_PACKAGE:
+      case 0x13: //VarPackage
+        PkgEnd = AmlTreePkgEnd (Dsdt, i + 1, End, &Body);
+        i = PkgEnd ? PkgEnd : (i + 1);
+        continue;
+
+      case 0xA0: //If, Else, While - objects inside belong to Parent
+      case 0xA1:
+      case 0xA2:
+        PkgEnd = AmlTreePkgEnd (Dsdt, i + 1, End, &Body);
+        if (PkgEnd && (Depth < AML_TREE_MAX_DEPTH)) {
+          AmlTreeParse (Dsdt, Parent, Body, PkgEnd, Depth + 1);
+          i = PkgEnd;
+        } else {
+          i++;
+        }
+        continue;
+
+      case AML_CHUNK_SCOPE:
+      case AML_CHUNK_METHOD:
+        Type = Dsdt[i];
+        SizeAdr = i + 1;
+        break;
+
+      case AML_CHUNK_OP:
+        if ((i + 1) >= End) {
+          break;
+        }
+
+        switch (Dsdt[i + 1]) {
+          case 0x80: //OperationRegion (Name, Space, ...)
+            NameLen = AmlTreeNameString (Dsdt, i + 2, End, &SegAdr);
+            if (NameLen) {
+              i += NameLen + 3;
+              continue;
+            }
+            break;
+
+          case 0x81: //Field, IndexField, BankField
+          case 0x86:
+          case 0x87:
+            PkgEnd = AmlTreePkgEnd (Dsdt, i + 2, End, &Body);
+            if (PkgEnd) {
+              i = PkgEnd;
+              continue;
+            }
+            break;
+
+          case AML_CHUNK_DEVICE:
+          case AML_TREE_PROCESSOR:
+          case AML_TREE_POWER_RES:
+          case AML_TREE_THERMAL_ZONE:
+            Type = Dsdt[i + 1];
+            SizeAdr = i + 2;
+            break;
+        }
+        break;
+    }
+
+    if (Type == 0) {
+      i++;
+      continue;
+    }
+
+    PkgEnd = AmlTreePkgEnd (Dsdt, SizeAdr, End, &Body);
+    NameLen = PkgEnd ? AmlTreeNameString (Dsdt, Body, PkgEnd, &SegAdr) : 0;
+    if (!NameLen) {
+      i++;
+      continue;
+    }
+
+    Node = AllocateZeroPool (sizeof (AML_TREE_NODE));
+    if (Node == NULL) {
+      return;
+    }
+
+    Node->Type = Type;
+    Node->SizeAdr = SizeAdr;
+    Node->End = PkgEnd;
+    Node->NameAdr = SegAdr;
+    Node->Parent = Parent;
+
+    if (Parent->Last != NULL) {
+      Parent->Last->Next = Node;
+    } else {
+      Parent->First = Node;
+    }
+
+    Parent->Last = Node;
+
+    Body += NameLen;
+    if (Type == AML_TREE_PROCESSOR) {
+      Body += 6; //ProcID, PblkAddr, PblkLen
+    } else if (Type == AML_TREE_POWER_RES) {
+      Body += 3; //SystemLevel, ResourceOrder
+    }
+
+    //method body is code, not declarations
+    if ((Type != AML_CHUNK_METHOD) && (Body < PkgEnd) && (Depth < AML_TREE_MAX_DEPTH)) {
+      AmlTreeParse (Dsdt, Node, Body, PkgEnd, Depth + 1);
+    }
+
+    i = PkgEnd;
+  }
+}
+
+STATIC
+AML_TREE_NODE *
+AmlTreeGet (
+  UINT8     *Dsdt,
+  UINT32    Len
+) {
+  if ((mAmlTree != NULL) && ((mAmlTreeDsdt != Dsdt) || (mAmlTreeLen != Len))) {
+    AmlTreeInvalidate ();
+  }
+
+  if ((mAmlTree == NULL) && (Len > sizeof (EFI_ACPI_DESCRIPTION_HEADER))) {
+    mAmlTree = AllocateZeroPool (sizeof (AML_TREE_NODE));
+    if (mAmlTree != NULL) {
+      mAmlTree->Type = AML_CHUNK_SCOPE;
+      mAmlTree->End = Len;
+      mAmlTreeDsdt = Dsdt;
+      mAmlTreeLen = Len;
+      AmlTreeParse (Dsdt, mAmlTree, sizeof (EFI_ACPI_DESCRIPTION_HEADER), Len, 0);
+    }
+  }
+
+  return mAmlTree;
+}
+
+//preorder walk inside Scope
+
+STATIC
+AML_TREE_NODE *
+AmlTreeNext (
+  AML_TREE_NODE   *Node,
+  AML_TREE_NODE   *Scope
+) {
+  if (Node->First != NULL) {
+    return Node->First;
+  }
+
+  while (Node != Scope) {
+    if (Node->Next != NULL) {
+      return Node->Next;
+    }
+
+    Node = Node->Parent;
+  }
+
+  return NULL;
+}
+
+//node with PkgLength at SizeAdr, the root for 0
+
+STATIC
+AML_TREE_NODE *
+AmlTreeFindNode (
+  UINT8     *Dsdt,
+  UINT32    Len,
+  UINT32    SizeAdr
+) {
+  AML_TREE_NODE   *Root = AmlTreeGet (Dsdt, Len), *Node;
+
+  if ((Root == NULL) || (SizeAdr == 0)) {
+    return Root;
+  }
+
+  //descend into the node which contains SizeAdr
+  Node = Root->First;
+  while (Node != NULL) {
+    if (Node->SizeAdr == SizeAdr) {
+      return Node;
+    }
+
+    Node = ((SizeAdr > Node->SizeAdr) && (SizeAdr < Node->End)) ? Node->First : Node->Next;
+  }
+
+  return NULL;
+}
+
+//first device with Name (_ADR, PciAdr) inside the one at Scope (0 - whole table)
+
+STATIC
+AML_TREE_NODE *
+AmlTreeFindDevice (
+  UINT8     *Dsdt,
+  UINT32    Len,
+  UINT32    Scope,
+  UINT32    PciAdr
+) {
+  AML_TREE_NODE   *Top = AmlTreeFindNode (Dsdt, Len, Scope), *Node;
+
+  if (Top == NULL) {
+    return NULL;
+  }
+
+  for (Node = AmlTreeNext (Top, Top); Node != NULL; Node = AmlTreeNext (Node, Top)) {
+    if (
+      (Node->Type == AML_CHUNK_DEVICE) && Node->AdrAdr &&
+      CmpAdr (Dsdt, Node->AdrAdr - 4, PciAdr)
+    ) {
+      return Node;
+    }
+  }
+
+  return NULL;
+}
+
+//first device with Name (_HID, EisaId ("PNPxxxx"))
+
+STATIC
+AML_TREE_NODE *
+AmlTreeFindPnpDevice (
+  UINT8     *Dsdt,
+  UINT32    Len,
+  UINT16    PNP
+) {
+  AML_TREE_NODE   *Root = AmlTreeGet (Dsdt, Len), *Node;
+
+  if (Root == NULL) {
+    return NULL;
+  }
+
+  for (Node = AmlTreeNext (Root, Root); Node != NULL; Node = AmlTreeNext (Node, Root)) {
+    if ((Node->Type == AML_CHUNK_DEVICE) && Node->HidAdr && CmpPNP (Dsdt, Node->HidAdr, PNP)) {
+      return Node;
+    }
+  }
+
+  return NULL;
+}
+
+STATIC
+AML_TREE_NODE *
+AmlTreeFindNamedDevice (
+  UINT8     *Dsdt,
+  UINT32    Len,
+  CHAR8     *Name
+) {
+  AML_TREE_NODE   *Root = AmlTreeGet (Dsdt, Len), *Node;
+
+  if (Root == NULL) {
+    return NULL;
+  }
+
+  for (Node = AmlTreeNext (Root, Root); Node != NULL; Node = AmlTreeNext (Node, Root)) {
+    if ((Node->Type == AML_CHUNK_DEVICE) && (CompareMem (Dsdt + Node->NameAdr, Name, 4) == 0)) {
+      return Node;
+    }
+  }
+
+  return NULL;
+}
+
+//return size field of method Name declared in the device at Scope,
+//or anywhere for Scope = 0
+
+STATIC
+UINT32
+AmlTreeFindMethod (
+  UINT8     *Dsdt,
+  UINT32    Len,
+  UINT32    Scope,
+  CHAR8     *Name
+) {
+  AML_TREE_NODE   *Top = AmlTreeFindNode (Dsdt, Len, Scope), *Node;
+
+  if (Top == NULL) {
+    return 0;
+  }
+
+  for (
+    Node = (Scope == 0) ? AmlTreeNext (Top, Top) : Top->First;
+    Node != NULL;
+    Node = (Scope == 0) ? AmlTreeNext (Node, Top) : Node->Next
+  ) {
+    if ((Node->Type == AML_CHUNK_METHOD) && (CompareMem (Dsdt + Node->NameAdr, Name, 4) == 0)) {
+      return Node->SizeAdr;
+    }
+  }
+
+  return 0;
+}
+
+STATIC
+BOOLEAN
+AddProperties (
+  AML_CHUNK     *Pack,
+  UINT32        Dev
+) {
+  INT32     i;
+  BOOLEAN   Injected = FALSE;
+
+  if (gSettings.NrAddProperties == 0xFFFE) {
+    return FALSE; // not do this for Arbitrary properties?
+  }
+
+  for (i = 0; i < gSettings.NrAddProperties; i++) {
+    if (gSettings.AddProperties[i].Device != Dev) {
+      continue;
+    }
+
+    Injected = TRUE;
+
+    AmlAddString (Pack, gSettings.AddProperties[i].Key);
+    AmlAddByteBuffer (
+      Pack,
+      gSettings.AddProperties[i].Value,
+      (UINT32)gSettings.AddProperties[i].ValueLen
+    );
+  }
+
+  return Injected;
+}
+
+/*
+//len = DeleteDevice ("AZAL", Dsdt, len);
+
+STATIC
+UINT32
+DeleteDevice (
+  CHAR8     *Name,
+  UINT8     *Dsdt,
+  UINT32    Len
+) {
+  UINT32    i, j;
+  INT32     Size = 0, SizeOffset;
+
+  DBG (" deleting device %a\n", Name);
+
+  for (i = 20; i < Len; i++) {
+    j = CmpDev (Dsdt, i, (UINT8 *)Name);
 
     if (j != 0) {
       Size = AcpiGetSize (Dsdt, j);
@@ -1147,208 +1848,796 @@ GetPciDevice (
   UINT8     *Dsdt,
   UINT32    Len
 ) {
-  UINT32    i, PCIADR = 0, PCISIZE = 0;
-
-  for (i = 20; i < Len; i++) {
-    // Find Device PCI0   // PNP0A03
-    if (CmpPNP (Dsdt, i, 0x0A03)) {
-      PCIADR = DevFind (Dsdt, i);
-      if (!PCIADR) {
-        continue;
-      }
+  AML_TREE_NODE   *Node;
 
-      PCISIZE = AcpiGetSize (Dsdt, PCIADR);
-      if (PCISIZE) {
-        break;
-      }
-    } // End find
+  // Find Device PCI0   // PNP0A03
+  Node = AmlTreeFindPnpDevice (Dsdt, Len, 0x0A03);
+  if (Node == NULL) {
+    // Find Device PCIE   // PNP0A08
+    Node = AmlTreeFindPnpDevice (Dsdt, Len, 0x0A08);
   }
 
-  if (!PCISIZE) {
-    for (i = 20; i < Len; i++) {
-      // Find Device PCIE   // PNP0A08
-      if (CmpPNP (Dsdt, i, 0x0A08)) {
-        PCIADR = DevFind (Dsdt, i);
-        if (!PCIADR) {
-          continue;
-        }
+  return (Node != NULL) ? Node->SizeAdr : 0;
+}
 
-        PCISIZE = AcpiGetSize (Dsdt, PCIADR);
-        if (PCISIZE) {
-          break;
-        }
-      } // End find
-    }
+#if 0
+// Find PCIRootUID and all need Fix Device
+
+STATIC
+UINTN
+FindPciRoot (
+  UINT8     *Dsdt,
+  UINT32    Len
+) {
+  UINTN     j, Root = 0;
+  UINT32    PCIADR, PCISIZE = 0;
+
+  //initialising
+  NetworkName   = FALSE;
+  DisplayName1  = FALSE;
+  DisplayName2  = FALSE;
+  //FirewireName  = FALSE;
+  ArptName      = FALSE;
+  //XhciName      = FALSE;
+
+  PCIADR = GetPciDevice (Dsdt, Len);
+  if (PCIADR) {
+    PCISIZE = AcpiGetSize (Dsdt, PCIADR);
   }
 
-  if (PCISIZE) {
-    return PCIADR;
+  //sample
+  /*
+   5B 82 8A F1 05 50 43 49 30           Device (PCI0) {
+   08 5F 48 49 44 0C 41 D0 0A 08        Name (_HID, EisaId ("PNP0A08"))
+   08 5F 43 49 44 0C 41 D0 0A 03        Name (_CID, EisaId ("PNP0A03"))
+   08 5F 41 44 52 00                    Name (_ADR, Zero)
+   14 09 5E 42 4E 30 30 00 A4 00        Method (^BN00, 0, NotSerialized) {Return (Zero)}
+   14 0B 5F 42 42 4E 00 A4 42 4E 30 30  Method (_BBN, 0, NotSerialized) {Return (BN00 ())}
+   08 5F 55 49 44 00                    Name (_UID, Zero)
+   14 16 5F 50 52 54 00                 Method (_PRT, 0, NotSerialized)
+  */
+
+  if (PCISIZE > 0) {
+    // find PCIRootUID
+    for (j = PCIADR; j < PCIADR + 64; j++) {
+      if (
+        (Dsdt[j] == '_') &&
+        (Dsdt[j + 1] == 'U') &&
+        (Dsdt[j + 2] == 'I') &&
+        (Dsdt[j + 3] == 'D')
+      ) {
+        // Slice - I want to set Root to zero instead of keeping original value
+        if (Dsdt[j + 4] == 0x0A) {
+          Dsdt[j + 5] = 0;  //AML_BYTE_PREFIX followed by a number
+        } else {
+          Dsdt[j + 4] = 0;  //any other will be considered as ONE or WRONG, replace to ZERO
+        }
+
+        DBG ("Found PCIROOTUID = %d\n", Root);
+        break;
+      }
+    }
+  } else {
+    DBG ("Warning! PCI Root is not found!");
+  }
+
+  return Root;
+}
+#endif
+
+//
+// FixAny () without DsdtEdit, for when it runs out of memory: every match
+// moves the rest of the table and fixes the outer PkgLengths right away
+//
+STATIC
+UINT32
+FixAnyInPlace (
+  UINT8     *Dsdt,
+  UINT32    Len,
+  UINT8     *ToFind,
+  UINT32    LenTF,
+  UINT8     *ToReplace,
+  UINT32    LenTR
+) {
+  INT32     SizeOffset = LenTR - LenTF, Adr, Offset;
+  UINT32    i, k, Moved;
+
+  for (i = 20; (i + LenTF) < Len; ) {
+    Adr = FindBin (Dsdt + i, Len - i, ToFind, LenTF);
+    if (Adr < 0) {
+      break;
+    }
+
+    Adr += i;
+    Len = MoveData (Adr, Dsdt, Len, SizeOffset);
+    if (ToReplace != NULL) {
+      CopyMem (Dsdt + Adr, ToReplace, LenTR);
+    } else {
+      ZeroMem (Dsdt + Adr, LenTR);
+    }
+
+    Moved = Len;
+
+    // a wider method PkgLength moves the match and grows the outers too
+    Offset = 0;
+    k = FindOuterMethod (Dsdt, Adr - 2);
+    if (k != 0) {
+      Offset = WriteSize (k, Dsdt, Len, SizeOffset);
+      Len += Offset;
+    }
+
+    Len = CorrectOuters (Dsdt, Len, Adr + Offset - 3, SizeOffset + Offset);
+    i = Adr + LenTR + (Len - Moved);
+  }
+
+  return Len;
+}
+
+UINT32
+FixAny (
+  UINT8     *Dsdt,
+  UINT32    Len,
+  UINT8     *ToFind,
+  UINT32    LenTF,
+  UINT8     *ToReplace,
+  UINT32    LenTR
+) {
+  INT32         Adr;
+  UINT32        i;
+  BOOLEAN       Found = FALSE;
+  DSDT_EDITOR   Editor;
+
+  if (!ToFind || !LenTF || !LenTR) {
+    MsgLog (" invalid patches!\n");
+    return Len;
+  }
+
+  //DBG (" pattern %02x%02x%02x%02x,", ToFind[0], ToFind[1], ToFind[2], ToFind[3]);
+
+  if ((LenTF + sizeof (EFI_ACPI_DESCRIPTION_HEADER)) > Len) {
+    MsgLog (" the patch is too large!\n");
+    return Len;
+  }
+
+  // all matches are replaced at once, scanning goes over the original bytes
+  DsdtEditInit (&Editor, Dsdt, Len);
+
+  for (i = 20; (i + LenTF) < Len; ) {
+    Adr = FindBin (Dsdt + i, Len - i, ToFind, LenTF);
+    if (Adr < 0) {
+      break;
+    }
+
+    if (!Found) {
+      MsgLog (" patched");
+      DBG (" at: [");
+    }
+
+    DBG (" (%x)", Adr);
+    Found = TRUE;
+
+    // out of memory: the commit below does nothing and it goes in place
+    if (!DsdtEditReplace (&Editor, Adr + i, LenTF, ToReplace, LenTR)) {
+      break;
+    }
+
+    i += Adr + LenTF;
+  }
+
+  if (Found) {
+    DBG (" ]");
+    MsgLog ("\n");
+    Len = DsdtEditCommit (&Editor);
+
+    if (Editor.Failed) {
+      DBG (" out of memory, patching in place\n");
+      Len = FixAnyInPlace (Dsdt, Len, ToFind, LenTF, ToReplace, LenTR);
+    }
+  } else {
+    MsgLog (" bin not Found / already patched!\n");
+  }
+
+  DsdtEditFree (&Editor);
+
+  return Len;
+}
+
+//
+// DsdtPatch list compiled once into a PATTERN_MATCHER and kept for the DSDT
+// and every SSDT, until PatchBinACPIFree (). One scan of a table finds all
+// patches, and as many of them as possible go into one DsdtEditCommit ().
+// A patch is only held back to the next scan if an earlier one of the same
+// batch could change what it matches, so the result is the same as applying
+// the patches one by one.
+//
+
+typedef struct {
+  UINT32    Patch;    // index into mBinPatches
+  UINT32    Adr;
+} BIN_PATCH_HIT;
+
+typedef struct {
+  UINT32          First;    // patches before it are already applied
+  BIN_PATCH_HIT   *Hits;
+  UINTN           Count;
+  UINTN           Capacity;
+  BOOLEAN         Failed;   // out of memory, hits are missing
+} BIN_PATCH_SCAN;
+
+STATIC PATTERN_MATCHER  *mBinPatchMatcher = NULL;
+STATIC PATCH_DSDT       **mBinPatches = NULL;
+STATIC UINTN            mBinPatchCount = 0;
+
+VOID
+PatchBinACPIFree () {
+  PatternMatcherFree (mBinPatchMatcher);
+  mBinPatchMatcher = NULL;
+
+  if (mBinPatches != NULL) {
+    FreePool (mBinPatches);
+    mBinPatches = NULL;
+  }
+
+  mBinPatchCount = 0;
+}
+
+STATIC
+BOOLEAN
+BinPatchCompile () {
+  PATCH_DSDT  *PatchDsdt;
+  UINTN       Count = 0, i;
+
+  if (mBinPatchMatcher != NULL) {
+    return TRUE;
+  }
+
+  for (PatchDsdt = gSettings.PatchDsdt; PatchDsdt; PatchDsdt = PatchDsdt->Next) {
+    if (!PatchDsdt->Disabled) {
+      Count++;
+    }
+  }
+
+  if (!Count) {
+    return FALSE;
+  }
+
+  mBinPatches = AllocatePool (Count * sizeof (PATCH_DSDT *));
+  mBinPatchMatcher = PatternMatcherCreate (Count);
+
+  if ((mBinPatches == NULL) || (mBinPatchMatcher == NULL)) {
+    PatchBinACPIFree ();
+    return FALSE;
+  }
+
+  for (PatchDsdt = gSettings.PatchDsdt, i = 0; PatchDsdt; PatchDsdt = PatchDsdt->Next) {
+    if (PatchDsdt->Disabled) {
+      continue;
+    }
+
+    // invalid ones stay in the list to be reported, but are never found
+    if (PatchDsdt->Find && PatchDsdt->LenToFind && PatchDsdt->LenToReplace) {
+      PatternMatcherAdd (mBinPatchMatcher, PatchDsdt->Find, PatchDsdt->LenToFind, PATTERN_MATCHER_NO_WILDCARD, (VOID *)(UINTN)i);
+    }
+
+    mBinPatches[i++] = PatchDsdt;
+  }
+
+  mBinPatchCount = Count;
+
+  return TRUE;
+}
+
+STATIC
+BOOLEAN
+BinPatchHit (
+  IN VOID   *Context,
+  IN UINTN  Index,
+  IN VOID   *EntryContext,
+  IN UINT8  *Buffer,
+  IN UINTN  Offset
+) {
+  BIN_PATCH_SCAN  *Scan = (BIN_PATCH_SCAN *)Context;
+  BIN_PATCH_HIT   *Hits;
+  UINT32          Patch = (UINT32)(UINTN)EntryContext;
+
+  if (Patch < Scan->First) {
+    // already applied, not wanted anymore
+    return FALSE;
+  }
+
+  if (Scan->Count == Scan->Capacity) {
+    Hits = ReallocatePool (
+             Scan->Capacity * sizeof (BIN_PATCH_HIT),
+             (Scan->Capacity + 64) * sizeof (BIN_PATCH_HIT),
+             Scan->Hits
+           );
+
+    if (Hits == NULL) {
+      Scan->Failed = TRUE;
+      return FALSE;
+    }
+
+    Scan->Hits = Hits;
+    Scan->Capacity += 64;
+  }
+
+  Scan->Hits[Scan->Count].Patch = Patch;
+  Scan->Hits[Scan->Count].Adr = (UINT32)Offset;
+  Scan->Count++;
+
+  return TRUE;
+}
+
+//
+// One scan of Ptr for all patches from First, hits grouped by patch
+// (ascending address inside a group): patch i owns Hits[Starts[i]..Starts[i + 1]).
+// FALSE if out of memory, some hits would be missing then.
+//
+STATIC
+BOOLEAN
+BinPatchScan (
+  UINT8           *Ptr,
+  UINT32          Len,
+  UINT32          First,
+  UINTN           *Starts,
+  BIN_PATCH_HIT   **Hits
+) {
+  BIN_PATCH_SCAN  Scan;
+  BIN_PATCH_HIT   *Sorted;
+  UINTN           i;
+
+  ZeroMem (&Scan, sizeof (Scan));
+  Scan.First = First;
+  *Hits = NULL;
+
+  PatternMatcherReset (mBinPatchMatcher);
+  PatternMatcherScan (mBinPatchMatcher, Ptr, Len, BinPatchHit, &Scan);
+
+  ZeroMem (Starts, (mBinPatchCount + 1) * sizeof (UINTN));
+
+  if (!Scan.Count || Scan.Failed) {
+    if (Scan.Hits != NULL) {
+      FreePool (Scan.Hits);
+    }
+
+    return !Scan.Failed;
+  }
+
+  Sorted = AllocatePool (Scan.Count * sizeof (BIN_PATCH_HIT));
+  if (Sorted == NULL) {
+    FreePool (Scan.Hits);
+    return FALSE;
+  }
+
+  // the scan reports a patch at ascending addresses, a stable counting sort keeps that
+  for (i = 0; i < Scan.Count; i++) {
+    Starts[Scan.Hits[i].Patch + 1]++;
+  }
+
+  for (i = 0; i < mBinPatchCount; i++) {
+    Starts[i + 1] += Starts[i];
+  }
+
+  for (i = 0; i < Scan.Count; i++) {
+    Sorted[Starts[Scan.Hits[i].Patch]++] = Scan.Hits[i];
+  }
+
+  for (i = mBinPatchCount; i > 0; i--) {
+    Starts[i] = Starts[i - 1];
+  }
+
+  Starts[0] = 0;
+
+  FreePool (Scan.Hits);
+  *Hits = Sorted;
+
+  return TRUE;
+}
+
+//
+// TRUE if Find can show up over the bytes Splice puts at its place:
+// Dsdt[..Adr) + Mid + Dsdt[Adr + DelLen..), Mid == NULL stands for any MidLen bytes.
+//
+STATIC
+BOOLEAN
+BinPatchCanMatchAcross (
+  UINT8     *Dsdt,
+  UINT32    Len,
+  UINT32    Adr,
+  UINT32    DelLen,
+  UINT8     *Mid,
+  UINT32    MidLen,
+  UINT8     *Find,
+  UINT32    FindLen
+) {
+  UINT32    Start, i, v;
+  UINT8     Byte;
+  BOOLEAN   Eq;
+
+  Start = (Adr >= FindLen) ? (Adr - FindLen + 1) : 0;
+
+  for (; Start < (Adr + MidLen); Start++) {
+    Eq = TRUE;
+
+    for (i = 0; Eq && (i < FindLen); i++) {
+      v = Start + i;
+
+      if (v < Adr) {
+        Byte = Dsdt[v];
+      } else if (v < (Adr + MidLen)) {
+        if (Mid == NULL) {
+          continue;
+        }
+
+        Byte = Mid[v - Adr];
+      } else if ((v - MidLen + DelLen) < Len) {
+        Byte = Dsdt[v - MidLen + DelLen];
+      } else {
+        // runs past the table end, so do all further starts
+        return FALSE;
+      }
+
+      Eq = (Byte == Find[i]);
+    }
+
+    if (Eq) {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+//
+// Can Patch go into the batch already recorded in Editor, at the addresses in Hits,
+// and still give what FixAny () would after the batch is committed?
+//
+STATIC
+BOOLEAN
+BinPatchFitsBatch (
+  DSDT_EDITOR   *Editor,
+  PATCH_DSDT    *Patch,
+  UINT32        *Hits,
+  UINTN         Count
+) {
+  DSDT_SPLICE   *Splice, *Other;
+  UINT32        Adr, End, Bound, Width;
+  UINTN         i, j, k;
+
+  for (j = 0; j < Editor->Count; j++) {
+    Splice = &Editor->Splices[j];
+
+    // new occurrences over the bytes this splice writes, its neighbours must be
+    // original bytes for the check to hold
+    for (k = 0; k < Editor->Count; k++) {
+      Other = &Editor->Splices[k];
+
+      if (
+        (k != j) &&
+        ((Other->Adr + Other->DelLen + Patch->LenToFind) > Splice->Adr) &&
+        (Other->Adr < (Splice->Adr + Splice->DelLen + Patch->LenToFind))
+      ) {
+        return FALSE;
+      }
+    }
+
+    if (Splice->IsSize) {
+      for (Width = 1; Width <= 4; Width++) {
+        if (BinPatchCanMatchAcross (Editor->Dsdt, Editor->Len, Splice->Adr, Splice->DelLen, NULL, Width, Patch->Find, Patch->LenToFind)) {
+          return FALSE;
+        }
+      }
+    } else if (BinPatchCanMatchAcross (Editor->Dsdt, Editor->Len, Splice->Adr, Splice->DelLen, Splice->Ins, Splice->InsLen, Patch->Find, Patch->LenToFind)) {
+      return FALSE;
+    }
+  }
+
+  for (i = 0; i < Count; i++) {
+    Adr = Hits[i];
+    End = Adr + Patch->LenToFind;
+    Bound = 0;
+
+    for (j = 0; j < Editor->Count; j++) {
+      Splice = &Editor->Splices[j];
+
+      // occurrence changed by an earlier patch
+      if (((Splice->Adr + Splice->DelLen) > Adr) && (Splice->Adr < End)) {
+        return FALSE;
+      }
+
+      // the table end moves, FixAny () stops LenToFind before it
+      if (Splice->Adr >= End) {
+        Bound += Splice->IsSize ? 3 : (UINT32)ABS ((INT32)Splice->InsLen - (INT32)Splice->DelLen);
+      }
+    }
+
+    if (Bound && ((End + Bound) >= Editor->Len)) {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+//
+// Without a matcher, or out of memory for a batch: one FixAny () per patch,
+// from the First enabled one on.
+//
+STATIC
+UINT32
+PatchBinACPISerial (
+  UINT8   *Ptr,
+  UINT32  Len,
+  UINTN   First
+) {
+  PATCH_DSDT  *PatchDsdt = gSettings.PatchDsdt;
+  UINTN       i = 0;
+
+  while (PatchDsdt) {
+    if (!PatchDsdt->Disabled && (i++ >= First)) {
+      MsgLog (" - [%02d]: (%a)",
+        i - 1,
+        PatchDsdt->Comment ? PatchDsdt->Comment : "NoLabel"
+      );
+
+      DBG (" (%a -> %a)",
+        Bytes2HexStr (PatchDsdt->Find, (UINTN)PatchDsdt->LenToFind),
+        Bytes2HexStr (PatchDsdt->Replace, (UINTN)PatchDsdt->LenToReplace)
+      );
+
+      Len = FixAny (
+              Ptr, Len,
+              PatchDsdt->Find, PatchDsdt->LenToFind,
+              PatchDsdt->Replace, PatchDsdt->LenToReplace
+            );
+    }
+
+    PatchDsdt = PatchDsdt->Next;
+  }
+
+  return Len;
+}
+
+UINT32
+PatchBinACPI (
+  UINT8   *Ptr,
+  UINT32  Len
+) {
+  PATCH_DSDT      *PatchDsdt;
+  DSDT_EDITOR     Editor;
+  BIN_PATCH_HIT   *Hits;
+  UINTN           *Starts, i, j, n = 0;
+  UINT32          *Found = NULL, First = 0, NrFound, Next;
+  BOOLEAN         Valid, Failed;
+
+  //if (!gSettings.PatchDsdtNum || !gSettings.PatchDsdt) {
+  //  return Len;
+  //}
+
+  if (!BinPatchCompile ()) {
+    return PatchBinACPISerial (Ptr, Len, 0);
   }
 
-  return 0;
-}
+  Starts = AllocatePool ((mBinPatchCount + 1) * sizeof (UINTN));
+  if (Starts == NULL) {
+    return PatchBinACPISerial (Ptr, Len, 0);
+  }
 
-#if 0
-// Find PCIRootUID and all need Fix Device
+  while (First < mBinPatchCount) {
+    if (!BinPatchScan (Ptr, Len, First, Starts, &Hits)) {
+      break;
+    }
 
-STATIC
-UINTN
-FindPciRoot (
-  UINT8     *Dsdt,
-  UINT32    Len
-) {
-  UINTN     j, Root = 0;
-  UINT32    PCIADR, PCISIZE = 0;
+    DsdtEditInit (&Editor, Ptr, Len);
 
-  //initialising
-  NetworkName   = FALSE;
-  DisplayName1  = FALSE;
-  DisplayName2  = FALSE;
-  //FirewireName  = FALSE;
-  ArptName      = FALSE;
-  //XhciName      = FALSE;
+    for (i = First; i < mBinPatchCount; i++) {
+      PatchDsdt = mBinPatches[i];
+      NrFound = 0;
+      Valid = (PatchDsdt->Find && PatchDsdt->LenToFind && PatchDsdt->LenToReplace);
 
-  PCIADR = GetPciDevice (Dsdt, Len);
-  if (PCIADR) {
-    PCISIZE = AcpiGetSize (Dsdt, PCIADR);
-  }
+      if (Starts[i + 1] > Starts[i]) {
+        // same occurrences FixAny () takes: from 20 on, not overlapping, not at the very end
+        Found = AllocatePool ((Starts[i + 1] - Starts[i]) * sizeof (UINT32));
+        if (Found == NULL) {
+          Editor.Failed = TRUE;
+          break;
+        }
 
-  //sample
-  /*
-   5B 82 8A F1 05 50 43 49 30           Device (PCI0) {
-   08 5F 48 49 44 0C 41 D0 0A 08        Name (_HID, EisaId ("PNP0A08"))
-   08 5F 43 49 44 0C 41 D0 0A 03        Name (_CID, EisaId ("PNP0A03"))
-   08 5F 41 44 52 00                    Name (_ADR, Zero)
-   14 09 5E 42 4E 30 30 00 A4 00        Method (^BN00, 0, NotSerialized) {Return (Zero)}
-   14 0B 5F 42 42 4E 00 A4 42 4E 30 30  Method (_BBN, 0, NotSerialized) {Return (BN00 ())}
-   08 5F 55 49 44 00                    Name (_UID, Zero)
-   14 16 5F 50 52 54 00                 Method (_PRT, 0, NotSerialized)
-  */
+        for (j = Starts[i], Next = 20; j < Starts[i + 1]; j++) {
+          if ((Hits[j].Adr >= Next) && ((Hits[j].Adr + PatchDsdt->LenToFind) < Len)) {
+            Found[NrFound++] = Hits[j].Adr;
+            Next = Hits[j].Adr + PatchDsdt->LenToFind;
+          }
+        }
+      }
 
-  if (PCISIZE > 0) {
-    // find PCIRootUID
-    for (j = PCIADR; j < PCIADR + 64; j++) {
+      // also with nothing found: the batch may write what this patch looks for.
+      // A resizing patch looks up the outer PkgLengths around its hits the way
+      // CorrectOuters () does, that has to see the batch committed
       if (
-        (Dsdt[j] == '_') &&
-        (Dsdt[j + 1] == 'U') &&
-        (Dsdt[j + 2] == 'I') &&
-        (Dsdt[j + 3] == 'D')
+        Valid && Editor.Count &&
+        ((NrFound && (PatchDsdt->LenToFind != PatchDsdt->LenToReplace)) ||
+         !BinPatchFitsBatch (&Editor, PatchDsdt, Found, NrFound))
       ) {
-        // Slice - I want to set Root to zero instead of keeping original value
-        if (Dsdt[j + 4] == 0x0A) {
-          Dsdt[j + 5] = 0;  //AML_BYTE_PREFIX followed by a number
-        } else {
-          Dsdt[j + 4] = 0;  //any other will be considered as ONE or WRONG, replace to ZERO
+        if (Found != NULL) {
+          FreePool (Found);
+          Found = NULL;
         }
 
-        DBG ("Found PCIROOTUID = %d\n", Root);
         break;
       }
-    }
-  } else {
-    DBG ("Warning! PCI Root is not found!");
-  }
-
-  return Root;
-}
-#endif
 
-UINT32
-FixAny (
-  UINT8     *Dsdt,
-  UINT32    Len,
-  UINT8     *ToFind,
-  UINT32    LenTF,
-  UINT8     *ToReplace,
-  UINT32    LenTR
-) {
-  INT32     SizeOffset, Adr;
-  UINT32    i;
-  BOOLEAN   Found = FALSE;
+      MsgLog (" - [%02d]: (%a)",
+        n++,
+        PatchDsdt->Comment ? PatchDsdt->Comment : "NoLabel"
+      );
 
-  if (!ToFind || !LenTF || !LenTR) {
-    MsgLog (" invalid patches!\n");
-    return Len;
-  }
+      DBG (" (%a -> %a)",
+        Bytes2HexStr (PatchDsdt->Find, (UINTN)PatchDsdt->LenToFind),
+        Bytes2HexStr (PatchDsdt->Replace, (UINTN)PatchDsdt->LenToReplace)
+      );
 
-  //DBG (" pattern %02x%02x%02x%02x,", ToFind[0], ToFind[1], ToFind[2], ToFind[3]);
+      if (!Valid) {
+        MsgLog (" invalid patches!\n");
+      } else if ((PatchDsdt->LenToFind + sizeof (EFI_ACPI_DESCRIPTION_HEADER)) > Len) {
+        MsgLog (" the patch is too large!\n");
+      } else if (NrFound) {
+        MsgLog (" patched");
+        DBG (" at: [");
 
-  if ((LenTF + sizeof (EFI_ACPI_DESCRIPTION_HEADER)) > Len) {
-    MsgLog (" the patch is too large!\n");
-    return Len;
-  }
+        for (j = 0; j < NrFound; j++) {
+          DBG (" (%x)", Found[j]);
 
-  SizeOffset = LenTR - LenTF;
+          if (!DsdtEditReplace (&Editor, Found[j], PatchDsdt->LenToFind, PatchDsdt->Replace, PatchDsdt->LenToReplace)) {
+            break;
+          }
+        }
 
-  for (i = 20; i < Len; ) {
-    Adr = FindBin (Dsdt + i, Len - i, ToFind, LenTF);
-    if (Adr < 0) {
-      if (Found) {
         DBG (" ]");
         MsgLog ("\n");
       } else {
         MsgLog (" bin not Found / already patched!\n");
       }
 
-      return Len;
-    }
+      if (Found != NULL) {
+        FreePool (Found);
+        Found = NULL;
+      }
 
-    if (!Found) {
-      MsgLog (" patched");
-      DBG (" at: [");
+      if (Editor.Failed) {
+        break;
+      }
     }
 
-    DBG (" (%x)", Adr);
-    Found = TRUE;
+    // out of memory: nothing of this batch is written, it is redone below
+    Len = DsdtEditCommit (&Editor);
+    Failed = Editor.Failed;
+    DsdtEditFree (&Editor);
+
+    if (Hits != NULL) {
+      FreePool (Hits);
+    }
 
-    Len = MoveData (Adr + i, Dsdt, Len, SizeOffset);
-    if ((LenTR > 0) && (ToReplace != NULL)) {
-      CopyMem (Dsdt + Adr + i, ToReplace, LenTR);
+    if (Failed) {
+      break;
     }
 
-    Len = CorrectOuterMethod (Dsdt, Len, Adr + i - 2, SizeOffset);
-    Len = CorrectOuters (Dsdt, Len, Adr + i - 3, SizeOffset);
-    i += Adr + LenTR;
+    // the first patch of a batch is always taken
+    First = (UINT32)i;
+  }
+
+  FreePool (Starts);
+
+  if (First < mBinPatchCount) {
+    MsgLog (" - out of memory, patches from [%02d] on go one by one\n", First);
+    Len = PatchBinACPISerial (Ptr, Len, First);
   }
 
   return Len;
 }
 
+//
+// Patched table cache keys. Everything PatchBinACPI / FixBiosDsdt read
+// besides the table itself is folded into the CRC, so a BIOS update, a
+// config change or a moved PCI device all give a different key.
+//
+
+STATIC
 UINT32
-PatchBinACPI (
+MixTableKey (
+  UINT32    Key,
+  VOID      *Data,
+  UINTN     Size
+) {
+  UINT32    Parts[2];
+
+  Parts[0] = Key;
+  Parts[1] = ((Data != NULL) && (Size > 0)) ? GetCrc32 ((UINT8 *)Data, Size) : 0;
+
+  return GetCrc32 ((UINT8 *)Parts, sizeof (Parts));
+}
+
+UINT32
+GetPatchBinACPIKey (
   UINT8   *Ptr,
   UINT32  Len
 ) {
   PATCH_DSDT  *PatchDsdt = gSettings.PatchDsdt;
-  UINTN       i = 0;
+  UINT32      Key;
 
-  //if (!gSettings.PatchDsdtNum || !gSettings.PatchDsdt) {
-  //  return Len;
-  //}
+  Key = MixTableKey (0, Ptr, Len);
 
   while (PatchDsdt) {
     if (!PatchDsdt->Disabled) {
-      MsgLog (" - [%02d]: (%a)",
-        i++,
-        PatchDsdt->Comment ? PatchDsdt->Comment : "NoLabel"
-      );
-
-      DBG (" (%a -> %a)",
-        Bytes2HexStr (PatchDsdt->Find, (UINTN)PatchDsdt->LenToFind),
-        Bytes2HexStr (PatchDsdt->Replace, (UINTN)PatchDsdt->LenToReplace)
-      );
-
-      Len = FixAny (
-              Ptr, Len,
-              PatchDsdt->Find, PatchDsdt->LenToFind,
-              PatchDsdt->Replace, PatchDsdt->LenToReplace
-            );
+      Key = MixTableKey (Key, &PatchDsdt->LenToFind, sizeof (PatchDsdt->LenToFind));
+      Key = MixTableKey (Key, PatchDsdt->Find, PatchDsdt->LenToFind);
+      Key = MixTableKey (Key, &PatchDsdt->LenToReplace, sizeof (PatchDsdt->LenToReplace));
+      Key = MixTableKey (Key, PatchDsdt->Replace, PatchDsdt->LenToReplace);
+      Key = MixTableKey (Key, &PatchDsdt->Wildcard, sizeof (PatchDsdt->Wildcard));
     }
 
     PatchDsdt = PatchDsdt->Next;
   }
 
-  return Len;
+  return Key;
+}
+
+UINT32
+GetFixBiosDsdtKey (
+  UINT8   *Temp
+) {
+  DEV_PROPERTY  *Prop = gSettings.AddProperties;
+  UINT32        Key, Values[20];
+  UINTN         n = 0;
+
+  CheckHardware ();
+
+  Key = GetPatchBinACPIKey (Temp, ((EFI_ACPI_DESCRIPTION_HEADER *)Temp)->Length);
+
+  Values[n++] = gSettings.FixDsdt;
+  Values[n++] = gSettings.DropOEM_DSM;
+  Values[n++] = gSettings.FakeATI;
+  Values[n++] = gSettings.FakeNVidia;
+  Values[n++] = gSettings.FakeIntel;
+  Values[n++] = gSettings.FakeLAN;
+  Values[n++] = gSettings.FakeWIFI;
+  Values[n++] = gSettings.FakeIMEI;
+  Values[n++] = gSettings.InjectATI;
+  Values[n++] = gSettings.InjectNVidia;
+  Values[n++] = gSettings.InjectIntel;
+  Values[n++] = gSettings.NoDefaultProperties;
+  Values[n++] = gSettings.UseIntelHDMI;
+  Values[n++] = gSettings.ReuseFFFF;
+  Values[n++] = gSettings.HDALayoutId;
+  Values[n++] = gSettings.CPUStructure.Family;
+  Values[n++] = (UINT32)gSettings.NrAddProperties;
+  Key = MixTableKey (Key, Values, n * sizeof (UINT32));
+
+  while (Prop) {
+    Key = MixTableKey (Key, &Prop->Device, sizeof (Prop->Device));
+    Key = MixTableKey (Key, Prop->Key, (Prop->Key != NULL) ? AsciiStrSize (Prop->Key) : 0);
+    Key = MixTableKey (Key, Prop->Value, Prop->ValueLen);
+    Prop = Prop->Next;
+  }
+
+  // _ADR of the devices FixBiosDsdt looks up, as found by CheckHardware
+  Key = MixTableKey (Key, DisplayADR1, sizeof (DisplayADR1));
+  Key = MixTableKey (Key, DisplayADR2, sizeof (DisplayADR2));
+  Key = MixTableKey (Key, DisplayVendor, sizeof (DisplayVendor));
+
+  n = 0;
+  Values[n++] = NetworkADR1;
+  Values[n++] = NetworkADR2;
+  Values[n++] = ArptADR1;
+  Values[n++] = ArptADR2;
+  Values[n++] = IMEIADR1;
+  Values[n++] = IMEIADR2;
+  Values[n++] = HDAADR1;
+  Values[n++] = HDMIADR1;
+  Values[n++] = HDMIADR2;
+  Values[n++] = HDAlayoutId;
+
+  return MixTableKey (Key, Values, n * sizeof (UINT32));
 }
 
 STATIC
@@ -1357,7 +2646,8 @@ AddPNLF (
   UINT8     *Dsdt,
   UINT32    Len
 ) {
-  UINT32    i, Adr  = 0;
+  UINT32          i, Adr  = 0;
+  AML_TREE_NODE   *Node;
 
   DBG ("Start PNLF Fix\n");
 
@@ -1366,23 +2656,17 @@ AddPNLF (
   }
 
   //search  PWRB PNP0C0C
-  for (i = 0x20; i < Len - 6; i++) {
-    if (CmpPNP (Dsdt, i, 0x0C0C)) {
-      DBG ("found PWRB at %x\n", i);
-      Adr = DevFind (Dsdt, i);
-      break;
-    }
-  }
-
-  if (!Adr) {
+  Node = AmlTreeFindPnpDevice (Dsdt, Len, 0x0C0C);
+  if (Node != NULL) {
+    Adr = Node->SizeAdr;
+    DBG ("found PWRB at %x\n", Adr);
+  } else {
     //search battery
     DBG ("PWRB not found, look BAT0\n");
-    for (i = 0x20; i < Len - 6; i++) {
-      if (CmpPNP (Dsdt, i, 0x0C0A)) {
-        Adr = DevFind (Dsdt, i);
-        DBG ("found BAT0 at %x\n", i);
-        break;
-      }
+    Node = AmlTreeFindPnpDevice (Dsdt, Len, 0x0C0A);
+    if (Node != NULL) {
+      Adr = Node->SizeAdr;
+      DBG ("found BAT0 at %x\n", Adr);
     }
   }
 
@@ -1405,14 +2689,15 @@ FIXDisplay (
   UINT32    Len,
   INT32     VCard
 ) {
-  UINT32      i = 0, j, k, FakeID = 0, FakeVen = 0,
-              PCIADR = 0, PCISIZE = 0, Size,
-              DevAdr = 0, DevSize = 0, DevAdr1 = 0, DevSize1 = 0;
-  INT32       SizeOffset = 0;
-  CHAR8       *Display;
-  BOOLEAN     DISPLAYFIX = FALSE, NonUsable = FALSE, DsmFound = FALSE,
-              NeedHDMI = (gSettings.FixDsdt & FIX_HDMI);
-  AML_CHUNK   *Root = NULL, *Gfx0, *Peg0, *Met, *Met2, *Pack;
+  UINT32          i = 0, j, k, FakeID = 0, FakeVen = 0,
+                  PCIADR = 0, PCISIZE = 0, Size,
+                  DevAdr = 0, DevSize = 0, DevAdr1 = 0, DevSize1 = 0;
+  INT32           SizeOffset = 0;
+  CHAR8           *Display;
+  BOOLEAN         DISPLAYFIX = FALSE, NonUsable = FALSE, DsmFound = FALSE,
+                  NeedHDMI = (gSettings.FixDsdt & FIX_HDMI);
+  AML_CHUNK       *Root = NULL, *Gfx0, *Peg0, *Met, *Met2, *Pack;
+  AML_TREE_NODE   *Node;
 
   DisplayName1 = FALSE;
 
@@ -1433,62 +2718,35 @@ FIXDisplay (
   Root = AmlCreateNode (NULL);
 
   //search DisplayADR1[0]
-  for (j = 0x20; j < Len - 10; j++) {
-    if (CmpAdr (Dsdt, j, DisplayADR1[VCard])) { //for example 0x00020000 = 2,0
-      DevAdr = DevFind (Dsdt, j);  //PEG0@2,0
-      if (!DevAdr) {
-        continue;
-      }
-
-      DevSize = AcpiGetSize (Dsdt, DevAdr); //sizeof PEG0  0x35
-      if (DevSize) {
-        DisplayName1 = TRUE;
-        break;
-      }
-    } // End Display1
+  Node = AmlTreeFindDevice (Dsdt, Len, 0, DisplayADR1[VCard]); //for example 0x00020000 = 2,0
+  if (Node != NULL) {
+    DevAdr = Node->SizeAdr;  //PEG0@2,0
+    DisplayName1 = TRUE;
   }
 
   //what if PEG0 is not found?
   if (DevAdr) {
-    for (j = DevAdr; j < DevAdr + DevSize; j++) { //search card inside PEG0@0
-      if (CmpAdr (Dsdt, j, DisplayADR2[VCard])) { //else DISPLAYFIX==false
-        DevAdr1 = DevFind (Dsdt, j); //found PEGP
-        if (!DevAdr1) {
-          continue;
-        }
-
-        DevSize1 = AcpiGetSize (Dsdt, DevAdr1);
-        if (DevSize1) {
-          DBG ("Found internal video device %x @%x\n", DisplayADR2[VCard], DevAdr1);
-          DISPLAYFIX = TRUE;
-          break;
-        }
-      }
+    Node = AmlTreeFindDevice (Dsdt, Len, DevAdr, DisplayADR2[VCard]); //search card inside PEG0@0
+    if (Node != NULL) { //else DISPLAYFIX==false
+      DevAdr1 = Node->SizeAdr; //found PEGP
+      DBG ("Found internal video device %x @%x\n", DisplayADR2[VCard], DevAdr1);
+      DISPLAYFIX = TRUE;
     }
 
     if (!DISPLAYFIX) {
-      for (j = DevAdr; j < DevAdr + DevSize; j++) { //search card inside PEGP@0
-        if (CmpAdr (Dsdt, j, 0xFFFF)) {  //Special case? want to change to 0
-          DevAdr1 = DevFind (Dsdt, j); //found PEGP
-          if (!DevAdr1) {
-            continue;
-          }
-
-          DevSize1 = AcpiGetSize (Dsdt, DevAdr1); //13
-          if (DevSize1) {
-            if (gSettings.ReuseFFFF) {
-              Dsdt[j + 10] = 0;
-              Dsdt[j + 11] = 0;
-              DBG ("Found internal video device FFFF@%x, ReUse as 0\n", DevAdr1);
-            } else {
-              NonUsable = TRUE;
-              DBG ("Found internal video device FFFF@%x, unusable\n", DevAdr1);
-            }
-
-            DISPLAYFIX = TRUE;
-            break;
-          }
+      Node = AmlTreeFindDevice (Dsdt, Len, DevAdr, 0xFFFF); //search card inside PEGP@0, special case? want to change to 0
+      if (Node != NULL) {
+        DevAdr1 = Node->SizeAdr; //found PEGP
+        if (gSettings.ReuseFFFF) {
+          Dsdt[Node->AdrAdr + 6] = 0;
+          Dsdt[Node->AdrAdr + 7] = 0;
+          DBG ("Found internal video device FFFF@%x, ReUse as 0\n", DevAdr1);
+        } else {
+          NonUsable = TRUE;
+          DBG ("Found internal video device FFFF@%x, unusable\n", DevAdr1);
         }
+
+        DISPLAYFIX = TRUE;
       }
     }
 
@@ -1504,10 +2762,9 @@ FIXDisplay (
 
     if (i != 0) {
       Size = AcpiGetSize (Dsdt, i);
-      k = FindMethod (Dsdt + i, Size, "_DSM");
+      k = AmlTreeFindMethod (Dsdt, Len, i, "_DSM");
 
       if (k != 0) {
-        k += i;
         if (
           ((DisplayVendor[VCard] == 0x1002) && (BIT_ISSET (gSettings.DropOEM_DSM, DEV_ATI))) ||
           ((DisplayVendor[VCard] == 0x10DE) && (BIT_ISSET (gSettings.DropOEM_DSM, DEV_NVIDIA))) ||
@@ -1730,12 +2987,13 @@ AddHDMI (
   UINT8     *Dsdt,
   UINT32    Len
 ) {
-  UINT32      i, j, k, PCIADR = 0, PCISIZE = 0, Size,
-              DevAdr = 0, BridgeSize = 0, DevAdr1 = 0;
-  INT32       SizeOffset = 0;
-  CHAR8       *Hdmi = NULL, Data[] = { 0xe0, 0x00, 0x56, 0x28 };
-  BOOLEAN     BridgeFound = FALSE, HdauFound = FALSE;
-  AML_CHUNK   *Brd = NULL, *Root = NULL, *Met, *Met2, *Pack;
+  UINT32          i, j, k, PCIADR = 0, PCISIZE = 0, Size,
+                  DevAdr = 0, BridgeSize = 0, DevAdr1 = 0;
+  INT32           SizeOffset = 0;
+  CHAR8           *Hdmi = NULL, Data[] = { 0xe0, 0x00, 0x56, 0x28 };
+  BOOLEAN         BridgeFound = FALSE, HdauFound = FALSE;
+  AML_CHUNK       *Brd = NULL, *Root = NULL, *Met, *Met2, *Pack;
+  AML_TREE_NODE   *Node;
 
   if (!HDMIADR1) {
     return Len;
@@ -1753,60 +3011,42 @@ AddHDMI (
   DBG ("Start HDMI%d Fix\n");
 
   // Device Address
-  for (i = 0x20; i < Len - 10; i++) {
-    if (CmpAdr (Dsdt, i, HDMIADR1)) {
-      DevAdr = DevFind (Dsdt, i);
-      if (!DevAdr) {
-        continue;
-      }
-
-      BridgeSize = AcpiGetSize (Dsdt, DevAdr);
-      if (!BridgeSize) {
-        continue;
-      }
-
-      BridgeFound = TRUE;
-      if (HDMIADR2 != 0xFFFE) {
-        for (k = DevAdr + 9; k < DevAdr + BridgeSize; k++) {
-          if (CmpAdr (Dsdt, k, HDMIADR2)) {
-            DevAdr1 = DevFind (Dsdt, k);
-            if (!DevAdr1) {
-              continue;
-            }
-
-            DeviceName[11] = AllocateZeroPool (5);
-            CopyMem (DeviceName[11], Dsdt + k, 4);
-
-            DBG (
-              "found HDMI device [0x%08x:%x] at %x and Name is %a\n",
-              HDMIADR1, HDMIADR2, DevAdr1, DeviceName[11]
-            );
-
-            ReplaceName (Dsdt + DevAdr, BridgeSize, DeviceName[11], "HDAU");
-            HdauFound = TRUE;
-            break;
-          }
-        }
-
-        if (!HdauFound) {
-          DBG ("have no HDMI device while HDMIADR2=%x\n", HDMIADR2);
-          DevAdr1 = DevAdr;
-        }
+  Node = AmlTreeFindDevice (Dsdt, Len, 0, HDMIADR1);
+  if (Node != NULL) {
+    DevAdr = Node->SizeAdr;
+    BridgeSize = AcpiGetSize (Dsdt, DevAdr);
+    BridgeFound = TRUE;
+
+    if (HDMIADR2 != 0xFFFE) {
+      Node = AmlTreeFindDevice (Dsdt, Len, DevAdr, HDMIADR2);
+      if (Node != NULL) {
+        DevAdr1 = Node->SizeAdr;
+        DeviceName[11] = AllocateZeroPool (5);
+        CopyMem (DeviceName[11], Dsdt + Node->NameAdr, 4);
+
+        DBG (
+          "found HDMI device [0x%08x:%x] at %x and Name is %a\n",
+          HDMIADR1, HDMIADR2, DevAdr1, DeviceName[11]
+        );
+
+        ReplaceName (Dsdt + DevAdr, BridgeSize, DeviceName[11], "HDAU");
+        HdauFound = TRUE;
       } else {
+        DBG ("have no HDMI device while HDMIADR2=%x\n", HDMIADR2);
         DevAdr1 = DevAdr;
       }
-      break;
-    } // End if DevAdr1 find
-  }
+    } else {
+      DevAdr1 = DevAdr;
+    }
+  } // End if DevAdr1 find
 
   if (BridgeFound) { // bridge or device
     if (HdauFound) {
       i = DevAdr1;
       Size = AcpiGetSize (Dsdt, i);
-      k = FindMethod (Dsdt + i, Size, "_DSM");
+      k = AmlTreeFindMethod (Dsdt, Len, i, "_DSM");
 
       if (k != 0) {
-        k += i;
         if (BIT_ISSET (gSettings.DropOEM_DSM, DEV_HDMI)) {
           Size = AcpiGetSize (Dsdt, k);
           SizeOffset = - 1 - Size;
@@ -1927,12 +3167,13 @@ FIXNetwork (
   UINT8     *Dsdt,
   UINT32    Len
 ) {
-  UINT32      i, k, NetworkADR = 0, BridgeSize, Size, BrdADR = 0,
-              PCIADR, PCISIZE = 0, FakeID = 0, FakeVen = 0;
-  INT32       SizeOffset;
-  AML_CHUNK   *Met, *Met2, *Brd, *Root, *Pack, *Dev;
-  CHAR8       *Network, NameCard[32];
-  UINTN       Length = ARRAY_SIZE (NameCard);
+  UINT32          i, k, NetworkADR = 0, Size, BrdADR = 0,
+                  PCIADR, PCISIZE = 0, FakeID = 0, FakeVen = 0;
+  INT32           SizeOffset;
+  AML_CHUNK       *Met, *Met2, *Brd, *Root, *Pack, *Dev;
+  AML_TREE_NODE   *Node;
+  CHAR8           *Network, NameCard[32];
+  UINTN           Length = ARRAY_SIZE (NameCard);
 
   if (!NetworkADR1) {
     return Len;
@@ -1960,56 +3201,37 @@ FIXNetwork (
   NetworkName = FALSE;
 
   // Network Address
-  for (i = 0x24; i < Len - 10; i++) {
-    if (CmpAdr (Dsdt, i, NetworkADR1)) { //0x001C0004
-      BrdADR = DevFind (Dsdt, i);
-      if (!BrdADR) {
-        continue;
-      }
-
-      BridgeSize = AcpiGetSize (Dsdt, BrdADR);
-      if (!BridgeSize) {
-        continue;
-      }
-
-      if (NetworkADR2 != 0xFFFE) {  //0
-        for (k = BrdADR + 9; k < BrdADR + BridgeSize; k++) {
-          if (CmpAdr (Dsdt, k, NetworkADR2)) {
-            NetworkADR = DevFind (Dsdt, k);
-            if (!NetworkADR) {
-              continue;
-            }
-
-            DeviceName[1] = AllocateZeroPool (5);
-            CopyMem (DeviceName[1], Dsdt + k, 4);
-            DBG ("found NetWork device [0x%08x:%x] at %x and Name is %a\n",
-                NetworkADR1, NetworkADR2, NetworkADR, DeviceName[1]);
-            //renaming disabled until better way will found
-            //ReplaceName (Dsdt + BrdADR, BridgeSize, DeviceName[1], "GIGE");
-            NetworkName = TRUE;
-            break;
-          }
-        }
-
-        if (!NetworkName) {
-          DBG ("have no Network device while NetworkADR2=%x\n", NetworkADR2);
-          //in this case NetworkADR point to bridge
-          NetworkADR = BrdADR;
-        }
+  Node = AmlTreeFindDevice (Dsdt, Len, 0, NetworkADR1); //0x001C0004
+  if (Node != NULL) {
+    BrdADR = Node->SizeAdr;
+
+    if (NetworkADR2 != 0xFFFE) {  //0
+      Node = AmlTreeFindDevice (Dsdt, Len, BrdADR, NetworkADR2);
+      if (Node != NULL) {
+        NetworkADR = Node->SizeAdr;
+        DeviceName[1] = AllocateZeroPool (5);
+        CopyMem (DeviceName[1], Dsdt + Node->NameAdr, 4);
+        DBG ("found NetWork device [0x%08x:%x] at %x and Name is %a\n",
+            NetworkADR1, NetworkADR2, NetworkADR, DeviceName[1]);
+        //renaming disabled until better way will found
+        //ReplaceName (Dsdt + BrdADR, AcpiGetSize (Dsdt, BrdADR), DeviceName[1], "GIGE");
+        NetworkName = TRUE;
       } else {
+        DBG ("have no Network device while NetworkADR2=%x\n", NetworkADR2);
+        //in this case NetworkADR point to bridge
         NetworkADR = BrdADR;
       }
-      break;
-    } // End if NetworkADR find
-  }
+    } else {
+      NetworkADR = BrdADR;
+    }
+  } // End if NetworkADR find
 
   if (BrdADR) { // bridge or device
     i = NetworkADR;
     Size = AcpiGetSize (Dsdt, i);
-    k = FindMethod (Dsdt + i, Size, "_DSM");
+    k = AmlTreeFindMethod (Dsdt, Len, i, "_DSM");
 
     if (k != 0) {
-      k += i;
       if (BIT_ISSET (gSettings.DropOEM_DSM, DEV_LAN)) {
         Size = AcpiGetSize (Dsdt, k);
         SizeOffset = - 1 - Size;
@@ -2152,12 +3374,13 @@ FIXAirport (
   UINT8     *Dsdt,
   UINT32    Len
 ) {
-  UINT32      i, k, PCIADR, PCISIZE = 0, FakeID = 0, FakeVen = 0,
-              ArptADR = 0, BridgeSize, Size, BrdADR = 0;
-  INT32       SizeOffset;
-  AML_CHUNK   *Met, *Met2, *Brd, *Root, *Pack, *Dev;
-  CHAR8       *Network, NameCard[32];
-  UINTN       Length = ARRAY_SIZE (NameCard);
+  UINT32          i, k, PCIADR, PCISIZE = 0, FakeID = 0, FakeVen = 0,
+                  ArptADR = 0, BridgeSize, Size, BrdADR = 0;
+  INT32           SizeOffset;
+  AML_CHUNK       *Met, *Met2, *Brd, *Root, *Pack, *Dev;
+  AML_TREE_NODE   *Node;
+  CHAR8           *Network, NameCard[32];
+  UINTN           Length = ARRAY_SIZE (NameCard);
 
   if (!ArptADR1) {
    return Len; // no device - no patch
@@ -2183,45 +3406,29 @@ FIXAirport (
 
   ArptName = FALSE;
 
-  for (i = 0x20; i < Len - 10; i++) {
-    // AirPort Address
-    if (CmpAdr (Dsdt, i, ArptADR1)) {
-      BrdADR = DevFind (Dsdt, i);
-      if (!BrdADR) {
-        continue;
-      }
-
-      BridgeSize = AcpiGetSize (Dsdt, BrdADR);
-      if (!BridgeSize) {
-        continue;
-      }
-
-      if (ArptADR2 != 0xFFFE) {
-        for (k = BrdADR + 9; k < BrdADR + BridgeSize; k++) {
-          if (CmpAdr (Dsdt, k, ArptADR2)) {
-            ArptADR = DevFind (Dsdt, k);
-
-            if (!ArptADR) {
-              continue;
-            }
-
-            DeviceName[9] = AllocateZeroPool (5);
-            CopyMem (DeviceName[9], Dsdt + k, 4);
-
-            DBG (
-              "found Airport device [%08x:%x] at %x And Name is %a\n",
-              ArptADR1, ArptADR2, ArptADR, DeviceName[9]
-            );
-
-            ReplaceName (Dsdt + BrdADR, BridgeSize, DeviceName[9], "ARPT");
-            ArptName = TRUE;
-            break;
-          }
-        }
+  // AirPort Address
+  Node = AmlTreeFindDevice (Dsdt, Len, 0, ArptADR1);
+  if (Node != NULL) {
+    BrdADR = Node->SizeAdr;
+    BridgeSize = AcpiGetSize (Dsdt, BrdADR);
+
+    if (ArptADR2 != 0xFFFE) {
+      Node = AmlTreeFindDevice (Dsdt, Len, BrdADR, ArptADR2);
+      if (Node != NULL) {
+        ArptADR = Node->SizeAdr;
+        DeviceName[9] = AllocateZeroPool (5);
+        CopyMem (DeviceName[9], Dsdt + Node->NameAdr, 4);
+
+        DBG (
+          "found Airport device [%08x:%x] at %x And Name is %a\n",
+          ArptADR1, ArptADR2, ArptADR, DeviceName[9]
+        );
+
+        ReplaceName (Dsdt + BrdADR, BridgeSize, DeviceName[9], "ARPT");
+        ArptName = TRUE;
       }
-      break;
-    } // End ArptADR2
-  }
+    }
+  } // End ArptADR2
 
   if (!ArptName) {
     ArptADR = BrdADR;
@@ -2231,9 +3438,8 @@ FIXAirport (
     i = ArptADR;
     Size = AcpiGetSize (Dsdt, i);
 
-    k = FindMethod (Dsdt + i, Size, "_DSM");
+    k = AmlTreeFindMethod (Dsdt, Len, i, "_DSM");
     if (k != 0) {
-      k += i;
       if (BIT_ISSET (gSettings.DropOEM_DSM, DEV_WIFI)) {
         Size = AcpiGetSize (Dsdt, k);
         SizeOffset = - 1 - Size;
@@ -2395,10 +3601,11 @@ AddMCHC (
   UINT8     *Dsdt,
   UINT32    Len
 ) {
-  UINT32      i, k = 0, PCIADR, PCISIZE = 0; //, Size;
-  INT32       SizeOffset;
-  AML_CHUNK   *Root, *Device; //*met, *met2; *Pack;
-  CHAR8       *Mchc;
+  UINT32          k = 0, PCIADR, PCISIZE = 0; //, Size;
+  INT32           SizeOffset;
+  AML_CHUNK       *Root, *Device; //*met, *met2; *Pack;
+  AML_TREE_NODE   *Node;
+  CHAR8           *Mchc;
 
   PCIADR = GetPciDevice (Dsdt, Len);
   if (PCIADR) {
@@ -2411,13 +3618,10 @@ AddMCHC (
   }
 
   //Find Device MCHC by name
-  for (i = 0x20; i < Len - 10; i++) {
-    k = CmpDev (Dsdt, i, (UINT8 *)"MCHC");
-    if (k != 0) {
-      DBG ("device name (MCHC) found at %x, don't add!\n", k);
-      //break;
-      return Len;
-    }
+  Node = AmlTreeFindNamedDevice (Dsdt, Len, "MCHC");
+  if (Node != NULL) {
+    DBG ("device name (MCHC) found at %x, don't add!\n", Node->SizeAdr);
+    return Len;
   }
 
   DBG ("Start Add MCHC\n");
@@ -2452,10 +3656,11 @@ AddIMEI (
   UINT8     *Dsdt,
   UINT32    Len
 ) {
-  UINT32      i, k = 0, PCIADR, PCISIZE = 0, FakeID, FakeVen;
-  INT32       SizeOffset;
-  AML_CHUNK   *Root, *Device, *Met, *Met2, *Pack;
-  CHAR8       *Imei;
+  UINT32          k = 0, PCIADR, PCISIZE = 0, FakeID, FakeVen;
+  INT32           SizeOffset;
+  AML_CHUNK       *Root, *Device, *Met, *Met2, *Pack;
+  AML_TREE_NODE   *Node;
+  CHAR8           *Imei;
 
   if (gSettings.FakeIMEI) {
     FakeID = gSettings.FakeIMEI >> 16;
@@ -2474,24 +3679,18 @@ AddIMEI (
 
   // Find Device IMEI
   if (IMEIADR1) {
-    for (i = 0x20; i < Len - 10; i++) {
-      if (CmpAdr (Dsdt, i, IMEIADR1)) {
-        k = DevFind (Dsdt, i);
-        if (k) {
-          DBG ("device (IMEI) found at %x, don't add!\n", k);
-          return Len;
-        }
-      }
+    Node = AmlTreeFindDevice (Dsdt, Len, 0, IMEIADR1);
+    if (Node != NULL) {
+      DBG ("device (IMEI) found at %x, don't add!\n", Node->SizeAdr);
+      return Len;
     }
   }
 
   //Find Device IMEI by name
-  for (i = 0x20; i < Len - 10; i++) {
-    k = CmpDev (Dsdt, i, (UINT8 *)"IMEI");
-    if (k != 0) {
-      DBG ("device name (IMEI) found at %x, don't add!\n", k);
-      return Len;
-    }
+  Node = AmlTreeFindNamedDevice (Dsdt, Len, "IMEI");
+  if (Node != NULL) {
+    DBG ("device name (IMEI) found at %x, don't add!\n", Node->SizeAdr);
+    return Len;
   }
 
   DBG ("Start Add IMEI\n");
@@ -2543,10 +3742,11 @@ AddHDEF (
   UINT8     *Dsdt,
   UINT32    Len
 ) {
-  UINT32        i, k, PCIADR, PCISIZE = 0, HDAADR = 0, Size;
-  INT32         SizeOffset;
-  AML_CHUNK     *Root, *Met, *Met2, *Device, *Pack;
-  CHAR8         *Hdef;
+  UINT32          i, k, PCIADR, PCISIZE = 0, HDAADR = 0, Size;
+  INT32           SizeOffset;
+  AML_CHUNK       *Root, *Met, *Met2, *Device, *Pack;
+  AML_TREE_NODE   *Node;
+  CHAR8           *Hdef;
 
   PCIADR = GetPciDevice (Dsdt, Len);
   if (PCIADR) {
@@ -2561,37 +3761,26 @@ AddHDEF (
   //Len = DeleteDevice ("AZAL", Dsdt, Len);
 
   // HDA Address
-  for (i = 0x20; i < (Len - 10); i++) {
-    if (
-      HDAFIX &&
-      (HDAADR1 != 0x00000000) &&
-      CmpAdr (Dsdt, i, HDAADR1)
-    ) {
-      HDAADR = DevFind (Dsdt, i);
-      if (!HDAADR) {
-        continue;
-      }
-
-      //BridgeSize = AcpiGetSize (Dsdt, HDAADR);
-      DeviceName[4] = AllocateZeroPool (5);
-      CopyMem (DeviceName[4], Dsdt + i, 4);
+  Node = (HDAFIX && (HDAADR1 != 0x00000000)) ? AmlTreeFindDevice (Dsdt, Len, 0, HDAADR1) : NULL;
+  if (Node != NULL) {
+    HDAADR = Node->SizeAdr;
+    //BridgeSize = AcpiGetSize (Dsdt, HDAADR);
+    DeviceName[4] = AllocateZeroPool (5);
+    CopyMem (DeviceName[4], Dsdt + Node->NameAdr, 4);
 
-      DBG ("found HDA device NAME (_ADR,0x%08x) And Name is %a\n",
-          HDAADR1, DeviceName[4]);
+    DBG ("found HDA device NAME (_ADR,0x%08x) And Name is %a\n",
+        HDAADR1, DeviceName[4]);
 
-      ReplaceName (Dsdt, Len, DeviceName[4], "HDEF");
-      HDAFIX = FALSE;
-      break;
-    } // End HDA
-  }
+    ReplaceName (Dsdt, Len, DeviceName[4], "HDEF");
+    HDAFIX = FALSE;
+  } // End HDA
 
   if (HDAADR) { // bridge or device
     i = HDAADR;
     Size = AcpiGetSize (Dsdt, i);
-    k = FindMethod (Dsdt + i, Size, "_DSM");
+    k = AmlTreeFindMethod (Dsdt, Len, i, "_DSM");
 
     if (k != 0) {
-      k += i;
       if (BIT_ISSET (gSettings.DropOEM_DSM, DEV_HDA)) {
         Size = AcpiGetSize (Dsdt, k);
         SizeOffset = - 1 - Size;
@@ -2690,6 +3879,8 @@ FixBiosDsdt (
   // First check hardware address: GetPciADR (DevicePath, &NetworkADR1, &NetworkADR2);
   CheckHardware ();
 
+  AmlTreeInvalidate ();
+
   //arbitrary fixes
   if (/*!Patched &&*/ (gSettings.PatchDsdtNum > 0) && gSettings.PatchDsdt) {
     MsgLog ("Patching DSDT:\n");
@@ -2704,7 +3895,7 @@ FixBiosDsdt (
     goto Finish;
   }
 
-  if (!FindMethod (Temp, DsdtLen, "DTGP")) {
+  if (!AmlTreeFindMethod (Temp, DsdtLen, 0, "DTGP")) {
     CopyMem ((CHAR8 *)Temp + DsdtLen, Dtgp, ARRAY_SIZE (Dtgp));
     DsdtLen += ARRAY_SIZE (Dtgp);
     ((EFI_ACPI_DESCRIPTION_HEADER *)Temp)->Length = DsdtLen;
@@ -2772,6 +3963,8 @@ FixBiosDsdt (
 
   Finish:
 
+  AmlTreeInvalidate ();
+
   // Finish DSDT patch and resize DSDT Length
   Temp[4] = (DsdtLen & 0x000000FF);
   Temp[5] = (UINT8)((DsdtLen & 0x0000FF00) >>  8);
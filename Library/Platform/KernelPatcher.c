@@ -154,9 +154,290 @@ GetKernelVersion (
 }
 #endif
 
+//
+// Mach-O symbol index: open addressing over defined symbols, keyed by name (n_strx).
+//
+
+STATIC
+UINT32
+MachOSymbolNameHash (
+  IN CHAR8    *Name,
+  IN CHAR8    *End
+) {
+  UINT32  Hash = 2166136261U;
+
+  while ((Name < End) && *Name) {
+    Hash = (Hash ^ (UINT8)*Name++) * 16777619U;
+  }
+
+  return Hash;
+}
+
+//
+// SymBin / StrBin are nlist_64 array and string table as mapped in memory.
+//
+EFI_STATUS
+MachOBuildSymbolIndex (
+  OUT MACH_SYMBOL_INDEX   *Index,
+  IN  UINT8               *SymBin,
+  IN  UINT32              NSyms,
+  IN  UINT8               *StrBin,
+  IN  UINT32              StrSize
+) {
+  struct nlist_64   *Sym;
+  CHAR8             *StrEnd = (CHAR8 *)StrBin + StrSize, *Name;
+  UINT32            i, Slot, Size = 16;
+
+  if ((Index == NULL) || (SymBin == NULL) || (StrBin == NULL) || !NSyms || !StrSize) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  ZeroMem (Index, sizeof (MACH_SYMBOL_INDEX));
+
+  // kept without Slots if allocation fails, MachOSymbolScan () still works on it
+  Index->Symbols = (struct nlist_64 *)SymBin;
+  Index->NSyms = NSyms;
+  Index->StrBin = (CHAR8 *)StrBin;
+  Index->StrSize = StrSize;
+
+  while (Size < (NSyms * 2)) {
+    Size <<= 1;
+  }
+
+  Index->Slots = AllocateZeroPool (Size * sizeof (UINT32));
+  if (Index->Slots == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Index->Size = Size;
+
+  for (i = 0; i < NSyms; i++) {
+    Sym = &Index->Symbols[i];
+
+    if (!Sym->n_value || !Sym->n_un.n_strx || (Sym->n_un.n_strx >= StrSize)) {
+      continue;
+    }
+
+    Name = Index->StrBin + Sym->n_un.n_strx;
+    Slot = MachOSymbolNameHash (Name, StrEnd) & (Size - 1);
+
+    while (Index->Slots[Slot]) {
+      // keep first definition
+      if (AsciiStrCmp (Index->StrBin + Index->Symbols[Index->Slots[Slot] - 1].n_un.n_strx, Name) == 0) {
+        break;
+      }
+
+      Slot = (Slot + 1) & (Size - 1);
+    }
+
+    if (!Index->Slots[Slot]) {
+      Index->Slots[Slot] = i + 1;
+      Index->Count++;
+    }
+  }
+
+  DBG ("%a: %d of %d symbols indexed\n", __FUNCTION__, Index->Count, NSyms);
+
+  return EFI_SUCCESS;
+}
+
+//
+// Linear search for the first defined symbol Name, for tables that could not be indexed.
+//
+STATIC
+struct nlist_64 *
+MachOSymbolScan (
+  IN MACH_SYMBOL_INDEX   *Index,
+  IN CHAR8               *Name
+) {
+  struct nlist_64   *Sym;
+  UINT32            i;
+
+  for (i = 0; i < Index->NSyms; i++) {
+    Sym = &Index->Symbols[i];
+
+    if (
+      Sym->n_value && Sym->n_un.n_strx && (Sym->n_un.n_strx < Index->StrSize) &&
+      (AsciiStrCmp (Index->StrBin + Sym->n_un.n_strx, Name) == 0)
+    ) {
+      return Sym;
+    }
+  }
+
+  return NULL;
+}
+
+VOID
+MachOFreeSymbolIndex (
+  IN OUT MACH_SYMBOL_INDEX   *Index
+) {
+  if ((Index != NULL) && (Index->Slots != NULL)) {
+    FreePool (Index->Slots);
+    ZeroMem (Index, sizeof (MACH_SYMBOL_INDEX));
+  }
+}
+
+//
+// Returns defined symbol Name, or NULL.
+//
+struct nlist_64 *
+MachOSymbolLookup (
+  IN MACH_SYMBOL_INDEX   *Index,
+  IN CHAR8               *Name
+) {
+  struct nlist_64   *Sym;
+  UINT32            Slot;
+
+  if ((Index == NULL) || (Index->Slots == NULL) || (Name == NULL)) {
+    return NULL;
+  }
+
+  Slot = MachOSymbolNameHash (Name, Name + AsciiStrLen (Name)) & (Index->Size - 1);
+
+  while (Index->Slots[Slot]) {
+    Sym = &Index->Symbols[Index->Slots[Slot] - 1];
+
+    if (AsciiStrCmp (Index->StrBin + Sym->n_un.n_strx, Name) == 0) {
+      return Sym;
+    }
+
+    Slot = (Slot + 1) & (Index->Size - 1);
+  }
+
+  return NULL;
+}
+
+//
+// Kernel symbol -> offset in KernelInfo->Bin, 0 if missing or not in section SectIndex.
+// The index is built on first call from the symbol table InitKernel () found,
+// and released by KernelAndKextsPatcherStart () once patching is done. Without
+// memory for it the table is searched linearly instead.
+//
+UINT32
+GetKernelSymbolLocation (
+  IN CHAR8  *Name,
+  IN UINT8  SectIndex
+) {
+  MACH_SYMBOL_INDEX   *Index = &KernelInfo->Symbols;
+  struct nlist_64     *Sym;
+
+  if (Index->Symbols == NULL) {
+    return 0;
+  }
+
+  if (Index->Slots == NULL) {
+    if (EFI_ERROR (MachOBuildSymbolIndex (Index, (UINT8 *)Index->Symbols, Index->NSyms, (UINT8 *)Index->StrBin, Index->StrSize))) {
+      DBG ("%a: cannot index symbol table\n", __FUNCTION__);
+    }
+  }
+
+  Sym = (Index->Slots != NULL) ? MachOSymbolLookup (Index, Name) : MachOSymbolScan (Index, Name);
+
+  if ((Sym == NULL) || (Sym->n_sect != SectIndex)) {
+    return 0;
+  }
+
+  return (UINT32)Sym->n_value - (UINT32)(UINTN)KernelInfo->Bin + (UINT32)KernelInfo->RelocBase;
+}
+
+STATIC
+UINT8
+KernelSymbolSection (
+  IN KernelPatchSymbolLookupIndex   Index
+) {
+  switch (Index) {
+    case kLoadEXEStart:
+    case kLoadEXEEnd:
+    case kCPUInfoStart:
+    case kCPUInfoEnd:
+      return KernelInfo->TextIndex;
+
+    case kVersion:
+    case kVersionMajor:
+    case kVersionMinor:
+    case kRevision:
+      return KernelInfo->ConstIndex;
+
+    case kXCPMStart:
+    case kXCPMEnd:
+      return KernelInfo->DataIndex;
+
+    case kStartupExtStart:
+    case kStartupExtEnd:
+      return KernelInfo->KldIndex;
+
+    default:
+      break;
+  }
+
+  return 0;
+}
+
+STATIC
+VOID
+KernelSymbolFound (
+  IN KernelPatchSymbolLookupIndex   Index,
+  IN UINT32                         PatchLocation
+) {
+  UINT8   *Data = (UINT8 *)KernelInfo->Bin;
+
+  switch (Index) {
+    case kLoadEXEStart:
+      KernelInfo->LoadEXEStart = PatchLocation;
+      break;
+
+    case kLoadEXEEnd:
+      KernelInfo->LoadEXEEnd = PatchLocation;
+      break;
+
+    case kCPUInfoStart:
+      KernelInfo->CPUInfoStart = PatchLocation;
+      break;
+
+    case kCPUInfoEnd:
+      KernelInfo->CPUInfoEnd = PatchLocation;
+      break;
+
+    case kVersion:
+      KernelInfo->Version = PTR_OFFSET (Data, PatchLocation, CHAR8 *);
+      break;
+
+    case kVersionMajor:
+      KernelInfo->VersionMajor = *(PTR_OFFSET (Data, PatchLocation, UINT32 *));
+      break;
+
+    case kVersionMinor:
+      KernelInfo->VersionMinor = *(PTR_OFFSET (Data, PatchLocation, UINT32 *));
+      break;
+
+    case kRevision:
+      KernelInfo->Revision = *(PTR_OFFSET (Data, PatchLocation, UINT32 *));
+      break;
+
+    case kXCPMStart:
+      KernelInfo->XCPMStart = PatchLocation;
+      break;
+
+    case kXCPMEnd:
+      KernelInfo->XCPMEnd = PatchLocation;
+      break;
+
+    case kStartupExtStart:
+      KernelInfo->StartupExtStart = PatchLocation;
+      break;
+
+    case kStartupExtEnd:
+      KernelInfo->StartupExtEnd = PatchLocation;
+      //KernelInfo->PrelinkedStart = KernelInfo->StartupExtEnd;
+      break;
+
+    default:
+      break;
+  }
+}
+
 VOID
 InitKernel () {
-  struct  nlist_64            *SysTabEntry;
   struct  symtab_command      *ComSymTab;
   struct  load_command        *LoadCommand;
   struct  segment_command_64  *SegCmd64;
@@ -298,100 +579,28 @@ InitKernel () {
   }
 
   if (ISectionIndex && (LinkeditAddr != 0) && (SymOff != 0)) {
-    UINTN     CntPatches = KernelPatchSymbolLookupCount /*+ 2*/;
-    CHAR8     *SymbolName = NULL;
-    UINT32    PatchLocation;
+    UINT32  Location;
 
-    Cnt = 0;
     SymBin = (UINT8 *)(UINTN)(LinkeditAddr + (SymOff - LinkeditFileOff) + KernelInfo->RelocBase);
     StrBin = (UINT8 *)(UINTN)(LinkeditAddr + (StrOff - LinkeditFileOff) + KernelInfo->RelocBase);
 
     //DBG ("%a: symaddr = 0x%x, straddr = 0x%x\n", __FUNCTION__, SymBin, StrBin);
 
-    while ((Cnt < NSyms) && CntPatches) {
-      SysTabEntry = (struct nlist_64 *)(SymBin);
+    // GetKernelSymbolLocation () indexes it on the first lookup below
+    KernelInfo->Symbols.Symbols = (struct nlist_64 *)SymBin;
+    KernelInfo->Symbols.NSyms = NSyms;
+    KernelInfo->Symbols.StrBin = (CHAR8 *)StrBin;
+    KernelInfo->Symbols.StrSize = StrSize;
 
-      if (SysTabEntry->n_value) {
-        SymbolName = (CHAR8 *)(StrBin + SysTabEntry->n_un.n_strx);
-        Addr = (UINT32)SysTabEntry->n_value;
-        PatchLocation = Addr - (UINT32)(UINTN)KernelInfo->Bin + (UINT32)KernelInfo->RelocBase;
+    for (Cnt = 0; Cnt < KernelPatchSymbolLookupCount; Cnt++) {
+      Location = GetKernelSymbolLocation (
+                   KernelPatchSymbolLookup[Cnt].Name,
+                   KernelSymbolSection (KernelPatchSymbolLookup[Cnt].Index)
+                 );
 
-        if (SysTabEntry->n_sect == KernelInfo->TextIndex) {
-          if (AsciiStrCmp (SymbolName, KernelPatchSymbolLookup[kLoadEXEStart].Name) == 0) {
-            KernelInfo->LoadEXEStart = PatchLocation;
-            CntPatches--;
-          }
-          else if (AsciiStrCmp (SymbolName, KernelPatchSymbolLookup[kLoadEXEEnd].Name) == 0) {
-            KernelInfo->LoadEXEEnd = PatchLocation;
-            CntPatches--;
-          }
-          else if (AsciiStrCmp (SymbolName, KernelPatchSymbolLookup[kCPUInfoStart].Name) == 0) {
-            KernelInfo->CPUInfoStart = PatchLocation;
-            CntPatches--;
-          }
-          else if (AsciiStrCmp (SymbolName, KernelPatchSymbolLookup[kCPUInfoEnd].Name) == 0) {
-            KernelInfo->CPUInfoEnd = PatchLocation;
-            CntPatches--;
-          }/*
-          else if (AsciiStrCmp (SymbolName, "__ZN6OSKext25updateLoadedKextSummariesEv") == 0) {
-            LOLAddr = PatchLocation;
-            LOLVal = *(PTR_OFFSET (Data, PatchLocation, UINT64 *));
-            CntPatches--;
-          }*/
-        } else if (SysTabEntry->n_sect == KernelInfo->ConstIndex) {
-          if (AsciiStrCmp (SymbolName, KernelPatchSymbolLookup[kVersion].Name) == 0) {
-            KernelInfo->Version = PTR_OFFSET (Data, PatchLocation, CHAR8 *);
-            CntPatches--;
-          }
-          else if (AsciiStrCmp (SymbolName, KernelPatchSymbolLookup[kVersionMajor].Name) == 0) {
-            KernelInfo->VersionMajor = *(PTR_OFFSET (Data, PatchLocation, UINT32 *));
-            CntPatches--;
-          }
-          else if (AsciiStrCmp (SymbolName, KernelPatchSymbolLookup[kVersionMinor].Name) == 0) {
-            KernelInfo->VersionMinor = *(PTR_OFFSET (Data, PatchLocation, UINT32 *));
-            CntPatches--;
-          }
-          else if (AsciiStrCmp (SymbolName, KernelPatchSymbolLookup[kRevision].Name) == 0) {
-            KernelInfo->Revision = *(PTR_OFFSET (Data, PatchLocation, UINT32 *));
-            CntPatches--;
-          }
-        } else if (SysTabEntry->n_sect == KernelInfo->DataIndex) {
-          if (AsciiStrCmp (SymbolName, KernelPatchSymbolLookup[kXCPMStart].Name) == 0) {
-            KernelInfo->XCPMStart = PatchLocation;
-            CntPatches--;
-          }
-          else if (AsciiStrCmp (SymbolName, KernelPatchSymbolLookup[kXCPMEnd].Name) == 0) {
-            KernelInfo->XCPMEnd = PatchLocation;
-            CntPatches--;
-          }/*
-        } else if (SysTabEntry->n_sect == KernelInfo->DataCommonIndex) {
-          if (AsciiStrCmp (SymbolName, "_gLoadedKextSummaries") == 0) {
-            loadedKextSummaries = (PTR_OFFSET (Data, PatchLocation, OSKextLoadedKextSummaryHeader *));
-            CntPatches--;
-          }*/
-        } else if (SysTabEntry->n_sect == KernelInfo->KldIndex) {
-          if (AsciiStrCmp (SymbolName, KernelPatchSymbolLookup[kStartupExtStart].Name) == 0) {
-            KernelInfo->StartupExtStart = PatchLocation;
-            CntPatches--;
-          }
-          else if (AsciiStrCmp (SymbolName, KernelPatchSymbolLookup[kStartupExtEnd].Name) == 0) {
-            KernelInfo->StartupExtEnd = PatchLocation;
-            //KernelInfo->PrelinkedStart = PatchLocation;
-            CntPatches--;
-          }/*
-          //else if (AsciiStrCmp (SymbolName, KernelPatchSymbolLookup[kPrelinkedStart].Name) == 0) {
-          //  KernelInfo->PrelinkedStart = PatchLocation;
-          //  CntPatches--;
-          //}
-          else if (AsciiStrCmp (SymbolName, KernelPatchSymbolLookup[kPrelinkedEnd].Name) == 0) {
-            KernelInfo->PrelinkedEnd = PatchLocation;
-            CntPatches--;
-          }*/
-        }
+      if (Location) {
+        KernelSymbolFound (KernelPatchSymbolLookup[Cnt].Index, Location);
       }
-
-      Cnt++;
-      SymBin += sizeof (struct nlist_64);
     }
   } else {
     DBG ("%a: symbol table not found\n", __FUNCTION__);
@@ -704,39 +913,326 @@ FindBootArgs (
   return Ret;
 }
 
+typedef struct {
+  UINTN     Start;
+  UINTN     End;
+} KERNEL_USER_PATCH_RANGE;
+
+typedef struct {
+  KERNEL_PATCH              *Patch;
+  UINTN                     NextOffset;
+  UINTN                     *Hits;          // non-overlapping match offsets in the unpatched image
+  UINTN                     HitCount;
+  UINTN                     HitSize;
+  BOOLEAN                   Overflow;       // hit list could not grow, patch goes the serial way
+  KERNEL_USER_PATCH_RANGE   **Written;      // shared list of ranges rewritten so far (apply phase)
+  UINTN                     *WrittenCount;
+  UINTN                     *WrittenSize;
+  UINTN                     Num;
+} KERNEL_USER_PATCH_STATE;
+
+STATIC
+BOOLEAN
+KernelUserPatchGrow (
+  IN OUT VOID   **Buffer,
+  IN OUT UINTN  *Size,
+  IN     UINTN  Count,
+  IN     UINTN  ItemSize
+) {
+  VOID    *NewBuffer;
+  UINTN   NewSize;
+
+  if (Count < *Size) {
+    return TRUE;
+  }
+
+  NewSize = (*Size != 0) ? (*Size << 1) : 16;
+  NewBuffer = ReallocatePool (*Size * ItemSize, NewSize * ItemSize, *Buffer);
+  if (NewBuffer == NULL) {
+    return FALSE;
+  }
+
+  *Buffer = NewBuffer;
+  *Size = NewSize;
+
+  return TRUE;
+}
+
+//
+// PatternMatcherScan () callback for the collecting pass: remembers where one
+// KernelPatches entry matches the unpatched image, skipping self-overlapping hits
+// and stopping at Count (MaxReplaces), the same way SearchAndReplace () does.
+//
+STATIC
+BOOLEAN
+KernelUserPatchCollect (
+  IN VOID   *Context,
+  IN UINTN  Index,
+  IN VOID   *EntryContext,
+  IN UINT8  *Buffer,
+  IN UINTN  Offset
+) {
+  KERNEL_USER_PATCH_STATE   *State = (KERNEL_USER_PATCH_STATE *)EntryContext;
+
+  if (Offset < State->NextOffset) {
+    return TRUE;
+  }
+
+  if (!KernelUserPatchGrow ((VOID **)&State->Hits, &State->HitSize, State->HitCount, sizeof (UINTN))) {
+    State->Overflow = TRUE;
+    return FALSE;
+  }
+
+  State->Hits[State->HitCount++] = Offset;
+  State->NextOffset = Offset + State->Patch->DataLen;
+
+  return ((State->Patch->Count <= 0) || (State->HitCount < (UINTN)State->Patch->Count));
+}
+
+//
+// Patches one hit and records the rewritten range, so later patches can tell
+// whether they see the bytes of this one. Returns FALSE if the range is lost.
+//
+STATIC
+BOOLEAN
+KernelUserPatchWrite (
+  IN OUT KERNEL_USER_PATCH_STATE  *State,
+  IN     UINT8                    *Buffer,
+  IN     UINTN                    Offset
+) {
+  PatternMatcherReplace (Buffer + Offset, State->Patch->Patch, State->Patch->DataLen, State->Patch->Wildcard);
+  State->Num++;
+
+  if (!KernelUserPatchGrow ((VOID **)State->Written, State->WrittenSize, *State->WrittenCount, sizeof (KERNEL_USER_PATCH_RANGE))) {
+    return FALSE;
+  }
+
+  (*State->Written)[*State->WrittenCount].Start = Offset;
+  (*State->Written)[*State->WrittenCount].End = Offset + State->Patch->DataLen;
+  (*State->WrittenCount)++;
+
+  return TRUE;
+}
+
+//
+// PatternMatcherScan () callback for the serial pass: patches the current image.
+//
+STATIC
+BOOLEAN
+KernelUserPatchApply (
+  IN VOID   *Context,
+  IN UINTN  Index,
+  IN VOID   *EntryContext,
+  IN UINT8  *Buffer,
+  IN UINTN  Offset
+) {
+  KERNEL_USER_PATCH_STATE   *State = (KERNEL_USER_PATCH_STATE *)EntryContext;
+
+  if (Offset < State->NextOffset) {
+    return TRUE;
+  }
+
+  if (!KernelUserPatchWrite (State, Buffer, Offset)) {
+    State->Overflow = TRUE;
+  }
+
+  State->NextOffset = Offset + State->Patch->DataLen;
+
+  return ((State->Patch->Count <= 0) || (State->Num < (UINTN)State->Patch->Count));
+}
+
+//
+// TRUE if a range rewritten by an earlier patch touches one of this patch's hits,
+// or makes it match somewhere it did not: its hits from the unpatched image are
+// then not what a serial SearchAndReplace () would find.
+//
+STATIC
+BOOLEAN
+KernelUserPatchInteracts (
+  IN KERNEL_USER_PATCH_STATE  *State,
+  IN UINT8                    *Buffer,
+  IN UINTN                    Size
+) {
+  KERNEL_USER_PATCH_RANGE   *Range;
+  UINTN                     i, j, Len = State->Patch->DataLen, Start, End;
+
+  if (Len > Size) {
+    return FALSE;
+  }
+
+  for (i = 0; i < *State->WrittenCount; i++) {
+    Range = &(*State->Written)[i];
+
+    for (j = 0; j < State->HitCount; j++) {
+      if ((State->Hits[j] < Range->End) && ((State->Hits[j] + Len) > Range->Start)) {
+        return TRUE;
+      }
+    }
+
+    Start = (Range->Start >= Len) ? (Range->Start - Len + 1) : 0;
+    End = MIN (Range->End, Size - Len + 1);
+
+    for (; Start < End; Start++) {
+      if (PatternMatcherCompare (Buffer + Start, State->Patch->Data, Len, State->Patch->Wildcard)) {
+        return TRUE;
+      }
+    }
+  }
+
+  return FALSE;
+}
+
+//
+// Serial pass for one patch over the current image, through a one entry matcher
+// so the rewritten ranges are recorded. Returns FALSE if ranges were lost.
+//
+STATIC
+BOOLEAN
+KernelUserPatchSerial (
+  IN OUT KERNEL_USER_PATCH_STATE  *State,
+  IN     UINT8                    *Buffer,
+  IN     UINTN                    Size
+) {
+  PATTERN_MATCHER   *Matcher = PatternMatcherCreate (1);
+
+  State->NextOffset = 0;
+  State->Num = 0;
+  State->Overflow = FALSE;
+
+  if (State->Patch->DataLen <= 0) {
+    PatternMatcherFree (Matcher);
+    return TRUE;
+  }
+
+  if ((Matcher == NULL) || (PatternMatcherAdd (Matcher, State->Patch->Data, State->Patch->DataLen, State->Patch->Wildcard, State) < 0)) {
+    PatternMatcherFree (Matcher);
+    State->Num = SearchAndReplace (
+                   Buffer,
+                   (UINT32)Size,
+                   State->Patch->Data,
+                   State->Patch->DataLen,
+                   State->Patch->Patch,
+                   State->Patch->Wildcard,
+                   State->Patch->Count
+                 );
+    return FALSE;
+  }
+
+  PatternMatcherScan (Matcher, Buffer, Size, KernelUserPatchApply, NULL);
+  PatternMatcherFree (Matcher);
+
+  return !State->Overflow;
+}
+
+//
+// Applies all enabled KernelPatches.
+//
+// The image is scanned once for every patch, then patches are applied in config
+// order, each exactly as a serial SearchAndReplace () over the image patched so
+// far would do: a patch whose hits overlap bytes rewritten by an earlier patch,
+// or which matches inside them, is redone serially on the current image. Once
+// rewritten ranges can no longer be tracked, the rest goes the serial way.
+//
 BOOLEAN
 KernelUserPatch (
   LOADER_ENTRY  *Entry
 ) {
-  UINTN    Num, i = 0, y = 0;
+  KERNEL_AND_KEXT_PATCHES   *Patches = Entry->KernelAndKextPatches;
+  KERNEL_USER_PATCH_STATE   *States, *State;
+  KERNEL_USER_PATCH_RANGE   *Written = NULL;
+  PATTERN_MATCHER           *Matcher;
+  UINTN                     i = 0, j, y = 0, WrittenCount = 0, WrittenSize = 0;
+  UINT32                    Size = gSettings.KernelPatchesWholePrelinked ? KernelInfo->PrelinkedSize : KernelInfo->KernelSize;
+  BOOLEAN                   Tracked;
 
   DBG ("%a: Start\n", __FUNCTION__);
 
-  for (i = 0; i < Entry->KernelAndKextPatches->NrKernels; ++i) {
-    DBG ("KernelUserPatch[%02d]: %a", i, Entry->KernelAndKextPatches->KernelPatches[i].Label);
+  States = AllocateZeroPool (Patches->NrKernels * sizeof (KERNEL_USER_PATCH_STATE));
+  if (States == NULL) {
+    DBG (" - error allocating states\n");
+    return FALSE;
+  }
+
+  Matcher = PatternMatcherCreate (Patches->NrKernels);
+  Tracked = (Matcher != NULL);
+
+  for (i = 0; i < Patches->NrKernels; ++i) {
+    States[i].Patch = &Patches->KernelPatches[i];
+    States[i].Written = &Written;
+    States[i].WrittenCount = &WrittenCount;
+    States[i].WrittenSize = &WrittenSize;
+
+    if (
+      !Patches->KernelPatches[i].Disabled &&
+      Tracked &&
+      (PatternMatcherAdd (
+        Matcher,
+        Patches->KernelPatches[i].Data,
+        Patches->KernelPatches[i].DataLen,
+        Patches->KernelPatches[i].Wildcard,
+        &States[i]
+      ) < 0)
+    ) {
+      States[i].Overflow = TRUE;
+    }
+  }
+
+  if (Matcher != NULL) {
+    PatternMatcherScan (Matcher, KernelInfo->Bin, Size, KernelUserPatchCollect, NULL);
+    PatternMatcherFree (Matcher);
+  }
+
+  for (i = 0; i < Patches->NrKernels; ++i) {
+    State = &States[i];
+
+    DBG ("KernelUserPatch[%02d]: %a", i, State->Patch->Label);
 
-    if (Entry->KernelAndKextPatches->KernelPatches[i].Disabled) {
+    if (State->Patch->Disabled) {
       DBG (" | DISABLED!\n");
       continue;
     }
 
-    Num = SearchAndReplace (
-            KernelInfo->Bin,
-            gSettings.KernelPatchesWholePrelinked ? KernelInfo->PrelinkedSize : KernelInfo->KernelSize,
-            Entry->KernelAndKextPatches->KernelPatches[i].Data,
-            Entry->KernelAndKextPatches->KernelPatches[i].DataLen,
-            Entry->KernelAndKextPatches->KernelPatches[i].Patch,
-            Entry->KernelAndKextPatches->KernelPatches[i].Wildcard,
-            Entry->KernelAndKextPatches->KernelPatches[i].Count
-          );
-
-    if (Num) {
+    if (!Tracked) {
+      // no matcher or lost track of rewritten ranges: plain serial patching
+      State->Num = SearchAndReplace (
+                     KernelInfo->Bin,
+                     Size,
+                     State->Patch->Data,
+                     State->Patch->DataLen,
+                     State->Patch->Patch,
+                     State->Patch->Wildcard,
+                     State->Patch->Count
+                   );
+    } else if (State->Overflow || KernelUserPatchInteracts (State, KernelInfo->Bin, Size)) {
+      DBG (" | serial");
+      Tracked = KernelUserPatchSerial (State, KernelInfo->Bin, Size);
+    } else {
+      for (j = 0; j < State->HitCount; j++) {
+        if (!KernelUserPatchWrite (State, KernelInfo->Bin, State->Hits[j])) {
+          Tracked = FALSE;
+        }
+      }
+    }
+
+    if (State->Num) {
       y++;
     }
 
-    DBG (" | %r: %d replaces done\n", Num ? EFI_SUCCESS : EFI_NOT_FOUND, Num);
+    DBG (" | %r: %d replaces done\n", State->Num ? EFI_SUCCESS : EFI_NOT_FOUND, State->Num);
+  }
+
+  for (i = 0; i < Patches->NrKernels; ++i) {
+    if (States[i].Hits != NULL) {
+      FreePool (States[i].Hits);
+    }
+  }
+
+  if (Written != NULL) {
+    FreePool (Written);
   }
 
+  FreePool (States);
+
   DBG ("%a: End\n", __FUNCTION__);
 
   return (y != 0);
@@ -1130,7 +1626,7 @@ KernelAndKextsPatcherStart (
     if (Status == EFI_BUFFER_TOO_SMALL) {
       // var exists - just exit
       DBG ("InjectKexts: skip, FSInject already injected\n");
-      return;
+      goto Finish;
     }
 
     if (!KernelAndKextPatcherInit (Entry)) {
@@ -1147,9 +1643,15 @@ KernelAndKextsPatcherStart (
     }
   }
 
-  return;
+  goto Finish;
 
   NoKernelData:
 
   DBG ("==> ERROR: in KernelAndKextPatcherInit\n");
+
+  Finish:
+
+  if (KernelInfo != NULL) {
+    MachOFreeSymbolIndex (&KernelInfo->Symbols);
+  }
 }
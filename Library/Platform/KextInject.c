@@ -555,7 +555,6 @@ InjectKexts (
         Entry->KernelAndKextPatches->NrKexts &&
         KernelAndKextPatcherInit (Entry)
       ) {
-        INT32       i, IsBundle;
         CHAR8       SavedValue, *InfoPlist = (CHAR8 *)(UINTN)Drvinfo->infoDictPhysAddr,
                     KextBundleIdentifier[AVALUE_MAX_SIZE];
 #ifdef LAZY_PARSE_KEXT_PLIST
@@ -594,26 +593,14 @@ InjectKexts (
 
         DBG ("\n");
 
-        for (i = 0; i < Entry->KernelAndKextPatches->NrKexts; i++) {
-          if (
-            !Entry->KernelAndKextPatches->KextPatches[i].Disabled &&
-            !Entry->KernelAndKextPatches->KextPatches[i].Patched &&
-            IsPatchNameMatch (KextBundleIdentifier, Entry->KernelAndKextPatches->KextPatches[i].Name, InfoPlist, &IsBundle)
-          ) {
-            AnyKextPatch (
-              KextBundleIdentifier,
-              (UINT8 *)(UINTN)Drvinfo->executablePhysAddr,
-              Drvinfo->executableLength,
-              InfoPlist,
-              Drvinfo->infoDictLength,
-              &Entry->KernelAndKextPatches->KextPatches[i]
-            );
-
-            if (IsBundle) {
-              Entry->KernelAndKextPatches->KextPatches[i].Patched = TRUE;
-            }
-          }
-        }
+        ApplyKextPatches (
+          KextBundleIdentifier,
+          (UINT8 *)(UINTN)Drvinfo->executablePhysAddr,
+          Drvinfo->executableLength,
+          InfoPlist,
+          Drvinfo->infoDictLength,
+          Entry->KernelAndKextPatches
+        );
 
         CheckForFakeSMC (InfoPlist, Entry);
 
@@ -104,52 +104,115 @@ FilterKextPatches (
 }
 
 //
-// Searches Source for Search pattern of size SearchSize
-// and replaces it with Replace up to MaxReplaces times.
-// If MaxReplaces <= 0, then there is no restriction on number of replaces.
-// Replace should have the same size as Search.
-// Returns number of replaces done.
+// Precompiled search pattern: wildcard mask is implied by Wildcard,
+// Skip is a Boyer-Moore-Horspool table built over the longest run of
+// non-wildcard bytes (Search[RunOff .. RunOff + RunLen - 1]).
 //
-BOOLEAN
-FindWildcardPattern (
-  UINT8     *Source,
-  UINT8     *Search,
-  UINTN     SearchSize,
-  UINT8     *Replace,
-  UINT8     **NewReplace,
-  UINT8     Wildcard
+typedef struct {
+  UINT8     *Search;
+  UINTN     SearchSize;
+  UINT8     Wildcard;
+  UINTN     RunOff;
+  UINTN     RunLen;
+  UINT32    Skip[256];
+} SEARCH_PATTERN;
+
+STATIC
+VOID
+CompileSearchPattern (
+  OUT SEARCH_PATTERN  *Pattern,
+  IN  UINT8           *Search,
+  IN  UINTN           SearchSize,
+  IN  UINT8           Wildcard
 ) {
-  UINTN     i, SearchCount = 0, ReplaceCount = 0;
-  UINT8     *TmpReplace = AllocateZeroPool (SearchSize);
-  BOOLEAN   Ret;
+  UINTN   i, RunOff = 0, RunLen = 0;
+
+  Pattern->Search = Search;
+  Pattern->SearchSize = SearchSize;
+  Pattern->Wildcard = Wildcard;
+  Pattern->RunOff = 0;
+  Pattern->RunLen = 0;
+
+  for (i = 0; i <= SearchSize; i++) {
+    if ((i < SearchSize) && ((Wildcard == 0xFF) || (Search[i] != Wildcard))) {
+      if (!RunLen) {
+        RunOff = i;
+      }
 
-  for (i = 0; i < SearchSize; i++) {
-    if ((Search[i] != Wildcard) && (Search[i] != Source[i])) {
-      SearchCount = 0;
-      break;
+      RunLen++;
+      continue;
     }
 
-    if (Replace[i] == Wildcard) {
-      TmpReplace[i] = Source[i];
-      ReplaceCount++;
-    } else {
-      TmpReplace[i] = Replace[i];
+    if (RunLen > Pattern->RunLen) {
+      Pattern->RunOff = RunOff;
+      Pattern->RunLen = RunLen;
     }
 
-    SearchCount++;
+    RunLen = 0;
   }
 
-  Ret = (SearchSize == SearchCount);
+  for (i = 0; i < ARRAY_SIZE (Pattern->Skip); i++) {
+    Pattern->Skip[i] = (UINT32)Pattern->RunLen;
+  }
 
-  if (!Ret || !ReplaceCount) {
-    FreePool (TmpReplace);
-  } else {
-    *NewReplace = TmpReplace;
+  for (i = 0; (i + 1) < Pattern->RunLen; i++) {
+    Pattern->Skip[Search[Pattern->RunOff + i]] = (UINT32)(Pattern->RunLen - 1 - i);
   }
+}
 
-  return Ret;
+//
+// Returns leftmost match in [Start, End), or NULL.
+//
+STATIC
+UINT8 *
+FindSearchPattern (
+  IN SEARCH_PATTERN   *Pattern,
+  IN UINT8            *Start,
+  IN UINT8            *End
+) {
+  UINT8   *Run, *Pos, *Last, Tail;
+  UINTN   RunLast;
+
+  if ((Start >= End) || ((UINTN)(End - Start) < Pattern->SearchSize)) {
+    return NULL;
+  }
+
+  if (!Pattern->RunLen) {
+    // Wildcards only, matches anywhere.
+    return Start;
+  }
+
+  Run = Pattern->Search + Pattern->RunOff;
+  RunLast = Pattern->RunLen - 1;
+  Pos = Start + Pattern->RunOff;
+  Last = End - Pattern->SearchSize + Pattern->RunOff;
+
+  while (Pos <= Last) {
+    Tail = Pos[RunLast];
+
+    if (
+      (Tail == Run[RunLast]) &&
+      (CompareMem (Pos, Run, RunLast) == 0) &&
+      PatternMatcherCompare (Pos - Pattern->RunOff, Pattern->Search, Pattern->SearchSize, Pattern->Wildcard)
+    ) {
+      return Pos - Pattern->RunOff;
+    }
+
+    Pos += Pattern->Skip[Tail];
+  }
+
+  return NULL;
 }
 
+//
+// Searches Source for Search pattern of size SearchSize
+// and replaces it with Replace up to MaxReplaces times.
+// If MaxReplaces <= 0, then there is no restriction on number of replaces.
+// Replace should have the same size as Search.
+// Bytes equal to Wildcard (if not 0xFF) match anything in Search,
+// and keep original byte in Replace.
+// Returns number of replaces done.
+//
 UINTN
 SearchAndReplace (
   UINT8     *Source,
@@ -160,34 +223,28 @@ SearchAndReplace (
   UINT8     Wildcard,
   INTN      MaxReplaces
 ) {
-  BOOLEAN   NoReplacesRestriction = (MaxReplaces <= 0);
-  UINTN     NumReplaces = 0;
-  UINT8     *End = Source + SourceSize;
+  BOOLEAN         NoReplacesRestriction = (MaxReplaces <= 0);
+  UINTN           NumReplaces = 0;
+  UINT8           *End = Source + SourceSize;
+  SEARCH_PATTERN  Pattern;
 
   if (!Source || !Search || !Replace || !SearchSize) {
     return 0;
   }
 
-  while ((Source < End) && (NoReplacesRestriction || (MaxReplaces > 0))) {
-    UINT8   *NewReplace = NULL;
-
-    if (
-      ((Wildcard != 0xFF) && FindWildcardPattern (Source, Search, SearchSize, Replace, &NewReplace, Wildcard)) ||
-      (CompareMem (Source, Search, SearchSize) == 0)
-    ) {
-      if (NewReplace != NULL) {
-        CopyMem (Source, NewReplace, SearchSize);
-        FreePool (NewReplace);
-      } else {
-        CopyMem (Source, Replace, SearchSize);
-      }
+  CompileSearchPattern (&Pattern, Search, SearchSize, Wildcard);
 
-      NumReplaces++;
-      MaxReplaces--;
-      Source += SearchSize;
-    } else {
-      Source++;
+  while (NoReplacesRestriction || (MaxReplaces > 0)) {
+    Source = FindSearchPattern (&Pattern, Source, End);
+    if (Source == NULL) {
+      break;
     }
+
+    PatternMatcherReplace (Source, Replace, SearchSize, Wildcard);
+
+    NumReplaces++;
+    MaxReplaces--;
+    Source += SearchSize;
   }
 
   return NumReplaces;
@@ -291,6 +348,299 @@ IsPatchNameMatch (
       : (AsciiStrCmp (BundleIdentifier, Name) == 0);
 }
 
+//
+// CFBundleIdentifier -> KextsToPatch dispatch, built once when the patch list is loaded.
+// Full bundle names (2+ dots) are hashed, partial names (matched against Info.plist)
+// are searched together in a single pass over each Info.plist.
+//
+
+#define KEXT_PATCH_INDEX_NONE     MAX_UINT32
+#define KEXT_PATCH_INDEX_BUNDLE   BIT31
+
+typedef struct KEXT_PATCH_INDEX {
+  UINT32            *Buckets;     // first patch per hash bucket, KEXT_PATCH_INDEX_NONE == empty
+  UINT32            *Next;        // next patch in the same bucket, in patch order
+  UINT32            *Hashes;
+  UINTN             BucketMask;
+  UINT32            *Partial;     // partial name patches, in patch order
+  BOOLEAN           *PartialHit;
+  UINTN             NrPartial;
+  PATTERN_MATCHER   *Matcher;     // NULL == fallback to AsciiStrStr
+  UINT32            *Candidates;  // scratch, NrKexts
+} KEXT_PATCH_INDEX;
+
+STATIC
+UINT32
+KextPatchNameHash (
+  IN CHAR8  *Name
+) {
+  UINT32  Hash = 2166136261U;
+
+  while (*Name) {
+    Hash = (Hash ^ (UINT8)*Name++) * 16777619U;
+  }
+
+  return Hash;
+}
+
+STATIC
+BOOLEAN
+KextPatchPartialHit (
+  IN VOID   *Context,
+  IN UINTN  Index,
+  IN VOID   *EntryContext,
+  IN UINT8  *Buffer,
+  IN UINTN  Offset
+) {
+  *(BOOLEAN *)EntryContext = TRUE;
+
+  // first occurrence is enough
+  return FALSE;
+}
+
+VOID
+FreeKextPatchIndex (
+  IN OUT KERNEL_AND_KEXT_PATCHES  *Patches
+) {
+  KEXT_PATCH_INDEX  *Index;
+
+  if ((Patches == NULL) || (Patches->KextPatchIndex == NULL)) {
+    return;
+  }
+
+  Index = Patches->KextPatchIndex;
+
+  PatternMatcherFree (Index->Matcher);
+
+  if (Index->Buckets != NULL) {
+    FreePool (Index->Buckets);
+  }
+
+  if (Index->Next != NULL) {
+    FreePool (Index->Next);
+  }
+
+  if (Index->Hashes != NULL) {
+    FreePool (Index->Hashes);
+  }
+
+  if (Index->Partial != NULL) {
+    FreePool (Index->Partial);
+  }
+
+  if (Index->PartialHit != NULL) {
+    FreePool (Index->PartialHit);
+  }
+
+  if (Index->Candidates != NULL) {
+    FreePool (Index->Candidates);
+  }
+
+  FreePool (Index);
+
+  Patches->KextPatchIndex = NULL;
+}
+
+VOID
+BuildKextPatchIndex (
+  IN OUT KERNEL_AND_KEXT_PATCHES  *Patches
+) {
+  KEXT_PATCH_INDEX  *Index;
+  UINTN             i, Size = 16;
+  UINT32            *Link;
+
+  if (Patches == NULL) {
+    return;
+  }
+
+  FreeKextPatchIndex (Patches);
+
+  if (!Patches->NrKexts || (Patches->KextPatches == NULL)) {
+    return;
+  }
+
+  Index = AllocateZeroPool (sizeof (KEXT_PATCH_INDEX));
+  if (Index == NULL) {
+    return;
+  }
+
+  Patches->KextPatchIndex = Index;
+
+  while (Size < (Patches->NrKexts * 2)) {
+    Size <<= 1;
+  }
+
+  Index->Buckets    = AllocatePool (Size * sizeof (UINT32));
+  Index->Next       = AllocatePool (Patches->NrKexts * sizeof (UINT32));
+  Index->Hashes     = AllocateZeroPool (Patches->NrKexts * sizeof (UINT32));
+  Index->Partial    = AllocatePool (Patches->NrKexts * sizeof (UINT32));
+  Index->PartialHit = AllocateZeroPool (Patches->NrKexts * sizeof (BOOLEAN));
+  Index->Candidates = AllocatePool (Patches->NrKexts * sizeof (UINT32));
+
+  if (
+    (Index->Buckets == NULL) || (Index->Next == NULL) || (Index->Hashes == NULL) ||
+    (Index->Partial == NULL) || (Index->PartialHit == NULL) || (Index->Candidates == NULL)
+  ) {
+    FreeKextPatchIndex (Patches);
+    return;
+  }
+
+  SetMem32 (Index->Buckets, Size * sizeof (UINT32), KEXT_PATCH_INDEX_NONE);
+  Index->BucketMask = Size - 1;
+
+  for (i = 0; i < Patches->NrKexts; i++) {
+    CHAR8   *Name = Patches->KextPatches[i].Name;
+
+    Index->Next[i] = KEXT_PATCH_INDEX_NONE;
+
+    if (CountOccurrences (Name, '.') < 2) {
+      Index->Partial[Index->NrPartial++] = (UINT32)i;
+      continue;
+    }
+
+    Index->Hashes[i] = KextPatchNameHash (Name);
+
+    // Append, patches for the same kext are applied in config order.
+    Link = &Index->Buckets[Index->Hashes[i] & Index->BucketMask];
+    while (*Link != KEXT_PATCH_INDEX_NONE) {
+      Link = &Index->Next[*Link];
+    }
+
+    *Link = (UINT32)i;
+  }
+
+  if (Index->NrPartial) {
+    Index->Matcher = PatternMatcherCreate (Index->NrPartial);
+
+    for (i = 0; (Index->Matcher != NULL) && (i < Index->NrPartial); i++) {
+      CHAR8   *Name = Patches->KextPatches[Index->Partial[i]].Name;
+
+      if (PatternMatcherAdd (Index->Matcher, (UINT8 *)Name, AsciiStrLen (Name), PATTERN_MATCHER_NO_WILDCARD, &Index->PartialHit[i]) < 0) {
+        PatternMatcherFree (Index->Matcher);
+        Index->Matcher = NULL;
+      }
+    }
+  }
+
+  DBG ("%a: %d patches, %d by bundle, %d partial\n", __FUNCTION__, Patches->NrKexts, Patches->NrKexts - Index->NrPartial, Index->NrPartial);
+}
+
+//
+// Collects patches matching this kext into Index->Candidates, same set and order
+// as IsPatchNameMatch () over the whole list. Bundle matches are flagged with KEXT_PATCH_INDEX_BUNDLE.
+//
+STATIC
+UINTN
+GetKextPatchCandidates (
+  IN KEXT_PATCH_INDEX   *Index,
+  IN KEXT_PATCH         *KextPatches,
+  IN CHAR8              *BundleIdentifier,
+  IN CHAR8              *InfoPlist,
+  IN UINT32             InfoPlistSize
+) {
+  UINTN   i, Count = 0;
+  UINT32  Hash, Bundle;
+
+  if (InfoPlist == NULL) {
+    for (i = 0; i < Index->NrPartial; i++) {
+      Index->PartialHit[i] = (AsciiStrCmp (BundleIdentifier, KextPatches[Index->Partial[i]].Name) == 0);
+    }
+  } else if (Index->Matcher != NULL) {
+    ZeroMem (Index->PartialHit, Index->NrPartial * sizeof (BOOLEAN));
+    PatternMatcherReset (Index->Matcher);
+    PatternMatcherScan (Index->Matcher, (UINT8 *)InfoPlist, InfoPlistSize, KextPatchPartialHit, NULL);
+  } else {
+    for (i = 0; i < Index->NrPartial; i++) {
+      Index->PartialHit[i] = (AsciiStrStr (InfoPlist, KextPatches[Index->Partial[i]].Name) != NULL);
+    }
+  }
+
+  Hash = KextPatchNameHash (BundleIdentifier);
+  Bundle = Index->Buckets[Hash & Index->BucketMask];
+  i = 0;
+
+  // Merge both (ascending) lists to keep config order.
+  while ((Bundle != KEXT_PATCH_INDEX_NONE) || (i < Index->NrPartial)) {
+    if (
+      (Bundle != KEXT_PATCH_INDEX_NONE) &&
+      ((Index->Hashes[Bundle] != Hash) || (AsciiStrCmp (BundleIdentifier, KextPatches[Bundle].Name) != 0))
+    ) {
+      Bundle = Index->Next[Bundle];
+      continue;
+    }
+
+    if ((i < Index->NrPartial) && !Index->PartialHit[i]) {
+      i++;
+      continue;
+    }
+
+    if ((Bundle != KEXT_PATCH_INDEX_NONE) && ((i >= Index->NrPartial) || (Bundle < Index->Partial[i]))) {
+      Index->Candidates[Count++] = Bundle | KEXT_PATCH_INDEX_BUNDLE;
+      Bundle = Index->Next[Bundle];
+    } else {
+      Index->Candidates[Count++] = Index->Partial[i++];
+    }
+  }
+
+  return Count;
+}
+
+//
+// Applies all KextsToPatch entries matching this kext, in config order.
+//
+VOID
+ApplyKextPatches (
+  CHAR8                     *BundleIdentifier,
+  UINT8                     *Driver,
+  UINT32                    DriverSize,
+  CHAR8                     *InfoPlist,
+  UINT32                    InfoPlistSize,
+  KERNEL_AND_KEXT_PATCHES   *Patches
+) {
+  KEXT_PATCH_INDEX  *Index = Patches->KextPatchIndex;
+  KEXT_PATCH        *KextPatch;
+  UINTN             i, Count;
+  INT32             IsBundle = 0;
+
+  if (Index == NULL) {
+    for (i = 0; i < Patches->NrKexts; i++) {
+      KextPatch = &Patches->KextPatches[i];
+
+      if (
+        KextPatch->Patched ||
+        KextPatch->Disabled || // avoid redundant: if unique / IsBundle
+        !IsPatchNameMatch (BundleIdentifier, KextPatch->Name, InfoPlist, &IsBundle)
+      ) {
+        continue;
+      }
+
+      AnyKextPatch (BundleIdentifier, Driver, DriverSize, InfoPlist, InfoPlistSize, KextPatch);
+
+      if (IsBundle) {
+        KextPatch->Patched = TRUE;
+      }
+    }
+
+    return;
+  }
+
+  Count = GetKextPatchCandidates (Index, Patches->KextPatches, BundleIdentifier, InfoPlist, InfoPlistSize);
+
+  for (i = 0; i < Count; i++) {
+    KextPatch = &Patches->KextPatches[Index->Candidates[i] & ~KEXT_PATCH_INDEX_BUNDLE];
+
+    if (KextPatch->Patched || KextPatch->Disabled) {
+      continue;
+    }
+
+    AnyKextPatch (BundleIdentifier, Driver, DriverSize, InfoPlist, InfoPlistSize, KextPatch);
+
+    if (Index->Candidates[i] & KEXT_PATCH_INDEX_BUNDLE) {
+      KextPatch->Patched = TRUE;
+    }
+  }
+}
+
 ////////////////////////////////////
 //
 // ATIConnectors patch
@@ -534,6 +884,8 @@ AnyKextPatch (
             KextPatch->Wildcard,
             KextPatch->Count
           );
+  } else if ((Driver == NULL) || (DriverSize == 0)) { // codeless kext
+    MsgLog (" | BinPatch: no executable");
   } else { // kext binary patch
     UINT32  Addr = 0, Size = 0, Off = 0;;
 
@@ -604,13 +956,14 @@ PatchKext (
   CHAR8         *BundleIdentifier,
   LOADER_ENTRY  *Entry
 ) {
-  INT32  i, IsBundle = 0;
+  INT32  IsBundle = 0;
 
   //
   // ATIConnectors
   //
 
   if (
+    (Driver != NULL) &&
     (Entry->KernelAndKextPatches->KPATIConnectorsController != NULL) &&
     (
       IsPatchNameMatch (BundleIdentifier, ATIKextBundleId[0], NULL, &IsBundle) ||
@@ -637,6 +990,7 @@ PatchKext (
   //
 
   } else if (
+    (Driver != NULL) &&
     Entry->KernelAndKextPatches->KPKernelPm &&
     IsPatchNameMatch (BundleIdentifier, kPropCFBundleIdentifierAICPUPM, NULL, &IsBundle)
   ) {
@@ -648,28 +1002,14 @@ PatchKext (
   //
 
   } else {
-    for (i = 0; i < Entry->KernelAndKextPatches->NrKexts; i++) {
-      if (
-        Entry->KernelAndKextPatches->KextPatches[i].Patched ||
-        Entry->KernelAndKextPatches->KextPatches[i].Disabled || // avoid redundant: if unique / IsBundle
-        !IsPatchNameMatch (BundleIdentifier, Entry->KernelAndKextPatches->KextPatches[i].Name, InfoPlist, &IsBundle)
-      ) {
-        continue;
-      }
-
-      AnyKextPatch (
-        BundleIdentifier,
-        Driver,
-        DriverSize,
-        InfoPlist,
-        InfoPlistSize,
-        &Entry->KernelAndKextPatches->KextPatches[i]
-      );
-
-      if (IsBundle) {
-        Entry->KernelAndKextPatches->KextPatches[i].Patched = TRUE;
-      }
-    }
+    ApplyKextPatches (
+      BundleIdentifier,
+      Driver,
+      DriverSize,
+      InfoPlist,
+      InfoPlistSize,
+      Entry->KernelAndKextPatches
+    );
   }
 }
 
@@ -699,14 +1039,184 @@ CheckForFakeSMC (
   }
 }
 
-/** Extracts kext BundleIdentifier from given Plist into KextBundleIdentifier */
+//
+// ID="..." -> value index over the whole __PRELINK_INFO plist,
+// used to resolve IDREF values without rescanning the plist.
+//
+
+#define PLIST_ID_INDEX_MIN_SIZE   1024
+
+typedef struct {
+  UINT32    Id;
+  UINT32    Offset; // value offset (past '>') in WholePlist, 0 == empty slot
+} PLIST_ID_SLOT;
+
+typedef struct {
+  CHAR8           *WholePlist;
+  PLIST_ID_SLOT   *Slots;
+  UINTN           Size;
+  UINTN           Count;
+} PLIST_ID_INDEX;
+
+STATIC
+UINTN
+PlistIdSlot (
+  IN PLIST_ID_INDEX   *Index,
+  IN UINT32           Id
+) {
+  UINTN   Slot = (UINTN)((Id * 2654435761U) & (Index->Size - 1));
+
+  while (Index->Slots[Slot].Offset && (Index->Slots[Slot].Id != Id)) {
+    Slot = (Slot + 1) & (Index->Size - 1);
+  }
+
+  return Slot;
+}
+
+#ifndef LAZY_PARSE_KEXT_PLIST
+STATIC
+BOOLEAN
+PlistIdIndexGrow (
+  IN OUT PLIST_ID_INDEX   *Index
+) {
+  PLIST_ID_SLOT   *OldSlots = Index->Slots;
+  UINTN           OldSize = Index->Size, i;
+
+  Index->Size = OldSize ? (OldSize << 1) : PLIST_ID_INDEX_MIN_SIZE;
+  Index->Slots = AllocateZeroPool (Index->Size * sizeof (PLIST_ID_SLOT));
+
+  if (Index->Slots == NULL) {
+    Index->Slots = OldSlots;
+    Index->Size = OldSize;
+    return FALSE;
+  }
+
+  for (i = 0; i < OldSize; i++) {
+    if (OldSlots[i].Offset) {
+      Index->Slots[PlistIdSlot (Index, OldSlots[i].Id)] = OldSlots[i];
+    }
+  }
+
+  if (OldSlots != NULL) {
+    FreePool (OldSlots);
+  }
+
+  return TRUE;
+}
+
+//
+// One pass over WholePlist, recording every <tag ID="n" ...>value.
+//
+STATIC
+PLIST_ID_INDEX *
+CreatePlistIdIndex (
+  IN CHAR8  *WholePlist
+) {
+  PLIST_ID_INDEX  *Index = AllocateZeroPool (sizeof (PLIST_ID_INDEX));
+  CHAR8           *Ptr = WholePlist, *TagEnd;
+  UINTN           Slot;
+  UINT32          Id;
+
+  if ((Index == NULL) || !PlistIdIndexGrow (Index)) {
+    goto Error;
+  }
+
+  Index->WholePlist = WholePlist;
+
+  while ((Ptr = AsciiStrStr (Ptr, " ID=\"")) != NULL) {
+    Ptr += 5; // skip ' ID="'
+    Id = (UINT32)AsciiStrDecimalToUintn (Ptr);
+
+    TagEnd = Ptr;
+    while ((*TagEnd != '>') && (*TagEnd != '\0')) {
+      TagEnd++;
+    }
+
+    if (*TagEnd == '\0') {
+      break;
+    }
+
+    if (TagEnd[-1] == '/') {
+      continue;
+    }
+
+    if (((Index->Count + 1) * 2) > Index->Size) {
+      if (!PlistIdIndexGrow (Index)) {
+        goto Error;
+      }
+    }
+
+    Slot = PlistIdSlot (Index, Id);
+    if (!Index->Slots[Slot].Offset) {
+      Index->Count++;
+    }
+
+    Index->Slots[Slot].Id = Id;
+    Index->Slots[Slot].Offset = (UINT32)(TagEnd + 1 - WholePlist);
+
+    Ptr = TagEnd + 1;
+  }
+
+  DBG ("%a: %d IDs indexed\n", __FUNCTION__, Index->Count);
+
+  return Index;
+
+  Error:
 
+  if (Index != NULL) {
+    if (Index->Slots != NULL) {
+      FreePool (Index->Slots);
+    }
+
+    FreePool (Index);
+  }
+
+  return NULL;
+}
+
+STATIC
 VOID
-ExtractKextPropString (
-  OUT CHAR8   *Res,
-  IN  INTN    Len,
-  IN  CHAR8   *Key,
-  IN  CHAR8   *Plist
+FreePlistIdIndex (
+  IN PLIST_ID_INDEX   *Index
+) {
+  if (Index != NULL) {
+    if (Index->Slots != NULL) {
+      FreePool (Index->Slots);
+    }
+
+    FreePool (Index);
+  }
+}
+#endif
+
+//
+// Resolves IDREF="Id" to its value.
+//
+STATIC
+CHAR8 *
+LookupPlistIdRef (
+  IN PLIST_ID_INDEX   *Index,
+  IN UINT32           Id
+) {
+  UINTN   Slot;
+
+  if (Index == NULL) {
+    return NULL;
+  }
+
+  Slot = PlistIdSlot (Index, Id);
+
+  return Index->Slots[Slot].Offset ? (Index->WholePlist + Index->Slots[Slot].Offset) : NULL;
+}
+
+STATIC
+VOID
+ExtractKextPropStringEx (
+  OUT CHAR8             *Res,
+  IN  INTN              Len,
+  IN  CHAR8             *Key,
+  IN  CHAR8             *Plist,
+  IN  PLIST_ID_INDEX    *Index
 ) {
   CHAR8     *Tag, *BIStart, *BIEnd;
   UINTN     DictLevel = 0, KeyLen = AsciiStrLen (Key);
@@ -732,11 +1242,19 @@ ExtractKextPropString (
       DictLevel--;
       Tag += 7;
     } else if ((DictLevel == 1) && (AsciiStrnCmp (Tag, Key, KeyLen) == 0)) {
-      // StringValue is next <string>...</string>
-      BIStart = AsciiStrStr (Tag + KeyLen, "<string>");
-      if (BIStart != NULL) {
-        BIStart += 8; // skip "<string>"
-        BIEnd = AsciiStrStr (BIStart, "</string>");
+      // StringValue is next <string ...>...</string> or <string IDREF="n"/>
+      BIStart = AsciiStrStr (Tag + KeyLen, "<string");
+      BIEnd = (BIStart != NULL) ? AsciiStrStr (BIStart, ">") : NULL;
+      if (BIEnd != NULL) {
+        if (BIEnd[-1] != '/') {
+          BIStart = BIEnd + 1;
+        } else if ((AsciiStrnCmp (BIStart, "<string IDREF=\"", 15) == 0) && (Index != NULL)) {
+          BIStart = LookupPlistIdRef (Index, (UINT32)AsciiStrDecimalToUintn (BIStart + 15));
+        } else {
+          BIStart = NULL;
+        }
+
+        BIEnd = (BIStart != NULL) ? AsciiStrStr (BIStart, "</string>") : NULL;
         if ((BIEnd != NULL) && ((BIEnd - BIStart + 1) < Len)) {
           CopyMem (Res, BIStart, BIEnd - BIStart);
           Res[BIEnd - BIStart] = '\0';
@@ -756,6 +1274,18 @@ ExtractKextPropString (
   }
 }
 
+/** Extracts kext BundleIdentifier from given Plist into KextBundleIdentifier */
+
+VOID
+ExtractKextPropString (
+  OUT CHAR8   *Res,
+  IN  INTN    Len,
+  IN  CHAR8   *Key,
+  IN  CHAR8   *Plist
+) {
+  ExtractKextPropStringEx (Res, Len, Key, Plist, NULL);
+}
+
 //
 // Prevent prelinked kext being loaded by kernel:
 //
@@ -836,14 +1366,14 @@ EFI_STATUS
 ParsePrelinkKexts (
   CHAR8   *WholePlist
 ) {
-  TagPtr        KextsDict, DictPointer;
-  EFI_STATUS    Status = ParseXML (WholePlist, 0, &KextsDict);
+  TagPtr          KextsDict, DictPointer;
+  PLIST_DOCUMENT  *KextsDoc;
+  EFI_STATUS      Status = ParseXMLDocument (WholePlist, 0, &KextsDoc);
 
   //DBG ("Using LAZY_PARSE_KEXT_PLIST\n")
 
-  if (EFI_ERROR (Status)) {
-    KextsDict = NULL;
-  } else {
+  if (!EFI_ERROR (Status)) {
+    KextsDict = KextsDoc->Root;
     DictPointer = GetProperty (KextsDict, kPrelinkInfoDictionaryKey);
     if ((DictPointer != NULL) && (DictPointer->type == kTagTypeArray)) {
       INTN    Count = DictPointer->size, i = 0,
@@ -952,6 +1482,8 @@ ParsePrelinkKexts (
     } else {
       DBG ("NO kPrelinkInfoDictionaryKey\n");
     }
+
+    FreeXMLDocument (KextsDoc);
   }
 
   return IsListEmpty (&gPrelinkKextList) ? EFI_UNSUPPORTED : EFI_SUCCESS;
@@ -1004,107 +1536,158 @@ PatchPrelinkedKexts (
 #else
 
 //
-// Returns parsed hex integer key.
-// Plist - kext pist
-// Key - key to find
-// WholePlist - _PrelinkInfoDictionary, used to find referenced values
+// Kext being collected by PrelinkedKextEvent ().
+//
+typedef struct {
+  LOADER_ENTRY      *Entry;
+  PLIST_ID_INDEX    *Index;
+  CHAR8             BundleIdentifier[AVALUE_MAX_SIZE];
+  UINT32            Addr;
+  UINT32            Size;
+} PRELINKED_KEXT;
+
 //
-// Searches for Key in Plist and it's value:
+// Value text of a plist event, IDREF="n" values are looked up in Index:
 // a) <integer ID="26" size="64">0x2b000</integer>
-//    returns 0x2b000
 // b) <integer IDREF="26"/>
-//    searches for <integer ID="26"... from WholePlist
-//    and returns value from that referenced field
 //
-// Whole function is here since we should avoid ParseXML () and it's
-// memory allocations during ExitBootServices (). And it seems that
-// ParseXML () does not support IDREF.
-// This func is hard to read and debug and probably not reliable,
-// but it seems it works.
+STATIC
+CONST CHAR8 *
+PrelinkedKextValue (
+  IN  PRELINKED_KEXT  *Kext,
+  IN  PLIST_EVENT     *Event
+) {
+  if (Event->IdRef != -1) {
+    return LookupPlistIdRef (Kext->Index, (UINT32)Event->IdRef);
+  }
+
+  return Event->Value;
+}
+
+//
+// PrelinkInfo plist walker: only the top-level keys of every
+// _PrelinkInfoDictionary entry are looked at, everything else is skipped.
 //
 STATIC
-UINT64
-GetPlistHexValue (
-  CHAR8     *Plist,
-  CHAR8     *Key,
-  CHAR8     *WholePlist
+PLIST_STREAM_ACTION
+EFIAPI
+PrelinkedKextEvent (
+  IN PLIST_EVENT  *Event,
+  IN VOID         *Context
 ) {
-  UINT64    NumValue = 0;
-  CHAR8     *Value, *IntTag, *IDStart, *IDEnd, Buffer[48];
-  UINTN     IDLen, BufferLen = ARRAY_SIZE (Buffer);
+  PRELINKED_KEXT  *Kext = Context;
+  CONST CHAR8     *Value;
+  CHAR8           *InfoPlistStart, *InfoPlistEnd, SavedValue;
+  UINT8           *Driver;
+  UINTN           Len;
+
+  switch (Event->Event) {
+    case kPlistEventListStart:
+      if (Event->Depth == 1) {
+        // root dict items
+        return PlistEventKeyIs (Event, kPrelinkInfoDictionaryKey) ? kPlistStreamContinue : kPlistStreamSkip;
+      }
 
-  // search for Key
-  Value = AsciiStrStr (Plist, Key);
-  if (Value == NULL) {
-    return 0;
-  }
+      if (Event->Depth == 2) {
+        // kext start
+        if (Event->Type != kTagTypeDict) {
+          return kPlistStreamSkip;
+        }
 
-  // search for <integer
-  IntTag = AsciiStrStr (Value, "<integer");
-  if (IntTag == NULL) {
-    return 0;
-  }
+        Kext->BundleIdentifier[0] = '\0';
+        Kext->Addr = Kext->Size = 0;
 
-  // find <integer end
-  Value = AsciiStrStr (IntTag, ">");
-  if (Value == NULL) {
-    return 0;
-  }
+        return kPlistStreamContinue;
+      }
 
-  if (Value[-1] != '/') {
-    // normal case: value is here
-    NumValue = AsciiStrHexToUint64 (Value + 1);
-    return NumValue;
-  }
+      // IOKitPersonalities, OSBundleLibraries, ...
+      return (Event->Depth > 2) ? kPlistStreamSkip : kPlistStreamContinue;
 
-  // it might be a reference: IDREF="173"/>
-  Value = AsciiStrStr (IntTag, "<integer IDREF=\"");
-  if (Value != IntTag) {
-    return 0;
-  }
+    case kPlistEventValue:
+      if ((Event->Depth != 3) || ((Value = PrelinkedKextValue (Kext, Event)) == NULL)) {
+        break;
+      }
 
-  // compose <integer ID="xxx" in the Buffer
-  IDStart = AsciiStrStr (IntTag, "\"") + 1;
-  IDEnd = AsciiStrStr (IDStart, "\"");
-  IDLen = IDEnd - IDStart;
+      if ((Event->Type == kTagTypeString) && PlistEventKeyIs (Event, kPropCFBundleIdentifier)) {
+        Len = 0;
+        while ((Value[Len] != '<') && (Value[Len] != '\0')) {
+          Len++;
+        }
 
-  if (IDLen > 8) {
-    return 0;
-  }
+        if (Len < ARRAY_SIZE (Kext->BundleIdentifier)) {
+          CopyMem (Kext->BundleIdentifier, Value, Len);
+          Kext->BundleIdentifier[Len] = '\0';
+        }
+      } else if (Event->Type == kTagTypeInteger) {
+        // get kext address from _PrelinkExecutableSourceAddr
+        // truncate to 32 bit to get physical addr
+        if (PlistEventKeyIs (Event, kPrelinkExecutableSourceKey)) {
+          Kext->Addr = (UINT32)AsciiStrHexToUint64 (Value);
+        } else if (PlistEventKeyIs (Event, kPrelinkExecutableSizeKey)) {
+          Kext->Size = (UINT32)AsciiStrHexToUint64 (Value);
+        }
+      }
 
-  AsciiStrCpyS (Buffer, BufferLen, "<integer ID=\"");
-  AsciiStrnCatS (Buffer, BufferLen, IDStart, IDLen);
-  AsciiStrCatS (Buffer, BufferLen, "\"");
+      break;
 
-  // and search whole plist for ID
-  IntTag = AsciiStrStr (WholePlist, Buffer);
-  if (IntTag == NULL) {
-    return 0;
-  }
+    case kPlistEventListEnd:
+      if (Event->Depth != 2) {
+        break;
+      }
 
-  Value = AsciiStrStr (IntTag, ">");
-  if (Value == NULL) {
-    return 0;
-  }
+      // no bundle id (empty <dict/>) - nothing to match against
+      if (Kext->BundleIdentifier[0] == '\0') {
+        break;
+      }
 
-  if (Value[-1] == '/') {
-    return 0;
-  }
+      // kext end, terminate Info.plist with 0
+      InfoPlistStart = (CHAR8 *)Event->Start;
+      InfoPlistEnd = (CHAR8 *)Event->End;
+      SavedValue = *InfoPlistEnd;
+      *InfoPlistEnd = '\0';
 
-  // we should have value now
-  NumValue = AsciiStrHexToUint64 (Value + 1);
+      if (IsKextInBlockCachesList (Kext->BundleIdentifier)) {
+        DBG ("Blocking KextCaches: %a\n", Kext->BundleIdentifier);
+        BlockListedKextCaches (InfoPlistStart);
+      } else {
+        // codeless kexts have no executable, only their Info.plist gets patched
+        Driver = NULL;
+        if (Kext->Addr && Kext->Size) {
+          Driver = (UINT8 *)(UINTN)(
+                     Kext->Addr +
+                     // KextAddr is always relative to 0x200000
+                     // and if KernelSlide is != 0 then KextAddr must be adjusted
+                     KernelInfo->Slide +
+                     // and adjust for AptioFixDrv's KernelRelocBase
+                     (UINT32)KernelInfo->RelocBase
+                   );
+        }
 
-  return NumValue;
+        // patch it
+        PatchKext (
+          Driver,
+          (Driver != NULL) ? Kext->Size : 0,
+          InfoPlistStart,
+          (UINT32)(InfoPlistEnd - InfoPlistStart),
+          Kext->BundleIdentifier,
+          Kext->Entry
+        );
+      }
+
+      // return saved char
+      *InfoPlistEnd = SavedValue;
+      break;
+  }
+
+  return kPlistStreamContinue;
 }
 
 VOID
 PatchPrelinkedKexts (
   LOADER_ENTRY    *Entry
 ) {
-  CHAR8     *WholePlist, *DictPtr, *InfoPlistStart = NULL,
-            *InfoPlistEnd = NULL, SavedValue;
-  INTN      DictLevel = 0;
-  UINT32    KextAddr, KextSize;
+  CHAR8           *WholePlist;
+  PRELINKED_KEXT  Kext;
 
   WholePlist = (CHAR8 *)(UINTN)KernelInfo->PrelinkInfoAddr;
 
@@ -1121,69 +1704,15 @@ PatchPrelinkedKexts (
 
   CheckForFakeSMC (WholePlist, Entry);
 
-  DictPtr = WholePlist;
+  ZeroMem (&Kext, sizeof (Kext));
+  Kext.Entry = Entry;
 
-  while ((DictPtr = AsciiStrStr (DictPtr, "dict>")) != NULL) {
-    if (DictPtr[-1] == '<') {
-      // opening dict
-      DictLevel++;
-      if (DictLevel == 2) {
-        // kext start
-        InfoPlistStart = DictPtr - 1;
-      }
+  // Index all ID="..." values once, IDREF lookups below are then O(1).
+  Kext.Index = CreatePlistIdIndex (WholePlist);
 
-    } else if ((DictPtr[-2] == '<') && (DictPtr[-1] == '/')) {
-      // closing dict
-      if ((DictLevel == 2) && (InfoPlistStart != NULL)) {
-        CHAR8   KextBundleIdentifier[AVALUE_MAX_SIZE];
+  ParseXMLStream (WholePlist, 0, PrelinkedKextEvent, &Kext);
 
-        // kext end
-        InfoPlistEnd = DictPtr + 5 /* "dict>" */;
-
-        // terminate Info.plist with 0
-        SavedValue = *InfoPlistEnd;
-        *InfoPlistEnd = '\0';
-
-        ExtractKextPropString (KextBundleIdentifier, ARRAY_SIZE (KextBundleIdentifier), PropCFBundleIdentifierKey, InfoPlistStart);
-
-        if (IsKextInBlockCachesList (KextBundleIdentifier)) {
-          DBG ("Blocking KextCaches: %a\n", KextBundleIdentifier);
-          BlockListedKextCaches (InfoPlistStart);
-          goto Next;
-        }
-
-        // get kext address from _PrelinkExecutableSourceAddr
-        // truncate to 32 bit to get physical addr
-        KextAddr = (UINT32)GetPlistHexValue (InfoPlistStart, kPrelinkExecutableSourceKey, WholePlist);
-        // KextAddr is always relative to 0x200000
-        // and if KernelSlide is != 0 then KextAddr must be adjusted
-        KextAddr += KernelInfo->Slide;
-        // and adjust for AptioFixDrv's KernelRelocBase
-        KextAddr += (UINT32)KernelInfo->RelocBase;
-
-        KextSize = (UINT32)GetPlistHexValue (InfoPlistStart, kPrelinkExecutableSizeKey, WholePlist);
-
-        // patch it
-        PatchKext (
-          (UINT8 *)(UINTN)KextAddr,
-          KextSize,
-          InfoPlistStart,
-          (UINT32)(InfoPlistEnd - InfoPlistStart),
-          KextBundleIdentifier,
-          Entry
-        );
-
-        Next:
-
-        // return saved char
-        *InfoPlistEnd = SavedValue;
-      }
-
-      DictLevel--;
-    }
-
-    DictPtr += 5;
-  }
+  FreePlistIdIndex (Kext.Index);
 }
 
 #endif
@@ -0,0 +1,144 @@
+/*
+ * Boot stage tasks on application processors.
+ *
+ * MpTaskStart () hands a procedure to an idle AP through EFI_MP_SERVICES_PROTOCOL
+ * and returns at once, MpTaskWait () blocks the BSP until it is done. Without
+ * MP services (or with every AP busy) the procedure simply runs on the BSP inside
+ * MpTaskStart (), so callers never need a serial path of their own.
+ *
+ * AP procedures must not touch boot services, protocols, pool allocation or the
+ * log: only preallocated memory, port I/O and plain computation.
+ */
+
+#include <Library/Platform/Platform.h>
+
+#ifndef DEBUG_ALL
+#ifndef DEBUG_MP_TASK
+#define DEBUG_MP_TASK -1
+#endif
+#else
+#ifdef DEBUG_MP_TASK
+#undef DEBUG_MP_TASK
+#endif
+#define DEBUG_MP_TASK DEBUG_ALL
+#endif
+
+#define DBG(...) DebugLog (DEBUG_MP_TASK, __VA_ARGS__)
+
+STATIC EFI_MP_SERVICES_PROTOCOL   *mMpServices = NULL;
+STATIC BOOLEAN                    *mMpApBusy = NULL;    // indexed by processor number, TRUE for BSP / disabled
+STATIC UINTN                      mMpCpuCount = 0;
+
+VOID
+MpTaskInit () {
+  EFI_STATUS                  Status;
+  EFI_PROCESSOR_INFORMATION   Info;
+  UINTN                       Index, Enabled = 0;
+
+  if (mMpServices != NULL) {
+    return;
+  }
+
+  Status = gBS->LocateProtocol (&gEfiMpServiceProtocolGuid, NULL, (VOID **)&mMpServices);
+  if (EFI_ERROR (Status)) {
+    DBG ("MpTask: no MP services, tasks run on BSP\n");
+    mMpServices = NULL;
+    return;
+  }
+
+  Status = mMpServices->GetNumberOfProcessors (mMpServices, &mMpCpuCount, &Enabled);
+  if (EFI_ERROR (Status) || (Enabled < 2)) {
+    DBG ("MpTask: %d enabled processor(s), tasks run on BSP\n", Enabled);
+    mMpServices = NULL;
+    return;
+  }
+
+  mMpApBusy = AllocateZeroPool (mMpCpuCount * sizeof (BOOLEAN));
+  if (mMpApBusy == NULL) {
+    mMpServices = NULL;
+    return;
+  }
+
+  for (Index = 0; Index < mMpCpuCount; Index++) {
+    Status = mMpServices->GetProcessorInfo (mMpServices, Index, &Info);
+
+    if (
+      EFI_ERROR (Status) ||
+      BIT_ISSET (Info.StatusFlag, PROCESSOR_AS_BSP_BIT) ||
+      BIT_ISUNSET (Info.StatusFlag, PROCESSOR_ENABLED_BIT)
+    ) {
+      mMpApBusy[Index] = TRUE;
+    }
+  }
+
+  DBG ("MpTask: %d APs available\n", Enabled - 1);
+}
+
+//
+// Runs Procedure (Context) on an idle AP, or right here on the BSP when there is none.
+//
+EFI_STATUS
+MpTaskStart (
+  IN OUT MP_TASK            *Task,
+  IN     EFI_AP_PROCEDURE   Procedure,
+  IN     VOID               *Context
+) {
+  EFI_STATUS    Status;
+  UINTN         Index;
+
+  if ((Task == NULL) || (Procedure == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  ZeroMem (Task, sizeof (MP_TASK));
+  Task->Procedure = Procedure;
+  Task->Context = Context;
+
+  if (mMpServices != NULL) {
+    for (Index = 0; Index < mMpCpuCount; Index++) {
+      if (mMpApBusy[Index]) {
+        continue;
+      }
+
+      Status = gBS->CreateEvent (0, 0, NULL, NULL, &Task->Event);
+      if (EFI_ERROR (Status)) {
+        break;
+      }
+
+      Status = mMpServices->StartupThisAP (mMpServices, Procedure, Index, Task->Event, 0, Context, NULL);
+      if (!EFI_ERROR (Status)) {
+        mMpApBusy[Index] = TRUE;
+        Task->ProcessorNumber = Index;
+        DBG ("MpTask: started on AP %d\n", Index);
+        return EFI_SUCCESS;
+      }
+
+      gBS->CloseEvent (Task->Event);
+      Task->Event = NULL;
+
+      // AP is not usable, do not try it again
+      mMpApBusy[Index] = TRUE;
+    }
+  }
+
+  Procedure (Context);
+
+  return EFI_SUCCESS;
+}
+
+VOID
+MpTaskWait (
+  IN OUT MP_TASK  *Task
+) {
+  UINTN   Index;
+
+  if ((Task == NULL) || (Task->Event == NULL)) {
+    return;
+  }
+
+  gBS->WaitForEvent (1, &Task->Event, &Index);
+  gBS->CloseEvent (Task->Event);
+  Task->Event = NULL;
+
+  mMpApBusy[Task->ProcessorNumber] = FALSE;
+}
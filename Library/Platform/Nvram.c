@@ -58,7 +58,9 @@ CONST NVRAM_DATA   gNvramData[] = {
 
   { kNvCloverConfig,            L"Clover.Config",           &gEfiAppleBootGuid,  NVRAM_ATTR_RT_BS_NV, 1 },
   { kNvCloverTheme,             L"Clover.Theme",            &gEfiAppleBootGuid,  NVRAM_ATTR_RT_BS_NV, 1 },
-  { kNvCloverNoEarlyProgress,   L"Clover.NoEarlyProgress",  &gEfiAppleBootGuid,  NVRAM_ATTR_RT_BS_NV, 1 }
+  { kNvCloverNoEarlyProgress,   L"Clover.NoEarlyProgress",  &gEfiAppleBootGuid,  NVRAM_ATTR_RT_BS_NV, 1 },
+  { kNvCloverTscFrequency,      MEM_LOG_TSC_VARIABLE,       &gEfiAppleBootGuid,  NVRAM_ATTR_RT_BS_NV, 1 },
+  { kNvCloverBootEntry,         L"Clover.BootEntry",        &gEfiAppleBootGuid,  NVRAM_ATTR_RT_BS_NV, 1 }
 };
 
 #if 0
@@ -0,0 +1,352 @@
+/*
+ * Multi-pattern binary matcher.
+ *
+ * Every pattern registered into a PATTERN_MATCHER gets an "anchor": 4 fixed
+ * (non-wildcard) bytes picked from its longest fixed run, or a single fixed
+ * byte when the pattern has no such run. Anchors are indexed into a hashed
+ * word table / byte table, so the whole buffer is walked once, and a full
+ * (wildcard aware) compare is only done where some anchor hits.
+ */
+
+#include <Library/Platform/Platform.h>
+
+#ifndef DEBUG_ALL
+#ifndef DEBUG_PATTERN_MATCHER
+#define DEBUG_PATTERN_MATCHER 0
+#endif
+#else
+#ifdef DEBUG_PATTERN_MATCHER
+#undef DEBUG_PATTERN_MATCHER
+#endif
+#define DEBUG_PATTERN_MATCHER DEBUG_ALL
+#endif
+
+#define DBG(...) DebugLog (DEBUG_PATTERN_MATCHER, __VA_ARGS__)
+
+#define PATTERN_MATCHER_HASH(Word)  ((UINT32)((Word) * 2654435761U) >> (32 - PATTERN_MATCHER_HASH_BITS))
+
+STATIC
+BOOLEAN
+IsFixedByte (
+  IN PATTERN_MATCHER_ENTRY  *Entry,
+  IN UINTN                  Index
+) {
+  return (Entry->Wildcard == PATTERN_MATCHER_NO_WILDCARD) || (Entry->Find[Index] != Entry->Wildcard);
+}
+
+//
+// Pick the anchor: first non-uniform 4 bytes window of the longest fixed run,
+// falls back to the first fixed byte if there is no run long enough.
+//
+STATIC
+VOID
+PatternMatcherSetAnchor (
+  IN OUT PATTERN_MATCHER_ENTRY  *Entry
+) {
+  UINTN   i, RunStart = 0, RunLen = 0, BestStart = 0, BestLen = 0;
+
+  for (i = 0; i <= Entry->Len; i++) {
+    if ((i < Entry->Len) && IsFixedByte (Entry, i)) {
+      if (!RunLen) {
+        RunStart = i;
+      }
+
+      RunLen++;
+      continue;
+    }
+
+    if (RunLen > BestLen) {
+      BestStart = RunStart;
+      BestLen = RunLen;
+    }
+
+    RunLen = 0;
+  }
+
+  if (BestLen >= sizeof (UINT32)) {
+    Entry->AnchorOff = (UINT32)BestStart;
+
+    for (i = BestStart; (i + sizeof (UINT32)) <= (BestStart + BestLen); i++) {
+      UINT8   *Ptr = &Entry->Find[i];
+
+      if ((Ptr[0] != Ptr[1]) || (Ptr[1] != Ptr[2]) || (Ptr[2] != Ptr[3])) {
+        Entry->AnchorOff = (UINT32)i;
+        break;
+      }
+    }
+
+    Entry->AnchorLen = sizeof (UINT32);
+    Entry->Anchor = ReadUnaligned32 ((UINT32 *)&Entry->Find[Entry->AnchorOff]);
+  } else if (BestLen) {
+    Entry->AnchorOff = (UINT32)BestStart;
+    Entry->AnchorLen = 1;
+    Entry->Anchor = Entry->Find[BestStart];
+  } else {
+    Entry->AnchorOff = 0;
+    Entry->AnchorLen = 0;
+    Entry->Anchor = 0;
+  }
+}
+
+STATIC
+VOID
+PatternMatcherLink (
+  IN OUT UINT16           *Head,
+  IN     PATTERN_MATCHER  *Matcher,
+  IN     UINT16           Index
+) {
+  // Append to keep registration order for candidates sharing one anchor.
+  while (*Head) {
+    Head = &Matcher->Entries[*Head - 1].Next;
+  }
+
+  *Head = Index + 1;
+}
+
+PATTERN_MATCHER *
+PatternMatcherCreate (
+  IN UINTN  Capacity
+) {
+  PATTERN_MATCHER   *Matcher;
+
+  if (!Capacity || (Capacity > PATTERN_MATCHER_MAX_ENTRIES)) {
+    return NULL;
+  }
+
+  Matcher = AllocateZeroPool (sizeof (PATTERN_MATCHER));
+  if (Matcher == NULL) {
+    return NULL;
+  }
+
+  Matcher->Entries = AllocateZeroPool (Capacity * sizeof (PATTERN_MATCHER_ENTRY));
+  if (Matcher->Entries == NULL) {
+    FreePool (Matcher);
+    return NULL;
+  }
+
+  Matcher->Capacity = Capacity;
+
+  return Matcher;
+}
+
+VOID
+PatternMatcherFree (
+  IN PATTERN_MATCHER  *Matcher
+) {
+  if (Matcher == NULL) {
+    return;
+  }
+
+  if (Matcher->Entries != NULL) {
+    FreePool (Matcher->Entries);
+  }
+
+  FreePool (Matcher);
+}
+
+//
+// Registers Find (Len bytes). Bytes equal to Wildcard match anything,
+// pass PATTERN_MATCHER_NO_WILDCARD (0xFF) for an exact pattern.
+// Returns entry index, or -1 on failure.
+//
+INTN
+PatternMatcherAdd (
+  IN PATTERN_MATCHER  *Matcher,
+  IN UINT8            *Find,
+  IN UINTN            Len,
+  IN UINT8            Wildcard,
+  IN VOID             *Context
+) {
+  PATTERN_MATCHER_ENTRY   *Entry;
+  UINT16                  Index;
+
+  if ((Matcher == NULL) || (Find == NULL) || !Len || (Matcher->Count >= Matcher->Capacity)) {
+    return -1;
+  }
+
+  Index = (UINT16)Matcher->Count;
+  Entry = &Matcher->Entries[Index];
+
+  Entry->Find = Find;
+  Entry->Len = (UINT32)Len;
+  Entry->Wildcard = Wildcard;
+  Entry->Context = Context;
+
+  PatternMatcherSetAnchor (Entry);
+
+  if (Entry->AnchorLen == sizeof (UINT32)) {
+    PatternMatcherLink (&Matcher->WordHeads[PATTERN_MATCHER_HASH (Entry->Anchor)], Matcher, Index);
+  } else if (Entry->AnchorLen) {
+    PatternMatcherLink (&Matcher->ByteHeads[Entry->Anchor], Matcher, Index);
+  } else {
+    PatternMatcherLink (&Matcher->Unanchored, Matcher, Index);
+  }
+
+  Matcher->Count++;
+  Matcher->Active++;
+
+  DBG ("%a: [%d] Len: %d, AnchorOff: %d, AnchorLen: %d\n", __FUNCTION__, Index, Entry->Len, Entry->AnchorOff, Entry->AnchorLen);
+
+  return (INTN)Index;
+}
+
+//
+// Full compare, wildcard aware.
+//
+BOOLEAN
+PatternMatcherCompare (
+  IN UINT8  *Source,
+  IN UINT8  *Find,
+  IN UINTN  Len,
+  IN UINT8  Wildcard
+) {
+  UINTN   i;
+
+  if (Wildcard == PATTERN_MATCHER_NO_WILDCARD) {
+    return (CompareMem (Source, Find, Len) == 0);
+  }
+
+  for (i = 0; i < Len; i++) {
+    if ((Find[i] != Source[i]) && (Find[i] != Wildcard)) {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+//
+// Writes Replace over Dest, keeping Dest bytes where Replace holds the Wildcard.
+//
+VOID
+PatternMatcherReplace (
+  IN OUT UINT8  *Dest,
+  IN     UINT8  *Replace,
+  IN     UINTN  Len,
+  IN     UINT8  Wildcard
+) {
+  UINTN   i;
+
+  if (Wildcard == PATTERN_MATCHER_NO_WILDCARD) {
+    CopyMem (Dest, Replace, Len);
+    return;
+  }
+
+  for (i = 0; i < Len; i++) {
+    if (Replace[i] != Wildcard) {
+      Dest[i] = Replace[i];
+    }
+  }
+}
+
+STATIC
+UINTN
+PatternMatcherWalk (
+  IN PATTERN_MATCHER            *Matcher,
+  IN UINT16                     Head,
+  IN UINT32                     Anchor,
+  IN UINTN                      AnchorLen,
+  IN UINT8                      *Buffer,
+  IN UINTN                      Size,
+  IN UINTN                      Pos,
+  IN PATTERN_MATCHER_CALLBACK   Callback,
+  IN VOID                       *Context
+) {
+  PATTERN_MATCHER_ENTRY   *Entry;
+  UINTN                   Start, Found = 0;
+
+  while (Head) {
+    Entry = &Matcher->Entries[Head - 1];
+    Head = Entry->Next;
+
+    if (
+      Entry->Retired ||
+      (AnchorLen && ((Entry->AnchorLen != AnchorLen) || (Entry->Anchor != Anchor))) ||
+      (Pos < Entry->AnchorOff)
+    ) {
+      continue;
+    }
+
+    Start = Pos - Entry->AnchorOff;
+
+    if (
+      ((Start + Entry->Len) > Size) ||
+      !PatternMatcherCompare (Buffer + Start, Entry->Find, Entry->Len, Entry->Wildcard)
+    ) {
+      continue;
+    }
+
+    Found++;
+
+    if (!Callback (Context, (UINTN)(Entry - Matcher->Entries), Entry->Context, Buffer, Start)) {
+      Entry->Retired = TRUE;
+      Matcher->Active--;
+    }
+  }
+
+  return Found;
+}
+
+//
+// Walks Buffer once, calling Callback for every occurrence of any registered pattern.
+// Callback returns FALSE to retire its pattern (no more occurrences wanted),
+// scan stops early once every pattern is retired. Callback may modify the
+// matched bytes in place. Returns number of occurrences reported.
+//
+UINTN
+PatternMatcherScan (
+  IN PATTERN_MATCHER            *Matcher,
+  IN UINT8                      *Buffer,
+  IN UINTN                      Size,
+  IN PATTERN_MATCHER_CALLBACK   Callback,
+  IN VOID                       *Context
+) {
+  UINTN   Pos, Found = 0;
+  UINT32  Word;
+  UINT16  Head;
+
+  if ((Matcher == NULL) || (Buffer == NULL) || (Callback == NULL)) {
+    return 0;
+  }
+
+  for (Pos = 0; (Pos < Size) && Matcher->Active; Pos++) {
+    Head = Matcher->ByteHeads[Buffer[Pos]];
+    if (Head) {
+      Found += PatternMatcherWalk (Matcher, Head, Buffer[Pos], 1, Buffer, Size, Pos, Callback, Context);
+    }
+
+    if ((Pos + sizeof (UINT32)) <= Size) {
+      Word = ReadUnaligned32 ((UINT32 *)(Buffer + Pos));
+      Head = Matcher->WordHeads[PATTERN_MATCHER_HASH (Word)];
+      if (Head) {
+        Found += PatternMatcherWalk (Matcher, Head, Word, sizeof (UINT32), Buffer, Size, Pos, Callback, Context);
+      }
+    }
+
+    if (Matcher->Unanchored) {
+      Found += PatternMatcherWalk (Matcher, Matcher->Unanchored, 0, 0, Buffer, Size, Pos, Callback, Context);
+    }
+  }
+
+  return Found;
+}
+
+//
+// Brings retired patterns back, so the same matcher can scan another buffer.
+//
+VOID
+PatternMatcherReset (
+  IN PATTERN_MATCHER  *Matcher
+) {
+  UINTN   i;
+
+  if (Matcher == NULL) {
+    return;
+  }
+
+  for (i = 0; i < Matcher->Count; i++) {
+    Matcher->Entries[i].Retired = FALSE;
+  }
+
+  Matcher->Active = Matcher->Count;
+}
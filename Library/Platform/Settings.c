@@ -22,6 +22,7 @@ S_FILES           *gConfigFiles = NULL, *gThemeFiles = NULL, *gToolFiles = NULL,
 ACPI_USER_LOAD    *gACPIUserLoad = NULL;
 UINTN             gACPIDropTablesNum = 0, gACPIUserLoadNum = 0;
 SETTINGS_DATA     gSettings;
+UINT32            gConfigCrc = 0;   // CRC32 of loaded config.plist
 LANGUAGES         gLanguage = english;
 SLOT_DEVICE       SmbiosSlotDevices[DEV_INDEX_MAX];
 GUI_ANIME         *gGuiAnime = NULL;
@@ -1306,6 +1307,8 @@ FillinKextPatches (
           }
         }
       }
+
+      BuildKextPatchIndex (Patches);
     }
 
     Prop = GetProperty (DictPointer, "KernelToPatch");
@@ -1799,12 +1802,12 @@ ScanConfigs () {
 // Theme
 //
 
-TagPtr
+PLIST_DOCUMENT *
 LoadTheme (
   CHAR16    *TestTheme
 ) {
-  EFI_STATUS    Status    = EFI_UNSUPPORTED;
-  TagPtr        ThemeDict = NULL;
+  EFI_STATUS        Status    = EFI_UNSUPPORTED;
+  PLIST_DOCUMENT    *ThemeDoc = NULL;
   CHAR8         *ThemePtr = NULL;
   UINTN         Size      = 0;
 
@@ -1824,11 +1827,11 @@ LoadTheme (
       if (!EFI_ERROR (Status)) {
         Status = LoadFile (gThemeDir, PoolPrint (L"%s.plist", CONFIG_THEME_FILENAME), (UINT8 **)&ThemePtr, &Size);
         if (!EFI_ERROR (Status) && (ThemePtr != NULL) && (Size != 0)) {
-          Status = ParseXML (ThemePtr, 0, &ThemeDict);
+          Status = ParseXMLDocument (ThemePtr, (UINT32)Size, &ThemeDoc);
 
           if (EFI_ERROR (Status)) {
-            ThemeDict = NULL;
-            DBG ("Theme: '%s' (%s) %s parsed\n", TestTheme, gThemePath, (ThemeDict == NULL) ? L"NOT" : L"");
+            ThemeDoc = NULL;
+            DBG ("Theme: '%s' (%s) %s parsed\n", TestTheme, gThemePath, (ThemeDoc == NULL) ? L"NOT" : L"");
           }
         }
 
@@ -1839,7 +1842,7 @@ LoadTheme (
     }
   }
 
-  return ThemeDict;
+  return ThemeDoc;
 }
 
 CHAR16 *
@@ -1881,6 +1884,7 @@ FreeTheme () {
   FreeBuiltinIcons ();
   FreeAnims ();
   FreeScrollBar ();
+  FreeThemeImages ();
 
   if (GlobalConfig.BackgroundName != NULL) {
     FreePool (GlobalConfig.BackgroundName);
@@ -2403,7 +2407,7 @@ InitTheme (
 ) {
   EFI_STATUS    Status = EFI_NOT_FOUND;
   UINTN         Size = 0, Rnd;
-  TagPtr        ThemeDict = NULL;
+  PLIST_DOCUMENT  *ThemeDoc = NULL;
   CHAR16        *TestTheme = NULL, *RndTheme;
   CHAR8         *NvramTheme = NULL;
 
@@ -2436,8 +2440,8 @@ InitTheme (
       }
 
       if (TestTheme != NULL) {
-        ThemeDict = LoadTheme (TestTheme);
-        if (ThemeDict != NULL) {
+        ThemeDoc = LoadTheme (TestTheme);
+        if (ThemeDoc != NULL) {
           //DBG ("special theme %s found and %s parsed\n", TestTheme, PoolPrint (L"%s.plist", CONFIG_THEME_FILENAME));
           if (GlobalConfig.Theme) {
             FreePool (GlobalConfig.Theme);
@@ -2454,7 +2458,7 @@ InitTheme (
     #endif
 
     // Try theme from nvram
-    if ((ThemeDict == NULL) && UseThemeDefinedInNVRam) {
+    if ((ThemeDoc == NULL) && UseThemeDefinedInNVRam) {
       NvramTheme = GetNvramVariable (gNvramData[kNvCloverTheme].VariableName, gNvramData[kNvCloverTheme].Guid, NULL, &Size);
       if (NvramTheme != NULL) {
         TestTheme = PoolPrint (L"%a", NvramTheme);
@@ -2463,12 +2467,12 @@ InitTheme (
         }
 
         if (StriCmp (TestTheme, CONFIG_THEME_RANDOM) == 0) {
-          ThemeDict = LoadTheme (RndTheme);
+          ThemeDoc = LoadTheme (RndTheme);
           goto Finish;
         }
 
-        ThemeDict = LoadTheme (TestTheme);
-        if (ThemeDict != NULL) {
+        ThemeDoc = LoadTheme (TestTheme);
+        if (ThemeDoc != NULL) {
           DBG ("Theme %s defined in NVRAM found and %s parsed\n", TestTheme, PoolPrint (L"%s.plist", CONFIG_THEME_FILENAME));
           if (GlobalConfig.Theme != NULL) {
             FreePool (GlobalConfig.Theme);
@@ -2488,7 +2492,7 @@ InitTheme (
     }
 
     // Try to get theme from settings
-    if (ThemeDict == NULL) {
+    if (ThemeDoc == NULL) {
       if (GlobalConfig.Theme == NULL) {
         if (Time != NULL) {
           DBG ("No default theme, get random theme %s\n", RndTheme);
@@ -2499,11 +2503,11 @@ InitTheme (
         if (StriCmp (GlobalConfig.Theme, CONFIG_THEME_EMBEDDED) == 0) {
           goto Finish;
         } else if (StriCmp (GlobalConfig.Theme, CONFIG_THEME_RANDOM) == 0) {
-          ThemeDict = LoadTheme (RndTheme);
+          ThemeDoc = LoadTheme (RndTheme);
         } else {
-          ThemeDict = LoadTheme (GlobalConfig.Theme);
+          ThemeDoc = LoadTheme (GlobalConfig.Theme);
 
-          if (ThemeDict == NULL) {
+          if (ThemeDoc == NULL) {
             DBG ("GlobalConfig: %s not found, get random theme %s\n", PoolPrint (L"%s.plist", CONFIG_THEME_FILENAME), RndTheme);
             FreePool (GlobalConfig.Theme);
             GlobalConfig.Theme = NULL;
@@ -2513,9 +2517,9 @@ InitTheme (
     }
 
     // Try to get a theme
-    if (ThemeDict == NULL) {
-      ThemeDict = LoadTheme (RndTheme);
-      if (ThemeDict != NULL) {
+    if (ThemeDoc == NULL) {
+      ThemeDoc = LoadTheme (RndTheme);
+      if (ThemeDoc != NULL) {
         GlobalConfig.Theme = PoolPrint (RndTheme);
       }
     }
@@ -2527,7 +2531,7 @@ InitTheme (
     FreePool (TestTheme);
   }
 
-  if (!ThemeDict) {  // No theme could be loaded, use embedded
+  if (!ThemeDoc) {  // No theme could be loaded, use embedded
     //DBG ("Using theme: embedded\n");
     GlobalConfig.Theme = NULL;
     if (gThemePath != NULL) {
@@ -2544,7 +2548,7 @@ InitTheme (
     GetThemeTagSettings (NULL);
   } else { // theme loaded successfully
     // read theme settings
-    TagPtr    DictPointer = GetProperty (ThemeDict, "Theme");
+    TagPtr    DictPointer = GetProperty (ThemeDoc->Root, "Theme");
 
     if (DictPointer != NULL) {
       Status = GetThemeTagSettings (DictPointer);
@@ -2553,7 +2557,7 @@ InitTheme (
       }
     }
 
-    FreeTag (ThemeDict);
+    FreeXMLDocument (ThemeDoc);
   }
 
   SetThemeIndex ();
@@ -4203,7 +4207,8 @@ GetRootUUID (
   CHAR8         *PlistBuffer;
   CHAR16        Uuid[40], *SystemPlistR, *SystemPlistP, *SystemPlistS;
   UINTN         PlistLen;
-  TagPtr        Dict, Prop;
+  TagPtr        Prop;
+  PLIST_DOCUMENT  *Doc;
   BOOLEAN       HasRock, HasPaper, HasScissors;
 
   Status = EFI_NOT_FOUND;
@@ -4246,18 +4251,18 @@ GetRootUUID (
   }
 
   if (!EFI_ERROR (Status)) {
-    Dict = NULL;
-    if (EFI_ERROR (ParseXML (PlistBuffer, 0, &Dict))) {
+    if (EFI_ERROR (ParseXMLDocument (PlistBuffer, 0, &Doc))) {
       FreePool (PlistBuffer);
       return EFI_NOT_FOUND;
     }
 
-    Prop = GetProperty (Dict, "Root UUID");
+    Prop = GetProperty (Doc->Root, "Root UUID");
     if ((Prop != NULL) && (Prop->type == kTagTypeString)) {
       AsciiStrToUnicodeStrS (Prop->string, Uuid, ARRAY_SIZE (Uuid));
       Status = StrToGuid (Uuid, &Volume->RootUUID);
     }
 
+    FreeXMLDocument (Doc);
     FreePool (PlistBuffer);
   }
 
@@ -4731,6 +4736,104 @@ GetUserSettings (
   return Status;
 }
 
+//
+// Parsed config tree kept as bplist next to the other Misc files, so an
+// unchanged config.plist skips the XML parser on the next boot. Only trees
+// ExportBinaryPlist () can reproduce field for field are cached.
+//
+
+#define SETTINGS_CACHE_SIGNATURE  SIGNATURE_32 ('C','C','F','G')
+#define SETTINGS_CACHE_VERSION    2
+
+typedef struct {
+  UINT32    Signature;
+  UINT32    Version;
+  UINT32    ConfigCrc;
+  UINT32    ConfigSize;
+  UINT32    DataCrc;
+  UINT32    DataSize;
+} SETTINGS_CACHE_HEADER;
+
+STATIC
+EFI_STATUS
+LoadSettingsCache (
+  IN  CHAR16    *CachePath,
+  IN  UINT32    ConfigCrc,
+  IN  UINTN     ConfigSize,
+  OUT TagPtr    *Dict
+) {
+  EFI_STATUS              Status;
+  UINT8                   *Buffer = NULL;
+  UINTN                   Size = 0;
+  SETTINGS_CACHE_HEADER   *Header;
+
+  Status = LoadFile (gSelfRootDir, CachePath, &Buffer, &Size);
+  if (EFI_ERROR (Status) || (Buffer == NULL)) {
+    return EFI_NOT_FOUND;
+  }
+
+  Header = (SETTINGS_CACHE_HEADER *)Buffer;
+
+  if (
+    (Size <= sizeof (SETTINGS_CACHE_HEADER)) ||
+    (Header->Signature != SETTINGS_CACHE_SIGNATURE) ||
+    (Header->Version != SETTINGS_CACHE_VERSION) ||
+    (Header->ConfigCrc != ConfigCrc) ||
+    (Header->ConfigSize != ConfigSize) ||
+    (Header->DataSize != (Size - sizeof (SETTINGS_CACHE_HEADER))) ||
+    (Header->DataCrc != GetCrc32 (Buffer + sizeof (SETTINGS_CACHE_HEADER), Header->DataSize))
+  ) {
+    Status = EFI_NOT_FOUND;
+  } else {
+    Status = ParseXML ((CHAR8 *)(Buffer + sizeof (SETTINGS_CACHE_HEADER)), Header->DataSize, Dict);
+  }
+
+  FreePool (Buffer);
+
+  return Status;
+}
+
+STATIC
+EFI_STATUS
+SaveSettingsCache (
+  IN CHAR16   *CachePath,
+  IN UINT32   ConfigCrc,
+  IN UINTN    ConfigSize,
+  IN TagPtr   Dict
+) {
+  EFI_STATUS              Status;
+  UINT8                   *Data = NULL, *Buffer;
+  UINTN                   DataSize = 0;
+  SETTINGS_CACHE_HEADER   *Header;
+
+  Status = ExportBinaryPlist (Dict, &Data, &DataSize);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Buffer = AllocatePool (sizeof (SETTINGS_CACHE_HEADER) + DataSize);
+  if (Buffer == NULL) {
+    FreePool (Data);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Header = (SETTINGS_CACHE_HEADER *)Buffer;
+  Header->Signature = SETTINGS_CACHE_SIGNATURE;
+  Header->Version = SETTINGS_CACHE_VERSION;
+  Header->ConfigCrc = ConfigCrc;
+  Header->ConfigSize = (UINT32)ConfigSize;
+  Header->DataCrc = GetCrc32 (Data, DataSize);
+  Header->DataSize = (UINT32)DataSize;
+  CopyMem (Buffer + sizeof (SETTINGS_CACHE_HEADER), Data, DataSize);
+
+  Status = SaveFile (gSelfRootDir, CachePath, Buffer, sizeof (SETTINGS_CACHE_HEADER) + DataSize);
+
+  FreePool (Buffer);
+  FreePool (Data);
+
+  return Status;
+}
+
 EFI_STATUS
 LoadUserSettings (
   IN EFI_FILE   *RootDir,
@@ -4740,7 +4843,8 @@ LoadUserSettings (
   EFI_STATUS    Status = EFI_NOT_FOUND;
   UINTN         Size = 0;
   CHAR8         *gConfigPtr = NULL;
-  CHAR16        *ConfigDirPath;
+  CHAR16        *ConfigDirPath, *CachePath;
+  UINT32        ConfigCrc;
 
   //DbgHeader ("LoadUserSettings");
 
@@ -4757,8 +4861,32 @@ LoadUserSettings (
     DBG ("Load plist: '%s' ... %r\n", ConfigDirPath, Status);
 
     if (!EFI_ERROR (Status) && (gConfigPtr != NULL)) {
-      Status = ParseXML (gConfigPtr, (UINT32)Size, Dict);
-      DBG ("Parsing plist: ... %r\n", Status);
+      ConfigCrc = GetCrc32 ((UINT8 *)gConfigPtr, Size);
+      gConfigCrc = ConfigCrc;
+
+      // already bplist, nothing to gain from a cache
+      if ((Size > 8) && (CompareMem (gConfigPtr, "bplist00", 8) == 0)) {
+        Status = ParseXML (gConfigPtr, (UINT32)Size, Dict);
+        DBG ("Parsing plist: ... %r\n", Status);
+      } else {
+        CachePath = PoolPrint (L"%s\\%s.cache", DIR_MISC, ConfName);
+
+        Status = LoadSettingsCache (CachePath, ConfigCrc, Size, Dict);
+        DBG ("Load cache: '%s' (CRC %08x) ... %r\n", CachePath, ConfigCrc, Status);
+
+        if (EFI_ERROR (Status)) {
+          Status = ParseXML (gConfigPtr, (UINT32)Size, Dict);
+          DBG ("Parsing plist: ... %r\n", Status);
+
+          if (!EFI_ERROR (Status)) {
+            DBG ("Save cache: ... %r\n", SaveSettingsCache (CachePath, ConfigCrc, Size, *Dict));
+          }
+        }
+
+        FreePool (CachePath);
+      }
+
+      FreePool (gConfigPtr);
     }
   }
 
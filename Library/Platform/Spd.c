@@ -140,6 +140,7 @@ UINT16 SpdIndexesDDR4[] = {
 
 BOOLEAN     SmbIntel;
 UINT8       SmbPage;
+UINTN       SmbErrors;    // counted instead of logged, SmbReadByte () may run on an AP
 
 /** Read one byte from i2c, used for reading SPD */
 
@@ -169,7 +170,7 @@ SmbReadByte (
           );
 
       if (t > 5) {
-        DBG ("host is busy for too long for byte %2X:%d!\n", Adr, Cmd);
+        SmbErrors++;                  // host is busy for too long
         return 0xFF;                  // break
       }
     }
@@ -198,12 +199,12 @@ SmbReadByte (
         */
 
         if (c & 4) {
-          DBG ("spd page change error for byte %2X:%d!\n", Adr, Cmd);
+          SmbErrors++;            // spd page change error
           break;
         }
 
         if (t > 5) {
-          DBG ("spd page change taking too long for byte %2X:%d!\n", Adr, Cmd);
+          SmbErrors++;            // spd page change taking too long
           break;                  // break after 5ms
         }
       }
@@ -238,7 +239,7 @@ SmbReadByte (
 
       if (t > 5) {
         // if (Cmd != 2)
-        DBG ("spd byte read taking too long for byte %2X:%d!\n", Adr, Cmd);
+        SmbErrors++;            // spd byte read taking too long
         break;                  // break after 5ms
       }
     }
@@ -561,37 +562,42 @@ GetDDRSerial (
   return AsciiSerial;
 }
 
-/** Get DDR2 or DDR3 or DDR4 Part Number, always return a valid ptr */
-CHAR8 *
-GetDDRPartNum (
-  UINT8   *Spd,
-  UINT32  Base,
-  UINT8   Slot
+/** First of the 20 Part Number bytes, 0 for unknown types */
+STATIC
+UINT16
+GetDDRPartNumStart (
+  UINT8   SpdType
 ) {
-  UINT16  i, Start=0, Index = 0;
-  CHAR8   c, *AsciiPartNo = AllocateZeroPool (32);
-
-  switch (Spd[SPD_MEMORY_TYPE]) {
+  switch (SpdType) {
     case SPD_MEMORY_TYPE_SDRAM_DDR4:
-      Start = 329;
-      break;
+      return 329;
 
     case SPD_MEMORY_TYPE_SDRAM_DDR3:
-      Start = 128;
-      break;
+      return 128;
 
     case SPD_MEMORY_TYPE_SDRAM_DDR2:
     case SPD_MEMORY_TYPE_SDRAM_DDR:
-      Start = 73;
-      break;
+      return 73;
 
     default:
       break;
   }
 
+  return 0;
+}
+
+/** Get DDR2 or DDR3 or DDR4 Part Number, always return a valid ptr */
+CHAR8 *
+GetDDRPartNum (
+  UINT8   *Spd
+) {
+  UINT16  i, Start, Index = 0;
+  CHAR8   c, *AsciiPartNo = AllocateZeroPool (32);
+
+  Start = GetDDRPartNumStart (Spd[SPD_MEMORY_TYPE]);
+
   for (i = Start; i < Start + 20; i++) {
-    READ_SPD (Spd, Base, Slot, (UINT16)i); // only read once the corresponding model part (ddr3 or ddr2)
-    c = Spd[i];
+    c = Spd[i]; // read together with the other bytes (ddr3 or ddr2 model part)
 
     if (IS_ALFA (c) || IS_DIGIT (c) || IS_PUNCT (c)) { // It seems that System Profiler likes only letters and digits...
       AsciiPartNo[Index++] = c;
@@ -603,25 +609,42 @@ GetDDRPartNum (
   return AsciiPartNo;
 }
 
-/** Read from smbus the SPD content and interpret it for detecting memory attributes */
+//
+// SMBus reads are slow (port polling, up to 5ms a byte), so they are started
+// early by StartScanSPD () on an AP if there is one, and ScanSPD () decodes the
+// bytes later on the BSP. SmbReadSlots () is what runs on the AP: port I/O and
+// preallocated buffers only.
+//
+
+#define SPD_MAX_SMBUS   2
+
+typedef struct {
+  UINT32    Base;
+  BOOLEAN   Intel;
+  UINT16    Vid;
+  UINT16    Did;
+  UINT8     *Spd;     // MAX_RAM_SLOTS * MAX_SPD_SIZE
+} SPD_SMBUS;
+
+typedef struct {
+  MP_TASK     Task;
+  BOOLEAN     Started;
+  UINTN       Count;
+  SPD_SMBUS   Bus[SPD_MAX_SMBUS];
+} SPD_SCAN;
+
+STATIC SPD_SCAN   mSpdScan;
+
+/** Enable the SMBus controller and get its io base */
 STATIC
 VOID
-ReadSmb (
+OpenSmb (
   EFI_PCI_IO_PROTOCOL   *PciIo,
-  UINT16                Vid,
-  UINT16                Did
+  SPD_SMBUS             *Bus
 ) {
   //EFI_STATUS  Status;
-  //RAM_SLOT_INFO  *Slot;
-  //BOOLEAN     fullBanks;
-  //UINT16      Vid, Did;
-  UINT16      Speed, Command;
+  UINT16      Command;
   UINT32      Base, Mmio, HostC;
-  UINT8       *SpdBuf, i, SpdType;
-
-  SmbPage = 0; // valid pages are 0 and 1; assume the first page (page 0) is already selected
-  //Vid = gPci->Hdr.VendorId;
-  //Did = gPci->Hdr.DeviceId;
 
   /*Status = */PciIo->Pci.Read (
                             PciIo,
@@ -649,7 +672,7 @@ ReadSmb (
                             1,
                             &Mmio
                           );
-  if (Vid == 0x8086) {
+  if (Bus->Vid == 0x8086) {
     /*Status = */PciIo->Pci.Read (
                               PciIo,
                               EfiPciIoWidthUint32,
@@ -659,7 +682,7 @@ ReadSmb (
                             );
 
     Base &= 0xFFFE;
-    SmbIntel = TRUE;
+    Bus->Intel = TRUE;
   } else {
     /*Status = */PciIo->Pci.Read (
                               PciIo,
@@ -669,7 +692,7 @@ ReadSmb (
                               &Base
                             );
     Base &= 0xFFFC;
-    SmbIntel = FALSE;
+    Bus->Intel = FALSE;
   }
 
  /*Status = */PciIo->Pci.Read (
@@ -682,39 +705,104 @@ ReadSmb (
 
   MsgLog (
     "Scanning SMBus [%04x:%04x], Mmio: 0x%x, ioport: 0x%x, HostC: 0x%x\n",
-    Vid, Did, Mmio, Base, HostC
+    Bus->Vid, Bus->Did, Mmio, Base, HostC
   );
 
-  // needed at least for laptops
-  //fullBanks = (gDMI->MemoryModules == gDMI->CntMemorySlots);
+  Bus->Base = Base;
+}
 
-  SpdBuf = AllocateZeroPool (MAX_SPD_SIZE);
+/** Read from smbus the SPD bytes ReadSmb () needs, for every slot of every controller */
+STATIC
+VOID
+EFIAPI
+SmbReadSlots (
+  IN OUT VOID   *Context
+) {
+  SPD_SCAN    *Scan = (SPD_SCAN *)Context;
+  SPD_SMBUS   *Bus;
+  UINT8       *SpdBuf, i, SpdType;
+  UINT16      Start, j;
+  UINTN       Index;
+
+  for (Index = 0; Index < Scan->Count; Index++) {
+    Bus = &Scan->Bus[Index];
+    SmbIntel = Bus->Intel;
+    SmbPage = 0; // valid pages are 0 and 1; assume the first page (page 0) is already selected
+
+    // Search MAX_RAM_SLOTS Slots
+    //==>
+    /*
+      TotalSlotsCount = (UINT8)TotalCount; // TotalCount from SMBIOS.
+      if (!TotalSlotsCount) {
+        TotalSlotsCount = MAX_RAM_SLOTS;
+      }
+    */
 
-  // Search MAX_RAM_SLOTS Slots
-  //==>
-  /*
-    TotalSlotsCount = (UINT8)TotalCount; // TotalCount from SMBIOS.
-    if (!TotalSlotsCount) {
-      TotalSlotsCount = MAX_RAM_SLOTS;
-    }
-  */
+    //TotalSlotsCount = 8; //MAX_RAM_SLOTS;  -- spd can read only 8 Slots
 
-  //TotalSlotsCount = 8; //MAX_RAM_SLOTS;  -- spd can read only 8 Slots
+    for (i = 0; i < MAX_RAM_SLOTS; i++) {
+      //<==
+      SpdBuf = Bus->Spd + i * MAX_SPD_SIZE;
+      READ_SPD (SpdBuf, Bus->Base, i, SPD_MEMORY_TYPE);
 
-  MsgLog ("Slots to scan: %d (max)\n", MAX_RAM_SLOTS);
+      if (SpdBuf[SPD_MEMORY_TYPE] == 0) {
+        // First 0x40 bytes of DDR4 spd second page is 0. Maybe we need to change page, so do that and retry.
+        SmbPage = 0xFF; // force page to be set
+        READ_SPD (SpdBuf, Bus->Base, i, SPD_MEMORY_TYPE);
+      }
 
-  for (i = 0; i <  MAX_RAM_SLOTS; i++) {
-    //<==
-    ZeroMem (SpdBuf, MAX_SPD_SIZE);
-    READ_SPD (SpdBuf, Base, i, SPD_MEMORY_TYPE);
-
-    if (SpdBuf[SPD_MEMORY_TYPE] == 0) {
-      // First 0x40 bytes of DDR4 spd second page is 0. Maybe we need to change page, so do that and retry.
-      //DBG (" - [%02d]: Got invalid type 0 @0x%x. Will set page and retry.\n", i, 0x50 + i);
-      SmbPage = 0xFF; // force page to be set
-      READ_SPD (SpdBuf, Base, i, SPD_MEMORY_TYPE);
+      SpdType = SpdBuf[SPD_MEMORY_TYPE];
+
+      switch (SpdType) {
+        case SPD_MEMORY_TYPE_SDRAM_DDR:
+        case SPD_MEMORY_TYPE_SDRAM_DDR2:
+          InitSPD (SpdIndexesDDR, SpdBuf, Bus->Base, i);
+          break;
+
+        case SPD_MEMORY_TYPE_SDRAM_DDR3:
+          InitSPD (SpdIndexesDDR3, SpdBuf, Bus->Base, i);
+          break;
+
+        case SPD_MEMORY_TYPE_SDRAM_DDR4:
+          InitSPD (SpdIndexesDDR4, SpdBuf, Bus->Base, i);
+          break;
+
+        default:
+          // empty (0xFF) or unknown
+          continue;
+      }
+
+      Start = GetDDRPartNumStart (SpdType);
+      for (j = Start; j < Start + 20; j++) {
+        READ_SPD (SpdBuf, Bus->Base, i, j);
+      }
+    } // for
+
+    if (SmbPage != 0) {
+      READ_SPD (Bus->Spd, Bus->Base, 0, 0); // force first page when we're done
     }
+  }
+}
+
+/** Interpret the SPD content read from smbus for detecting memory attributes */
+STATIC
+VOID
+ReadSmb (
+  SPD_SMBUS   *Bus
+) {
+  //EFI_STATUS  Status;
+  //RAM_SLOT_INFO  *Slot;
+  //BOOLEAN     fullBanks;
+  UINT16      Speed;
+  UINT8       *SpdBuf, i, SpdType;
 
+  // needed at least for laptops
+  //fullBanks = (gDMI->MemoryModules == gDMI->CntMemorySlots);
+
+  MsgLog ("Slots to scan: %d (max) on SMBus [%04x:%04x]\n", MAX_RAM_SLOTS, Bus->Vid, Bus->Did);
+
+  for (i = 0; i <  MAX_RAM_SLOTS; i++) {
+    SpdBuf = Bus->Spd + i * MAX_SPD_SIZE;
     SpdType = SpdBuf[SPD_MEMORY_TYPE];
 
     if (SpdType == 0xFF) {
@@ -722,12 +810,10 @@ ReadSmb (
       continue;
     }
 
-    // Copy spd data into buffer
+    // spd data is in the buffer already
 
     switch (SpdType)  {
       case SPD_MEMORY_TYPE_SDRAM_DDR:
-        InitSPD (SpdIndexesDDR, SpdBuf, Base, i);
-
         gSettings.RAM.SPD[i].Type = MemoryTypeDdr;
         gSettings.RAM.SPD[i].ModuleSize =  (
                                               (
@@ -738,8 +824,6 @@ ReadSmb (
         break;
 
       case SPD_MEMORY_TYPE_SDRAM_DDR2:
-        InitSPD (SpdIndexesDDR, SpdBuf, Base, i);
-
         gSettings.RAM.SPD[i].Type = MemoryTypeDdr2;
         gSettings.RAM.SPD[i].ModuleSize =  (
                                               (1 << ((SpdBuf[SPD_NUM_ROWS] & 0x0f) + (SpdBuf[SPD_NUM_COLUMNS] & 0x0f) - 17)) *
@@ -748,8 +832,6 @@ ReadSmb (
         break;
 
       case SPD_MEMORY_TYPE_SDRAM_DDR3:
-        InitSPD (SpdIndexesDDR3, SpdBuf, Base, i);
-
         gSettings.RAM.SPD[i].Type = MemoryTypeDdr3;
         gSettings.RAM.SPD[i].ModuleSize = ((SpdBuf[4] & 0x0f) + 28) + ((SpdBuf[8] & 0x7)  + 3);
         gSettings.RAM.SPD[i].ModuleSize -= (SpdBuf[7] & 0x7) + 25;
@@ -757,8 +839,6 @@ ReadSmb (
         break;
 
       case SPD_MEMORY_TYPE_SDRAM_DDR4:
-        InitSPD (SpdIndexesDDR4, SpdBuf, Base, i);
-
         gSettings.RAM.SPD[i].Type = MemoryTypeDdr4;
 
         gSettings.RAM.SPD[i].ModuleSize =
@@ -837,8 +917,8 @@ ReadSmb (
 
     //SpdType = (Slot->spd[SPD_MEMORY_TYPE] < ((UINT8)12) ? Slot->spd[SPD_MEMORY_TYPE] : 0);
     //gRAM Type = spd_mem_to_smbios[SpdType];
-    gSettings.RAM.SPD[i].PartNo = GetDDRPartNum (SpdBuf, Base, i);
-    gSettings.RAM.SPD[i].Vendor = GetVendorName (&(gSettings.RAM.SPD[i]), SpdBuf, Base, i);
+    gSettings.RAM.SPD[i].PartNo = GetDDRPartNum (SpdBuf);
+    gSettings.RAM.SPD[i].Vendor = GetVendorName (&(gSettings.RAM.SPD[i]), SpdBuf, Bus->Base, i);
     gSettings.RAM.SPD[i].SerialNo = GetDDRSerial (SpdBuf);
     //XXX - when we can FreePool allocated for these buffers?
     // determine spd Speed
@@ -883,21 +963,22 @@ ReadSmb (
     gSettings.RAM.SPD[i].InUse = TRUE;
     ++(gSettings.RAM.SPDInUse);
   } // for
-
-  if (SmbPage != 0) {
-    READ_SPD (SpdBuf, Base, 0, 0); // force first page when we're done
-  }
 }
 
+/** Find the SMBus controllers and start reading their SPD, on an AP if possible */
 VOID
-ScanSPD () {
+StartScanSPD () {
   EFI_STATUS            Status;
   EFI_HANDLE            *HandleBuffer = NULL;
   EFI_PCI_IO_PROTOCOL   *PciIo = NULL;
   UINTN                 HandleCount, Index;
   PCI_TYPE00            Pci;
+  SPD_SMBUS             *Bus;
 
-  DbgHeader ("ScanSPD");
+  DbgHeader ("StartScanSPD");
+
+  ZeroMem (&mSpdScan, sizeof (mSpdScan));
+  SmbErrors = 0;
 
   // Scan PCI handles
   Status = gBS->LocateHandleBuffer (
@@ -909,7 +990,7 @@ ScanSPD () {
                 );
 
   if (!EFI_ERROR (Status)) {
-    for (Index = 0; Index < HandleCount; ++Index) {
+    for (Index = 0; (Index < HandleCount) && (mSpdScan.Count < SPD_MAX_SMBUS); ++Index) {
       Status = gBS->HandleProtocol (HandleBuffer[Index], &gEfiPciIoProtocolGuid, (VOID **)&PciIo);
       if (!EFI_ERROR (Status)) {
         // Read PCI BUS
@@ -938,9 +1019,53 @@ ScanSPD () {
             Status
           );
 
-          ReadSmb (PciIo, Pci.Hdr.VendorId, Pci.Hdr.DeviceId);
+          Bus = &mSpdScan.Bus[mSpdScan.Count];
+          Bus->Spd = AllocateZeroPool (MAX_RAM_SLOTS * MAX_SPD_SIZE);
+          if (Bus->Spd == NULL) {
+            break;
+          }
+
+          Bus->Vid = Pci.Hdr.VendorId;
+          Bus->Did = Pci.Hdr.DeviceId;
+          OpenSmb (PciIo, Bus);
+          mSpdScan.Count++;
         }
       }
     }
+
+    FreePool (HandleBuffer);
   }
+
+  if (mSpdScan.Count) {
+    MpTaskStart (&mSpdScan.Task, SmbReadSlots, &mSpdScan);
+  }
+
+  mSpdScan.Started = TRUE;
+}
+
+/** Decode what StartScanSPD () read */
+VOID
+ScanSPD () {
+  UINTN   Index;
+
+  DbgHeader ("ScanSPD");
+
+  if (!mSpdScan.Started) {
+    StartScanSPD ();
+  }
+
+  MpTaskWait (&mSpdScan.Task);
+
+  if (SmbErrors) {
+    DBG ("SMBus: %d byte reads failed or timed out\n", SmbErrors);
+  }
+
+  for (Index = 0; Index < mSpdScan.Count; Index++) {
+    ReadSmb (&mSpdScan.Bus[Index]);
+    FreePool (mSpdScan.Bus[Index].Spd);
+    mSpdScan.Bus[Index].Spd = NULL;
+  }
+
+  mSpdScan.Count = 0;
+  mSpdScan.Started = FALSE;
 }
@@ -36,6 +36,10 @@
 
 #include <Library/Platform/Platform.h>
 
+#if defined (MDE_CPU_X64)
+#include <emmintrin.h>
+#endif
+
 #ifndef DEBUG_ALL
 #ifndef DEBUG_IMG
 #define DEBUG_IMG -1
@@ -79,6 +83,7 @@ CreateImage (
   NewImage->Width = Width;
   NewImage->Height = Height;
   NewImage->HasAlpha = HasAlpha;
+  NewImage->RefCount = 1;
 
   return NewImage;
 }
@@ -124,7 +129,287 @@ CopyImage (
   return NewImage;
 }
 
-//Scaling functions
+//
+// Scaling functions
+//
+// Images are resized in two separable passes, rows first and columns second,
+// each driven by a table of taps per destination pixel: area-averaging when
+// shrinking, bilinear when enlarging. Weights are fixed point and add up to
+// SCALE_ONE; there is no float math here (some 32-bit Mac firmwares hang on
+// float-to-UINT8 conversions).
+//
+
+#define SCALE_SHIFT   14
+#define SCALE_ONE     (1 << SCALE_SHIFT)
+
+typedef struct {
+  INTN    Taps;     // source pixels per destination pixel, always even
+  INTN    *Index;   // Taps source pixels for every destination pixel
+  INT16   *Weight;  // and their weights
+} SCALE_FILTER;
+
+STATIC
+VOID
+FreeScaleFilter (
+  IN SCALE_FILTER   *Filter
+) {
+  if (Filter->Index != NULL) {
+    FreePool (Filter->Index);
+    Filter->Index = NULL;
+  }
+
+  if (Filter->Weight != NULL) {
+    FreePool (Filter->Weight);
+    Filter->Weight = NULL;
+  }
+}
+
+STATIC
+BOOLEAN
+CreateScaleFilter (
+  IN  INTN           OldSize,
+  IN  INTN           NewSize,
+  OUT SCALE_FILTER   *Filter
+) {
+  INTN    i, j, Count, Start, End, Sum, Max, *Index;
+  INT16   *Weight;
+
+  // Shrinking maps destination pixel i onto [i * OldSize, (i + 1) * OldSize) and source
+  // pixel j onto [j * NewSize, (j + 1) * NewSize): that touches OldSize / NewSize + 2 pixels at most.
+  Filter->Taps = (NewSize < OldSize) ? ((OldSize / NewSize + 3) & ~1) : 2;
+  Filter->Index = AllocatePool (NewSize * Filter->Taps * sizeof (INTN));
+  Filter->Weight = AllocateZeroPool (NewSize * Filter->Taps * sizeof (INT16));
+
+  if ((Filter->Index == NULL) || (Filter->Weight == NULL)) {
+    FreeScaleFilter (Filter);
+    return FALSE;
+  }
+
+  for (i = 0; i < NewSize; i++) {
+    Index = Filter->Index + i * Filter->Taps;
+    Weight = Filter->Weight + i * Filter->Taps;
+
+    if (NewSize < OldSize) {
+      Start = i * OldSize;
+      End = Start + OldSize;
+      Count = Sum = Max = 0;
+
+      for (j = Start / NewSize; (j * NewSize) < End; j++, Count++) {
+        Index[Count] = j;
+        Weight[Count] = (INT16)(((MIN (End, (j + 1) * NewSize) - MAX (Start, j * NewSize)) * SCALE_ONE) / OldSize);
+        Sum += Weight[Count];
+
+        if (Weight[Count] > Weight[Max]) {
+          Max = Count;
+        }
+      }
+
+      // rounding leftovers go to the heaviest tap
+      Weight[Max] += (INT16)(SCALE_ONE - Sum);
+    } else {
+      // centre of destination pixel i in source pixels: (i + 1/2) * OldSize / NewSize - 1/2
+      Start = MAX ((2 * i + 1) * OldSize - NewSize, 0);
+      Index[0] = Start / (2 * NewSize);
+      Index[1] = MIN (Index[0] + 1, OldSize - 1);
+      Weight[1] = (INT16)(((Start % (2 * NewSize)) * SCALE_ONE) / (2 * NewSize));
+      Weight[0] = (INT16)(SCALE_ONE - Weight[1]);
+      Count = 2;
+    }
+
+    // padding taps repeat the last pixel with no weight
+    for (; Count < Filter->Taps; Count++) {
+      Index[Count] = Index[Count - 1];
+    }
+  }
+
+  return TRUE;
+}
+
+/** Weighs Taps pixels Src[Index[k] * Stride] into Dest. */
+STATIC
+VOID
+ScalePixel (
+  OUT EG_PIXEL   *Dest,
+  IN  EG_PIXEL   *Src,
+  IN  INTN       Stride,
+  IN  INTN       *Index,
+  IN  INT16      *Weight,
+  IN  INTN       Taps
+) {
+  INTN      k;
+#if defined (MDE_CPU_X64)
+  __m128i   Zero = _mm_setzero_si128 (), Sum = _mm_set1_epi32 (SCALE_ONE / 2), Pair;
+
+  for (k = 0; k < Taps; k += 2) {
+    // b0 b1 g0 g1 r0 r1 a0 a1, so madd weighs and adds both pixels per channel
+    Pair = _mm_unpacklo_epi8 (
+             _mm_cvtsi32_si128 (*(INT32 *)&Src[Index[k] * Stride]),
+             _mm_cvtsi32_si128 (*(INT32 *)&Src[Index[k + 1] * Stride])
+           );
+    Sum = _mm_add_epi32 (Sum, _mm_madd_epi16 (_mm_unpacklo_epi8 (Pair, Zero), _mm_set1_epi32 (*(INT32 *)&Weight[k])));
+  }
+
+  Sum = _mm_srai_epi32 (Sum, SCALE_SHIFT);
+  Sum = _mm_packs_epi32 (Sum, Sum);
+  *(INT32 *)Dest = _mm_cvtsi128_si32 (_mm_packus_epi16 (Sum, Sum));
+#else
+  EG_PIXEL  *Pixel;
+  INTN      b, g, r, a;
+
+  b = g = r = a = SCALE_ONE / 2;
+
+  for (k = 0; k < Taps; k++) {
+    Pixel = &Src[Index[k] * Stride];
+    b += Pixel->b * Weight[k];
+    g += Pixel->g * Weight[k];
+    r += Pixel->r * Weight[k];
+    a += Pixel->a * Weight[k];
+  }
+
+  Dest->b = (UINT8)(b >> SCALE_SHIFT);
+  Dest->g = (UINT8)(g >> SCALE_SHIFT);
+  Dest->r = (UINT8)(r >> SCALE_SHIFT);
+  Dest->a = (UINT8)(a >> SCALE_SHIFT);
+#endif
+}
+
+/** Resamples Rows rows of SrcWidth pixels into rows of DestWidth pixels. */
+STATIC
+VOID
+ScaleRows (
+  IN  EG_PIXEL       *Src,
+  IN  INTN           SrcWidth,
+  OUT EG_PIXEL       *Dest,
+  IN  INTN           DestWidth,
+  IN  INTN           Rows,
+  IN  SCALE_FILTER   *Filter
+) {
+  INTN    x, y;
+
+  for (y = 0; y < Rows; y++, Src += SrcWidth, Dest += DestWidth) {
+    for (x = 0; x < DestWidth; x++) {
+      ScalePixel (Dest + x, Src, 1, Filter->Index + x * Filter->Taps, Filter->Weight + x * Filter->Taps, Filter->Taps);
+    }
+  }
+}
+
+/** Resamples rows of Width pixels into DestRows rows, 4 pixels per step where possible. */
+STATIC
+VOID
+ScaleColumns (
+  IN  EG_PIXEL       *Src,
+  OUT EG_PIXEL       *Dest,
+  IN  INTN           Width,
+  IN  INTN           DestRows,
+  IN  SCALE_FILTER   *Filter
+) {
+  INTN      x, y, *Index;
+  INT16     *Weight;
+#if defined (MDE_CPU_X64)
+  INTN      k;
+  __m128i   Zero = _mm_setzero_si128 (), Round = _mm_set1_epi32 (SCALE_ONE / 2),
+            Sum0, Sum1, Sum2, Sum3, Row0, Row1, Lo, Hi, W;
+#endif
+
+  for (y = 0; y < DestRows; y++, Dest += Width) {
+    Index = Filter->Index + y * Filter->Taps;
+    Weight = Filter->Weight + y * Filter->Taps;
+    x = 0;
+
+#if defined (MDE_CPU_X64)
+    for (; (x + 4) <= Width; x += 4) {
+      Sum0 = Sum1 = Sum2 = Sum3 = Round;
+
+      for (k = 0; k < Filter->Taps; k += 2) {
+        Row0 = _mm_loadu_si128 ((__m128i *)(Src + Index[k] * Width + x));
+        Row1 = _mm_loadu_si128 ((__m128i *)(Src + Index[k + 1] * Width + x));
+        W = _mm_set1_epi32 (*(INT32 *)&Weight[k]);
+
+        // interleave both rows byte by byte, as in ScalePixel
+        Lo = _mm_unpacklo_epi8 (Row0, Row1);
+        Hi = _mm_unpackhi_epi8 (Row0, Row1);
+        Sum0 = _mm_add_epi32 (Sum0, _mm_madd_epi16 (_mm_unpacklo_epi8 (Lo, Zero), W));
+        Sum1 = _mm_add_epi32 (Sum1, _mm_madd_epi16 (_mm_unpackhi_epi8 (Lo, Zero), W));
+        Sum2 = _mm_add_epi32 (Sum2, _mm_madd_epi16 (_mm_unpacklo_epi8 (Hi, Zero), W));
+        Sum3 = _mm_add_epi32 (Sum3, _mm_madd_epi16 (_mm_unpackhi_epi8 (Hi, Zero), W));
+      }
+
+      _mm_storeu_si128 (
+        (__m128i *)(Dest + x),
+        _mm_packus_epi16 (
+          _mm_packs_epi32 (_mm_srai_epi32 (Sum0, SCALE_SHIFT), _mm_srai_epi32 (Sum1, SCALE_SHIFT)),
+          _mm_packs_epi32 (_mm_srai_epi32 (Sum2, SCALE_SHIFT), _mm_srai_epi32 (Sum3, SCALE_SHIFT))
+        )
+      );
+    }
+#endif
+
+    for (; x < Width; x++) {
+      ScalePixel (Dest + x, Src + x, Width, Index, Weight, Filter->Taps);
+    }
+  }
+}
+
+/** Resizes Image to NewWidth x NewHeight, NULL on failure. */
+STATIC
+EG_IMAGE *
+ResampleImage (
+  IN EG_IMAGE   *Image,
+  IN INTN       NewWidth,
+  IN INTN       NewHeight
+) {
+  EG_IMAGE       *NewImage;
+  EG_PIXEL       *Rows, *Buffer = NULL;
+  SCALE_FILTER   Horz, Vert;
+
+  if ((Image->Width == NewWidth) && (Image->Height == NewHeight)) {
+    return CopyImage (Image);
+  }
+
+  NewImage = CreateImage (NewWidth, NewHeight, Image->HasAlpha);
+  if (NewImage == NULL) {
+    return NULL;
+  }
+
+  // the column pass is skipped when the height stays, the row pass when the width does
+  if (Image->Height == NewHeight) {
+    Rows = NewImage->PixelData;
+  } else if (Image->Width == NewWidth) {
+    Rows = Image->PixelData;
+  } else {
+    Rows = Buffer = (EG_PIXEL *)AllocatePool ((UINTN)(NewWidth * Image->Height * sizeof (EG_PIXEL)));
+  }
+
+  ZeroMem (&Horz, sizeof (SCALE_FILTER));
+  ZeroMem (&Vert, sizeof (SCALE_FILTER));
+
+  if (
+    (Rows == NULL) ||
+    ((Image->Width != NewWidth) && !CreateScaleFilter (Image->Width, NewWidth, &Horz)) ||
+    ((Image->Height != NewHeight) && !CreateScaleFilter (Image->Height, NewHeight, &Vert))
+  ) {
+    FreeImage (NewImage);
+    NewImage = NULL;
+  } else {
+    if (Image->Width != NewWidth) {
+      ScaleRows (Image->PixelData, Image->Width, Rows, NewWidth, Image->Height, &Horz);
+    }
+
+    if (Image->Height != NewHeight) {
+      ScaleColumns (Rows, NewImage->PixelData, NewWidth, NewHeight, &Vert);
+    }
+  }
+
+  if (Buffer != NULL) {
+    FreePool (Buffer);
+  }
+
+  FreeScaleFilter (&Horz);
+  FreeScaleFilter (&Vert);
+
+  return NewImage;
+}
+
 EG_IMAGE *
 CopyScaledImage (
   IN EG_IMAGE   *OldImage,
@@ -133,9 +418,8 @@ CopyScaledImage (
   //(c)Slice 2012
   BOOLEAN     Grey = FALSE;
   EG_IMAGE    *NewImage;
-  INTN        x, x0, x1, x2, y, y0, y1, y2,
-              NewH, NewW, OldW;
-  EG_PIXEL    *Dest, *Src;
+  INTN        x, y, NewH, NewW;
+  EG_PIXEL    *Dest;
 
   if (Ratio < 0) {
     Ratio = -Ratio;
@@ -146,42 +430,16 @@ CopyScaledImage (
     return NULL;
   }
 
-  Src = OldImage->PixelData;
-  OldW = OldImage->Width;
-
   NewW = (OldImage->Width * Ratio) >> 4;
   NewH = (OldImage->Height * Ratio) >> 4;
 
-  if (Ratio == 16) {
-    NewImage = CopyImage (OldImage);
-  } else {
-    NewImage = CreateImage (NewW, NewH, OldImage->HasAlpha);
-
-    if (NewImage == NULL) {
-      return NULL;
-    }
-
-    Dest = NewImage->PixelData;
-    for (y = 0; y < NewH; y++) {
-      y1 = (y << 4) / Ratio;
-      y0 = ((y1 > 0) ? (y1 - 1) : y1) * OldW;
-      y2 = ((y1 < (OldImage->Height - 1)) ? (y1 + 1) : y1) * OldW;
-      y1 *= OldW;
+  // a ratio rounding a side down to nothing still gives an (empty) image, as before
+  NewImage = ((NewW == 0) || (NewH == 0) || (OldImage->Width == 0) || (OldImage->Height == 0))
+               ? CreateImage (NewW, NewH, OldImage->HasAlpha)
+               : ResampleImage (OldImage, NewW, NewH);
 
-      for (x = 0; x < NewW; x++) {
-        x1 = (x << 4) / Ratio;
-        x0 = (x1 > 0) ? (x1 - 1) : x1;
-        x2 = (x1 < (OldW - 1)) ? (x1 + 1) : x1;
-        Dest->b = (UINT8)(((INTN)Src[x1 + y1].b * 2 + Src[x0 + y1].b +
-                           Src[x2 + y1].b + Src[x1 + y0].b + Src[x1 + y2].b) / 6);
-        Dest->g = (UINT8)(((INTN)Src[x1 + y1].g * 2 + Src[x0 + y1].g +
-                           Src[x2 + y1].g + Src[x1 + y0].g + Src[x1 + y2].g) / 6);
-        Dest->r = (UINT8)(((INTN)Src[x1 + y1].r * 2 + Src[x0 + y1].r +
-                           Src[x2 + y1].r + Src[x1 + y0].r + Src[x1 + y2].r) / 6);
-        Dest->a = Src[x1 + y1].a;
-        Dest++;
-      }
-    }
+  if (NewImage == NULL) {
+    return NULL;
   }
 
   if (Grey) {
@@ -198,102 +456,25 @@ CopyScaledImage (
   return NewImage;
 }
 
-// The following function implements a bilinear image scaling algorithm, based on
-// code presented at http://tech-algorithm.com/articles/bilinear-image-scaling/.
 // Resize an image; returns pointer to resized image if successful, NULL otherwise.
 // Calling function is responsible for freeing allocated memory.
-// NOTE: x_ratio, y_ratio, x_diff, and y_diff should really be float values;
-// however, I've found that my 32-bit Mac Mini has a buggy EFI (or buggy CPU?), which
-// causes this function to hang on float-to-UINT8 conversions on some (but not all!)
-// float values. Therefore, this function uses integer arithmetic but multiplies
-// all values by FP_MULTIPLIER to achieve something resembling the sort of precision
-// needed for good results.
-
-#define FP_MULTIPLIER (UINTN) 65536
-
 EG_IMAGE *
 ScaleImage (
   IN EG_IMAGE   *Image,
   IN UINTN      NewWidth,
   IN UINTN      NewHeight
 ) {
-  EG_IMAGE   *NewImage = NULL;
-  EG_PIXEL   a, b, c, d;
-  UINTN      x, y, Index,
-             i, j,
-             Offset = 0,
-             x_ratio, y_ratio, x_diff, y_diff;
+  EG_IMAGE   *NewImage;
 
   if ((Image == NULL) || (Image->Height == 0) || (Image->Width == 0) || (NewWidth == 0) || (NewHeight == 0)) {
     return NULL;
   }
 
-  if (((UINTN)Image->Width == NewWidth) && ((UINTN)Image->Height == NewHeight)) {
-    return (CopyImage(Image));
-  }
-
-  NewImage = CreateImage(NewWidth, NewHeight, Image->HasAlpha);
+  NewImage = ResampleImage (Image, (INTN)NewWidth, (INTN)NewHeight);
   if (NewImage == NULL) {
     return (CopyImage(Image));
   }
 
-  x_ratio = ((Image->Width - 1) * FP_MULTIPLIER) / NewWidth;
-  y_ratio = ((Image->Height - 1) * FP_MULTIPLIER) / NewHeight;
-
-  for (i = 0; i < NewHeight; i++) {
-     for (j = 0; j < NewWidth; j++) {
-        x = (j * (Image->Width - 1)) / NewWidth;
-        y = (i * (Image->Height - 1)) / NewHeight;
-        x_diff = (x_ratio * j) - x * FP_MULTIPLIER;
-        y_diff = (y_ratio * i) - y * FP_MULTIPLIER;
-        Index = ((y * Image->Width) + x);
-        a = Image->PixelData[Index];
-        b = Image->PixelData[Index + 1];
-        c = Image->PixelData[Index + Image->Width];
-        d = Image->PixelData[Index + Image->Width + 1];
-
-        // blue element
-        NewImage->PixelData[Offset].b = (UINT8)(
-                                            (
-                                              (a.b) * (FP_MULTIPLIER - x_diff) * (FP_MULTIPLIER - y_diff) +
-                                              (b.b) * (x_diff) * (FP_MULTIPLIER - y_diff) +
-                                              (c.b) * (y_diff) * (FP_MULTIPLIER - x_diff) +
-                                              (d.b) * (x_diff * y_diff
-                                            )) / (FP_MULTIPLIER * FP_MULTIPLIER)
-                                          );
-
-        // green element
-        NewImage->PixelData[Offset].g = (UINT8)(
-                                            (
-                                              (a.g) * (FP_MULTIPLIER - x_diff) * (FP_MULTIPLIER - y_diff) +
-                                              (b.g) * (x_diff) * (FP_MULTIPLIER - y_diff) +
-                                              (c.g) * (y_diff) * (FP_MULTIPLIER - x_diff) +
-                                              (d.g) * (x_diff * y_diff
-                                            )) / (FP_MULTIPLIER * FP_MULTIPLIER)
-                                          );
-
-        // red element
-        NewImage->PixelData[Offset].r =   (UINT8)(
-                                            (
-                                              (a.r) * (FP_MULTIPLIER - x_diff) * (FP_MULTIPLIER - y_diff) +
-                                              (b.r) * (x_diff) * (FP_MULTIPLIER - y_diff) +
-                                              (c.r) * (y_diff) * (FP_MULTIPLIER - x_diff) +
-                                              (d.r) * (x_diff * y_diff
-                                            )) / (FP_MULTIPLIER * FP_MULTIPLIER)
-                                          );
-
-        // alpha element
-        NewImage->PixelData[Offset++].a = (UINT8)(
-                                            (
-                                              (a.a) * (FP_MULTIPLIER - x_diff) * (FP_MULTIPLIER - y_diff) +
-                                              (b.a) * (x_diff) * (FP_MULTIPLIER - y_diff) +
-                                              (c.a) * (y_diff) * (FP_MULTIPLIER - x_diff) +
-                                              (d.a) * (x_diff * y_diff
-                                            )) / (FP_MULTIPLIER * FP_MULTIPLIER)
-                                          );
-     }
-  }
-
   return NewImage;
 }
 
@@ -302,6 +483,12 @@ FreeImage (
   IN EG_IMAGE   *Image
 ) {
   if (Image != NULL) {
+    // still shared, e.g. with the theme image cache
+    if (Image->RefCount > 1) {
+      Image->RefCount--;
+      return;
+    }
+
     if (Image->PixelData != NULL) {
       FreePool (Image->PixelData);
       Image->PixelData = NULL; //FreePool will not zero pointer
@@ -347,6 +534,123 @@ LoadImage (
   return NewImage;
 }
 
+//
+// Theme image cache
+//
+// Theme assets are decoded on first use and kept while the theme is loaded. They
+// are keyed by theme-relative path and size, where 0 x 0 is the size of the file.
+// Missing files are cached too, so icon name fallbacks do not go back to the disk.
+// Every caller gets its own reference to drop with FreeImage. Cached images are
+// shared, so never draw into them.
+//
+
+typedef struct THEME_IMAGE THEME_IMAGE;
+
+struct THEME_IMAGE {
+  THEME_IMAGE   *Next;
+  CHAR16        *Path;
+  INTN          Width;
+  INTN          Height;
+  EG_IMAGE      *Image;   // NULL when the file is missing or not decoded
+};
+
+STATIC THEME_IMAGE  *mThemeImages = NULL;
+STATIC CHAR16       *mThemeImagesPath = NULL; // gThemePath the cache was filled from
+
+STATIC
+EG_IMAGE *
+ShareImage (
+  IN EG_IMAGE   *Image
+) {
+  if (Image != NULL) {
+    Image->RefCount++;
+  }
+
+  return Image;
+}
+
+VOID
+FreeThemeImages () {
+  THEME_IMAGE   *Entry;
+
+  while (mThemeImages != NULL) {
+    Entry = mThemeImages;
+    mThemeImages = Entry->Next;
+
+    FreeImage (Entry->Image);
+    FreePool (Entry->Path);
+    FreePool (Entry);
+  }
+
+  if (mThemeImagesPath != NULL) {
+    FreePool (mThemeImagesPath);
+    mThemeImagesPath = NULL;
+  }
+}
+
+//caller is responsible for free image
+EG_IMAGE *
+LoadThemeImage (
+  IN CHAR16   *Path,
+  IN INTN     Width,
+  IN INTN     Height
+) {
+  THEME_IMAGE   *Entry;
+  EG_IMAGE      *Image, *ScaledImage;
+
+  if ((gThemeDir == NULL) || (gThemePath == NULL) || (Path == NULL)) {
+    return NULL;
+  }
+
+  if ((mThemeImagesPath == NULL) || (StriCmp (mThemeImagesPath, gThemePath) != 0)) {
+    FreeThemeImages ();
+    mThemeImagesPath = AllocateCopyPool (StrSize (gThemePath), gThemePath);
+  }
+
+  if ((Width <= 0) || (Height <= 0)) {
+    Width = Height = 0;
+  }
+
+  for (Entry = mThemeImages; Entry != NULL; Entry = Entry->Next) {
+    if ((Entry->Width == Width) && (Entry->Height == Height) && (StriCmp (Entry->Path, Path) == 0)) {
+      return ShareImage (Entry->Image);
+    }
+  }
+
+  if (Width == 0) {
+    Image = LoadImage (gThemeDir, Path);
+  } else {
+    Image = LoadThemeImage (Path, 0, 0);
+
+    if ((Image != NULL) && ((Image->Width != Width) || (Image->Height != Height))) {
+      ScaledImage = ScaleImage (Image, Width, Height);
+      FreeImage (Image);
+      Image = ScaledImage;
+    }
+  }
+
+  DBG ("ThemeImage: %s %dx%d %a\n", Path, Width, Height, (Image != NULL) ? "decoded" : "missing");
+
+  Entry = AllocatePool (sizeof (THEME_IMAGE));
+  if (Entry == NULL) {
+    return Image;
+  }
+
+  Entry->Path = AllocateCopyPool (StrSize (Path), Path);
+  if (Entry->Path == NULL) {
+    FreePool (Entry);
+    return Image;
+  }
+
+  Entry->Width = Width;
+  Entry->Height = Height;
+  Entry->Image = Image;
+  Entry->Next = mThemeImages;
+  mThemeImages = Entry;
+
+  return ShareImage (Image);
+}
+
 //
 // Compositing
 //
@@ -472,6 +776,69 @@ RawCopy (
   }
 }
 
+#if defined (MDE_CPU_X64)
+//
+// SSE2 helpers for RawCompose / RawComposeOnFlat, giving exactly the results of their
+// scalar loops: every sum there fits 16 bits (at most 255 * 255), and for those
+// (Sum + 1 + (Sum >> 8)) >> 8 is Sum / 255.
+//
+
+/** Blends 2 pixels (unpacked to 16 bit lanes), without OnFlat the alpha lanes get the composed alpha. */
+STATIC
+__m128i
+RawBlendSse2 (
+  IN __m128i    Top,
+  IN __m128i    Comp,
+  IN BOOLEAN    OnFlat
+) {
+  __m128i   Max = _mm_set1_epi16 (255), Alpha, RevAlpha, Sum, AlphaSum, AlphaLanes;
+
+  Alpha = _mm_shufflehi_epi16 (_mm_shufflelo_epi16 (Top, 0xFF), 0xFF);  // top alpha in every lane of its pixel
+  RevAlpha = _mm_sub_epi16 (Max, Alpha);
+  Sum = _mm_add_epi16 (_mm_mullo_epi16 (Top, Alpha), _mm_mullo_epi16 (Comp, RevAlpha));
+
+  if (!OnFlat) {
+    // 255 * 255 - (255 - TopAlpha) * (255 - CompAlpha)
+    AlphaLanes = _mm_set_epi16 (-1, 0, 0, 0, -1, 0, 0, 0);
+    AlphaSum = _mm_sub_epi16 (_mm_set1_epi16 ((INT16)(255 * 255)), _mm_mullo_epi16 (RevAlpha, _mm_sub_epi16 (Max, Comp)));
+    Sum = _mm_or_si128 (_mm_andnot_si128 (AlphaLanes, Sum), _mm_and_si128 (AlphaLanes, AlphaSum));
+  }
+
+  return _mm_srli_epi16 (_mm_add_epi16 (_mm_add_epi16 (Sum, _mm_set1_epi16 (1)), _mm_srli_epi16 (Sum, 8)), 8);
+}
+
+/** Composes 4 pixels per step, returns the number of pixels done (the rest is left to the scalar loop). */
+STATIC
+INTN
+RawComposeLineSse2 (
+  IN OUT  EG_PIXEL   *CompPtr,
+  IN      EG_PIXEL   *TopPtr,
+  IN      INTN       Width,
+  IN      BOOLEAN    OnFlat
+) {
+  __m128i   Zero = _mm_setzero_si128 (), Top, Comp, Result;
+  INTN      x;
+
+  for (x = 0; (x + 4) <= Width; x += 4) {
+    Top = _mm_loadu_si128 ((__m128i *)(TopPtr + x));
+    Comp = _mm_loadu_si128 ((__m128i *)(CompPtr + x));
+
+    Result = _mm_packus_epi16 (
+               RawBlendSse2 (_mm_unpacklo_epi8 (Top, Zero), _mm_unpacklo_epi8 (Comp, Zero), OnFlat),
+               RawBlendSse2 (_mm_unpackhi_epi8 (Top, Zero), _mm_unpackhi_epi8 (Comp, Zero), OnFlat)
+             );
+
+    if (OnFlat) {
+      Result = _mm_or_si128 (Result, _mm_set1_epi32 ((INT32)0xFF000000));
+    }
+
+    _mm_storeu_si128 ((__m128i *)(CompPtr + x), Result);
+  }
+
+  return x;
+}
+#endif
+
 VOID
 RawCompose (
   IN OUT  EG_PIXEL   *CompBasePtr,
@@ -499,8 +866,14 @@ RawCompose (
   for (y = 0; y < Height; y++) {
     TopPtr = TopBasePtr;
     CompPtr = CompBasePtr;
+    x = 0;
 
-    for (x = 0; x < Width; x++) {
+#if defined (MDE_CPU_X64)
+    x = RawComposeLineSse2 (CompPtr, TopPtr, Width, FALSE);
+    TopPtr += x, CompPtr += x;
+#endif
+
+    for (; x < Width; x++) {
       TopAlpha = TopPtr->a & 0xFF; //exclude sign
       CompAlpha = CompPtr->a & 0xFF;
       RevAlpha = 255 - TopAlpha;
@@ -555,7 +928,14 @@ RawComposeOnFlat (
   for (y = 0; y < Height; y++) {
     TopPtr = TopBasePtr;
     CompPtr = CompBasePtr;
-    for (x = 0; x < Width; x++) {
+    x = 0;
+
+#if defined (MDE_CPU_X64)
+    x = RawComposeLineSse2 (CompPtr, TopPtr, Width, TRUE);
+    TopPtr += x, CompPtr += x;
+#endif
+
+    for (; x < Width; x++) {
       TopAlpha = TopPtr->a;
       RevAlpha = 255 - TopAlpha;
 
@@ -718,18 +1098,13 @@ DecodePNG (
   IN UINT8    *FileData,
   IN UINTN    FileDataLength
 ) {
-  EG_IMAGE    *NewImage = NULL;
-  EG_PIXEL    *PixelData, *Pixel, *PixelD;
-  UINT32      PNG_error, Width, Height;
-  INTN        i, ImageSize;
-
-  PNG_error = lodepng_decode32 (
-                (UINT8 **)&PixelData,
-                &Width,
-                &Height,
-                (CONST UINT8 *)FileData,
-                FileDataLength
-              );
+  EG_IMAGE        *NewImage = NULL;
+  LodePNGState    State;
+  UINT32          PNG_error, Width, Height;
+
+  lodepng_state_init (&State);
+  PNG_error = lodepng_inspect (&Width, &Height, &State, (CONST UINT8 *)FileData, FileDataLength);
+  lodepng_state_cleanup (&State);
 
   if (PNG_error) {
     return NULL;
@@ -745,19 +1120,21 @@ DecodePNG (
     return NULL;
   }
 
-  ImageSize = (NewImage->Height * NewImage->Width);
+  // EG_PIXEL is BGRA, decode straight into the image; 255 is opaque, 0 - transparent
+  PNG_error = lodepng_decode_bgra (
+                (UINT8 *)NewImage->PixelData,
+                Width,
+                Height,
+                (CONST UINT8 *)FileData,
+                FileDataLength,
+                FALSE
+              );
 
-  Pixel = (EG_PIXEL *)NewImage->PixelData;
-  PixelD = PixelData;
-  for (i = 0; i < ImageSize; i++, Pixel++, PixelD++) {
-    Pixel->b = PixelD->r; //change r <-> b
-    Pixel->r = PixelD->b;
-    Pixel->g = PixelD->g;
-    Pixel->a = PixelD->a; // 255 is opaque, 0 - transparent
+  if (PNG_error) {
+    FreeImage (NewImage);
+    return NULL;
   }
 
-  lodepng_free (PixelData);
-
   return NewImage;
 }
 
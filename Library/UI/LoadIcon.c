@@ -201,7 +201,9 @@ LoadIcnsFallback (
     return NULL;
   }
 
-  return LoadImage (BaseDir, FileName);
+  return ((BaseDir != NULL) && (BaseDir == gThemeDir))
+    ? LoadThemeImage (FileName, 0, 0)
+    : LoadImage (BaseDir, FileName);
 }
 
 //
@@ -242,7 +244,7 @@ InitUISelection () {
         }
 
         if (gThemeDir && (gSelectionImg[i].Path != NULL)) {
-          gSelectionImg[i].Image = LoadImage (gThemeDir, gSelectionImg[i].Path);
+          gSelectionImg[i].Image = LoadThemeImage (gSelectionImg[i].Path, 0, 0);
         }
 
         if (gSelectionImg[i].Image == NULL) {
@@ -277,33 +279,54 @@ InitUISelection () {
     }
   }
 
-  for (i = 0; i < ButtonsImgCount; ++i) {
-    if (gThemeDir && !IsEmbeddedTheme ()) {
-      gButtonsImg[i].Image = LoadImage (gThemeDir, PoolPrint (L"%s.png", gButtonsImg[i].Path));
-    }
+  //  DBG ("selections inited\n");
+}
 
-    if (!gButtonsImg[i].Image) {
-      switch (i) {
-        case kRadioImage:
-          gButtonsImg[i].Image =  DEC_PNG_BUILTIN (emb_radio_button);
-          break;
+//
+// Radio buttons and checkboxes are only needed by option menus, load them on first draw
+//
 
-        case kRadioSelectedImage:
-          gButtonsImg[i].Image =  DEC_PNG_BUILTIN (emb_radio_button_selected);
-          break;
+EG_IMAGE *
+ButtonImage (
+  IN INTN   Id
+) {
+  CHAR16  *Path;
 
-        case kCheckboxImage:
-          gButtonsImg[i].Image =  DEC_PNG_BUILTIN (emb_checkbox);
-          break;
+  if ((Id < 0) || (Id >= ButtonsImgCount)) {
+    return NULL;
+  }
 
-        case kCheckboxCheckedImage:
-          gButtonsImg[i].Image =  DEC_PNG_BUILTIN (emb_checkbox_checked);
-          break;
-      }
+  if (gButtonsImg[Id].Image != NULL) {
+    return gButtonsImg[Id].Image;
+  }
+
+  if (!IsEmbeddedTheme ()) {
+    Path = PoolPrint (L"%s.png", gButtonsImg[Id].Path);
+    gButtonsImg[Id].Image = LoadThemeImage (Path, 0, 0);
+    FreePool (Path);
+  }
+
+  if (!gButtonsImg[Id].Image) {
+    switch (Id) {
+      case kRadioImage:
+        gButtonsImg[Id].Image =  DEC_PNG_BUILTIN (emb_radio_button);
+        break;
+
+      case kRadioSelectedImage:
+        gButtonsImg[Id].Image =  DEC_PNG_BUILTIN (emb_radio_button_selected);
+        break;
+
+      case kCheckboxImage:
+        gButtonsImg[Id].Image =  DEC_PNG_BUILTIN (emb_checkbox);
+        break;
+
+      case kCheckboxCheckedImage:
+        gButtonsImg[Id].Image =  DEC_PNG_BUILTIN (emb_checkbox_checked);
+        break;
     }
   }
 
-  //  DBG ("selections inited\n");
+  return gButtonsImg[Id].Image;
 }
 
 VOID
@@ -367,11 +390,14 @@ FreeAnims () {
 
 VOID
 InitUIBar () {
-  INTN    i;
+  INTN      i;
+  CHAR16    *Path;
 
   for (i = 0; i < ScrollbarImgCount; ++i) {
     if (gThemeDir && !ScrollbarImg[i].Image) {
-      ScrollbarImg[i].Image = LoadImage (gThemeDir, PoolPrint (L"%s.png", ScrollbarImg[i].Path));
+      Path = PoolPrint (L"%s.png", ScrollbarImg[i].Path);
+      ScrollbarImg[i].Image = LoadThemeImage (Path, 0, 0);
+      FreePool (Path);
     }
 
     if (!ScrollbarImg[i].Image) {
@@ -414,8 +440,6 @@ InitUIBar () {
 
 VOID
 InitBar () {
-  InitUIBar ();
-
   UpButton.Width       = gDownButton.Width = GlobalConfig.ScrollButtonWidth;
   UpButton.Height      = gDownButton.Height = GlobalConfig.ScrollButtonHeight;
   BarStart.Height      = BarEnd.Height = GlobalConfig.ScrollBarDecorationsHeight;
@@ -480,6 +504,9 @@ ScrollingBar (
 
   ScrollEnabled = (State->MaxFirstVisible != 0);
   if (ScrollEnabled) {
+    // bar images are loaded the first time a menu needs to scroll
+    InitUIBar ();
+
     Total = CreateFilledImage (ScrollTotal.Width, ScrollTotal.Height, TRUE, &gTransparentBackgroundPixel);
     for (i = 0; i < gScrollbarBackground.Height; i++) {
       ComposeImage (
@@ -562,12 +589,16 @@ EG_IMAGE *
 GetSmallHover (
   IN UINTN    Id
 ) {
-  EG_IMAGE  *Image;
+  EG_IMAGE  *Image, *ScaledImage;
+  CHAR16    *Path;
   BOOLEAN   NeedScaling = (GlobalConfig.IconScale != DefaultConfig.IconScale);
 
-  Image = IsEmbeddedTheme ()
-            ? NULL
-            : LoadImage (gThemeDir, PoolPrint (L"%s_hover.png", gBuiltinIconTable[Id].Path));
+  if (IsEmbeddedTheme ()) {
+    return NULL;
+  }
+
+  Path = PoolPrint (L"%s_hover.png", gBuiltinIconTable[Id].Path);
+  Image = LoadThemeImage (Path, 0, 0);
 
   if (
     (Image != NULL) &&
@@ -579,17 +610,16 @@ GetSmallHover (
       )
     )
   ) {
-    EG_IMAGE  *NewImage = CopyImage (Image);
+    ScaledImage = NeedScaling
+                    ? CopyScaledImage (Image, GlobalConfig.IconScale)
+                    : LoadThemeImage (Path, TOOL_DIMENSION, TOOL_DIMENSION);
 
     FreeImage (Image);
-
-    Image = NeedScaling
-              ? CopyScaledImage (NewImage, GlobalConfig.IconScale)
-              : ScaleImage (NewImage, TOOL_DIMENSION, TOOL_DIMENSION);
-
-    FreeImage (NewImage);
+    Image = ScaledImage;
   }
 
+  FreePool (Path);
+
   return Image;
 }
 
@@ -655,15 +685,13 @@ BuiltinIcon (
     }
 
     if (ScaleTo > 0) {
-      EG_IMAGE  *NewImage = CopyImage (gBuiltinIconTable[Id].Image);
-
-      FreeImage (gBuiltinIconTable[Id].Image);
+      EG_IMAGE  *Image = gBuiltinIconTable[Id].Image;
 
       gBuiltinIconTable[Id].Image = NeedScaling
-                                      ? CopyScaledImage (NewImage, GlobalConfig.IconScale)
-                                      : ScaleImage (NewImage, ScaleTo, ScaleTo);
+                                      ? CopyScaledImage (Image, GlobalConfig.IconScale)
+                                      : ScaleImage (Image, ScaleTo, ScaleTo);
 
-      FreeImage (NewImage);
+      FreeImage (Image);
     }
 
     if (gBuiltinIconTable[Id].Image != NULL) {
@@ -869,7 +897,10 @@ LoadOSIcon (
   CHAR16      CutoutName[16], TmpName[64], FileName[AVALUE_MAX_SIZE];
   UINTN       StartIndex, Index, NextIndex;
 
-  *OSIconNameHover = NULL;
+  // Android and Linux scans pass no hover name
+  if (OSIconNameHover != NULL) {
+    *OSIconNameHover = NULL;
+  }
 
   if (gSettings.TextOnly || IsEmbeddedTheme ()) {
     return NULL;
@@ -903,10 +934,13 @@ LoadOSIcon (
     UnicodeSPrint (FileName, ARRAY_SIZE (FileName), L"icons\\%s.png", TmpName);
 
     // try to load it
-    Image = LoadImage (gThemeDir, FileName);
+    Image = LoadThemeImage (FileName, 0, 0);
     if (Image != NULL) {
-      *OSIconNameHover = AllocateZeroPool (64);
-      UnicodeSPrint (*OSIconNameHover, 64, L"%s_hover", TmpName);
+      if (OSIconNameHover != NULL) {
+        *OSIconNameHover = AllocateZeroPool (64);
+        UnicodeSPrint (*OSIconNameHover, 64, L"%s_hover", TmpName);
+      }
+
       return Image;
     }
   }
@@ -915,11 +949,14 @@ LoadOSIcon (
   StrCpyS (TmpName, ARRAY_SIZE (TmpName), L"os_unknown");
   UnicodeSPrint (FileName, ARRAY_SIZE (FileName), L"icons\\%s.png", TmpName);
 
-  Image = LoadImage (gThemeDir, FileName);
+  Image = LoadThemeImage (FileName, 0, 0);
 
   if (Image != NULL) {
-    *OSIconNameHover = AllocateZeroPool (64);
-    UnicodeSPrint (*OSIconNameHover, 64, L"%s_hover", TmpName);
+    if (OSIconNameHover != NULL) {
+      *OSIconNameHover = AllocateZeroPool (64);
+      UnicodeSPrint (*OSIconNameHover, 64, L"%s_hover", TmpName);
+    }
+
     return Image;
   }
 
@@ -932,7 +969,7 @@ LoadHoverIcon (
 ) {
   return (gSettings.TextOnly || IsEmbeddedTheme ())
     ? NULL
-    : LoadImage (gThemeDir, OSIconName);
+    : LoadThemeImage (OSIconName, 0, 0);
 }
 
 CHAR16 *
@@ -2478,7 +2478,7 @@ GraphicsMenuStyle (
                 EntriesPosX,
                 Entry->Place.YPos,
                 0xFFFF,
-                gButtonsImg[((REFIT_INPUT_DIALOG *)(Entry))->Item->BValue ? kCheckboxCheckedImage : kCheckboxImage].Image
+                ButtonImage (((REFIT_INPUT_DIALOG *)(Entry))->Item->BValue ? kCheckboxCheckedImage : kCheckboxImage)
               );
             } else { //text input
               StrCatS (ResultString, SVALUE_MAX_SIZE, PoolPrint (L": %s ", ((REFIT_INPUT_DIALOG *)(Entry))->Item->SValue));
@@ -2525,7 +2525,7 @@ GraphicsMenuStyle (
               EntriesPosX,
               Entry->Place.YPos,
               0xFFFF,
-              gButtonsImg[(Entry->Row == iSwitch) ? kRadioSelectedImage : kRadioImage].Image
+              ButtonImage ((Entry->Row == iSwitch) ? kRadioSelectedImage : kRadioImage)
             );
             break;
 
@@ -2536,7 +2536,7 @@ GraphicsMenuStyle (
               EntriesPosX,
               Entry->Place.YPos,
               0xFFFF,
-              gButtonsImg[BIT_ISSET (((REFIT_INPUT_DIALOG *)(Entry))->Item->IValue, Entry->Row) ? kCheckboxCheckedImage : kCheckboxImage].Image
+              ButtonImage (BIT_ISSET (((REFIT_INPUT_DIALOG *)(Entry))->Item->IValue, Entry->Row) ? kCheckboxCheckedImage : kCheckboxImage)
             );
             break;
 
@@ -2584,7 +2584,7 @@ GraphicsMenuStyle (
               EntriesPosX,
               EntriesPosY + (State->LastSelection - State->FirstVisible) * gTextHeight,
               0xFFFF,
-              gButtonsImg[((REFIT_INPUT_DIALOG *)EntryL)->Item->BValue ? kCheckboxCheckedImage : kCheckboxImage].Image
+              ButtonImage (((REFIT_INPUT_DIALOG *)EntryL)->Item->BValue ? kCheckboxCheckedImage : kCheckboxImage)
             );
           } else {
             StrCatS (ResultString, SVALUE_MAX_SIZE, PoolPrint (L": %s ", ((REFIT_INPUT_DIALOG *)(EntryL))->Item->SValue));
@@ -2629,7 +2629,7 @@ GraphicsMenuStyle (
             EntriesPosX,
             EntriesPosY + (State->LastSelection - State->FirstVisible) * gTextHeight,
             0xFFFF,
-            gButtonsImg[(EntryL->Row == iSwitch) ? kRadioSelectedImage : kRadioImage].Image
+            ButtonImage ((EntryL->Row == iSwitch) ? kRadioSelectedImage : kRadioImage)
           );
           break;
 
@@ -2640,7 +2640,7 @@ GraphicsMenuStyle (
             EntriesPosX,
             EntryL->Place.YPos,
             0xFFFF,
-            gButtonsImg[BIT_ISSET (((REFIT_INPUT_DIALOG *)EntryL)->Item->IValue, EntryL->Row) ? kCheckboxCheckedImage : kCheckboxImage].Image
+            ButtonImage (BIT_ISSET (((REFIT_INPUT_DIALOG *)EntryL)->Item->IValue, EntryL->Row) ? kCheckboxCheckedImage : kCheckboxImage)
           );
           break;
 
@@ -2677,7 +2677,7 @@ GraphicsMenuStyle (
               EntriesPosX,
               EntriesPosY + (State->CurrentSelection - State->FirstVisible) * gTextHeight,
               0xFFFF,
-              gButtonsImg[((REFIT_INPUT_DIALOG *)EntryC)->Item->BValue ? kCheckboxCheckedImage : kCheckboxImage].Image
+              ButtonImage (((REFIT_INPUT_DIALOG *)EntryC)->Item->BValue ? kCheckboxCheckedImage : kCheckboxImage)
             );
           } else {
             StrCatS (ResultString, SVALUE_MAX_SIZE, PoolPrint (L": %s ", ((REFIT_INPUT_DIALOG *)(EntryC))->Item->SValue));
@@ -2717,7 +2717,7 @@ GraphicsMenuStyle (
             EntriesPosX,
             EntriesPosY + (State->CurrentSelection - State->FirstVisible) * gTextHeight,
             0xFFFF,
-            gButtonsImg[(EntryC->Row == iSwitch) ? kRadioSelectedImage : kRadioImage].Image
+            ButtonImage ((EntryC->Row == iSwitch) ? kRadioSelectedImage : kRadioImage)
           );
           break;
 
@@ -2728,7 +2728,7 @@ GraphicsMenuStyle (
             EntriesPosX,
             EntryC->Place.YPos,
             0xFFFF,
-            gButtonsImg[BIT_ISSET (((REFIT_INPUT_DIALOG *)EntryC)->Item->IValue, EntryC->Row) ? kCheckboxCheckedImage : kCheckboxImage].Image
+            ButtonImage (BIT_ISSET (((REFIT_INPUT_DIALOG *)EntryC)->Item->IValue, EntryC->Row) ? kCheckboxCheckedImage : kCheckboxImage)
             );
           break;
 
@@ -2770,7 +2770,8 @@ DrawMainMenuEntry (
   INTN                XPos,
   INTN                YPos
 ) {
-  INTN  Scale = GlobalConfig.MainEntriesSize >> 3;
+  INTN      Scale = GlobalConfig.MainEntriesSize >> 3;
+  EG_IMAGE  *FallbackImage = NULL;
 
   MainImage = (
                 (Entry->Tag == TAG_LOADER) &&
@@ -2781,10 +2782,11 @@ DrawMainMenuEntry (
                 : Entry->Image;
 
   if (!MainImage) {
-    MainImage = LoadImage (gThemeDir, L"icons\\os_mac.png");
+    // shared with the theme image cache, decoded once rather than on every draw
+    MainImage = FallbackImage = LoadThemeImage (L"icons\\os_mac.png", 0, 0);
 
     if (!MainImage) {
-      MainImage = DummyImage (Scale << 3);
+      MainImage = FallbackImage = DummyImage (Scale << 3);
     }
   }
 
@@ -2815,6 +2817,11 @@ DrawMainMenuEntry (
   Entry->Place.YPos = YPos;
   Entry->Place.Width = MainImage->Width;
   Entry->Place.Height = MainImage->Height;
+
+  if (FallbackImage != NULL) {
+    FreeImage (FallbackImage);
+    MainImage = NULL;
+  }
 }
 
 STATIC
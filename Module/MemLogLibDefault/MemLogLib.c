@@ -8,6 +8,7 @@
 #include <Library/BaseMemoryLib.h>
 #include <Library/MemoryAllocationLib.h>
 #include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiRuntimeServicesTableLib.h>
 #include <Library/DebugLib.h>
 
 #include <Library/IoLib.h>
@@ -33,6 +34,17 @@ typedef struct {
   UINT64            TscFreqSec;
 } MEM_LOG;
 
+//
+// TSC frequency saved in NVRAM (MEM_LOG_TSC_VARIABLE), valid for the same CPU only.
+//
+typedef struct {
+  UINT32            CpuVendor;    // CPUID 0 EBX
+  UINT32            CpuSignature; // CPUID 1 EAX
+  UINT64            TscFreqSec;
+} MEM_LOG_TSC_CACHE;
+
+#define CPU_VENDOR_GENUINE_INTEL    0x756E6547  // "Genu"
+
 //
 // Pointer to mem log buffer.
 //
@@ -43,6 +55,11 @@ MEM_LOG   *mMemLog = NULL;
 //
 CHAR8     mTimingTxt[32];
 
+//
+// Where TSC frequency came from, for the log.
+//
+STATIC CONST CHAR8  *mTscSource = NULL;
+
 /**
   Inits mem log.
 
@@ -73,52 +90,128 @@ GetTiming () {
 }
 
 /**
-  Inits mem log.
+  Checks Freq against a rough 2ms measurement, within 1/8. CPUID and saved values
+  are nominal, so this catches an overclocked BCLK or a changed TSC ratio.
 
-  @retval EFI_SUCCESS   The constructor always returns EFI_SUCCESS.
+**/
+STATIC
+BOOLEAN
+IsTscFrequencyPlausible (
+  IN UINT64   Freq
+) {
+  UINT64    Tsc0, Tsc1, Rough;
+
+  Tsc0 = AsmReadTsc ();
+  gBS->Stall (2000); // 2ms
+  Tsc1 = AsmReadTsc ();
+  Rough = MultU64x32 ((Tsc1 - Tsc0), 500);
+
+  return (Rough >= Freq - RShiftU64 (Freq, 3)) && (Rough <= Freq + RShiftU64 (Freq, 3));
+}
+
+/**
+  Gets TSC frequency from CPUID Time Stamp Counter leaf (0x15) or, failing that,
+  from Processor Frequency leaf (0x16). Intel only, returns 0 when not enumerated.
 
 **/
-EFI_STATUS
-EFIAPI
-MemLogInit () {
-  EFI_STATUS      Status;
-  UINT32          TimerAddr = 0, AcpiTick0, AcpiTick1, AcpiTicksDelta, AcpiTicksTarget;
-  UINT64          Tsc0, Tsc1;
-  CHAR8           InitError[50];
+STATIC
+UINT64
+GetTscFrequencyFromCpuid () {
+  UINT32    MaxLeaf, Vendor, Signature, Model, Denom, Num, Crystal, BaseMhz;
 
-  if (mMemLog != NULL) {
-    return  EFI_SUCCESS;
+  AsmCpuid (0, &MaxLeaf, &Vendor, NULL, NULL);
+  if ((Vendor != CPU_VENDOR_GENUINE_INTEL) || (MaxLeaf < 0x15)) {
+    return 0;
   }
 
-  //
-  // Try to use existing MEM_LOG
-  //
-  Status = gBS->LocateProtocol (&gMsgLogProtocolGuid, NULL, (VOID **)&mMemLog);
-  if ((Status == EFI_SUCCESS) && (mMemLog != NULL)) {
-    //
-    // We are inited with existing MEM_LOG
-    //
-    return EFI_SUCCESS;
+  AsmCpuid (1, &Signature, NULL, NULL, NULL);
+  Model = ((Signature >> 4) & 0x0F) | ((Signature >> 12) & 0xF0);
+
+  AsmCpuid (0x15, &Denom, &Num, &Crystal, NULL);
+  if ((Denom == 0) || (Num == 0)) {
+    return 0;
   }
 
-  //
-  // Set up and publish new MEM_LOG
-  //
-  mMemLog = AllocateZeroPool (sizeof (MEM_LOG));
+  if ((Crystal == 0) && (((Signature >> 8) & 0x0F) == 0x06)) {
+    // Crystal clock is not enumerated on SkyLake / KabyLake and Atoms, see SDM "Time-Stamp Counter"
+    switch (Model) {
+      case 0x4E: // SkyLake
+      case 0x5E:
+      case 0x8E: // KabyLake / CoffeeLake
+      case 0x9E:
+        Crystal = 24000000;
+        break;
+
+      case 0x5C: // Goldmont
+        Crystal = 19200000;
+        break;
+
+      case 0x5F: // Denverton
+        Crystal = 25000000;
+        break;
+
+      default:
+        break;
+    }
+  }
 
-  if (mMemLog == NULL) {
-    return EFI_OUT_OF_RESOURCES;
+  if (Crystal != 0) {
+    return DivU64x32 (MultU64x32 (Crystal, Num), Denom);
   }
 
-  mMemLog->BufferSize = MEM_LOG_INITIAL_SIZE;
-  mMemLog->Buffer = AllocateZeroPool (MEM_LOG_INITIAL_SIZE);
-  mMemLog->Cursor = mMemLog->Buffer;
-  mMemLog->Callback = NULL;
+  if (MaxLeaf >= 0x16) {
+    AsmCpuid (0x16, &BaseMhz, NULL, NULL, NULL);
+    if (BaseMhz != 0) {
+      return MultU64x32 (BaseMhz, 1000000);
+    }
+  }
 
-  //
-  // Calibrate TSC for timings
-  //
-  InitError[0]='\0';
+  return 0;
+}
+
+/**
+  Fills Id with the current CPU and returns TSC frequency saved in NVRAM for it, or 0.
+
+**/
+STATIC
+UINT64
+GetTscFrequencyFromCache (
+  OUT MEM_LOG_TSC_CACHE   *Id
+) {
+  EFI_STATUS          Status;
+  MEM_LOG_TSC_CACHE   Cache;
+  UINTN               Size = sizeof (Cache);
+
+  AsmCpuid (0, NULL, &Id->CpuVendor, NULL, NULL);
+  AsmCpuid (1, &Id->CpuSignature, NULL, NULL, NULL);
+  Id->TscFreqSec = 0;
+
+  Status = gRT->GetVariable (MEM_LOG_TSC_VARIABLE, &gEfiAppleBootGuid, NULL, &Size, &Cache);
+  if (
+    EFI_ERROR (Status) ||
+    (Size != sizeof (Cache)) ||
+    (Cache.CpuVendor != Id->CpuVendor) ||
+    (Cache.CpuSignature != Id->CpuSignature) ||
+    (Cache.TscFreqSec == 0)
+  ) {
+    return 0;
+  }
+
+  return Cache.TscFreqSec;
+}
+
+/**
+  Calibrates TSC frequency, takes about 100ms.
+
+**/
+STATIC
+UINT64
+CalibrateTscFrequency (
+  OUT CHAR8   *InitError,
+  IN  UINTN   InitErrorSize
+) {
+  UINT32          TimerAddr = 0, AcpiTick0, AcpiTick1, AcpiTicksDelta, AcpiTicksTarget;
+  UINT64          Tsc0, Tsc1;
 
   // We will try to calibrate TSC frequency according to the ACPI Power Management Timer.
   // The ACPI PM Timer is running at a universal known frequency of 3579545Hz.
@@ -127,15 +220,15 @@ MemLogInit () {
 
   // Check if we can use the timer - we need to be on Intel ICH, get ACPI PM Timer Address from PCI, and check that it's sane
   if ((PciRead16 (PCI_ICH_LPC_ADDRESS (0))) != 0x8086) { // Intel ICH device was not found
-    AsciiSPrint (InitError, sizeof (InitError), "Intel ICH device was not found.");
+    AsciiSPrint (InitError, InitErrorSize, "Intel ICH device was not found.");
   } else if ((PciRead8 (PCI_ICH_LPC_ADDRESS (R_ICH_LPC_ACPI_CNT)) & B_ICH_LPC_ACPI_CNT_ACPI_EN) == 0) { // Check for TSC at LPC (default location)
     /*if ((PciRead8 (PCI_ICH_SMBUS_ADDRESS (R_ICH_SMBUS_ACPI_CNT)) & B_ICH_SMBUS_ACPI_CNT_ACPI_EN) != 0) { // Check for TSC at SMBUS (Skylake specific)
       TimerAddr = (PciRead16 (PCI_ICH_SMBUS_ADDRESS (R_ICH_SMBUS_ACPI_BASE)) & B_ICH_SMBUS_ACPI_BASE_BAR) + R_ACPI_PM1_TMR;
     } else { */
-      AsciiSPrint (InitError, sizeof (InitError), "ACPI I/O space is not enabled.");
+      AsciiSPrint (InitError, InitErrorSize, "ACPI I/O space is not enabled.");
    // }
   } else if ((TimerAddr = ((PciRead16 (PCI_ICH_LPC_ADDRESS (R_ICH_LPC_ACPI_BASE))) & B_ICH_LPC_ACPI_BASE_BAR) + R_ACPI_PM1_TMR) == 0) { // Timer address can't be obtained
-    AsciiSPrint (InitError, sizeof (InitError), "Timer address can't be obtained.");
+    AsciiSPrint (InitError, InitErrorSize, "Timer address can't be obtained.");
   } else {
     // Check that Timer is advancing
     AcpiTick0 = IoRead32 (TimerAddr);
@@ -144,7 +237,7 @@ MemLogInit () {
 
     if (AcpiTick0 == AcpiTick1) { // Timer is not advancing
       TimerAddr = 0; // Flag it as not working
-      AsciiSPrint (InitError, sizeof (InitError), "Timer is not advancing.");
+      AsciiSPrint (InitError, InitErrorSize, "Timer is not advancing.");
     }
   }
 
@@ -175,17 +268,95 @@ MemLogInit () {
     } while (AcpiTicksDelta < AcpiTicksTarget); // keep checking Acpi ticks until target is reached
 
     Tsc1 = AsmReadTsc (); // we're done, get another TSC
-    mMemLog->TscFreqSec = DivU64x32 (MultU64x32 ((Tsc1 - Tsc0), V_ACPI_TMR_FREQUENCY), AcpiTicksDelta);
+    return DivU64x32 (MultU64x32 ((Tsc1 - Tsc0), V_ACPI_TMR_FREQUENCY), AcpiTicksDelta);
   } else {
     // ACPI PM Timer is not working, fallback to old method
     Tsc0 = AsmReadTsc ();
     gBS->Stall (100000); // 100ms
     Tsc1 = AsmReadTsc ();
-    mMemLog->TscFreqSec = MultU64x32 ((Tsc1 - Tsc0), 10);
+    return MultU64x32 ((Tsc1 - Tsc0), 10);
+  }
+}
+
+/**
+  Inits mem log.
+
+  @retval EFI_SUCCESS   The constructor always returns EFI_SUCCESS.
+
+**/
+EFI_STATUS
+EFIAPI
+MemLogInit () {
+  EFI_STATUS          Status;
+  MEM_LOG_TSC_CACHE   Cache;
+  CHAR8               InitError[50];
+
+  if (mMemLog != NULL) {
+    return  EFI_SUCCESS;
+  }
+
+  //
+  // Try to use existing MEM_LOG
+  //
+  Status = gBS->LocateProtocol (&gMsgLogProtocolGuid, NULL, (VOID **)&mMemLog);
+  if ((Status == EFI_SUCCESS) && (mMemLog != NULL)) {
+    //
+    // We are inited with existing MEM_LOG
+    //
+    return EFI_SUCCESS;
+  }
+
+  //
+  // Set up and publish new MEM_LOG
+  //
+  mMemLog = AllocateZeroPool (sizeof (MEM_LOG));
+
+  if (mMemLog == NULL) {
+    return EFI_OUT_OF_RESOURCES;
   }
 
-  mMemLog->TscStart = Tsc0;
-  mMemLog->TscLast = Tsc0;
+  mMemLog->BufferSize = MEM_LOG_INITIAL_SIZE;
+  mMemLog->Buffer = AllocateZeroPool (MEM_LOG_INITIAL_SIZE);
+  mMemLog->Cursor = mMemLog->Buffer;
+  mMemLog->Callback = NULL;
+  mMemLog->TscStart = AsmReadTsc ();
+  mMemLog->TscLast = mMemLog->TscStart;
+
+  //
+  // Get TSC frequency for timings, this value is also used later to calculate FSBFrequency.
+  // Calibration is the last resort, and its result is saved for next boots.
+  //
+  InitError[0]='\0';
+
+  mTscSource = "CPUID";
+  mMemLog->TscFreqSec = GetTscFrequencyFromCpuid ();
+
+  if ((mMemLog->TscFreqSec != 0) && !IsTscFrequencyPlausible (mMemLog->TscFreqSec)) {
+    mMemLog->TscFreqSec = 0;
+  }
+
+  if (mMemLog->TscFreqSec == 0) {
+    mTscSource = "NVRAM";
+    mMemLog->TscFreqSec = GetTscFrequencyFromCache (&Cache);
+
+    if ((mMemLog->TscFreqSec != 0) && !IsTscFrequencyPlausible (mMemLog->TscFreqSec)) {
+      mMemLog->TscFreqSec = 0;
+    }
+  }
+
+  if (mMemLog->TscFreqSec == 0) {
+    mTscSource = "calibration";
+    mMemLog->TscFreqSec = CalibrateTscFrequency (InitError, sizeof (InitError));
+
+    Cache.TscFreqSec = mMemLog->TscFreqSec;
+    gRT->SetVariable (
+           MEM_LOG_TSC_VARIABLE,
+           &gEfiAppleBootGuid,
+           EFI_VARIABLE_BOOTSERVICE_ACCESS | EFI_VARIABLE_RUNTIME_ACCESS | EFI_VARIABLE_NON_VOLATILE,
+           sizeof (Cache),
+           &Cache
+         );
+  }
 
   //
   // Install (publish) MEM_LOG
@@ -198,7 +369,7 @@ MemLogInit () {
                  );
 
 #if DEBUG_MEMLOG >= 0
-  MemLog (TRUE, DEBUG_MEMLOG, "MemLog inited, TSC freq: %ld\n", mMemLog->TscFreqSec);
+  MemLog (TRUE, DEBUG_MEMLOG, "MemLog inited, TSC freq: %ld (%a)\n", mMemLog->TscFreqSec, mTscSource);
 
   if (InitError[0] != '\0') {
     MemLog (TRUE, DEBUG_MEMLOG, "MemLog was calibrated without ACPI PM Timer: %a\n", InitError);
@@ -57,17 +57,46 @@
 #define DUMP_PLIST 1
 
 #define kTagsPerBlock (0x1000)
+#define kSymbolsTableMinSize (0x400)
+
+// dicts / arrays smaller than this are just walked
+#define kTagIndexMinSize (8)
+
+#define kArenaBlockSize (0x10000)
+
+#define kBinaryPlistMagic         "bplist00"
+#define kBinaryPlistHeaderSize    (8)
+#define kBinaryPlistTrailerSize   (32)
+#define kBinaryPlistMaxDepth      (64)
+#define kBinaryPlistMaxNodes      (0x40000)  // tags built for one document, shared objects count every time
+
+typedef struct {
+  UINTN     Count;    // dict: slots (power of 2), array: elements
+  UINT32    *Hashes;  // dict only
+  TagPtr    *Items;   // dict: key tags by hash, array: elements in list order
+} TAG_INDEX;
+
+struct PLIST_ARENA_BLOCK {
+  PLIST_ARENA_BLOCK   *Next;
+  UINTN               Size;
+  UINTN               Used;
+};
 
 INT32       ParseTagList (CHAR8 *Buffer, TagPtr *Tag, INT32 Type, INT32 Empty);
 INT32       ParseNextTag (CHAR8 *Buffer, TagPtr *Tag);
+TAG_INDEX   *GetTagIndex (TagPtr Tag);
 
 //INT32       dbgCount = 0;
-SymbolPtr   gSymbolsHead;
+SymbolPtr   *gSymbolsTable = NULL;
+UINTN       gSymbolsTableSize = 0, gSymbolsCount = 0;
 TagPtr      gTagsFree;
 CHAR8       *BufferStart = NULL;
 
 sREF        *gRefString = NULL, *gRefInteger = NULL;
 
+// document being parsed by ParseXMLDocument (), everything goes to its arena
+PLIST_DOCUMENT  *gDocument = NULL;
+
 // intended to look for two versions of the tag; now just for sizeof
 #define MATCHTAG(ParsedTag, KeyTag) (!AsciiStrnCmp (ParsedTag, KeyTag, AsciiStrLen (KeyTag)))
 
@@ -182,6 +211,72 @@ GetPropInt (
   return (INTN)AsciiStrDecimalToUintn (Prop);
 }
 
+//
+//  Allocation
+//
+
+VOID *
+ArenaAllocate (
+  UINTN   Size
+) {
+  PLIST_ARENA_BLOCK   *Block = gDocument->Blocks, *NewBlock;
+  UINT8               *Ptr;
+
+  Size = ALIGN_VALUE (Size, sizeof (UINT64));
+
+  if ((Block == NULL) || ((Block->Used + Size) > Block->Size)) {
+    UINTN   BlockSize = MAX (kArenaBlockSize, Size);
+
+    NewBlock = AllocateZeroPool (sizeof (PLIST_ARENA_BLOCK) + BlockSize);
+    if (NewBlock == NULL) {
+      return NULL;
+    }
+
+    NewBlock->Size = BlockSize;
+
+    if ((Block != NULL) && (Size > (kArenaBlockSize / 4))) {
+      // big one gets its own block, keep filling the current one
+      NewBlock->Used = Size;
+      NewBlock->Next = Block->Next;
+      Block->Next = NewBlock;
+
+      return (UINT8 *)(NewBlock + 1);
+    }
+
+    NewBlock->Next = Block;
+    gDocument->Blocks = Block = NewBlock;
+  }
+
+  Ptr = (UINT8 *)(Block + 1) + Block->Used;
+  Block->Used += Size;
+
+  return Ptr;
+}
+
+//
+// Zeroed buffer, owned by the document being parsed (if any).
+//
+VOID *
+PlistAllocateZero (
+  UINTN   Size
+) {
+  return (gDocument != NULL) ? ArenaAllocate (Size) : AllocateZeroPool (Size);
+}
+
+VOID *
+PlistAllocateCopy (
+  UINTN   Size,
+  VOID    *Buffer
+) {
+  VOID  *Copy = PlistAllocateZero (Size);
+
+  if (Copy != NULL) {
+    CopyMem (Copy, Buffer, Size);
+  }
+
+  return Copy;
+}
+
 //
 //  Attributes
 //
@@ -199,7 +294,7 @@ GetAttr (
     CHAR8   *Prop;
 
     Str += AsciiStrLen (Needle) + 1;
-    Prop = AllocateZeroPool (AsciiStrSize (Str));
+    Prop = PlistAllocateZero (AsciiStrSize (Str));
 
     while (Str[i] != '"') {
       Prop[i] = Str[i];
@@ -218,12 +313,19 @@ GetAttrID (
   CHAR8   *Attr
 ) {
   CHAR8   *AttrVal = GetAttr (Str, Attr);
+  INT32   Id;
 
   if (AttrVal == NULL) {
     return -1;
   }
 
-  return (INT32)GetPropInt (AttrVal);
+  Id = (INT32)GetPropInt (AttrVal);
+
+  if (gDocument == NULL) {
+    FreePool (AttrVal);
+  }
+
+  return Id;
 }
 
 //
@@ -240,7 +342,7 @@ SaveRefString (
 
   while (Tmp) {
     if (Tmp->id == Id) {
-      Tmp->string = AllocateCopyPool (AsciiStrSize (Val), Val);
+      Tmp->string = PlistAllocateCopy (AsciiStrSize (Val), Val);
       Tmp->size = Size;
       return;
     }
@@ -248,8 +350,8 @@ SaveRefString (
     Tmp = Tmp->next;
   }
 
-  NewRef = AllocatePool (sizeof (sREF));
-  NewRef->string = AllocateCopyPool (AsciiStrSize (Val), Val);
+  NewRef = PlistAllocateZero (sizeof (sREF));
+  NewRef->string = PlistAllocateCopy (AsciiStrSize (Val), Val);
   NewRef->size = Size;
   NewRef->id = Id;
   NewRef->next = gRefString;
@@ -268,7 +370,7 @@ SaveRefInteger (
 
   while (Tmp) {
     if (Tmp->id == Id) {
-      Tmp->string = AllocateCopyPool (AsciiStrSize (Val), Val);
+      Tmp->string = PlistAllocateCopy (AsciiStrSize (Val), Val);
       Tmp->integer = DecVal;
       Tmp->size = Size;
       return;
@@ -277,8 +379,8 @@ SaveRefInteger (
     Tmp = Tmp->next;
   }
 
-  NewRef = AllocatePool (sizeof (sREF));
-  NewRef->string = AllocateCopyPool (AsciiStrSize (Val), Val);
+  NewRef = PlistAllocateZero (sizeof (sREF));
+  NewRef->string = PlistAllocateCopy (AsciiStrSize (Val), Val);
   NewRef->integer = DecVal;
   NewRef->size = Size;
   NewRef->id = Id;
@@ -340,24 +442,71 @@ GetRefInteger (
 //  Symbol
 //
 
+UINT32
+SymbolHash (
+  CHAR8   *String
+) {
+  UINT32  Hash = 2166136261U;
+
+  while (*String) {
+    Hash = (Hash ^ (UINT8)*String++) * 16777619U;
+  }
+
+  return Hash;
+}
+
+VOID
+GrowSymbolsTable () {
+  SymbolPtr   *NewTable, Symbol, Next;
+  UINTN       i, NewSize = gSymbolsTableSize ? (gSymbolsTableSize << 1) : kSymbolsTableMinSize;
+
+  NewTable = AllocateZeroPool (NewSize * sizeof (SymbolPtr));
+  if (NewTable == NULL) {
+    // keep old table, chains just get longer
+    return;
+  }
+
+  for (i = 0; i < gSymbolsTableSize; i++) {
+    for (Symbol = gSymbolsTable[i]; Symbol != NULL; Symbol = Next) {
+      Next = Symbol->next;
+      Symbol->next = NewTable[Symbol->hash & (NewSize - 1)];
+      NewTable[Symbol->hash & (NewSize - 1)] = Symbol;
+    }
+  }
+
+  if (gSymbolsTable != NULL) {
+    FreePool (gSymbolsTable);
+  }
+
+  gSymbolsTable = NewTable;
+  gSymbolsTableSize = NewSize;
+}
+
+//
+// Returns Symbol for String (or 0), Link receives the pointer referencing it.
+//
 SymbolPtr
 FindSymbol (
   CHAR8       *String,
-  SymbolPtr   *PrevSymbol
+  UINT32      Hash,
+  SymbolPtr   **Link
 ) {
-  SymbolPtr   Symbol = gSymbolsHead, Prev = 0;
+  SymbolPtr   *Prev, Symbol;
+
+  if (gSymbolsTable == NULL) {
+    return 0;
+  }
 
-  while (Symbol != 0) {
-    if (!AsciiStrCmp (Symbol->string, String)) {
+  Prev = &gSymbolsTable[Hash & (gSymbolsTableSize - 1)];
+
+  for (Symbol = *Prev; Symbol != 0; Prev = &Symbol->next, Symbol = Symbol->next) {
+    if ((Symbol->hash == Hash) && !AsciiStrCmp (Symbol->string, String)) {
       break;
     }
-
-    Prev = Symbol;
-    Symbol = Symbol->next;
   }
 
-  if ((Symbol != 0) && (PrevSymbol != 0)) {
-    *PrevSymbol = Prev;
+  if ((Symbol != 0) && (Link != 0)) {
+    *Link = Prev;
   }
 
   return Symbol;
@@ -368,26 +517,42 @@ NewSymbol (
   CHAR8   *String
 ) {
   SymbolPtr   Symbol;
+  UINT32      Hash;
+
+  AsciiTrimSpaces (&String);
+
+  // Document strings are not shared, the arena owns them.
+  if (gDocument != NULL) {
+    return PlistAllocateCopy (AsciiStrSize (String), String);
+  }
 
-  // Look for string in the list of Symbols.
-  Symbol = FindSymbol (String, 0);
+  // Look for string in the table of Symbols.
+  Hash = SymbolHash (String);
+  Symbol = FindSymbol (String, Hash, 0);
 
   // Add the new Symbol.
   if (Symbol == 0) {
-    Symbol = AllocateZeroPool (sizeof (Symbol));
+    if (gSymbolsCount >= gSymbolsTableSize) {
+      GrowSymbolsTable ();
+      if (gSymbolsTable == NULL) {
+        return 0;
+      }
+    }
+
+    Symbol = AllocateZeroPool (sizeof (struct Symbol));
     if (Symbol == 0) {
       return 0;
     }
 
-    AsciiTrimSpaces (&String);
-
     // Set the Symbol's data.
     Symbol->refCount = 0;
+    Symbol->hash = Hash;
     Symbol->string = AllocateCopyPool (AsciiStrSize (String), String);
 
-    // Add the Symbol to the list.
-    Symbol->next = gSymbolsHead;
-    gSymbolsHead = Symbol;
+    // Add the Symbol to the table.
+    Symbol->next = gSymbolsTable[Hash & (gSymbolsTableSize - 1)];
+    gSymbolsTable[Hash & (gSymbolsTableSize - 1)] = Symbol;
+    gSymbolsCount++;
   }
 
   // Update the refCount and return the string.
@@ -400,10 +565,10 @@ VOID
 FreeSymbol (
   CHAR8   *String
 ) {
-  SymbolPtr   Symbol, Prev;
+  SymbolPtr   Symbol, *Link;
 
-  // Look for string in the list of Symbols.
-  Symbol = FindSymbol (String, &Prev);
+  // Look for string in the table of Symbols.
+  Symbol = FindSymbol (String, SymbolHash (String), &Link);
   if (Symbol == 0) {
     return;
   }
@@ -415,12 +580,9 @@ FreeSymbol (
     return;
   }
 
-  // Remove the Symbol from the list.
-  if (Prev != 0) {
-    Prev->next = Symbol->next;
-  } else {
-    gSymbolsHead = Symbol->next;
-  }
+  // Remove the Symbol from the table.
+  *Link = Symbol->next;
+  gSymbolsCount--;
 
   // Free the Symbol's memory.
   FreePool (Symbol);
@@ -508,6 +670,10 @@ NewTag () {
   INT32     Cnt;
   TagPtr    Tag;
 
+  if (gDocument != NULL) {
+    return ArenaAllocate (sizeof (TagStruct));
+  }
+
   if (gTagsFree == 0) {
     Tag = (TagPtr)AllocateZeroPool (kTagsPerBlock * sizeof (TagStruct));
     if (Tag == 0) {
@@ -542,7 +708,8 @@ EFIAPI
 FreeTag (
   TagPtr  Tag
 ) {
-  if (Tag == 0) {
+  // document tags go away with their arena
+  if ((Tag == 0) || (gDocument != NULL)) {
     return;
   }
 
@@ -554,6 +721,10 @@ FreeTag (
     FreePool (Tag->data);
   }
 
+  if (Tag->index) {
+    FreePool (Tag->index);
+  }
+
   FreeTag (Tag->tag);
   FreeTag (Tag->tagNext);
 
@@ -564,6 +735,7 @@ FreeTag (
   Tag->data = 0;
   Tag->size = 0;
   Tag->tag = 0;
+  Tag->index = 0;
   Tag->tagNext = gTagsFree;
 
   gTagsFree = Tag;
@@ -751,6 +923,17 @@ ParseTagData (
   TmpTag->tag = 0;
   TmpTag->tagNext = 0;
 
+  if ((gDocument != NULL) && (TmpTag->data != NULL)) {
+    UINT8   *Data = TmpTag->data;
+
+    TmpTag->data = PlistAllocateCopy (TmpTag->size, Data);
+    FreePool (Data);
+
+    if (TmpTag->data == NULL) {
+      return -1;
+    }
+  }
+
   *Tag = TmpTag;
 
   return Length;
@@ -1051,153 +1234,1618 @@ ParseTagList (
   TmpTag->offset = (UINT32)(BufferStart ? Buffer - BufferStart : 0);
   TmpTag->taglen = (UINT32)((Pos > Length) ? Pos - Length : 0);
 
+  // document lookup tables live in the arena too, so build them now
+  if ((gDocument != NULL) && (Size >= kTagIndexMinSize) && (GetTagIndex (TmpTag) == NULL)) {
+    return -1;
+  }
+
   *Tag = TmpTag;
 
   return Pos;
 }
 
-EFI_STATUS
-EFIAPI
-ParseXML (
-  CHAR8   *Buffer,
-  UINT32  BufSize,
-  TagPtr  *Dict
+//
+//  Binary (bplist00)
+//
+
+typedef struct {
+  CONST UINT8   *Buffer;
+  UINT64        ObjectsEnd;   // objects live in [kBinaryPlistHeaderSize, ObjectsEnd)
+  CONST UINT8   *OffsetTable;
+  UINT8         OffsetSize;
+  UINT8         RefSize;
+  UINT64        NumObjects;
+  CHAR8         *Scratch;     // zero terminated copy of the string being decoded
+  UINTN         ScratchSize;
+  UINTN         Nodes;        // objects left to visit, see kBinaryPlistMaxNodes
+} BINARY_PLIST;
+
+STATIC
+UINT64
+BinaryReadBE (
+  CONST UINT8   *Ptr,
+  UINTN         Size
 ) {
-  INT32     Length, Pos,
-            FixedBufferSize = BufSize ? BufSize : (UINT32)AsciiStrLen (Buffer);
-  TagPtr    ModuleDict;
-  CHAR8     *FixedBuffer = NULL;
+  UINT64  Value = 0;
 
-  if (Dict == NULL) {
-    return EFI_INVALID_PARAMETER;
+  while (Size-- > 0) {
+    Value = (Value << 8) | *Ptr++;
   }
 
-  FixedBuffer = AllocateZeroPool (FixedBufferSize + 1);
-  if (FixedBuffer == NULL) {
-    return EFI_OUT_OF_RESOURCES;
+  return Value;
+}
+
+STATIC
+BOOLEAN
+BinaryObjectOffset (
+  BINARY_PLIST  *Plist,
+  UINT64        Ref,
+  UINT64        *Offset
+) {
+  if (Ref >= Plist->NumObjects) {
+    return FALSE;
   }
 
-  CopyMem (FixedBuffer, Buffer, FixedBufferSize);
-  BufferStart = FixedBuffer;
+  *Offset = BinaryReadBE (Plist->OffsetTable + Ref * Plist->OffsetSize, Plist->OffsetSize);
 
-#if DEBUG_PLIST
-  gTagsParsed = 0;
-  gLastTag = NULL;
-#endif
+  return (*Offset >= kBinaryPlistHeaderSize) && (*Offset < Plist->ObjectsEnd);
+}
 
-  Pos = 0;
+//
+// Element / byte count from the object marker at Offset, Offset is moved
+// past the marker (and past the extended count if there is one).
+//
+STATIC
+BOOLEAN
+BinaryObjectCount (
+  BINARY_PLIST  *Plist,
+  UINT64        *Offset,
+  UINT64        *Count
+) {
+  UINT8   Marker = Plist->Buffer[(*Offset)++];
+  UINTN   Size;
 
-  gRefString = NULL;
-  gRefInteger = NULL;
+  *Count = Marker & 0x0F;
+  if (*Count != 0x0F) {
+    return TRUE;
+  }
 
-  while (1) {
-    ModuleDict = (TagPtr) - 1;  // have to detect changes to by-ref parameter
-    Length = ParseNextTag (FixedBuffer + Pos, &ModuleDict);
-    if (Length == -1) {
-      break;
-    }
+  if ((*Offset >= Plist->ObjectsEnd) || ((Plist->Buffer[*Offset] & 0xF0) != 0x10)) {
+    return FALSE;
+  }
 
-    Pos += Length;
+  Size = (UINTN)1 << (Plist->Buffer[(*Offset)++] & 0x0F);
+  if ((Size > sizeof (UINT64)) || ((*Offset + Size) > Plist->ObjectsEnd)) {
+    return FALSE;
+  }
 
-    if (ModuleDict == 0) {
-      continue;
-    }
+  *Count = BinaryReadBE (Plist->Buffer + *Offset, Size);
+  *Offset += Size;
 
-    // did we actually create anything?
-    if (ModuleDict != (TagPtr) - 1) {
-      if (
-        (ModuleDict->type == kTagTypeDict) ||
-        (ModuleDict->type == kTagTypeArray)
-      ) {
-        break;
-      }
+  return TRUE;
+}
 
-      FreeTag (ModuleDict);
+STATIC
+CHAR8 *
+BinaryScratch (
+  BINARY_PLIST  *Plist,
+  UINTN         Size
+) {
+  if (Size > Plist->ScratchSize) {
+    if (Plist->Scratch != NULL) {
+      FreePool (Plist->Scratch);
+    }
+
+    Plist->ScratchSize = MAX (Size, 0x100);
+    Plist->Scratch = AllocatePool (Plist->ScratchSize);
+    if (Plist->Scratch == NULL) {
+      Plist->ScratchSize = 0;
     }
   }
 
-  if (Length != -1) {
-//#if USE_REF
-    ModuleDict->ref_strings = (gRefString != NULL)
-      ? AllocateCopyPool (sizeof (gRefString) * sizeof (sREF), gRefString)
-      : NULL;
-    ModuleDict->ref_integer = (gRefInteger != NULL)
-      ? AllocateCopyPool (sizeof (gRefInteger) * sizeof (sREF), gRefInteger)
-      : NULL;
-//#endif
+  return Plist->Scratch;
+}
 
-    *Dict = ModuleDict;
+//
+// ASCII (0x5n) or UTF-16BE (0x6n) string object at Offset as a symbol,
+// UTF-16 is stored as UTF-8 like XML plists have it.
+//
+STATIC
+INT32
+BinaryNewSymbol (
+  BINARY_PLIST  *Plist,
+  UINT64        Offset,
+  CHAR8         **String
+) {
+  UINT8         Type = Plist->Buffer[Offset] >> 4;
+  UINT64        Count;
+  CONST UINT8   *Ptr;
+  CHAR8         *Str;
+  UINTN         i, Len = 0;
+  UINT32        Char, Low;
 
-#if DEBUG_PLIST
+  if (
+    ((Type != 0x5) && (Type != 0x6)) ||
+    !BinaryObjectCount (Plist, &Offset, &Count) ||
+    (Count > ((Plist->ObjectsEnd - Offset) >> (Type - 0x5)))
+  ) {
+    return -1;
+  }
+
+  Ptr = Plist->Buffer + Offset;
+
+  // UTF-8 needs 3 bytes for every UTF-16 unit at most
+  Str = BinaryScratch (Plist, (UINTN)Count * ((Type == 0x5) ? 1 : 3) + 1);
+  if (Str == NULL) {
+    return -1;
+  }
+
+  if (Type == 0x5) {
+    CopyMem (Str, Ptr, (UINTN)Count);
+    Len = (UINTN)Count;
   } else {
-    //DBG ("ParseXML gagged (-1) after '%s' (%d tags); buf + Pos: %s\n",
-    //  gLastTag, gTagsParsed, Buffer + Pos);
-#endif
+    for (i = 0; i < Count; i++) {
+      Char = (UINT32)BinaryReadBE (Ptr + i * 2, 2);
+
+      if ((Char >= 0xD800) && (Char < 0xDC00) && ((i + 1) < Count)) {
+        Low = (UINT32)BinaryReadBE (Ptr + (i + 1) * 2, 2);
+        if ((Low >= 0xDC00) && (Low < 0xE000)) {
+          Char = 0x10000 + ((Char - 0xD800) << 10) + (Low - 0xDC00);
+          i++;
+        }
+      }
+
+      if (Char < 0x80) {
+        Str[Len++] = (CHAR8)Char;
+      } else if (Char < 0x800) {
+        Str[Len++] = (CHAR8)(0xC0 | (Char >> 6));
+        Str[Len++] = (CHAR8)(0x80 | (Char & 0x3F));
+      } else if (Char < 0x10000) {
+        Str[Len++] = (CHAR8)(0xE0 | (Char >> 12));
+        Str[Len++] = (CHAR8)(0x80 | ((Char >> 6) & 0x3F));
+        Str[Len++] = (CHAR8)(0x80 | (Char & 0x3F));
+      } else {
+        Str[Len++] = (CHAR8)(0xF0 | (Char >> 18));
+        Str[Len++] = (CHAR8)(0x80 | ((Char >> 12) & 0x3F));
+        Str[Len++] = (CHAR8)(0x80 | ((Char >> 6) & 0x3F));
+        Str[Len++] = (CHAR8)(0x80 | (Char & 0x3F));
+      }
+    }
   }
 
-  FreePool (FixedBuffer);
+  Str[Len] = '\0';
 
-  //dbgCount++;
+  *String = NewSymbol (Str);
+  if (*String == 0) {
+    return -1;
+  }
 
-  // return 0 for no error
-  return (Length != -1) ? EFI_SUCCESS : EFI_OUT_OF_RESOURCES;
+  AsciiTrimSpaces (String);
+
+  return 0;
 }
 
 //
-// Public
+// Text ParseTagInteger () would have kept for the value, in decimal.
 //
-
-TagPtr
-EFIAPI
-GetProperty (
-  TagPtr  Dict,
-  CHAR8   *Key
+STATIC
+CHAR8 *
+BinaryIntegerSymbol (
+  BINARY_PLIST  *Plist,
+  INT64         Value
 ) {
-  TagPtr  TagList, Tag;
+  CHAR8   *Str = BinaryScratch (Plist, 24), Digits[21];
+  UINT64  Abs = (Value < 0) ? (0 - (UINT64)Value) : (UINT64)Value;
+  UINTN   Len = 0, i = 0;
 
-  if (Dict->type != kTagTypeDict) {
+  if (Str == NULL) {
     return 0;
   }
 
-  Tag = 0;    // ?
-  TagList = Dict->tag;
-
-  while (TagList) {
-    Tag = TagList;
-    TagList = Tag->tagNext;
+  do {
+    Digits[i++] = (CHAR8)('0' + (UINTN)(Abs % 10));
+    Abs /= 10;
+  } while (Abs);
 
-    if ((Tag->type != kTagTypeKey) || (Tag->string == 0)) {
-      continue;
-    }
+  if (Value < 0) {
+    Str[Len++] = '-';
+  }
 
-    if (!AsciiStrCmp (Tag->string, Key)) {
-      return Tag->tag;
-    }
+  while (i) {
+    Str[Len++] = Digits[--i];
   }
 
-  return 0;
+  Str[Len] = '\0';
+
+  return NewSymbol (Str);
 }
 
-INTN
-EFIAPI
-GetTagCount (
-  TagPtr    Dict
+//
+// Text ParseTagData () would have kept for the bytes, in Base64.
+//
+STATIC
+CHAR8 *
+BinaryDataSymbol (
+  BINARY_PLIST  *Plist,
+  CONST UINT8   *Data,
+  UINTN         Size
 ) {
-  return Dict->size;
+  STATIC CONST CHAR8  Encoding[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  CHAR8               *Str = BinaryScratch (Plist, ((Size + 2) / 3) * 4 + 1);
+  UINTN               i, Len = 0;
+  UINT32              Triple;
+
+  if (Str == NULL) {
+    return 0;
+  }
+
+  for (i = 0; i < Size; i += 3) {
+    Triple = ((UINT32)Data[i] << 16) |
+             (((i + 1) < Size) ? ((UINT32)Data[i + 1] << 8) : 0) |
+             (((i + 2) < Size) ? (UINT32)Data[i + 2] : 0);
+
+    Str[Len++] = Encoding[(Triple >> 18) & 0x3F];
+    Str[Len++] = Encoding[(Triple >> 12) & 0x3F];
+    Str[Len++] = ((i + 1) < Size) ? Encoding[(Triple >> 6) & 0x3F] : '=';
+    Str[Len++] = ((i + 2) < Size) ? Encoding[Triple & 0x3F] : '=';
+  }
+
+  Str[Len] = '\0';
+
+  return NewSymbol (Str);
 }
 
-EFI_STATUS
-EFIAPI
-GetElement (
-  TagPtr    Dict,
-  INTN      Id,
-  INTN      Count,
-  TagPtr    *Dict1
+//
+// Builds the same tags ParseNextTag () does for the object Ref, *Tag is NULL
+// for objects XML plists have no tag for (real, date, null, UID).
+//
+STATIC
+INT32
+ParseBinaryObject (
+  BINARY_PLIST  *Plist,
+  UINT64        Ref,
+  UINTN         Depth,
+  TagPtr        *Tag
 ) {
-  TagPtr  Child;
+  UINT64        Offset, Count, i, KeyOffset;
+  UINT8         Marker;
+  UINTN         Size, RefSize = Plist->RefSize, Items;
+  CHAR8         *String;
+  TagPtr        TmpTag, SubTag, TagList = 0;
+  CONST UINT8   *Refs;
 
-  if (!Dict || !Dict1 || (Dict->type != kTagTypeArray)) {
-    return EFI_UNSUPPORTED;
+  *Tag = NULL;
+
+  if ((Depth > kBinaryPlistMaxDepth) || !Plist->Nodes || !BinaryObjectOffset (Plist, Ref, &Offset)) {
+    return -1;
+  }
+
+  // a DAG of shared objects must not turn into an exponential tree
+  Plist->Nodes--;
+
+  Marker = Plist->Buffer[Offset];
+
+  switch (Marker >> 4) {
+    case 0x0: // null / false / true / fill
+      if ((Marker != 0x08) && (Marker != 0x09)) {
+        return 0;
+      }
+
+      TmpTag = NewTag ();
+      if (TmpTag == 0) {
+        return -1;
+      }
+
+      TmpTag->type = (Marker == 0x09) ? kTagTypeTrue : kTagTypeFalse;
+      TmpTag->integer = 0;
+      TmpTag->data = 0;
+      TmpTag->size = 0;
+      TmpTag->string = 0;
+      TmpTag->tag = 0;
+      TmpTag->tagNext = 0;
+      break;
+
+    case 0x1: // integer, 2^n bytes big-endian
+      Size = (UINTN)1 << (Marker & 0x0F);
+      if ((Size > 16) || ((Offset + 1 + Size) > Plist->ObjectsEnd)) {
+        return -1;
+      }
+
+      TmpTag = NewTag ();
+      if (TmpTag == 0) {
+        return -1;
+      }
+
+      TmpTag->type = kTagTypeInteger;
+      TmpTag->integer = (INTN)BinaryReadBE (
+                                Plist->Buffer + Offset + 1 + ((Size > sizeof (UINT64)) ? (Size - sizeof (UINT64)) : 0),
+                                MIN (Size, sizeof (UINT64))
+                              );
+      TmpTag->string = BinaryIntegerSymbol (Plist, (INT64)TmpTag->integer);
+      TmpTag->data = 0;
+      TmpTag->size = 0;
+      TmpTag->tag = 0;
+      TmpTag->tagNext = 0;
+      TmpTag->id = -1;
+      TmpTag->ref = -1;
+
+      if (TmpTag->string == 0) {
+        FreeTag (TmpTag);
+        return -1;
+      }
+      break;
+
+    case 0x4: // data
+      if (!BinaryObjectCount (Plist, &Offset, &Count) || (Count > (Plist->ObjectsEnd - Offset))) {
+        return -1;
+      }
+
+      TmpTag = NewTag ();
+      if (TmpTag == 0) {
+        return -1;
+      }
+
+      TmpTag->type = Count ? kTagTypeData : kTagTypeNone;
+      TmpTag->string = Count ? BinaryDataSymbol (Plist, Plist->Buffer + Offset, (UINTN)Count) : 0;
+      TmpTag->integer = 0;
+      TmpTag->data = Count ? PlistAllocateCopy ((UINTN)Count, (VOID *)(Plist->Buffer + Offset)) : 0;
+      TmpTag->size = (UINTN)Count;
+      TmpTag->tag = 0;
+      TmpTag->tagNext = 0;
+
+      if (Count && ((TmpTag->data == NULL) || (TmpTag->string == 0))) {
+        FreeTag (TmpTag);
+        return -1;
+      }
+      break;
+
+    case 0x5: // ASCII string
+    case 0x6: // UTF-16BE string
+      if (BinaryNewSymbol (Plist, Offset, &String) == -1) {
+        return -1;
+      }
+
+      TmpTag = NewTag ();
+      if (TmpTag == 0) {
+        return -1;
+      }
+
+      TmpTag->type = AsciiStrLen (String) ? kTagTypeString : kTagTypeNone;
+      TmpTag->string = String;
+      TmpTag->integer = 0;
+      TmpTag->data = 0;
+      TmpTag->size = 0;
+      TmpTag->tag = 0;
+      TmpTag->tagNext = 0;
+      TmpTag->id = -1;
+      TmpTag->ref = -1;
+      break;
+
+    case 0xA: // array, n object refs
+    case 0xD: // dict, n key refs followed by n value refs
+      Items = ((Marker >> 4) == 0xD) ? 2 : 1;
+      if (
+        !BinaryObjectCount (Plist, &Offset, &Count) ||
+        (Count > ((Plist->ObjectsEnd - Offset) / (RefSize * Items)))
+      ) {
+        return -1;
+      }
+
+      Refs = Plist->Buffer + Offset;
+
+      // children are kept in reverse order, same as ParseTagList () does
+      for (i = 0; i < Count; i++) {
+        if (ParseBinaryObject (Plist, BinaryReadBE (Refs + (Count * (Items - 1) + i) * RefSize, RefSize), Depth + 1, &SubTag) == -1) {
+          FreeTag (TagList);
+          return -1;
+        }
+
+        if (Items == 1) {
+          if (SubTag == NULL) {
+            continue;
+          }
+
+          TmpTag = SubTag;
+        } else {
+          if (
+            !BinaryObjectOffset (Plist, BinaryReadBE (Refs + i * RefSize, RefSize), &KeyOffset) ||
+            (BinaryNewSymbol (Plist, KeyOffset, &String) == -1) ||
+            ((TmpTag = NewTag ()) == 0)
+          ) {
+            FreeTag (SubTag);
+            FreeTag (TagList);
+            return -1;
+          }
+
+          if (!AsciiStrLen (String) || (String[0] == '#')) {
+            FreeTag (SubTag);
+            SubTag = NULL;
+          }
+
+          TmpTag->type = kTagTypeKey;
+          TmpTag->string = String;
+          TmpTag->integer = 0;
+          TmpTag->data = 0;
+          TmpTag->size = 0;
+          TmpTag->tag = SubTag;
+        }
+
+        TmpTag->tagNext = TagList;
+        TagList = TmpTag;
+      }
+
+      TmpTag = NewTag ();
+      if (TmpTag == 0) {
+        FreeTag (TagList);
+        return -1;
+      }
+
+      TmpTag->type = (Items == 2) ? kTagTypeDict : kTagTypeArray;
+      TmpTag->string = 0;
+      TmpTag->integer = 0;
+      TmpTag->data = 0;
+      TmpTag->size = 0;
+      TmpTag->tag = TagList;
+      TmpTag->tagNext = 0;
+      TmpTag->offset = 0;
+      TmpTag->taglen = 0;
+
+      for (SubTag = TagList; SubTag != NULL; SubTag = SubTag->tagNext) {
+        TmpTag->size++;
+      }
+
+      if ((gDocument != NULL) && (TmpTag->size >= kTagIndexMinSize) && (GetTagIndex (TmpTag) == NULL)) {
+        return -1;
+      }
+      break;
+
+    default: // real, date, UID, set
+      return 0;
+  }
+
+  *Tag = TmpTag;
+
+  return 0;
+}
+
+STATIC
+EFI_STATUS
+ParseBinaryPlist (
+  CONST UINT8   *Buffer,
+  UINTN         BufSize,
+  TagPtr        *Dict
+) {
+  BINARY_PLIST  Plist;
+  CONST UINT8   *Trailer;
+  UINT64        Top, TableOffset;
+  TagPtr        Root = NULL;
+  INT32         Length;
+
+  if (BufSize < (kBinaryPlistHeaderSize + kBinaryPlistTrailerSize)) {
+    return EFI_LOAD_ERROR;
+  }
+
+  ZeroMem (&Plist, sizeof (Plist));
+
+  // 6 unused bytes, offset size, ref size, objects count, top object, offset table offset
+  Trailer = Buffer + BufSize - kBinaryPlistTrailerSize;
+  Plist.Buffer = Buffer;
+  Plist.OffsetSize = Trailer[6];
+  Plist.RefSize = Trailer[7];
+  Plist.NumObjects = BinaryReadBE (Trailer + 8, 8);
+  Top = BinaryReadBE (Trailer + 16, 8);
+  TableOffset = BinaryReadBE (Trailer + 24, 8);
+
+  if (
+    (Plist.OffsetSize == 0) || (Plist.OffsetSize > sizeof (UINT64)) ||
+    (Plist.RefSize == 0) || (Plist.RefSize > sizeof (UINT64)) ||
+    (TableOffset < kBinaryPlistHeaderSize) ||
+    (TableOffset > (BufSize - kBinaryPlistTrailerSize)) ||
+    (Plist.NumObjects > ((BufSize - kBinaryPlistTrailerSize - TableOffset) / Plist.OffsetSize))
+  ) {
+    return EFI_LOAD_ERROR;
+  }
+
+  Plist.ObjectsEnd = TableOffset;
+  Plist.OffsetTable = Buffer + TableOffset;
+  Plist.Nodes = kBinaryPlistMaxNodes;
+
+  Length = ParseBinaryObject (&Plist, Top, 0, &Root);
+
+  if (Plist.Scratch != NULL) {
+    FreePool (Plist.Scratch);
+  }
+
+  if ((Length == -1) || (Root == NULL) || ((Root->type != kTagTypeDict) && (Root->type != kTagTypeArray))) {
+    FreeTag (Root);
+    return EFI_LOAD_ERROR;
+  }
+
+  Root->ref_strings = NULL;
+  Root->ref_integer = NULL;
+
+  *Dict = Root;
+
+  return EFI_SUCCESS;
+}
+
+typedef struct {
+  UINT8     *Buffer;
+  UINTN     Size;
+  UINTN     Used;
+  UINT64    *Offsets;
+  UINT8     RefSize;
+  BOOLEAN   Error;
+} BINARY_PLIST_WRITER;
+
+//
+// Objects ExportBinaryPlist () writes for Tag and everything below it.
+//
+STATIC
+UINTN
+BinaryCountObjects (
+  TagPtr  Tag
+) {
+  UINTN   Count = 1;
+  TagPtr  Child;
+
+  if ((Tag != NULL) && ((Tag->type == kTagTypeDict) || (Tag->type == kTagTypeArray))) {
+    for (Child = Tag->tag; Child != NULL; Child = Child->tagNext) {
+      if (Tag->type == kTagTypeArray) {
+        Count += BinaryCountObjects (Child);
+      } else if (Child->type == kTagTypeKey) {
+        Count += 1 + BinaryCountObjects (Child->tag);
+      }
+    }
+  }
+
+  return Count;
+}
+
+STATIC
+VOID
+BinaryPut (
+  BINARY_PLIST_WRITER   *Writer,
+  CONST VOID            *Data,
+  UINTN                 Size
+) {
+  UINT8   *NewBuffer;
+  UINTN   NewSize;
+
+  if (Writer->Error) {
+    return;
+  }
+
+  if ((Writer->Used + Size) > Writer->Size) {
+    NewSize = MAX (Writer->Size << 1, Writer->Used + Size + 0x1000);
+    NewBuffer = ReallocatePool (Writer->Size, NewSize, Writer->Buffer);
+    if (NewBuffer == NULL) {
+      Writer->Error = TRUE;
+      return;
+    }
+
+    Writer->Buffer = NewBuffer;
+    Writer->Size = NewSize;
+  }
+
+  CopyMem (Writer->Buffer + Writer->Used, Data, Size);
+  Writer->Used += Size;
+}
+
+STATIC
+VOID
+BinaryPutBE (
+  BINARY_PLIST_WRITER   *Writer,
+  UINT64                Value,
+  UINTN                 Size
+) {
+  UINT8   Bytes[sizeof (UINT64)];
+  UINTN   i;
+
+  for (i = Size; i > 0; i--) {
+    Bytes[i - 1] = (UINT8)Value;
+    Value >>= 8;
+  }
+
+  BinaryPut (Writer, Bytes, Size);
+}
+
+STATIC
+VOID
+BinaryPutMarker (
+  BINARY_PLIST_WRITER   *Writer,
+  UINT8                 Type,
+  UINT64                Count
+) {
+  if (Count < 0x0F) {
+    BinaryPutBE (Writer, (Type << 4) | Count, 1);
+    return;
+  }
+
+  BinaryPutBE (Writer, (Type << 4) | 0x0F, 1);
+
+  // extended count is an integer object
+  if (Count <= MAX_UINT8) {
+    BinaryPutBE (Writer, 0x10, 1);
+    BinaryPutBE (Writer, Count, 1);
+  } else if (Count <= MAX_UINT16) {
+    BinaryPutBE (Writer, 0x11, 1);
+    BinaryPutBE (Writer, Count, 2);
+  } else {
+    BinaryPutBE (Writer, 0x13, 1);
+    BinaryPutBE (Writer, Count, 8);
+  }
+}
+
+//
+// ASCII string object, or UTF-16BE one if String has any UTF-8 sequence.
+//
+STATIC
+VOID
+BinaryPutString (
+  BINARY_PLIST_WRITER   *Writer,
+  CONST CHAR8           *String
+) {
+  CONST UINT8   *Ptr = (CONST UINT8 *)String;
+  UINTN         Len = AsciiStrLen (String), Units = 0, i, Extra;
+  UINT32        Char;
+
+  for (i = 0; i < Len; i++) {
+    if (Ptr[i] >= 0x80) {
+      break;
+    }
+  }
+
+  if (i == Len) {
+    BinaryPutMarker (Writer, 0x5, Len);
+    BinaryPut (Writer, String, Len);
+    return;
+  }
+
+  // two passes: count UTF-16 units, then write them
+  for (Extra = 0; Extra < 2; Extra++) {
+    if (Extra == 1) {
+      BinaryPutMarker (Writer, 0x6, Units);
+    }
+
+    for (i = 0; i < Len;) {
+      Char = Ptr[i++];
+
+      if (Char >= 0x80) {
+        UINTN   Follow = (Char >= 0xF0) ? 3 : ((Char >= 0xE0) ? 2 : 1);
+
+        if ((Char < 0xC0) || (Char >= 0xF8) || ((i + Follow) > Len)) {
+          Writer->Error = TRUE;
+          return;
+        }
+
+        Char &= (0x3F >> Follow);
+        while (Follow-- > 0) {
+          if ((Ptr[i] & 0xC0) != 0x80) {
+            Writer->Error = TRUE;
+            return;
+          }
+
+          Char = (Char << 6) | (Ptr[i++] & 0x3F);
+        }
+      }
+
+      if (Char >= 0x10000) {
+        if (Extra == 0) {
+          Units += 2;
+        } else {
+          Char -= 0x10000;
+          BinaryPutBE (Writer, 0xD800 + (Char >> 10), 2);
+          BinaryPutBE (Writer, 0xDC00 + (Char & 0x3FF), 2);
+        }
+      } else if (Extra == 0) {
+        Units++;
+      } else {
+        BinaryPutBE (Writer, Char, 2);
+      }
+    }
+  }
+}
+
+//
+// Writes Tag as object Id, its children get the following Ids (depth first).
+//
+STATIC
+VOID
+BinaryWriteObject (
+  BINARY_PLIST_WRITER   *Writer,
+  TagPtr                Tag,
+  UINT64                Id
+) {
+  TagPtr    Child, *Items;
+  UINT64    *Ids, Next;
+  UINTN     Count = 0, i, Len;
+
+  Writer->Offsets[Id] = Writer->Used;
+
+  if (Tag == NULL) {
+    BinaryPutBE (Writer, 0x00, 1);
+    return;
+  }
+
+  switch (Tag->type) {
+    case kTagTypeFalse:
+    case kTagTypeTrue:
+      BinaryPutBE (Writer, (Tag->type == kTagTypeTrue) ? 0x09 : 0x08, 1);
+      break;
+
+    case kTagTypeInteger:
+      if (Tag->ref != -1) {
+        // IDREF, no value of its own
+        Writer->Error = TRUE;
+        break;
+      }
+
+      BinaryPutBE (Writer, 0x13, 1);
+      BinaryPutBE (Writer, (UINT64)Tag->integer, 8);
+      break;
+
+    case kTagTypeKey:
+    case kTagTypeString:
+      if ((Tag->string == NULL) || ((Tag->type == kTagTypeString) && (Tag->ref != -1))) {
+        Writer->Error = TRUE;
+        break;
+      }
+
+      BinaryPutString (Writer, Tag->string);
+      break;
+
+    case kTagTypeData:
+      BinaryPutMarker (Writer, 0x4, Tag->size);
+      BinaryPut (Writer, Tag->data, Tag->size);
+      break;
+
+    case kTagTypeDict:
+    case kTagTypeArray:
+      for (Child = Tag->tag; Child != NULL; Child = Child->tagNext) {
+        if ((Tag->type == kTagTypeArray) || (Child->type == kTagTypeKey)) {
+          Count++;
+        }
+      }
+
+      Items = AllocatePool (Count * sizeof (TagPtr) + 1);
+      Ids = AllocatePool (Count * 2 * sizeof (UINT64) + 1);
+
+      if ((Items != NULL) && (Ids != NULL)) {
+        // children are kept in reverse order, write them in the original one
+        i = Count;
+        for (Child = Tag->tag; Child != NULL; Child = Child->tagNext) {
+          if ((Tag->type == kTagTypeArray) || (Child->type == kTagTypeKey)) {
+            Items[--i] = Child;
+          }
+        }
+
+        // array: element Ids, dict: Count key Ids followed by Count value Ids
+        Next = Id + 1;
+        for (i = 0; i < Count; i++) {
+          if (Tag->type == kTagTypeArray) {
+            Ids[i] = Next;
+            Next += BinaryCountObjects (Items[i]);
+          } else {
+            Ids[i] = Next++;
+            Ids[Count + i] = Next;
+            Next += BinaryCountObjects (Items[i]->tag);
+          }
+        }
+
+        BinaryPutMarker (Writer, (Tag->type == kTagTypeDict) ? 0xD : 0xA, Count);
+        for (i = 0; i < ((Tag->type == kTagTypeDict) ? (Count * 2) : Count); i++) {
+          BinaryPutBE (Writer, Ids[i], Writer->RefSize);
+        }
+
+        for (i = 0; i < Count; i++) {
+          BinaryWriteObject (Writer, Items[i], Ids[i]);
+          if (Tag->type == kTagTypeDict) {
+            BinaryWriteObject (Writer, Items[i]->tag, Ids[Count + i]);
+          }
+        }
+      } else {
+        Writer->Error = TRUE;
+      }
+
+      if (Items != NULL) {
+        FreePool (Items);
+      }
+
+      if (Ids != NULL) {
+        FreePool (Ids);
+      }
+      break;
+
+    default:
+      // kTagTypeNone: empty string or empty data
+      BinaryPutMarker (Writer, (Tag->string != NULL) ? 0x5 : 0x4, 0);
+      break;
+  }
+
+}
+
+//
+// Field by field comparison of two tag lists (and everything below them).
+//
+STATIC
+BOOLEAN
+BinaryTagsEqual (
+  TagPtr  A,
+  TagPtr  B
+) {
+  while ((A != NULL) && (B != NULL)) {
+    if (
+      (A->type != B->type) ||
+      (A->integer != B->integer) ||
+      (A->size != B->size) ||
+      ((A->string == NULL) != (B->string == NULL)) ||
+      ((A->string != NULL) && (AsciiStrCmp (A->string, B->string) != 0))
+    ) {
+      return FALSE;
+    }
+
+    if (
+      ((A->type == kTagTypeData) || (A->data != NULL) || (B->data != NULL)) &&
+      (
+        (A->data == NULL) || (B->data == NULL) ||
+        (CompareMem (A->data, B->data, A->size) != 0)
+      )
+    ) {
+      return FALSE;
+    }
+
+    if (!BinaryTagsEqual (A->tag, B->tag)) {
+      return FALSE;
+    }
+
+    A = A->tagNext;
+    B = B->tagNext;
+  }
+
+  return (A == B);
+}
+
+//
+// Serializes Dict into a new binary (bplist00) plist ParseXML () reads back
+// into the same tree. The result is read back and compared before it is
+// returned: trees the binary format cannot reproduce exactly (IDREF values,
+// size="" attributes, integer / data text other than the one
+// ParseBinaryObject () rebuilds) give EFI_UNSUPPORTED.
+//
+EFI_STATUS
+EFIAPI
+ExportBinaryPlist (
+  IN  TagPtr  Dict,
+  OUT UINT8   **Buffer,
+  OUT UINTN   *BufSize
+) {
+  BINARY_PLIST_WRITER   Writer;
+  UINT64                NumObjects, TableOffset, i;
+  UINT8                 OffsetSize;
+
+  if ((Dict == NULL) || (Buffer == NULL) || (BufSize == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  ZeroMem (&Writer, sizeof (Writer));
+
+  NumObjects = BinaryCountObjects (Dict);
+  Writer.RefSize = (NumObjects <= MAX_UINT8) ? 1 : ((NumObjects <= MAX_UINT16) ? 2 : 4);
+  Writer.Offsets = AllocatePool ((UINTN)NumObjects * sizeof (UINT64));
+  if (Writer.Offsets == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  BinaryPut (&Writer, kBinaryPlistMagic, kBinaryPlistHeaderSize);
+  BinaryWriteObject (&Writer, Dict, 0);
+
+  TableOffset = Writer.Used;
+  OffsetSize = (TableOffset <= MAX_UINT8) ? 1 : ((TableOffset <= MAX_UINT16) ? 2 : 4);
+
+  for (i = 0; i < NumObjects; i++) {
+    BinaryPutBE (&Writer, Writer.Offsets[i], OffsetSize);
+  }
+
+  // 6 unused bytes, offset size, ref size, objects count, top object, offset table offset
+  BinaryPutBE (&Writer, 0, 6);
+  BinaryPutBE (&Writer, OffsetSize, 1);
+  BinaryPutBE (&Writer, Writer.RefSize, 1);
+  BinaryPutBE (&Writer, NumObjects, 8);
+  BinaryPutBE (&Writer, 0, 8);
+  BinaryPutBE (&Writer, TableOffset, 8);
+
+  FreePool (Writer.Offsets);
+
+  if (!Writer.Error) {
+    TagPtr  Copy = NULL;
+
+    if (
+      EFI_ERROR (ParseBinaryPlist (Writer.Buffer, Writer.Used, &Copy)) ||
+      !BinaryTagsEqual (Dict, Copy)
+    ) {
+      DBG ("%a: tree does not survive the round trip\n", __FUNCTION__);
+      Writer.Error = TRUE;
+    }
+
+    FreeTag (Copy);
+  }
+
+  if (Writer.Error) {
+    if (Writer.Buffer != NULL) {
+      FreePool (Writer.Buffer);
+    }
+
+    return EFI_UNSUPPORTED;
+  }
+
+  *Buffer = Writer.Buffer;
+  *BufSize = Writer.Used;
+
+  return EFI_SUCCESS;
+}
+
+//
+// Buffer may hold a binary (bplist00) plist too, BufSize is required then.
+//
+EFI_STATUS
+EFIAPI
+ParseXML (
+  CHAR8   *Buffer,
+  UINT32  BufSize,
+  TagPtr  *Dict
+) {
+  INT32     Length, Pos,
+            FixedBufferSize = BufSize ? BufSize : (UINT32)AsciiStrLen (Buffer);
+  TagPtr    ModuleDict;
+  CHAR8     *FixedBuffer = NULL;
+
+  if (Dict == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if ((BufSize > kBinaryPlistHeaderSize) && (CompareMem (Buffer, kBinaryPlistMagic, kBinaryPlistHeaderSize) == 0)) {
+    return ParseBinaryPlist ((UINT8 *)Buffer, BufSize, Dict);
+  }
+
+  FixedBuffer = AllocateZeroPool (FixedBufferSize + 1);
+  if (FixedBuffer == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  CopyMem (FixedBuffer, Buffer, FixedBufferSize);
+  BufferStart = FixedBuffer;
+
+#if DEBUG_PLIST
+  gTagsParsed = 0;
+  gLastTag = NULL;
+#endif
+
+  Pos = 0;
+
+  gRefString = NULL;
+  gRefInteger = NULL;
+
+  while (1) {
+    ModuleDict = (TagPtr) - 1;  // have to detect changes to by-ref parameter
+    Length = ParseNextTag (FixedBuffer + Pos, &ModuleDict);
+    if (Length == -1) {
+      break;
+    }
+
+    Pos += Length;
+
+    if (ModuleDict == 0) {
+      continue;
+    }
+
+    // did we actually create anything?
+    if (ModuleDict != (TagPtr) - 1) {
+      if (
+        (ModuleDict->type == kTagTypeDict) ||
+        (ModuleDict->type == kTagTypeArray)
+      ) {
+        break;
+      }
+
+      FreeTag (ModuleDict);
+    }
+  }
+
+  if (Length != -1) {
+//#if USE_REF
+    if (gDocument != NULL) {
+      ModuleDict->ref_strings = gRefString;
+      ModuleDict->ref_integer = gRefInteger;
+    } else {
+      ModuleDict->ref_strings = (gRefString != NULL)
+        ? AllocateCopyPool (sizeof (gRefString) * sizeof (sREF), gRefString)
+        : NULL;
+      ModuleDict->ref_integer = (gRefInteger != NULL)
+        ? AllocateCopyPool (sizeof (gRefInteger) * sizeof (sREF), gRefInteger)
+        : NULL;
+    }
+//#endif
+
+    *Dict = ModuleDict;
+
+#if DEBUG_PLIST
+  } else {
+    //DBG ("ParseXML gagged (-1) after '%s' (%d tags); buf + Pos: %s\n",
+    //  gLastTag, gTagsParsed, Buffer + Pos);
+#endif
+  }
+
+  FreePool (FixedBuffer);
+
+  //dbgCount++;
+
+  // return 0 for no error
+  return (Length != -1) ? EFI_SUCCESS : EFI_OUT_OF_RESOURCES;
+}
+
+//
+//  Children index, built on first lookup into a big dict / array
+//
+
+TAG_INDEX *
+GetTagIndex (
+  TagPtr  Tag
+) {
+  TAG_INDEX   *Index;
+  TagPtr      Child;
+  UINTN       Count = 0, Size, Slot;
+  UINT32      Hash;
+
+  if (Tag->index != NULL) {
+    return Tag->index;
+  }
+
+  if (Tag->size < kTagIndexMinSize) {
+    return NULL;
+  }
+
+  for (Child = Tag->tag; Child != 0; Child = Child->tagNext) {
+    Count++;
+  }
+
+  if (Count < kTagIndexMinSize) {
+    return NULL;
+  }
+
+  if (Tag->type == kTagTypeDict) {
+    Size = kTagIndexMinSize;
+    while (Size < (Count * 2)) {
+      Size <<= 1;
+    }
+
+    Index = PlistAllocateZero (sizeof (TAG_INDEX) + Size * (sizeof (TagPtr) + sizeof (UINT32)));
+    if (Index == NULL) {
+      return NULL;
+    }
+
+    Index->Count = Size;
+    Index->Items = (TagPtr *)(Index + 1);
+    Index->Hashes = (UINT32 *)(Index->Items + Size);
+
+    for (Child = Tag->tag; Child != 0; Child = Child->tagNext) {
+      if ((Child->type != kTagTypeKey) || (Child->string == 0)) {
+        continue;
+      }
+
+      Hash = SymbolHash (Child->string);
+      Slot = Hash & (Size - 1);
+
+      while (Index->Items[Slot] != 0) {
+        // first one in list wins, same as walking it
+        if ((Index->Hashes[Slot] == Hash) && !AsciiStrCmp (Index->Items[Slot]->string, Child->string)) {
+          break;
+        }
+
+        Slot = (Slot + 1) & (Size - 1);
+      }
+
+      if (Index->Items[Slot] == 0) {
+        Index->Items[Slot] = Child;
+        Index->Hashes[Slot] = Hash;
+      }
+    }
+  } else {
+    Index = PlistAllocateZero (sizeof (TAG_INDEX) + Count * sizeof (TagPtr));
+    if (Index == NULL) {
+      return NULL;
+    }
+
+    Index->Count = Count;
+    Index->Items = (TagPtr *)(Index + 1);
+
+    for (Count = 0, Child = Tag->tag; Child != 0; Child = Child->tagNext) {
+      Index->Items[Count++] = Child;
+    }
+  }
+
+  Tag->index = Index;
+
+  return Index;
+}
+
+//
+// Same as ParseXML (), but every tag, string and data buffer of the result
+// is carved from one arena owned by the returned document.
+//
+EFI_STATUS
+EFIAPI
+ParseXMLDocument (
+  CHAR8           *Buffer,
+  UINT32          BufSize,
+  PLIST_DOCUMENT  **Document
+) {
+  EFI_STATUS      Status;
+  PLIST_DOCUMENT  *Doc;
+
+  if (Document == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Doc = AllocateZeroPool (sizeof (PLIST_DOCUMENT));
+  if (Doc == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  gDocument = Doc;
+  Status = ParseXML (Buffer, BufSize, &Doc->Root);
+  gDocument = NULL;
+
+  if (EFI_ERROR (Status)) {
+    FreeXMLDocument (Doc);
+    return Status;
+  }
+
+  *Document = Doc;
+
+  return EFI_SUCCESS;
+}
+
+VOID
+EFIAPI
+FreeXMLDocument (
+  PLIST_DOCUMENT  *Document
+) {
+  PLIST_ARENA_BLOCK   *Block, *Next;
+
+  if (Document == NULL) {
+    return;
+  }
+
+  for (Block = Document->Blocks; Block != NULL; Block = Next) {
+    Next = Block->Next;
+    FreePool (Block);
+  }
+
+  FreePool (Document);
+}
+
+//
+//  Streaming: events straight from a read-only buffer, nothing is allocated
+//
+
+STATIC
+CONST CHAR8 *
+StreamFindChar (
+  CONST CHAR8   *Ptr,
+  CONST CHAR8   *End,
+  CHAR8         Char
+) {
+  while (Ptr < End) {
+    if (*Ptr == Char) {
+      return Ptr;
+    }
+
+    Ptr++;
+  }
+
+  return NULL;
+}
+
+STATIC
+CONST CHAR8 *
+StreamFind (
+  CONST CHAR8   *Ptr,
+  CONST CHAR8   *End,
+  CONST CHAR8   *Str
+) {
+  UINTN   Len = AsciiStrLen (Str);
+
+  while ((Ptr = StreamFindChar (Ptr, End, Str[0])) != NULL) {
+    if ((UINTN)(End - Ptr) < Len) {
+      break;
+    }
+
+    if (CompareMem (Ptr, Str, Len) == 0) {
+      return Ptr;
+    }
+
+    Ptr++;
+  }
+
+  return NULL;
+}
+
+//
+// Decimal value of Attr (' ID="') inside the tag, -1 if there is none.
+//
+STATIC
+INT32
+StreamGetAttr (
+  CONST CHAR8   *Tag,
+  CONST CHAR8   *TagEnd,
+  CONST CHAR8   *Attr
+) {
+  CONST CHAR8   *Ptr = StreamFind (Tag, TagEnd, Attr);
+  INT32         Value = 0;
+
+  if (Ptr == NULL) {
+    return -1;
+  }
+
+  for (Ptr += AsciiStrLen (Attr); (Ptr < TagEnd) && (*Ptr >= '0') && (*Ptr <= '9'); Ptr++) {
+    Value = (Value * 10) + (*Ptr - '0');
+  }
+
+  return Value;
+}
+
+STATIC
+BOOLEAN
+StreamTagIs (
+  CONST CHAR8   *Name,
+  UINTN         NameLen,
+  CONST CHAR8   *Tag
+) {
+  return (NameLen == AsciiStrLen (Tag)) && (CompareMem (Name, Tag, NameLen) == 0);
+}
+
+//
+// Walks the plist in Buffer (BufSize == 0: zero terminated) calling Callback
+// for every value and every dict / array start and end, keys are attached
+// to the value following them. Buffer is never written to and no memory is
+// allocated, values are handed over as raw text (entities / base64 are not
+// decoded). Returning kPlistStreamSkip on kPlistEventListStart steps over
+// the whole list, kPlistStreamStop ends the walk.
+//
+EFI_STATUS
+EFIAPI
+ParseXMLStream (
+  IN CONST CHAR8            *Buffer,
+  IN UINTN                  BufSize,
+  IN PLIST_STREAM_CALLBACK  Callback,
+  IN VOID                   *Context
+) {
+  PLIST_STREAM_FRAME    Path[kPlistStreamMaxDepth];
+  PLIST_EVENT           Event;
+  PLIST_STREAM_ACTION   Action;
+  CONST CHAR8           *Ptr, *End, *TagEnd, *Name, *Next, *Key = NULL;
+  UINTN                 Depth = 0, SkipDepth = MAX_UINTN, NameLen, KeyLen = 0, Type;
+  BOOLEAN               Closing, Empty;
+
+  if ((Buffer == NULL) || (Callback == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  End = Buffer + (BufSize ? BufSize : AsciiStrLen (Buffer));
+  Ptr = Buffer;
+
+  while ((Ptr = StreamFindChar (Ptr, End, '<')) != NULL) {
+    if (((UINTN)(End - Ptr) >= 4) && (CompareMem (Ptr, "<!--", 4) == 0)) {
+      TagEnd = StreamFind (Ptr + 4, End, "-->");
+      if (TagEnd == NULL) {
+        return EFI_LOAD_ERROR;
+      }
+
+      Ptr = TagEnd + 3;
+      continue;
+    }
+
+    TagEnd = StreamFindChar (Ptr, End, '>');
+    if (TagEnd == NULL) {
+      return EFI_LOAD_ERROR;
+    }
+
+    Name = Ptr + 1;
+    Closing = (*Name == '/');
+    if (Closing) {
+      Name++;
+    }
+
+    NameLen = 0;
+    while (
+      ((Name + NameLen) < TagEnd) &&
+      (Name[NameLen] != ' ') && (Name[NameLen] != '/') &&
+      (Name[NameLen] != '\t') && (Name[NameLen] != '\r') && (Name[NameLen] != '\n')
+    ) {
+      NameLen++;
+    }
+
+    Empty = (TagEnd[-1] == '/');
+    Next = TagEnd + 1;
+
+    // <?xml ?>, <!DOCTYPE>, <plist>
+    if ((*Name == '?') || (*Name == '!') || StreamTagIs (Name, NameLen, kXMLTagPList)) {
+      Ptr = Next;
+      continue;
+    }
+
+    if (StreamTagIs (Name, NameLen, kXMLTagDict)) {
+      Type = kTagTypeDict;
+    } else if (StreamTagIs (Name, NameLen, kXMLTagArray)) {
+      Type = kTagTypeArray;
+    } else if (StreamTagIs (Name, NameLen, kXMLTagKey)) {
+      Type = kTagTypeKey;
+    } else if (StreamTagIs (Name, NameLen, kXMLTagString)) {
+      Type = kTagTypeString;
+    } else if (StreamTagIs (Name, NameLen, kXMLTagInteger)) {
+      Type = kTagTypeInteger;
+    } else if (StreamTagIs (Name, NameLen, kXMLTagData)) {
+      Type = kTagTypeData;
+    } else if (StreamTagIs (Name, NameLen, kXMLTagDate)) {
+      Type = kTagTypeDate;
+    } else if (StreamTagIs (Name, NameLen, kXMLTagFalse)) {
+      Type = kTagTypeFalse;
+    } else if (StreamTagIs (Name, NameLen, kXMLTagTrue)) {
+      Type = kTagTypeTrue;
+    } else {
+      Type = kTagTypeNone;
+    }
+
+    if (Closing) {
+      if ((Type == kTagTypeDict) || (Type == kTagTypeArray)) {
+        if (Depth == 0) {
+          return EFI_LOAD_ERROR;
+        }
+
+        Depth--;
+
+        if (SkipDepth == MAX_UINTN) {
+          Event.Event = kPlistEventListEnd;
+          Event.Type = Path[Depth].Type;
+          Event.Key = Path[Depth].Key;
+          Event.KeyLen = Path[Depth].KeyLen;
+          Event.Value = NULL;
+          Event.ValueLen = 0;
+          Event.Id = Event.IdRef = -1;
+          Event.Start = Path[Depth].Start;
+          Event.End = Next;
+          Event.Depth = Depth;
+          Event.Path = Path;
+
+          if (Callback (&Event, Context) == kPlistStreamStop) {
+            return EFI_SUCCESS;
+          }
+        } else if (Depth == SkipDepth) {
+          SkipDepth = MAX_UINTN;
+        }
+
+        Key = NULL;
+        KeyLen = 0;
+      }
+
+      Ptr = Next;
+      continue;
+    }
+
+    if ((Type == kTagTypeDict) || (Type == kTagTypeArray)) {
+      Action = kPlistStreamContinue;
+
+      if (Depth > 0) {
+        Path[Depth - 1].Count++;
+      }
+
+      if (SkipDepth == MAX_UINTN) {
+        Event.Event = kPlistEventListStart;
+        Event.Type = Type;
+        Event.Key = Key;
+        Event.KeyLen = KeyLen;
+        Event.Value = NULL;
+        Event.ValueLen = 0;
+        Event.Id = Event.IdRef = -1;
+        Event.Start = Ptr;
+        Event.End = NULL;
+        Event.Depth = Depth;
+        Event.Path = Path;
+
+        Action = Callback (&Event, Context);
+        if (Action == kPlistStreamStop) {
+          return EFI_SUCCESS;
+        }
+
+        if (Empty && (Action != kPlistStreamSkip)) {
+          Event.Event = kPlistEventListEnd;
+          Event.End = Next;
+
+          if (Callback (&Event, Context) == kPlistStreamStop) {
+            return EFI_SUCCESS;
+          }
+        }
+      }
+
+      if (!Empty) {
+        if (Depth == kPlistStreamMaxDepth) {
+          return EFI_UNSUPPORTED;
+        }
+
+        Path[Depth].Type = Type;
+        Path[Depth].Key = Key;
+        Path[Depth].KeyLen = KeyLen;
+        Path[Depth].Count = 0;
+        Path[Depth].Start = Ptr;
+
+        if ((Action == kPlistStreamSkip) && (SkipDepth == MAX_UINTN)) {
+          SkipDepth = Depth;
+        }
+
+        Depth++;
+      }
+
+      Key = NULL;
+      KeyLen = 0;
+      Ptr = Next;
+      continue;
+    }
+
+    // key / value / unknown element: text up to its closing tag
+    Event.Value = NULL;
+    Event.ValueLen = 0;
+
+    if (!Empty) {
+      CONST CHAR8   *ValueEnd = StreamFindChar (Next, End, '<');
+
+      if (ValueEnd == NULL) {
+        return EFI_LOAD_ERROR;
+      }
+
+      Event.Value = Next;
+      Event.ValueLen = ValueEnd - Next;
+
+      Next = StreamFindChar (ValueEnd, End, '>');
+      if (Next == NULL) {
+        return EFI_LOAD_ERROR;
+      }
+
+      Next++;
+    }
+
+    if (Type == kTagTypeKey) {
+      Key = (Event.Value != NULL) ? Event.Value : Next;
+      KeyLen = Event.ValueLen;
+      Ptr = Next;
+      continue;
+    }
+
+    if (Depth > 0) {
+      Path[Depth - 1].Count++;
+    }
+
+    if ((Type != kTagTypeNone) && (SkipDepth == MAX_UINTN)) {
+      Event.Event = kPlistEventValue;
+      Event.Type = Type;
+      Event.Key = Key;
+      Event.KeyLen = KeyLen;
+      Event.Id = StreamGetAttr (Name + NameLen, TagEnd, " " kXMLTagID "\"");
+      Event.IdRef = StreamGetAttr (Name + NameLen, TagEnd, " " kXMLTagIDREF "\"");
+      Event.Start = Ptr;
+      Event.End = Next;
+      Event.Depth = Depth;
+      Event.Path = Path;
+
+      if (Callback (&Event, Context) == kPlistStreamStop) {
+        return EFI_SUCCESS;
+      }
+    }
+
+    Key = NULL;
+    KeyLen = 0;
+    Ptr = Next;
+  }
+
+  return (Depth == 0) ? EFI_SUCCESS : EFI_LOAD_ERROR;
+}
+
+BOOLEAN
+EFIAPI
+PlistEventKeyIs (
+  IN PLIST_EVENT  *Event,
+  IN CONST CHAR8  *Key
+) {
+  return (
+    (Event->Key != NULL) &&
+    (Event->KeyLen == AsciiStrLen (Key)) &&
+    (CompareMem (Event->Key, Key, Event->KeyLen) == 0)
+  );
+}
+
+//
+// Public
+//
+
+TagPtr
+EFIAPI
+GetProperty (
+  TagPtr  Dict,
+  CHAR8   *Key
+) {
+  TagPtr      TagList, Tag;
+  TAG_INDEX   *Index;
+
+  if (Dict->type != kTagTypeDict) {
+    return 0;
+  }
+
+  Index = GetTagIndex (Dict);
+  if (Index != NULL) {
+    UINT32  Hash = SymbolHash (Key);
+    UINTN   Slot = Hash & (Index->Count - 1);
+
+    while (Index->Items[Slot] != 0) {
+      if ((Index->Hashes[Slot] == Hash) && !AsciiStrCmp (Index->Items[Slot]->string, Key)) {
+        return Index->Items[Slot]->tag;
+      }
+
+      Slot = (Slot + 1) & (Index->Count - 1);
+    }
+
+    return 0;
+  }
+
+  Tag = 0;    // ?
+  TagList = Dict->tag;
+
+  while (TagList) {
+    Tag = TagList;
+    TagList = Tag->tagNext;
+
+    if ((Tag->type != kTagTypeKey) || (Tag->string == 0)) {
+      continue;
+    }
+
+    if (!AsciiStrCmp (Tag->string, Key)) {
+      return Tag->tag;
+    }
+  }
+
+  return 0;
+}
+
+INTN
+EFIAPI
+GetTagCount (
+  TagPtr    Dict
+) {
+  return Dict->size;
+}
+
+EFI_STATUS
+EFIAPI
+GetElement (
+  TagPtr    Dict,
+  INTN      Id,
+  INTN      Count,
+  TagPtr    *Dict1
+) {
+  TagPtr      Child;
+  TAG_INDEX   *Index;
+
+  if (!Dict || !Dict1 || (Dict->type != kTagTypeArray)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  Index = GetTagIndex (Dict);
+  if (Index != NULL) {
+    // list is stored reversed, Count (if given) counts from the tail
+    INTN  Pos = (Count > Id) ? (Count - 1 - Id) : Id;
+
+    *Dict1 = ((Pos >= 0) && ((UINTN)Pos < Index->Count)) ? Index->Items[Pos] : NULL;
+
+    return EFI_SUCCESS;
   }
 
   Child = Dict->tag;
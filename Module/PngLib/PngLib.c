@@ -558,8 +558,16 @@ typedef struct HuffmanTree
   unsigned* lengths; /*the lengths of the codes of the 1d-tree*/
   unsigned maxbitlen; /*maximum number of bits a single code can get*/
   unsigned numcodes; /*number of symbols in the alphabet = number of codes*/
+  /*decoder lookup tables, only for complete codes: FIRSTBITS-bit primary table followed by the
+  subtables of longer codes. table_len is the code length, or for a primary entry pointing to a
+  subtable the longest code length in it, with table_value then the subtable offset*/
+  unsigned char* table_len;
+  unsigned short* table_value;
 } HuffmanTree;
 
+/*bits looked up at once in the primary decoding table*/
+#define FIRSTBITS 9u
+
 /*function used for debug purposes to draw the tree in ascii art with C++*/
 /*
 static void HuffmanTree_draw(HuffmanTree* tree)
@@ -578,6 +586,8 @@ static void HuffmanTree_init(HuffmanTree* tree)
   tree->tree2d = 0;
   tree->tree1d = 0;
   tree->lengths = 0;
+  tree->table_len = 0;
+  tree->table_value = 0;
 }
 
 static void HuffmanTree_cleanup(HuffmanTree* tree)
@@ -585,6 +595,8 @@ static void HuffmanTree_cleanup(HuffmanTree* tree)
   lodepng_free(tree->tree2d);
   lodepng_free(tree->tree1d);
   lodepng_free(tree->lengths);
+  lodepng_free(tree->table_len);
+  lodepng_free(tree->table_value);
 }
 
 /*the tree representation used by the decoder. return value is error*/
@@ -698,16 +710,109 @@ given the code lengths (as stored in the PNG file), generate the tree as defined
 by Deflate. maxbitlen is the maximum bits that a code in the tree can have.
 return value is error.
 */
+#ifdef LODEPNG_COMPILE_DECODER
+static unsigned reverseBits(unsigned bits, unsigned num)
+{
+  unsigned i, result = 0;
+  for(i = 0; i < num; ++i) result |= ((bits >> (num - i - 1)) & 1u) << i;
+  return result;
+}
+
+/*
+Builds the decoder lookup tables from tree1d and lengths. Deflate sends codes starting with their
+most significant bit, so the tables are indexed by the reversed code. Incomplete codes (a single
+code, or a damaged stream) get no tables, the decoder walks tree2d for them as it always did, so
+that they decode the same. return value is error.
+*/
+static unsigned HuffmanTree_makeTable(HuffmanTree* tree)
+{
+  const unsigned headsize = 1u << FIRSTBITS;
+  const unsigned mask = headsize - 1u;
+  unsigned kraft = 0, size, pointer, i, j;
+  unsigned char maxlens[1u << FIRSTBITS];
+
+  for(i = 0; i != tree->numcodes; ++i)
+  {
+    if(tree->lengths[i]) kraft += 1u << (15 - tree->lengths[i]);
+  }
+  if(tree->maxbitlen > 15 || kraft != (1u << 15)) return 0; /*incomplete, keep the tree walk*/
+
+  /*longest code behind each primary entry, that is the size of its subtable*/
+  ZeroMem (maxlens, sizeof(maxlens));
+  for(i = 0; i != tree->numcodes; ++i)
+  {
+    unsigned l = tree->lengths[i];
+    unsigned index;
+    if(l <= FIRSTBITS) continue;
+    index = reverseBits(tree->tree1d[i] >> (l - FIRSTBITS), FIRSTBITS);
+    if(maxlens[index] < l) maxlens[index] = (unsigned char)l;
+  }
+
+  size = headsize;
+  for(i = 0; i != headsize; ++i)
+  {
+    if(maxlens[i]) size += 1u << (maxlens[i] - FIRSTBITS);
+  }
+
+  tree->table_len = (unsigned char*)lodepng_malloc(size * sizeof(*tree->table_len));
+  tree->table_value = (unsigned short*)lodepng_malloc(size * sizeof(*tree->table_value));
+  if(!tree->table_len || !tree->table_value) return 83; /*alloc fail*/
+
+  pointer = headsize;
+  for(i = 0; i != headsize; ++i)
+  {
+    if(!maxlens[i]) continue;
+    tree->table_len[i] = maxlens[i];
+    tree->table_value[i] = (unsigned short)pointer;
+    pointer += 1u << (maxlens[i] - FIRSTBITS);
+  }
+
+  /*a code fills every entry whose low bits are the code; the code being complete, all entries get filled*/
+  for(i = 0; i != tree->numcodes; ++i)
+  {
+    unsigned l = tree->lengths[i];
+    unsigned reverse;
+    if(!l) continue;
+    reverse = reverseBits(tree->tree1d[i], l);
+
+    if(l <= FIRSTBITS)
+    {
+      for(j = reverse; j < headsize; j += 1u << l)
+      {
+        tree->table_len[j] = (unsigned char)l;
+        tree->table_value[j] = (unsigned short)i;
+      }
+    }
+    else
+    {
+      unsigned start = tree->table_value[reverse & mask];
+      unsigned subsize = 1u << (tree->table_len[reverse & mask] - FIRSTBITS);
+      for(j = reverse >> FIRSTBITS; j < subsize; j += 1u << (l - FIRSTBITS))
+      {
+        tree->table_len[start + j] = (unsigned char)l;
+        tree->table_value[start + j] = (unsigned short)i;
+      }
+    }
+  }
+
+  return 0;
+}
+#endif /*LODEPNG_COMPILE_DECODER*/
+
 static unsigned HuffmanTree_makeFromLengths(HuffmanTree* tree, const unsigned* bitlen,
                                             size_t numcodes, unsigned maxbitlen)
 {
-  unsigned i;
+  unsigned i, error;
   tree->lengths = (unsigned*)lodepng_malloc(numcodes * sizeof(unsigned));
   if(!tree->lengths) return 83; /*alloc fail*/
   for(i = 0; i != numcodes; ++i) tree->lengths[i] = bitlen[i];
   tree->numcodes = (unsigned)numcodes; /*number of symbols*/
   tree->maxbitlen = maxbitlen;
-  return HuffmanTree_makeFromLengths2(tree);
+  error = HuffmanTree_makeFromLengths2(tree);
+#ifdef LODEPNG_COMPILE_DECODER
+  if(!error) error = HuffmanTree_makeTable(tree);
+#endif /*LODEPNG_COMPILE_DECODER*/
+  return error;
 }
 
 #ifdef LODEPNG_COMPILE_ENCODER
@@ -988,6 +1093,79 @@ static unsigned generateFixedDistanceTree(HuffmanTree* tree)
 
 #ifdef LODEPNG_COMPILE_DECODER
 
+/*
+returns the 64 bits of in starting at bit position bp (lsb first, so at least 57 valid bits),
+bits past the end of in read as 0. One load covers a whole length/distance pair with its
+extra bits (15 + 5 + 15 + 13 bits at most).
+*/
+static UINT64 loadBits(const unsigned char* in, size_t inlength, size_t bp)
+{
+  size_t p = bp >> 3;
+  UINT64 result = 0;
+  unsigned i;
+
+  if(p + 8 <= inlength)
+  {
+    result = (UINT64)in[p] | ((UINT64)in[p + 1] << 8) | ((UINT64)in[p + 2] << 16) | ((UINT64)in[p + 3] << 24)
+           | ((UINT64)in[p + 4] << 32) | ((UINT64)in[p + 5] << 40) | ((UINT64)in[p + 6] << 48)
+           | ((UINT64)in[p + 7] << 56);
+  }
+  else
+  {
+    for(i = 0; i != 8 && p + i < inlength; ++i) result |= (UINT64)in[p + i] << (8 * i);
+  }
+
+  return result >> (bp & 7);
+}
+
+/*
+decodes one symbol from bits (loaded at *bp), advancing *bp and bits. returns the code, or
+(unsigned)(-1) if error happened, in the same cases and with the same *bp as the bit by bit
+tree walk: end of input reached (*bp is then inbitlength) or a jump outside of the tree
+*/
+static unsigned huffmanDecodeBits(UINT64* bits, size_t* bp, const HuffmanTree* codetree, size_t inbitlength)
+{
+  unsigned ct, len;
+
+  if(codetree->table_len)
+  {
+    unsigned index = (unsigned)*bits & ((1u << FIRSTBITS) - 1u);
+    len = codetree->table_len[index];
+    if(len > FIRSTBITS)
+    {
+      index = codetree->table_value[index] + ((unsigned)(*bits >> FIRSTBITS) & ((1u << (len - FIRSTBITS)) - 1u));
+      len = codetree->table_len[index];
+    }
+    ct = codetree->table_value[index];
+  }
+  else
+  {
+    /*incomplete code, no tables*/
+    unsigned treepos = 0;
+    for(len = 1; ; ++len)
+    {
+      ct = codetree->tree2d[(treepos << 1) + ((unsigned)(*bits >> (len - 1)) & 1u)];
+      if(ct < codetree->numcodes) break; /*the symbol is decoded*/
+      treepos = ct - codetree->numcodes; /*symbol not yet decoded, instead move tree position*/
+      if(treepos >= codetree->numcodes) /*error: it appeared outside the codetree*/
+      {
+        ct = (unsigned)(-1);
+        break;
+      }
+    }
+  }
+
+  if(*bp + len > inbitlength)
+  {
+    *bp = inbitlength;
+    return (unsigned)(-1); /*error: end of input memory reached without endcode*/
+  }
+
+  *bp += len;
+  *bits >>= len;
+  return ct;
+}
+
 /*
 returns the code, or (unsigned)(-1) if error happened
 inbitlength is the length of the complete buffer, in bits (so its byte length times 8)
@@ -995,21 +1173,10 @@ inbitlength is the length of the complete buffer, in bits (so its byte length ti
 static unsigned huffmanDecodeSymbol(const unsigned char* in, size_t* bp,
                                     const HuffmanTree* codetree, size_t inbitlength)
 {
-  unsigned treepos = 0, ct;
-  for(;;)
-  {
-    if(*bp >= inbitlength) return (unsigned)(-1); /*error: end of input memory reached without endcode*/
-    /*
-    decode the symbol from the tree. The "readBitFromStream" code is inlined in
-    the expression below because this is the biggest bottleneck while decoding
-    */
-    ct = codetree->tree2d[(treepos << 1) + READBIT(*bp, in)];
-    ++(*bp);
-    if(ct < codetree->numcodes) return ct; /*the symbol is decoded, return it*/
-    else treepos = ct - codetree->numcodes; /*symbol not yet decoded, instead move tree position*/
-
-    if(treepos >= codetree->numcodes) return (unsigned)(-1); /*error: it appeared outside the codetree*/
-  }
+  UINT64 bits;
+  if(*bp >= inbitlength) return (unsigned)(-1); /*error: end of input memory reached without endcode*/
+  bits = loadBits(in, inbitlength >> 3, *bp);
+  return huffmanDecodeBits(&bits, bp, codetree, inbitlength);
 }
 #endif /*LODEPNG_COMPILE_DECODER*/
 
@@ -1020,11 +1187,10 @@ static unsigned huffmanDecodeSymbol(const unsigned char* in, size_t* bp,
 /* ////////////////////////////////////////////////////////////////////////// */
 
 /*get the tree of a deflated block with fixed tree, as specified in the deflate specification*/
-static void getTreeInflateFixed(HuffmanTree* tree_ll, HuffmanTree* tree_d)
+static unsigned getTreeInflateFixed(HuffmanTree* tree_ll, HuffmanTree* tree_d)
 {
-  /*TODO: check for out of memory errors*/
-  generateFixedLitLenTree(tree_ll);
-  generateFixedDistanceTree(tree_d);
+  CERROR_TRY_RETURN(generateFixedLitLenTree(tree_ll));
+  return generateFixedDistanceTree(tree_d);
 }
 
 /*get the tree of a deflated block with dynamic tree, the tree itself is also Huffman compressed with a known tree*/
@@ -1185,21 +1351,32 @@ static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size
   HuffmanTree tree_ll; /*the huffman tree for literal and length codes*/
   HuffmanTree tree_d; /*the huffman tree for distance codes*/
   size_t inbitlength = inlength * 8;
+  UINT64 bits = 0; /*input bits from *bp on, see loadBits*/
+  size_t bitend = 0; /*bits is valid up to this bit position*/
 
   HuffmanTree_init(&tree_ll);
   HuffmanTree_init(&tree_d);
 
-  if(btype == 1) getTreeInflateFixed(&tree_ll, &tree_d);
+  if(btype == 1) error = getTreeInflateFixed(&tree_ll, &tree_d);
   else if(btype == 2) error = getTreeInflateDynamic(&tree_ll, &tree_d, in, bp, inlength);
 
   while(!error) /*decode all symbols until end reached, breaks at end code*/
   {
     /*code_ll is literal, length or end code*/
-    unsigned code_ll = huffmanDecodeSymbol(in, bp, &tree_ll, inbitlength);
+    unsigned code_ll;
+
+    /*a load lasts for several literals, up to 15 bits each*/
+    if((*bp) + 15 > bitend)
+    {
+      bits = loadBits(in, inlength, *bp);
+      bitend = (*bp) + 56;
+    }
+
+    code_ll = huffmanDecodeBits(&bits, bp, &tree_ll, inbitlength);
     if(code_ll <= 255) /*literal symbol*/
     {
-      /*ucvector_push_back would do the same, but for some reason the two lines below run 10% faster*/
-      if(!ucvector_resize(out, (*pos) + 1)) ERROR_BREAK(83 /*alloc fail*/);
+      /*the reserve grows geometrically, so this is normally just the compare*/
+      if((*pos) >= out->allocsize && !ucvector_reserve(out, (*pos) + 1)) ERROR_BREAK(83 /*alloc fail*/);
       out->data[*pos] = (unsigned char)code_ll;
       ++(*pos);
     }
@@ -1207,7 +1384,14 @@ static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size
     {
       unsigned code_d, distance;
       unsigned numextrabits_l, numextrabits_d; /*extra bits for length and distance*/
-      size_t start, forward, backward, length;
+      size_t start, backward, length, chunk, n;
+
+      /*length extra bits, distance code and distance extra bits need up to 5 + 15 + 13 bits*/
+      if((*bp) + 33 > bitend)
+      {
+        bits = loadBits(in, inlength, *bp);
+        bitend = (*bp) + 56;
+      }
 
       /*part 1: get length base*/
       length = LENGTHBASE[code_ll - FIRST_LENGTH_CODE_INDEX];
@@ -1215,10 +1399,12 @@ static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size
       /*part 2: get extra bits and add the value of that to length*/
       numextrabits_l = LENGTHEXTRA[code_ll - FIRST_LENGTH_CODE_INDEX];
       if((*bp + numextrabits_l) > inbitlength) ERROR_BREAK(51); /*error, bit pointer will jump past memory*/
-      length += readBitsFromStream(bp, in, numextrabits_l);
+      length += (size_t)(bits & ((1u << numextrabits_l) - 1u));
+      *bp += numextrabits_l;
+      bits >>= numextrabits_l;
 
       /*part 3: get distance code*/
-      code_d = huffmanDecodeSymbol(in, bp, &tree_d, inbitlength);
+      code_d = huffmanDecodeBits(&bits, bp, &tree_d, inbitlength);
       if(code_d > 29)
       {
         if(code_ll == (unsigned)(-1)) /*huffmanDecodeSymbol returns (unsigned)(-1) in case of error*/
@@ -1235,23 +1421,34 @@ static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size
       /*part 4: get extra bits from distance*/
       numextrabits_d = DISTANCEEXTRA[code_d];
       if((*bp + numextrabits_d) > inbitlength) ERROR_BREAK(51); /*error, bit pointer will jump past memory*/
-      distance += readBitsFromStream(bp, in, numextrabits_d);
+      distance += (unsigned)(bits & ((1u << numextrabits_d) - 1u));
+      *bp += numextrabits_d;
+      bits >>= numextrabits_d;
 
       /*part 5: fill in all the out[n] values based on the length and dist*/
       start = (*pos);
       if(distance > start) ERROR_BREAK(52); /*too long backward distance*/
       backward = start - distance;
 
-      if(!ucvector_resize(out, (*pos) + length)) ERROR_BREAK(83 /*alloc fail*/);
-      if (distance < length) {
-        for(forward = 0; forward < length; ++forward)
+      if((*pos) + length > out->allocsize && !ucvector_reserve(out, (*pos) + length)) ERROR_BREAK(83 /*alloc fail*/);
+      if(length <= 8)
+      {
+        for(n = 0; n != length; ++n) out->data[(*pos)++] = out->data[backward++];
+      }
+      else
+      {
+        /*
+        copy in chunks that never overlap their source: out[backward, *pos) repeats with period
+        distance, so each copied chunk extends the source for the next one (distance, 2 * distance, ...)
+        */
+        while(length)
         {
-          out->data[(*pos)++] = out->data[backward++];
+          chunk = (*pos) - backward; /*whole repeating part so far*/
+          n = chunk < length ? chunk : length;
+          CopyMem(out->data + *pos, out->data + backward, n);
+          *pos += n;
+          length -= n;
         }
-      } else {
-        //memcpy(out->data + *pos, out->data + backward, length);
-        CopyMem(out->data + *pos, out->data + backward, length);
-        *pos += length;
       }
     }
     else if(code_ll == 256)
@@ -1267,6 +1464,9 @@ static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size
     }
   }
 
+  /*the output was only reserved above, bring the size up to date*/
+  if(out->size < (*pos)) out->size = (*pos);
+
   HuffmanTree_cleanup(&tree_ll);
   HuffmanTree_cleanup(&tree_d);
 
@@ -4130,6 +4330,56 @@ static unsigned unfilter(unsigned char* out, const unsigned char* in, unsigned w
   return 0;
 }
 
+/*turns 8-bit RGBA pixels into BGRA (EFI_GRAPHICS_OUTPUT_BLT_PIXEL order) in place, optionally
+premultiplying the color channels by alpha*/
+static void rgbaToBgra(unsigned char* p, size_t numpixels, unsigned premultiply)
+{
+  size_t i;
+  unsigned char t;
+
+  for(i = 0; i != numpixels; ++i, p += 4)
+  {
+    t = p[0];
+    p[0] = p[2];
+    p[2] = t;
+
+    if(premultiply && p[3] != 255)
+    {
+      p[0] = (unsigned char)((p[0] * p[3] + 127) / 255);
+      p[1] = (unsigned char)((p[1] * p[3] + 127) / 255);
+      p[2] = (unsigned char)((p[2] * p[3] + 127) / 255);
+    }
+  }
+}
+
+/*
+unfilter for a non-interlaced 8-bit RGBA image that outputs BGRA: each row is reordered as soon as
+the next row, which needs it unchanged as precon, has been unfiltered, while it is still in cache
+*/
+static unsigned unfilterBGRA(unsigned char* out, const unsigned char* in, unsigned w, unsigned h,
+                             unsigned premultiply)
+{
+  unsigned y;
+  unsigned char* prevline = 0;
+  size_t linebytes = (size_t)w * 4;
+
+  for(y = 0; y < h; ++y)
+  {
+    size_t outindex = linebytes * y;
+    size_t inindex = (1 + linebytes) * y; /*the extra filterbyte added to each row*/
+    unsigned char filterType = in[inindex];
+
+    CERROR_TRY_RETURN(unfilterScanline(&out[outindex], &in[inindex + 1], prevline, 4, filterType, linebytes));
+
+    if(prevline) rgbaToBgra(prevline, w, premultiply);
+    prevline = &out[outindex];
+  }
+
+  if(prevline) rgbaToBgra(prevline, w, premultiply);
+
+  return 0;
+}
+
 /*
 in: Adam7 interlaced image, with no padding bits between scanlines, but between
  reduced images so that each reduced image starts at a byte.
@@ -4578,9 +4828,12 @@ static unsigned readChunk_pHYs(LodePNGInfo* info, const unsigned char* data, siz
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
 
 /*read a PNG, the result will be in the same color type as the PNG (hence "generic")*/
+/*bgra: if not NULL and the PNG is non-interlaced 8-bit RGBA, the image is unfiltered straight into
+this buffer as BGRA (w * h * 4 bytes) and *out is left NULL*/
 static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
                           LodePNGState* state,
-                          const unsigned char* in, size_t insize)
+                          const unsigned char* in, size_t insize,
+                          unsigned char* bgra, unsigned premultiply)
 {
   unsigned char IEND = 0;
   const unsigned char* chunk;
@@ -4765,17 +5018,25 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
   }
   ucvector_cleanup(&idat);
 
-  if(!state->error)
+  if(bgra && state->info_png.interlace_method == 0
+     && state->info_png.color.colortype == LCT_RGBA && state->info_png.color.bitdepth == 8)
   {
-    outsize = lodepng_get_raw_size(*w, *h, &state->info_png.color);
-    *out = (unsigned char*)lodepng_malloc(outsize);
-    if(!*out) state->error = 83; /*alloc fail*/
+    if(!state->error) state->error = unfilterBGRA(bgra, scanlines.data, *w, *h, premultiply);
   }
-  if(!state->error)
+  else
   {
-    //for(i = 0; i < outsize; i++) (*out)[i] = 0;
-    ZeroMem (*out, outsize);
-    state->error = postProcessScanlines(*out, scanlines.data, *w, *h, &state->info_png);
+    if(!state->error)
+    {
+      outsize = lodepng_get_raw_size(*w, *h, &state->info_png.color);
+      *out = (unsigned char*)lodepng_malloc(outsize);
+      if(!*out) state->error = 83; /*alloc fail*/
+    }
+    if(!state->error)
+    {
+      //for(i = 0; i < outsize; i++) (*out)[i] = 0;
+      ZeroMem (*out, outsize);
+      state->error = postProcessScanlines(*out, scanlines.data, *w, *h, &state->info_png);
+    }
   }
   ucvector_cleanup(&scanlines);
 }
@@ -4785,7 +5046,7 @@ unsigned lodepng_decode(unsigned char** out, unsigned* w, unsigned* h,
                         const unsigned char* in, size_t insize)
 {
   *out = 0;
-  decodeGeneric(out, w, h, state, in, insize);
+  decodeGeneric(out, w, h, state, in, insize, 0, 0);
   if(state->error) return state->error;
   if(!state->decoder.color_convert || lodepng_color_mode_equal(&state->info_raw, &state->info_png.color))
   {
@@ -4850,6 +5111,36 @@ unsigned lodepng_decode24(unsigned char** out, unsigned* w, unsigned* h, const u
   return lodepng_decode_memory(out, w, h, in, insize, LCT_RGB, 8);
 }
 
+unsigned
+EFIAPI
+lodepng_decode_bgra(unsigned char* out, unsigned w, unsigned h, const unsigned char* in, size_t insize,
+                    unsigned premultiply)
+{
+  unsigned error;
+  unsigned char* raw = 0;
+  unsigned rw = 0, rh = 0;
+  LodePNGState state;
+
+  lodepng_state_init(&state);
+  state.error = lodepng_inspect(&rw, &rh, &state, in, insize);
+  if(!state.error && (rw != w || rh != h)) state.error = 95;
+  if(!state.error) decodeGeneric(&raw, &rw, &rh, &state, in, insize, out, premultiply);
+
+  if(!state.error && raw)
+  {
+    /*not unfiltered straight into out: convert to 8-bit RGBA there, then reorder in place*/
+    state.info_raw.colortype = LCT_RGBA;
+    state.info_raw.bitdepth = 8;
+    state.error = lodepng_convert(out, raw, &state.info_raw, &state.info_png.color, w, h);
+    if(!state.error) rgbaToBgra(out, (size_t)w * h, premultiply);
+  }
+
+  lodepng_free(raw);
+  error = state.error;
+  lodepng_state_cleanup(&state);
+  return error;
+}
+
 #ifdef LODEPNG_COMPILE_DISK
 unsigned lodepng_decode_file(unsigned char** out, unsigned* w, unsigned* h, const char* filename,
                              LodePNGColorType colortype, unsigned bitdepth)
@@ -6063,6 +6354,7 @@ const char* lodepng_error_text(unsigned code)
     case 92: return "too many pixels, not supported";
     case 93: return "zero width or height is invalid";
     case 94: return "header chunk must have a size of 13 bytes";
+    case 95: return "image size differs from the size of the given output buffer";
   }
   return "unknown error code";
 }
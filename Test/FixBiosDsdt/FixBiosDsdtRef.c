@@ -0,0 +1,391 @@
+/*
+ * FixAny () as it was before the DsdtEdit rewrite: one MoveData () +
+ * CorrectOuterMethod () + CorrectOuters () per match. Kept verbatim, names
+ * prefixed with Ref, as the reference FixBiosDsdtTest.c compares against.
+ * Two fixes are marked "changed": RefFindBin () read past the table, and
+ * RefFixAny () lost its place when a PkgLength changed width.
+ */
+
+#include <Library/Platform/AmlGenerator.h>
+
+#define DBG(...)
+
+STATIC
+BOOLEAN
+RefCmpNum (
+  UINT8     *Dsdt,
+  INT32     i,
+  BOOLEAN   Sure
+) {
+  return  (
+            (Sure &&  (
+                        (Dsdt[i - 1] == 0x0A) ||
+                        (Dsdt[i - 2] == 0x0B) ||
+                        (Dsdt[i - 4] == 0x0C)
+                      )
+            ) ||
+            (!Sure && (
+                        ((Dsdt[i - 1] >= 0x0A) && (Dsdt[i - 1] <= 0x0C)) ||
+                        ((Dsdt[i - 2] == 0x0B) || (Dsdt[i - 2] == 0x0C)) ||
+                        (Dsdt[i - 4] == 0x0C)
+                      )
+            )
+          );
+}
+
+STATIC
+UINT32
+RefMoveData (
+  UINT32    Start,
+  UINT8     *Buffer,
+  UINT32    Len,
+  INT32     Offset
+) {
+  UINT32    i;
+
+  if (Offset < 0) {
+    for (i = Start; i < Len + Offset; i++) {
+      Buffer[i] = Buffer[i - Offset];
+    }
+  } else { // data move to back
+    for (i = Len - 1; i >= Start; i--) {
+      Buffer[i + Offset] = Buffer[i];
+    }
+  }
+
+  return Len + Offset;
+}
+
+STATIC
+UINT32
+RefAcpiGetSize (
+  UINT8     *Buffer,
+  UINT32    Adr
+) {
+  UINT32    Temp;
+
+  Temp = Buffer[Adr] & 0xF0; //keep bits 0x30 to check if this is valid size field
+
+  if (Temp <= 0x30)  {          // 0
+    Temp = Buffer[Adr];
+  } else if (Temp == 0x40) {    // 4
+    Temp =  (Buffer[Adr]   - 0x40)    <<  0 |
+             Buffer[Adr + 1]          <<  4;
+  } else if (Temp == 0x80) {    // 8
+    Temp = (Buffer[Adr]   - 0x80)     <<  0 |
+            Buffer[Adr + 1]           <<  4 |
+            Buffer[Adr + 2]           << 12;
+  } else if (Temp == 0xC0) {    // C
+    Temp = (Buffer[Adr]   - 0xC0)     <<  0 |
+            Buffer[Adr + 1]           <<  4 |
+            Buffer[Adr + 2]           << 12 |
+            Buffer[Adr + 3]           << 20;
+  } else {
+    //DBG ("wrong pointer to size field at %x\n", Adr);
+    return 0;
+  }
+
+  return Temp;
+}
+
+STATIC
+INT32
+RefWriteSize (
+  UINT32  Adr,
+  UINT8   *Buffer,
+  UINT32  Len,
+  INT32   SizeOffset
+) {
+  UINT32  Size, OldSize;
+  INT32   Offset = 0;
+
+  OldSize = RefAcpiGetSize (Buffer, Adr);
+  if (!OldSize) {
+    return 0; //wrong address, will not write here
+  }
+
+  Size = OldSize + SizeOffset;
+  // data move to back
+  if ((OldSize <= 0x3f) && (Size > 0x0fff)) {
+    Offset = 2;
+  } else if (((OldSize <= 0x3f) && (Size > 0x3f)) || ((OldSize <= 0x0fff) && (Size > 0x0fff))) {
+    Offset = 1;
+  } else if (((Size <= 0x3f) && (OldSize > 0x3f)) || ((Size <= 0x0fff) && (OldSize > 0x0fff))) {
+    // data move to front
+    Offset = -1;
+  } else if ((OldSize > 0x0fff) && (Size <= 0x3f)) {
+    Offset = -2;
+  }
+
+  Len = RefMoveData (Adr, Buffer, Len, Offset);
+  Size += Offset;
+  AmlWriteSize (Size, (CHAR8 *)Buffer, Adr); //reuse existing codes
+
+  return Offset;
+}
+
+STATIC
+BOOLEAN
+RefGetName (
+  IN  UINT8   *Dsdt,
+  IN  INT32   Adr,
+  IN  CHAR8   *Name,
+  OUT INTN    *Shift
+) {
+  INT32 i, j = (Dsdt[Adr] == 0x5C) ? 1 : 0; //now we accept \NAME
+
+  if (!Name) {
+    return FALSE;
+  }
+
+  for (i = Adr + j; i < Adr + j + 4; i++) {
+    if (
+      (Dsdt[i] < 0x2F) ||
+      ((Dsdt[i] > 0x39) && (Dsdt[i] < 0x41)) ||
+      ((Dsdt[i] > 0x5A) && (Dsdt[i] != 0x5F))
+    ) {
+      return FALSE;
+    }
+
+    Name[i - Adr - j] = Dsdt[i];
+  }
+
+  Name[4] = 0;
+  if (Shift) {
+    *Shift = j;
+  }
+
+  return TRUE;
+}
+
+STATIC
+INT32
+RefFindBin (
+  UINT8   *Bin,
+  UINT32  BinLen,
+  UINT8   *Pattern,
+  UINT32  PatternLen
+) {
+  UINT32    i, j;
+  BOOLEAN   Eq;
+
+  // changed: BinLen - PatternLen used to wrap and read past the table
+  if (BinLen <= PatternLen) {
+    return -1;
+  }
+
+  for (i = 0; i < BinLen - PatternLen; i++) {
+    Eq = TRUE;
+
+    for (j = 0; j < PatternLen; j++) {
+      if (Bin[i + j] != Pattern[j]) {
+        Eq = FALSE;
+        break;
+      }
+    }
+
+    if (Eq) {
+      return (INT32)i;
+    }
+  }
+
+  return -1;
+}
+
+STATIC
+UINT32
+RefCorrectOuterMethod (
+  UINT8   *Dsdt,
+  UINT32  Len,
+  UINT32  Adr,
+  INT32   Shift
+) {
+  INT32     i,  k, Offset = 0;
+  UINT32    Size = 0;
+  CHAR8     Name[5];
+
+  if (Shift == 0) {
+    return Len;
+  }
+
+  i = Adr; //usually Adr = @5B - 1 = Sizefield - 3
+  while (i-- > 0x20) {  //find method that previous to Adr
+    k = i + 1;
+
+    if ((Dsdt[i] == 0x14) && !RefCmpNum (Dsdt, i, FALSE)) { //method candidate
+      Size = RefAcpiGetSize (Dsdt, k);
+
+      if (!Size) {
+        continue;
+      }
+
+      if (
+        ((Size <= 0x3F) && !RefGetName (Dsdt, k + 1, &Name[0], NULL)) ||
+        ((Size > 0x3F) && (Size <= 0xFFF) && !RefGetName (Dsdt, k + 2, &Name[0], NULL)) ||
+        ((Size > 0xFFF) && !RefGetName (Dsdt, k + 3, &Name[0], NULL))
+      ) {
+        DBG ("method found, size = 0x%x but name is not\n", Size);
+        continue;
+      }
+
+      if ((k + Size) > (Adr + 4)) {  //Yes - it is outer
+        DBG ("found outer method %a begin=%x end=%x\n", Name, k, k + Size);
+        Offset = RefWriteSize (k, Dsdt, Len, Shift);  //size corrected to sizeOffset at address j
+        //Shift += Offset;
+        Len += Offset;
+      }  //else not an outer method
+      break;
+    }
+  }
+
+  return Len;
+}
+
+STATIC
+UINT32
+RefCorrectOuters (
+  UINT8     *Dsdt,
+  UINT32    Len,
+  UINT32    Adr,
+  INT32     Shift
+) {
+  INT32     i, j, k, Offset = 0;
+  UINT32    SBSIZE = 0, SBADR = 0, Size = 0;
+  BOOLEAN   SBFound = FALSE;
+
+  if (Shift == 0) {
+    return Len;
+  }
+
+  i = Adr; //usually Adr = @5B - 1 = Sizefield - 3
+
+  while (i > 0x20) {  //find devices that previous to Adr
+    //check device
+    k = i + 2;
+    if (
+      (Dsdt[i] == 0x5B) &&
+      (Dsdt[i + 1] == 0x82) &&
+      !RefCmpNum (Dsdt, i, TRUE)
+    ) { //device candidate
+      Size = RefAcpiGetSize (Dsdt, k);
+      if (Size) {
+        if ((k + Size) > (Adr + 4)) {  //Yes - it is outer
+          //DBG ("found outer device begin=%x end=%x\n", k, k + Size);
+          Offset = RefWriteSize (k, Dsdt, Len, Shift);  //Size corrected to SizeOffset at address j
+          Shift += Offset;
+          Len += Offset;
+        }  //else not an outer device
+      } //else wrong Size field - not a device
+    } //else not a device
+
+    // check scope
+    // a problem 45 43 4F 4E 08   10 84 10 05 5F 53 42 5F
+    SBSIZE = 0;
+
+    if (
+      (Dsdt[i] == '_') &&
+      (Dsdt[i + 1] == 'S') &&
+      (Dsdt[i + 2] == 'B') &&
+      (Dsdt[i + 3] == '_')
+    ) {
+      for (j = 0; j < 10; j++) {
+        if (Dsdt[i - j] != 0x10) {
+          continue;
+        }
+
+        if (!RefCmpNum (Dsdt, i - j, TRUE)) {
+          SBADR = i - j + 1;
+          SBSIZE = RefAcpiGetSize (Dsdt, SBADR);
+
+          //DBG ("found Scope (\\_SB) address = 0x%08x Size = 0x%08x\n", SBADR, SBSIZE);
+
+          if ((SBSIZE != 0) && (SBSIZE < Len)) {  //if zero or too large then search more
+            //if found
+            k = SBADR - 6;
+
+            if ((SBADR + SBSIZE) > Adr + 4) {  //Yes - it is outer
+              //DBG ("found outer scope begin=%x end=%x\n", SBADR, SBADR + SBSIZE);
+              Offset = RefWriteSize (SBADR, Dsdt, Len, Shift);
+              Shift += Offset;
+              Len += Offset;
+              SBFound = TRUE;
+              break;  //SB found
+            }  //else not an outer scope
+          }
+        }
+      }
+    } //else not a scope
+
+    if (SBFound) {
+      break;
+    }
+
+    i = k - 3;    //if found then search again from found
+  }
+
+  return Len;
+}
+
+UINT32
+RefFixAny (
+  UINT8     *Dsdt,
+  UINT32    Len,
+  UINT8     *ToFind,
+  UINT32    LenTF,
+  UINT8     *ToReplace,
+  UINT32    LenTR
+) {
+  INT32     SizeOffset, Adr;
+  UINT32    i, Moved;
+  BOOLEAN   Found = FALSE;
+
+  if (!ToFind || !LenTF || !LenTR) {
+    MsgLog (" invalid patches!\n");
+    return Len;
+  }
+
+  //DBG (" pattern %02x%02x%02x%02x,", ToFind[0], ToFind[1], ToFind[2], ToFind[3]);
+
+  if ((LenTF + sizeof (EFI_ACPI_DESCRIPTION_HEADER)) > Len) {
+    MsgLog (" the patch is too large!\n");
+    return Len;
+  }
+
+  SizeOffset = LenTR - LenTF;
+
+  for (i = 20; i < Len; ) {
+    Adr = RefFindBin (Dsdt + i, Len - i, ToFind, LenTF);
+    if (Adr < 0) {
+      if (Found) {
+        DBG (" ]");
+        MsgLog ("\n");
+      } else {
+        MsgLog (" bin not Found / already patched!\n");
+      }
+
+      return Len;
+    }
+
+    if (!Found) {
+      MsgLog (" patched");
+      DBG (" at: [");
+    }
+
+    DBG (" (%x)", Adr);
+    Found = TRUE;
+
+    Len = RefMoveData (Adr + i, Dsdt, Len, SizeOffset);
+    if ((LenTR > 0) && (ToReplace != NULL)) {
+      CopyMem (Dsdt + Adr + i, ToReplace, LenTR);
+    }
+
+    Moved = Len;
+    Len = RefCorrectOuterMethod (Dsdt, Len, Adr + i - 2, SizeOffset);
+    Len = RefCorrectOuters (Dsdt, Len, Adr + i - 3, SizeOffset);
+    // changed: the replacement moves too when an outer PkgLength grows or
+    // shrinks, this used to go on scanning from inside (or after) it
+    i += Adr + LenTR + (Len - Moved);
+  }
+
+  return Len;
+}
@@ -0,0 +1,841 @@
+/*
+ * Host test for the DSDT binary patching in Library/Platform/FixBiosDsdt.c.
+ *
+ * FixAny () edits through DsdtEdit (one pass for all matches of a patch),
+ * FixBiosDsdtRef.c keeps the old MoveData () + CorrectOuters () per match
+ * code. Every patch of a list is run through both, on the same table, and
+ * PatchBinACPI () (the whole list in batches) has to give exactly what
+ * FixAny () one patch after the other does.
+ *
+ * Tables are generated: nested Scope / Device / Method with PkgLengths of
+ * all widths and strings for the patches to hit. A FixAny () result has
+ * to be byte-identical to the old one, or else parse back with
+ * every PkgLength right where the old one does not: the old code loses a
+ * byte when a method PkgLength grows a byte inside a device. Both go wrong
+ * when a PkgLength byte reads as a method opcode (the CmpNum () and
+ * FindOuterMethod () heuristics they share), those are only counted.
+ *
+ * PatchBinACPI () is run again with every pool allocation failing in turn
+ * (HostFailAfter), it has to fall back and still give the same table.
+ *
+ * AML files given on the command line get same-length patches only (no
+ * PkgLength changes, nothing to parse them with) and have to come out
+ * byte-identical.
+ *
+ *   cc -I Test/FixBiosDsdt/Include -o FixBiosDsdtTest \
+ *     Test/FixBiosDsdt/FixBiosDsdtTest.c Test/FixBiosDsdt/FixBiosDsdtRef.c \
+ *     Library/Platform/FixBiosDsdt.c Library/Platform/PatternMatcher.c \
+ *     Library/Platform/AmlGenerator.c
+ *   ./FixBiosDsdtTest [Seeds] [DSDT.aml ...]
+ */
+
+#include <Library/Platform/AmlGenerator.h>
+
+UINT32
+RefFixAny (
+  UINT8     *Dsdt,
+  UINT32    Len,
+  UINT8     *ToFind,
+  UINT32    LenTF,
+  UINT8     *ToReplace,
+  UINT32    LenTR
+);
+
+SETTINGS_DATA       gSettings;
+EFI_BOOT_SERVICES   *gBS = NULL;
+EFI_GUID            gEfiPciIoProtocolGuid;
+UINT8               gAcpiCPUCount = 0;
+CHAR8               *gAcpiCPUName[32];
+CHAR8               *gAcpiCPUScore = NULL;
+INTN                HostFailAfter = -1;
+
+//
+// Only the FIX* passes use these, they are not run here.
+//
+
+STATIC
+VOID
+NotReached (
+  CONST CHAR8   *Name
+) {
+  fprintf (stderr, "%s () is not expected to be called\n", Name);
+  abort ();
+}
+
+UINTN AsciiSPrint (CHAR8 *Buffer, UINTN Size, CONST CHAR8 *Format, ...) { NotReached (__func__); return 0; }
+VOID AsciiStrCpyS (CHAR8 *Dst, UINTN Size, CONST CHAR8 *Src) { NotReached (__func__); }
+CHAR8 *AsciiStrToLower (CHAR8 *Str) { NotReached (__func__); return Str; }
+CHAR8 *AsciiStrToUpper (CHAR8 *Str) { NotReached (__func__); return Str; }
+CHAR8 *Bytes2HexStr (UINT8 *Data, UINTN Len) { NotReached (__func__); return NULL; }
+UINT32 GetCrc32 (UINT8 *Data, UINTN Size) { NotReached (__func__); return 0; }
+UINT8 Checksum8 (VOID *StartPtr, UINT32 Len) { NotReached (__func__); return 0; }
+BOOLEAN IsHDMIAudio (EFI_HANDLE Handle) { NotReached (__func__); return FALSE; }
+EFI_DEVICE_PATH_PROTOCOL *DuplicateDevicePath (EFI_DEVICE_PATH_PROTOCOL *DevicePath) { NotReached (__func__); return NULL; }
+EFI_DEVICE_PATH_PROTOCOL *DevicePathFromHandle (EFI_HANDLE Handle) { NotReached (__func__); return NULL; }
+EFI_DEVICE_PATH_PROTOCOL *NextDevicePathNode (EFI_DEVICE_PATH_PROTOCOL *Node) { NotReached (__func__); return NULL; }
+BOOLEAN IsDevicePathEndType (EFI_DEVICE_PATH_PROTOCOL *Node) { NotReached (__func__); return TRUE; }
+CHAR16 *DevicePathToStr (EFI_DEVICE_PATH_PROTOCOL *DevicePath) { NotReached (__func__); return NULL; }
+
+//
+// Table generator
+//
+
+#define TEST_MAX_TABLE    0x20000
+#define TEST_SLACK        0x40000
+#define TEST_MAX_PATCHES  24
+#define TEST_MAX_FAILS    256
+
+STATIC UINT64   mRandom;
+
+STATIC
+UINT32
+Random (
+  UINT32  Range
+) {
+  mRandom ^= mRandom << 13;
+  mRandom ^= mRandom >> 7;
+  mRandom ^= mRandom << 17;
+
+  return (UINT32)((mRandom >> 16) % Range);
+}
+
+//
+// Strings are made of these, so patches have several hits that sit in
+// methods, devices and scopes of every size. Patches only use [a-z0-9],
+// no two such bytes follow each other outside strings: no hit can touch
+// an opcode, a name or a PkgLength.
+//
+STATIC CHAR8  *mTokens[] = {
+  "gfx0", "hdas", "xhci", "ehc1", "lpcb", "igpu", "osi",  "osys",
+  "peg0", "rp05", "arpt", "sat0", "ab",   "abc",  "b0",   "z9"
+};
+
+STATIC
+BOOLEAN
+IsPatchChar (
+  UINT8   Byte
+) {
+  return ((Byte >= 'a') && (Byte <= 'z')) || IS_DIGIT (Byte);
+}
+
+STATIC
+BOOLEAN
+IsNameChar (
+  UINT8   Byte
+) {
+  return IS_UPPER (Byte) || IS_DIGIT (Byte) || (Byte == '_');
+}
+
+STATIC
+UINT8
+RandomPatchChar () {
+  return Random (5) ? (UINT8)('a' + Random (26)) : (UINT8)('0' + Random (10));
+}
+
+typedef struct {
+  UINT8     *Data;
+  UINT32    Len;
+} TEST_BUFFER;
+
+STATIC
+VOID
+Emit (
+  TEST_BUFFER   *Out,
+  CONST VOID    *Data,
+  UINT32        Len
+) {
+  if ((Out->Len + Len) > TEST_MAX_TABLE) {
+    fprintf (stderr, "generated table too large\n");
+    exit (2);
+  }
+
+  memcpy (Out->Data + Out->Len, Data, Len);
+  Out->Len += Len;
+}
+
+STATIC
+VOID
+EmitByte (
+  TEST_BUFFER   *Out,
+  UINT8         Byte
+) {
+  Emit (Out, &Byte, 1);
+}
+
+STATIC
+VOID
+EmitName (
+  TEST_BUFFER   *Out
+) {
+  CHAR8   Name[4];
+  UINTN   i;
+
+  for (i = 0; i < 4; i++) {
+    Name[i] = (CHAR8)('A' + Random (26));
+  }
+
+  Emit (Out, Name, 4);
+}
+
+STATIC
+VOID
+EmitString (
+  TEST_BUFFER   *Out,
+  UINT32        Len
+) {
+  CHAR8   *Token;
+  UINT32  Start = Out->Len;
+
+  EmitByte (Out, AML_CHUNK_STRING);
+
+  while ((Out->Len - Start - 1) < Len) {
+    if (Random (3) == 0) {
+      EmitByte (Out, RandomPatchChar ());
+    } else {
+      Token = mTokens[Random (ARRAY_SIZE (mTokens))];
+      Emit (Out, Token, (UINT32)AsciiStrLen (Token));
+    }
+  }
+
+  EmitByte (Out, 0);
+}
+
+STATIC
+VOID
+EmitPkgLength (
+  TEST_BUFFER   *Out,
+  UINT32        Content
+) {
+  UINT32  Width, Size;
+
+  for (Width = 1; Width < 4; Width++) {
+    Size = Content + Width;
+    if (Size <= ((Width == 1) ? 0x3F : (1U << (4 + 8 * (Width - 1))) - 1)) {
+      break;
+    }
+  }
+
+  Size = Content + Width;
+  if (Width == 1) {
+    EmitByte (Out, (UINT8)Size);
+    return;
+  }
+
+  EmitByte (Out, (UINT8)(((Width - 1) << 6) | (Size & 0x0F)));
+  for (Size >>= 4; --Width > 0; Size >>= 8) {
+    EmitByte (Out, (UINT8)Size);
+  }
+}
+
+STATIC
+UINT32
+StringLength () {
+  switch (Random (8)) {
+    case 0:
+      return 200 + Random (1800);
+    case 1:
+    case 2:
+      return 40 + Random (40);
+    default:
+      return 1 + Random (30);
+  }
+}
+
+STATIC
+VOID
+EmitTermList (
+  TEST_BUFFER   *Out,
+  UINT32        Depth,
+  BOOLEAN       InMethod
+);
+
+STATIC
+VOID
+EmitPackage (
+  TEST_BUFFER   *Out,
+  CONST UINT8   *Op,
+  UINT32        OpLen,
+  UINT32        Depth,
+  BOOLEAN       IsMethod
+) {
+  TEST_BUFFER   Body;
+  UINT8         Buffer[TEST_MAX_TABLE];
+
+  Body.Data = Buffer;
+  Body.Len = 0;
+
+  EmitName (&Body);
+  if (IsMethod) {
+    EmitByte (&Body, (UINT8)Random (8));
+  }
+
+  EmitTermList (&Body, Depth + 1, IsMethod);
+
+  Emit (Out, Op, OpLen);
+  EmitPkgLength (Out, Body.Len);
+  Emit (Out, Body.Data, Body.Len);
+}
+
+STATIC
+VOID
+EmitTermList (
+  TEST_BUFFER   *Out,
+  UINT32        Depth,
+  BOOLEAN       InMethod
+) {
+  STATIC CONST UINT8  MethodOp[] = { AML_CHUNK_METHOD };
+  STATIC CONST UINT8  DeviceOp[] = { AML_CHUNK_OP, AML_CHUNK_DEVICE };
+  UINT32              Count, i;
+
+  Count = 1 + Random ((Depth < 2) ? 6 : 4);
+
+  for (i = 0; i < Count; i++) {
+    switch (InMethod ? Random (2) : Random (5)) {
+      case 0:
+        // Store ("...", Local0)
+        EmitByte (Out, AML_STORE_OP);
+        EmitString (Out, StringLength ());
+        EmitByte (Out, AML_LOCAL0);
+        break;
+
+      case 1:
+        // Return ("...") or Name (XXXX, "...")
+        if (InMethod) {
+          EmitByte (Out, AML_CHUNK_RETURN);
+        } else {
+          EmitByte (Out, AML_CHUNK_NAME);
+          EmitName (Out);
+        }
+
+        EmitString (Out, StringLength ());
+        break;
+
+      case 2:
+        // Name (_ADR, 0x001N000M), no 0x0A..0x0C: CmpNum () would take
+        // a device or method behind it for a number
+        Emit (Out, "\x08_ADR\x0C", 6);
+        EmitByte (Out, (UINT8)Random (8));
+        EmitByte (Out, 0);
+        EmitByte (Out, (UINT8)(0x10 + Random (0x10)));
+        EmitByte (Out, 0);
+        break;
+
+      case 3:
+        EmitPackage (Out, MethodOp, sizeof (MethodOp), Depth, TRUE);
+        break;
+
+      default:
+        if (Depth < 4) {
+          EmitPackage (Out, DeviceOp, sizeof (DeviceOp), Depth, FALSE);
+        }
+        break;
+    }
+  }
+}
+
+STATIC
+UINT32
+GenerateTable (
+  UINT8   *Dsdt
+) {
+  TEST_BUFFER                   Out, Body;
+  EFI_ACPI_DESCRIPTION_HEADER   *Header;
+  UINT8                         Buffer[TEST_MAX_TABLE];
+
+  Out.Data = Dsdt;
+  Out.Len = 0;
+  ZeroMem (Dsdt, sizeof (EFI_ACPI_DESCRIPTION_HEADER));
+  Out.Len = sizeof (EFI_ACPI_DESCRIPTION_HEADER);
+
+  // Scope (\_SB) { ... }
+  Body.Data = Buffer;
+  Body.Len = 0;
+  Emit (&Body, "\\_SB_", 5);
+  EmitTermList (&Body, 0, FALSE);
+
+  EmitByte (&Out, AML_CHUNK_SCOPE);
+  EmitPkgLength (&Out, Body.Len);
+  Emit (&Out, Body.Data, Body.Len);
+
+  // and a few methods at the root
+  EmitTermList (&Out, 2, FALSE);
+
+  Header = (EFI_ACPI_DESCRIPTION_HEADER *)Dsdt;
+  memcpy (&Header->Signature, "DSDT", 4);
+  Header->Length = Out.Len;
+  Header->Revision = 2;
+
+  return Out.Len;
+}
+
+//
+// Patch lists
+//
+
+STATIC UINT8  mFind[TEST_MAX_PATCHES][16];
+STATIC UINT8  mReplace[TEST_MAX_PATCHES][96];
+
+STATIC
+UINT32
+PickFind (
+  UINT8     *Dsdt,
+  UINT32    Len,
+  UINT8     *Find,
+  BOOLEAN   Generated
+) {
+  CHAR8   *Token;
+  UINT32  FindLen, Adr, i, j;
+
+  if (!Generated) {
+    // names and the like of a real table
+    FindLen = 2 + Random (7);
+
+    for (i = 0; i < 64; i++) {
+      Adr = sizeof (EFI_ACPI_DESCRIPTION_HEADER) + Random (Len - sizeof (EFI_ACPI_DESCRIPTION_HEADER) - FindLen);
+
+      for (; (Adr + FindLen) < Len; Adr++) {
+        for (j = 0; (j < FindLen) && IsNameChar (Dsdt[Adr + j]); j++);
+
+        if (j == FindLen) {
+          memcpy (Find, Dsdt + Adr, FindLen);
+          return FindLen;
+        }
+      }
+    }
+
+    memcpy (Find, "_OSI", 4);
+    return 4;
+  }
+
+  if (Random (2) == 0) {
+    Token = mTokens[Random (ARRAY_SIZE (mTokens))];
+    FindLen = (UINT32)AsciiStrLen (Token);
+    memcpy (Find, Token, FindLen);
+    return FindLen;
+  }
+
+  // a piece of a string in the table
+  FindLen = 2 + Random (7);
+
+  for (i = 0; i < 64; i++) {
+    Adr = sizeof (EFI_ACPI_DESCRIPTION_HEADER) + Random (Len - sizeof (EFI_ACPI_DESCRIPTION_HEADER) - FindLen);
+
+    for (; (Adr + FindLen) < Len; Adr++) {
+      for (j = 0; (j < FindLen) && IsPatchChar (Dsdt[Adr + j]); j++);
+
+      if (j == FindLen) {
+        memcpy (Find, Dsdt + Adr, FindLen);
+        return FindLen;
+      }
+    }
+  }
+
+  memcpy (Find, "osys", 4);
+  return 4;
+}
+
+STATIC
+UINT32
+PickReplace (
+  UINT8     *Replace,
+  UINT32    FindLen,
+  UINT32    Index,
+  BOOLEAN   Generated
+) {
+  UINT32  Len, i, Other;
+
+  switch (Generated ? Random (6) : 0) {
+    case 0:
+    case 1:
+      Len = FindLen;
+      break;
+
+    case 2:
+      Len = 1 + Random (FindLen);
+      break;
+
+    case 3:
+      // enough to move outer PkgLengths across a width
+      Len = FindLen + 40 + Random (50);
+      break;
+
+    default:
+      Len = 1 + Random (20);
+      break;
+  }
+
+  for (i = 0; i < Len; i++) {
+    Replace[i] = Generated ? RandomPatchChar () : (UINT8)('A' + Random (26));
+  }
+
+  // write what an earlier or later patch looks for
+  if ((Index > 0) && (Random (3) == 0)) {
+    Other = Random (Index);
+    if (gSettings.PatchDsdt != NULL) {
+      PATCH_DSDT  *Patch = gSettings.PatchDsdt;
+
+      while (Other-- > 0 && Patch->Next != NULL) {
+        Patch = Patch->Next;
+      }
+
+      if (Patch->LenToFind <= Len) {
+        memcpy (Replace + Random (Len - Patch->LenToFind + 1), Patch->Find, Patch->LenToFind);
+      }
+    }
+  }
+
+  return Len;
+}
+
+STATIC PATCH_DSDT   mPatches[TEST_MAX_PATCHES];
+
+STATIC
+VOID
+GeneratePatches (
+  UINT8     *Dsdt,
+  UINT32    Len,
+  BOOLEAN   Generated
+) {
+  UINT32  Count, i;
+
+  Count = 1 + Random (TEST_MAX_PATCHES);
+  ZeroMem (mPatches, sizeof (mPatches));
+  gSettings.PatchDsdt = NULL;
+
+  for (i = 0; i < Count; i++) {
+    mPatches[i].Find = mFind[i];
+    mPatches[i].LenToFind = PickFind (Dsdt, Len, mFind[i], Generated);
+    mPatches[i].Replace = mReplace[i];
+    mPatches[i].LenToReplace = PickReplace (mReplace[i], mPatches[i].LenToFind, i, Generated);
+    mPatches[i].Disabled = (Random (10) == 0);
+    mPatches[i].Wildcard = PATTERN_MATCHER_NO_WILDCARD;
+
+    if (Random (20) == 0) {
+      mPatches[i].LenToReplace = 0;
+    }
+
+    if (i > 0) {
+      mPatches[i - 1].Next = &mPatches[i];
+    } else {
+      gSettings.PatchDsdt = &mPatches[0];
+    }
+  }
+
+  gSettings.PatchDsdtNum = Count;
+}
+
+//
+// Parser for what GenerateTable () writes, TRUE if every PkgLength ends
+// exactly where its content does
+//
+
+STATIC
+BOOLEAN
+ParseString (
+  UINT8   *Dsdt,
+  UINT32  *Adr,
+  UINT32  End
+) {
+  if ((*Adr >= End) || (Dsdt[*Adr] != AML_CHUNK_STRING)) {
+    return FALSE;
+  }
+
+  for ((*Adr)++; (*Adr < End) && (Dsdt[*Adr] != 0); (*Adr)++);
+
+  if (*Adr >= End) {
+    return FALSE;
+  }
+
+  (*Adr)++;
+
+  return TRUE;
+}
+
+STATIC
+BOOLEAN
+ParseTermList (
+  UINT8   *Dsdt,
+  UINT32  Adr,
+  UINT32  End
+) {
+  UINT32  Size, Width, Next;
+  UINT8   Op;
+
+  while (Adr < End) {
+    switch (Dsdt[Adr]) {
+      case AML_CHUNK_SCOPE:
+      case AML_CHUNK_METHOD:
+      case AML_CHUNK_OP:
+        Op = Dsdt[Adr++];
+        if ((Op == AML_CHUNK_OP) && (Dsdt[Adr++] != AML_CHUNK_DEVICE)) {
+          return FALSE;
+        }
+
+        Size = AcpiGetSize (Dsdt, Adr);
+        Width = (Dsdt[Adr] >> 6) + 1;
+        Next = Adr + Size;
+
+        if (!Size || (Size < (Width + 4)) || (Next > End)) {
+          return FALSE;
+        }
+
+        // name, \ only on the scope, and the method flags
+        Adr += Width + ((Dsdt[Adr + Width] == '\\') ? 5 : 4) + ((Op == AML_CHUNK_METHOD) ? 1 : 0);
+
+        if (!ParseTermList (Dsdt, Adr, Next)) {
+          return FALSE;
+        }
+
+        Adr = Next;
+        break;
+
+      case AML_CHUNK_NAME:
+        Adr += 5;
+        if ((Adr < End) && (Dsdt[Adr] == AML_CHUNK_DWORD)) {
+          Adr += 5;
+        } else if (!ParseString (Dsdt, &Adr, End)) {
+          return FALSE;
+        }
+        break;
+
+      case AML_STORE_OP:
+        Adr++;
+        if (!ParseString (Dsdt, &Adr, End) || (Adr >= End) || (Dsdt[Adr++] != AML_LOCAL0)) {
+          return FALSE;
+        }
+        break;
+
+      case AML_CHUNK_RETURN:
+        Adr++;
+        if (!ParseString (Dsdt, &Adr, End)) {
+          return FALSE;
+        }
+        break;
+
+      default:
+        return FALSE;
+    }
+  }
+
+  return (Adr == End);
+}
+
+STATIC
+BOOLEAN
+ValidTable (
+  UINT8   *Dsdt,
+  UINT32  Len
+) {
+  return ParseTermList (Dsdt, sizeof (EFI_ACPI_DESCRIPTION_HEADER), Len);
+}
+
+//
+// Checks
+//
+
+STATIC UINTN  mChecks = 0;
+STATIC UINTN  mFailures = 0;
+STATIC UINTN  mRefBroken = 0;
+STATIC UINTN  mBothBroken = 0;
+
+STATIC
+VOID
+Compare (
+  CONST CHAR8   *What,
+  CONST CHAR8   *Table,
+  BOOLEAN       Generated,
+  UINT8         *Expected,
+  UINT32        ExpectedLen,
+  UINT8         *Got,
+  UINT32        GotLen
+) {
+  UINT32  i;
+
+  mChecks++;
+
+  if ((ExpectedLen == GotLen) && (memcmp (Expected, Got, GotLen) == 0)) {
+    if (Generated && !ValidTable (Got, GotLen)) {
+      mBothBroken++;
+    }
+
+    return;
+  }
+
+  if (Generated && !ValidTable (Expected, ExpectedLen)) {
+    if (ValidTable (Got, GotLen)) {
+      mRefBroken++;
+    } else {
+      mBothBroken++;
+    }
+
+    return;
+  }
+
+  for (i = 0; (i < ExpectedLen) && (i < GotLen) && (Expected[i] == Got[i]); i++);
+
+  fprintf (
+    stderr, "%s: %s differs, length %u expected %u, first difference at 0x%x\n",
+    Table, What, GotLen, ExpectedLen, i
+    );
+
+  mFailures++;
+}
+
+STATIC
+VOID
+CheckTable (
+  CONST CHAR8   *Table,
+  BOOLEAN       Generated,
+  UINT8         *Dsdt,
+  UINT32        Len
+) {
+  UINT8       *Expected, *Serial, *Got;
+  UINT32      ExpectedLen, SerialLen, GotLen;
+  PATCH_DSDT  *Patch;
+  BOOLEAN     Broken = FALSE;
+  INTN        Fail;
+
+  Expected = malloc (Len + TEST_SLACK);
+  Serial = malloc (Len + TEST_SLACK);
+  Got = malloc (Len + TEST_SLACK);
+
+  // the patches one by one, each FixAny () against the old one on the same table
+  memcpy (Serial, Dsdt, Len);
+  SerialLen = Len;
+
+  for (Patch = gSettings.PatchDsdt; Patch != NULL; Patch = Patch->Next) {
+    if (Patch->Disabled) {
+      continue;
+    }
+
+    memcpy (Expected, Serial, SerialLen);
+
+    ExpectedLen = RefFixAny (Expected, SerialLen, Patch->Find, Patch->LenToFind, Patch->Replace, Patch->LenToReplace);
+    SerialLen = FixAny (Serial, SerialLen, Patch->Find, Patch->LenToFind, Patch->Replace, Patch->LenToReplace);
+
+    // once both broke the table there is nothing to hold the next ones to
+    if (!Broken) {
+      Compare ("FixAny", Table, Generated, Expected, ExpectedLen, Serial, SerialLen);
+      Broken = Generated && !ValidTable (Serial, SerialLen);
+    }
+  }
+
+  // batched, has to be the same as one by one
+  memcpy (Got, Dsdt, Len);
+
+  GotLen = PatchBinACPI (Got, Len);
+  PatchBinACPIFree ();
+
+  Compare ("PatchBinACPI", Table, FALSE, Serial, SerialLen, Got, GotLen);
+
+  // the same with each pool allocation failing in turn, until none is left to fail
+  if (!Generated || ValidTable (Got, GotLen)) {
+    for (Fail = 0; Fail < TEST_MAX_FAILS; Fail++) {
+      memcpy (Expected, Dsdt, Len);
+
+      HostFailAfter = Fail;
+      ExpectedLen = PatchBinACPI (Expected, Len);
+      PatchBinACPIFree ();
+
+      if (HostFailAfter >= 0) {
+        HostFailAfter = -1;
+        break;
+      }
+
+      Compare ("PatchBinACPI out of memory", Table, FALSE, Got, GotLen, Expected, ExpectedLen);
+    }
+  }
+
+  free (Expected);
+  free (Serial);
+  free (Got);
+}
+
+STATIC
+UINT8 *
+LoadTable (
+  CONST CHAR8   *Path,
+  UINT32        *Len
+) {
+  FILE    *File;
+  UINT8   *Data;
+  long    Size;
+
+  File = fopen (Path, "rb");
+  if (File == NULL) {
+    return NULL;
+  }
+
+  fseek (File, 0, SEEK_END);
+  Size = ftell (File);
+  fseek (File, 0, SEEK_SET);
+
+  Data = malloc (Size + 1);
+  if ((Size <= (long)sizeof (EFI_ACPI_DESCRIPTION_HEADER)) || (fread (Data, 1, Size, File) != (size_t)Size)) {
+    free (Data);
+    fclose (File);
+    return NULL;
+  }
+
+  fclose (File);
+  *Len = (UINT32)Size;
+
+  return Data;
+}
+
+int
+main (
+  int   argc,
+  char  **argv
+) {
+  STATIC UINT8  Dsdt[TEST_MAX_TABLE];
+  CHAR8         Name[64];
+  UINT8         *Table;
+  UINT32        Seeds = 500, Seed, Len;
+  int           Arg = 1;
+
+  if ((argc > 1) && IS_DIGIT (argv[1][0])) {
+    Seeds = (UINT32)strtoul (argv[1], NULL, 0);
+    Arg++;
+  }
+
+  for (Seed = 1; Seed <= Seeds; Seed++) {
+    mRandom = 0x9E3779B97F4A7C15ULL * Seed;
+    Len = GenerateTable (Dsdt);
+    if (!ValidTable (Dsdt, Len)) {
+      fprintf (stderr, "seed %u: generated table does not parse\n", Seed);
+      return 2;
+    }
+
+    GeneratePatches (Dsdt, Len, TRUE);
+
+    snprintf (Name, sizeof (Name), "seed %u", Seed);
+    CheckTable (Name, TRUE, Dsdt, Len);
+  }
+
+  for (; Arg < argc; Arg++) {
+    Table = LoadTable (argv[Arg], &Len);
+    if (Table == NULL) {
+      fprintf (stderr, "%s: cannot read\n", argv[Arg]);
+      mFailures++;
+      continue;
+    }
+
+    for (Seed = 1; Seed <= Seeds; Seed++) {
+      mRandom = 0x9E3779B97F4A7C15ULL * Seed;
+      GeneratePatches (Table, Len, FALSE);
+
+      snprintf (Name, sizeof (Name), "%s seed %u", argv[Arg], Seed);
+      CheckTable (Name, FALSE, Table, Len);
+    }
+
+    free (Table);
+  }
+
+  printf (
+    "%lu checks, %lu failed, %lu where only the old code broke the table, %lu where both did\n",
+    (unsigned long)mChecks, (unsigned long)mFailures, (unsigned long)mRefBroken, (unsigned long)mBothBroken
+    );
+
+  return (mFailures == 0) ? 0 : 1;
+}
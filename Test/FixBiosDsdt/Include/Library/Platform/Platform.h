@@ -0,0 +1,422 @@
+/*
+ * Host stand-in for Library/Platform/Platform.h, just enough of it for
+ * FixBiosDsdt.c and PatternMatcher.c to build with a host C compiler.
+ * Types the test does not touch are opaque, keep the rest in sync with
+ * Include/Library/Platform/Platform.h.
+ */
+
+#ifndef _HOST_PLATFORM_H
+#define _HOST_PLATFORM_H
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef uint8_t     UINT8;
+typedef int8_t      INT8;
+typedef uint16_t    UINT16;
+typedef int16_t     INT16;
+typedef uint32_t    UINT32;
+typedef int32_t     INT32;
+typedef uint64_t    UINT64;
+typedef int64_t     INT64;
+typedef uintptr_t   UINTN;
+typedef intptr_t    INTN;
+typedef char        CHAR8;
+typedef uint16_t    CHAR16;
+typedef uint8_t     BOOLEAN;
+typedef void        VOID;
+typedef UINTN       EFI_STATUS;
+typedef VOID        *EFI_HANDLE;
+typedef struct { UINT32 Data1; UINT16 Data2, Data3; UINT8 Data4[8]; } EFI_GUID;
+
+#define TRUE          ((BOOLEAN)1)
+#define FALSE         ((BOOLEAN)0)
+#define IN
+#define OUT
+#define OPTIONAL
+#define CONST         const
+#define STATIC        static
+#define EFIAPI
+
+#define EFI_SUCCESS           0
+#define EFI_ERROR(Status)     (((INTN)(Status)) < 0)
+
+#define BIT0    0x00000001
+#define BIT1    0x00000002
+#define BIT2    0x00000004
+#define BIT3    0x00000008
+#define BIT4    0x00000010
+#define BIT5    0x00000020
+#define BIT6    0x00000040
+#define BIT7    0x00000080
+#define BIT8    0x00000100
+#define BIT9    0x00000200
+
+#define BIT_ISSET(a, b)   ((a) & (b))
+#define ARRAY_SIZE(a)     (sizeof (a) / sizeof ((a)[0]))
+#define MIN(a, b)         (((a) < (b)) ? (a) : (b))
+#define MAX(a, b)         (((a) > (b)) ? (a) : (b))
+#define ABS(a)            (((a) < 0) ? -(a) : (a))
+#define IS_DIGIT(a)       (((a) >= '0') && ((a) <= '9'))
+#define IS_UPPER(a)       (((a) >= 'A') && ((a) <= 'Z'))
+
+//
+// Pool allocations can be made to fail from the test, see HostFailAfter.
+//
+extern INTN   HostFailAfter;
+
+static inline BOOLEAN HostFail (VOID) { return (HostFailAfter >= 0) && (HostFailAfter-- == 0); }
+static inline VOID *AllocatePool (UINTN Size) { return HostFail () ? NULL : malloc (Size ? Size : 1); }
+static inline VOID *AllocateZeroPool (UINTN Size) { return HostFail () ? NULL : calloc (1, Size ? Size : 1); }
+static inline VOID *ReallocatePool (UINTN OldSize, UINTN NewSize, VOID *Old) { return HostFail () ? NULL : realloc (Old, NewSize ? NewSize : 1); }
+static inline VOID FreePool (VOID *Buffer) { free (Buffer); }
+static inline VOID *AllocateCopyPool (UINTN Size, CONST VOID *Buffer) { VOID *Copy = AllocatePool (Size); return Copy ? memcpy (Copy, Buffer, Size) : NULL; }
+static inline VOID *CopyMem (VOID *Dst, CONST VOID *Src, UINTN Len) { return memmove (Dst, Src, Len); }
+static inline VOID *ZeroMem (VOID *Dst, UINTN Len) { return memset (Dst, 0, Len); }
+static inline INTN CompareMem (CONST VOID *A, CONST VOID *B, UINTN Len) { return memcmp (A, B, Len); }
+static inline UINT32 ReadUnaligned32 (CONST UINT32 *Ptr) { UINT32 Value; memcpy (&Value, Ptr, sizeof (Value)); return Value; }
+static inline UINT64 RShiftU64 (UINT64 Value, UINTN Count) { return Value >> Count; }
+static inline UINTN AsciiStrLen (CONST CHAR8 *Str) { return strlen (Str); }
+static inline UINTN AsciiStrSize (CONST CHAR8 *Str) { return strlen (Str) + 1; }
+static inline INTN AsciiStrCmp (CONST CHAR8 *A, CONST CHAR8 *B) { return strcmp (A, B); }
+
+#define DebugLog(Mode, ...)
+#define MsgLog(...)
+#define DbgHeader(Str)
+
+// only reached from the FIX* passes, which the test does not run
+UINTN     AsciiSPrint (CHAR8 *Buffer, UINTN Size, CONST CHAR8 *Format, ...);
+VOID      AsciiStrCpyS (CHAR8 *Dst, UINTN Size, CONST CHAR8 *Src);
+CHAR8     *AsciiStrToLower (CHAR8 *Str);
+CHAR8     *AsciiStrToUpper (CHAR8 *Str);
+CHAR8     *Bytes2HexStr (UINT8 *Data, UINTN Len);
+UINT32    GetCrc32 (UINT8 *Data, UINTN Size);
+UINT8     Checksum8 (VOID *StartPtr, UINT32 Len);
+BOOLEAN   IsHDMIAudio (EFI_HANDLE Handle);
+
+//
+// Device paths / PCI I/O
+//
+
+#define ACPI_DEVICE_PATH      0x02
+#define ACPI_DP               0x01
+#define HARDWARE_DEVICE_PATH  0x01
+#define HW_PCI_DP             0x01
+
+typedef struct {
+  UINT8   Type;
+  UINT8   SubType;
+  UINT8   Length[2];
+} EFI_DEVICE_PATH_PROTOCOL;
+
+typedef struct {
+  EFI_DEVICE_PATH_PROTOCOL  Header;
+  UINT8                     Function;
+  UINT8                     Device;
+} PCI_DEVICE_PATH;
+
+EFI_DEVICE_PATH_PROTOCOL  *DuplicateDevicePath (EFI_DEVICE_PATH_PROTOCOL *DevicePath);
+EFI_DEVICE_PATH_PROTOCOL  *DevicePathFromHandle (EFI_HANDLE Handle);
+EFI_DEVICE_PATH_PROTOCOL  *NextDevicePathNode (EFI_DEVICE_PATH_PROTOCOL *Node);
+BOOLEAN                   IsDevicePathEndType (EFI_DEVICE_PATH_PROTOCOL *Node);
+CHAR16                    *DevicePathToStr (EFI_DEVICE_PATH_PROTOCOL *DevicePath);
+
+#define PCI_CLASS_NETWORK             0x02
+#define PCI_CLASS_NETWORK_ETHERNET    0x00
+#define PCI_CLASS_NETWORK_OTHER       0x80
+#define PCI_CLASS_DISPLAY             0x03
+#define PCI_CLASS_DISPLAY_VGA         0x00
+#define PCI_CLASS_MEDIA               0x04
+#define PCI_CLASS_MEDIA_AUDIO         0x01
+#define PCI_CLASS_MEDIA_HDA           0x03
+#define PCI_CLASS_SCC                 0x07
+#define PCI_SUBCLASS_SCC_OTHER        0x80
+
+typedef struct {
+  UINT16  VendorId;
+  UINT16  DeviceId;
+  UINT16  Command;
+  UINT16  Status;
+  UINT8   RevisionID;
+  UINT8   ClassCode[3];
+  UINT8   CacheLineSize;
+  UINT8   LatencyTimer;
+  UINT8   HeaderType;
+  UINT8   BIST;
+} PCI_DEVICE_INDEPENDENT_REGION;
+
+typedef struct {
+  PCI_DEVICE_INDEPENDENT_REGION   Hdr;
+  UINT32                          Device[12];
+} PCI_TYPE00;
+
+typedef enum {
+  EfiPciIoWidthUint32 = 2
+} EFI_PCI_IO_PROTOCOL_WIDTH;
+
+typedef struct EFI_PCI_IO_PROTOCOL EFI_PCI_IO_PROTOCOL;
+
+typedef struct {
+  EFI_STATUS  (*Read) (EFI_PCI_IO_PROTOCOL *This, EFI_PCI_IO_PROTOCOL_WIDTH Width, UINT32 Offset, UINTN Count, VOID *Buffer);
+} EFI_PCI_IO_PROTOCOL_CONFIG_ACCESS;
+
+struct EFI_PCI_IO_PROTOCOL {
+  EFI_PCI_IO_PROTOCOL_CONFIG_ACCESS   Pci;
+  EFI_STATUS                          (*GetLocation) (EFI_PCI_IO_PROTOCOL *This, UINTN *Segment, UINTN *Bus, UINTN *Device, UINTN *Function);
+};
+
+typedef enum {
+  ByProtocol = 2
+} EFI_LOCATE_SEARCH_TYPE;
+
+typedef struct {
+  EFI_STATUS  (*LocateHandleBuffer) (EFI_LOCATE_SEARCH_TYPE SearchType, EFI_GUID *Protocol, VOID *SearchKey, UINTN *NoHandles, EFI_HANDLE **Buffer);
+  EFI_STATUS  (*HandleProtocol) (EFI_HANDLE Handle, EFI_GUID *Protocol, VOID **Interface);
+} EFI_BOOT_SERVICES;
+
+extern EFI_BOOT_SERVICES  *gBS;
+extern EFI_GUID           gEfiPciIoProtocolGuid;
+
+typedef struct PCI_DT {
+  EFI_HANDLE  DeviceHandle;
+  UINT16      vendor_id;
+  UINT16      device_id;
+} PCI_DT;
+
+//
+// ACPI
+//
+
+#define ACPI_OEM_ID_SIZE        6
+#define DARWIN_SYSTEM_VENDOR    "Apple Inc."
+
+#pragma pack(1)
+typedef struct {
+  UINT32  Signature;
+  UINT32  Length;
+  UINT8   Revision;
+  UINT8   Checksum;
+  UINT8   OemId[6];
+  UINT64  OemTableId;
+  UINT32  OemRevision;
+  UINT32  CreatorId;
+  UINT32  CreatorRevision;
+} EFI_ACPI_DESCRIPTION_HEADER;
+#pragma pack()
+
+#define AML_CHUNK_NONE          0xff
+#define AML_CHUNK_ZERO          0x00
+#define AML_CHUNK_ONE           0x01
+#define AML_CHUNK_ALIAS         0x06
+#define AML_CHUNK_NAME          0x08
+#define AML_CHUNK_BYTE          0x0A
+#define AML_CHUNK_WORD          0x0B
+#define AML_CHUNK_DWORD         0x0C
+#define AML_CHUNK_STRING        0x0D
+#define AML_CHUNK_QWORD         0x0E
+#define AML_CHUNK_SCOPE         0x10
+#define AML_CHUNK_PACKAGE       0x12
+#define AML_CHUNK_METHOD        0x14
+#define AML_CHUNK_RETURN        0xA4
+#define AML_LOCAL0              0x60
+#define AML_STORE_OP            0x70
+#define AML_CHUNK_BUFFER        0x11
+#define AML_CHUNK_STRING_BUFFER 0x15
+#define AML_CHUNK_OP            0x5B
+#define AML_CHUNK_REFOF         0x71
+#define AML_CHUNK_DEVICE        0x82
+#define AML_CHUNK_LOCAL0        0x60
+
+#define FIX_MCHC                BIT0
+#define FIX_DISPLAY             BIT1
+#define FIX_LAN                 BIT2
+#define FIX_WIFI                BIT3
+#define FIX_HDA                 BIT4
+#define FIX_INTELGFX            BIT5
+#define FIX_PNLF                BIT6
+#define FIX_HDMI                BIT7
+#define FIX_IMEI                BIT8
+#define FIX_HEADER              BIT9
+
+#define MAX_NUM_GFX             5
+
+#define DEV_ATI                 BIT0
+#define DEV_NVIDIA              BIT1
+#define DEV_INTEL               BIT2
+#define DEV_HDA                 BIT3
+#define DEV_HDMI                BIT4
+#define DEV_LAN                 BIT5
+#define DEV_WIFI                BIT6
+#define DEV_MCHC                (1 << 13)
+
+typedef struct PATCH_DSDT {
+          UINT8       *Find;
+          UINT32      LenToFind;
+          UINT8       *Replace;
+          UINT32      LenToReplace;
+          BOOLEAN     Disabled;
+          CHAR8       *Comment;
+          UINT8       Wildcard;
+  struct  PATCH_DSDT  *Next;
+} PATCH_DSDT;
+
+#define PATTERN_MATCHER_HASH_BITS     12
+#define PATTERN_MATCHER_HASH_SIZE     (1 << PATTERN_MATCHER_HASH_BITS)
+#define PATTERN_MATCHER_MAX_ENTRIES   0xFFFE
+#define PATTERN_MATCHER_NO_WILDCARD   0xFF
+
+typedef struct {
+  UINT8     *Find;
+  UINT32    Len;
+  UINT8     Wildcard;
+  UINT32    AnchorOff;
+  UINT32    AnchorLen;
+  UINT32    Anchor;
+  UINT16    Next;
+  BOOLEAN   Retired;
+  VOID      *Context;
+} PATTERN_MATCHER_ENTRY;
+
+typedef struct {
+  UINTN                   Count;
+  UINTN                   Capacity;
+  UINTN                   Active;
+  PATTERN_MATCHER_ENTRY   *Entries;
+  UINT16                  WordHeads[PATTERN_MATCHER_HASH_SIZE];
+  UINT16                  ByteHeads[256];
+  UINT16                  Unanchored;
+} PATTERN_MATCHER;
+
+typedef
+BOOLEAN
+(*PATTERN_MATCHER_CALLBACK) (
+  IN VOID   *Context,
+  IN UINTN  Index,
+  IN VOID   *EntryContext,
+  IN UINT8  *Buffer,
+  IN UINTN  Offset
+);
+
+typedef struct AML_CHUNK {
+          UINT8       Type;
+          UINT16      Length;
+          CHAR8       *Buffer;
+          UINT16      Size;
+  struct  AML_CHUNK   *Next;
+  struct  AML_CHUNK   *First;
+  struct  AML_CHUNK   *Last;
+} AML_CHUNK;
+
+typedef struct DEV_PROPERTY {
+          UINTN         Device;
+          CHAR8         *Key;
+          CHAR8         *Value;
+          UINTN         ValueLen;
+  struct  DEV_PROPERTY  *Next;
+} DEV_PROPERTY;
+
+typedef struct {
+  UINT32  Family;
+} CPU_STRUCTURE;
+
+typedef struct {
+  CPU_STRUCTURE   CPUStructure;
+  UINT16          DropOEM_DSM;
+  BOOLEAN         FakeATI, FakeIMEI, FakeIntel, FakeLAN, FakeNVidia, FakeWIFI;
+  BOOLEAN         InjectATI, InjectIntel, InjectNVidia;
+  BOOLEAN         NoDefaultProperties, ReuseFFFF, UseIntelHDMI;
+  UINT32          FixDsdt;
+  UINT32          HDALayoutId;
+  UINT16          PCIRootUID;
+  PATCH_DSDT      *PatchDsdt;
+  UINT32          PatchDsdtNum;
+  INTN            NrAddProperties;
+  DEV_PROPERTY    *AddProperties;
+} SETTINGS_DATA;
+
+extern SETTINGS_DATA  gSettings;
+extern UINT8          gAcpiCPUCount;
+extern CHAR8          *gAcpiCPUName[32];
+extern CHAR8          *gAcpiCPUScore;
+
+//
+// FixBiosDsdt.c
+//
+
+UINT32
+PatchBinACPI (
+  UINT8   *Ptr,
+  UINT32  Len
+);
+
+VOID
+PatchBinACPIFree ();
+
+UINT32
+FixAny (
+  UINT8     *Dsdt,
+  UINT32    Len,
+  UINT8     *ToFind,
+  UINT32    LenTF,
+  UINT8     *ToReplace,
+  UINT32    LenTR
+);
+
+//
+// PatternMatcher.c
+//
+
+PATTERN_MATCHER *
+PatternMatcherCreate (
+  IN UINTN  Capacity
+);
+
+VOID
+PatternMatcherFree (
+  IN PATTERN_MATCHER  *Matcher
+);
+
+INTN
+PatternMatcherAdd (
+  IN PATTERN_MATCHER  *Matcher,
+  IN UINT8            *Find,
+  IN UINTN            Len,
+  IN UINT8            Wildcard,
+  IN VOID             *Context
+);
+
+BOOLEAN
+PatternMatcherCompare (
+  IN UINT8  *Source,
+  IN UINT8  *Find,
+  IN UINTN  Len,
+  IN UINT8  Wildcard
+);
+
+VOID
+PatternMatcherReplace (
+  IN OUT UINT8  *Dest,
+  IN     UINT8  *Replace,
+  IN     UINTN  Len,
+  IN     UINT8  Wildcard
+);
+
+UINTN
+PatternMatcherScan (
+  IN PATTERN_MATCHER            *Matcher,
+  IN UINT8                      *Buffer,
+  IN UINTN                      Size,
+  IN PATTERN_MATCHER_CALLBACK   Callback,
+  IN VOID                       *Context
+);
+
+VOID
+PatternMatcherReset (
+  IN PATTERN_MATCHER  *Matcher
+);
+
+#endif
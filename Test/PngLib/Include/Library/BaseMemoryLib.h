@@ -0,0 +1,15 @@
+/*
+ * Host stand-in for Library/BaseMemoryLib.h.
+ */
+
+#ifndef _HOST_BASE_MEMORY_LIB_H
+#define _HOST_BASE_MEMORY_LIB_H
+
+#include <Uefi.h>
+
+static inline VOID *CopyMem (VOID *Dst, CONST VOID *Src, UINTN Len) { return memmove (Dst, Src, Len); }
+static inline VOID *SetMem (VOID *Dst, UINTN Len, UINT8 Value) { return memset (Dst, Value, Len); }
+static inline VOID *ZeroMem (VOID *Dst, UINTN Len) { return memset (Dst, 0, Len); }
+static inline INTN CompareMem (CONST VOID *A, CONST VOID *B, UINTN Len) { return memcmp (A, B, Len); }
+
+#endif
@@ -0,0 +1,14 @@
+/*
+ * Host stand-in for Library/Common/CommonLib.h, only what PngLib.c uses.
+ */
+
+#ifndef _HOST_COMMON_LIB_H
+#define _HOST_COMMON_LIB_H
+
+#include <Uefi.h>
+
+#define ABS(a)            (((a) < 0) ? -(a) : (a))
+
+static inline UINTN AsciiStrLen (CONST CHAR8 *String) { return strlen (String); }
+
+#endif
@@ -0,0 +1,90 @@
+/*
+ * Host stand-in for Library/MemoryAllocationLib.h.
+ *
+ * lodepng_realloc () copies new_size bytes out of the old block, past its
+ * end when the block grows. So pools are carved out of one arena, where
+ * that read stays in memory the test owns, and FreePool () leaves them
+ * there until HostPoolReset (). Each block is followed by a guard, a write
+ * past the end of a block shows up in HostPoolCheck ().
+ *
+ * Pool allocations can be made to fail from the test, see HostFailAfter.
+ */
+
+#ifndef _HOST_MEMORY_ALLOCATION_LIB_H
+#define _HOST_MEMORY_ALLOCATION_LIB_H
+
+#include <Uefi.h>
+
+#define HOST_POOL_ALIGN   16
+#define HOST_POOL_GUARD   32
+#define HOST_GUARD_BYTE   0xA5
+
+extern UINT8    *HostPool;
+extern UINTN    HostPoolSize;
+extern UINTN    HostPoolUsed;
+extern UINTN    HostAllocations;
+extern INTN     HostFailAfter;
+
+static inline BOOLEAN HostFail (VOID) { return (HostFailAfter >= 0) && (HostFailAfter-- == 0); }
+
+static inline
+VOID *
+AllocatePool (
+  UINTN   Size
+) {
+  UINT8   *Block;
+  UINTN   Data;
+
+  HostAllocations++;
+  if (HostFail ()) {
+    return NULL;
+  }
+
+  Data = (Size + HOST_POOL_ALIGN - 1) & ~(UINTN)(HOST_POOL_ALIGN - 1);
+  if ((HostPoolSize - HostPoolUsed) < (HOST_POOL_ALIGN + Data + HOST_POOL_GUARD)) {
+    return NULL;
+  }
+
+  Block = HostPool + HostPoolUsed;
+  *(UINTN *)Block = Data;
+  memset (Block + HOST_POOL_ALIGN + Data, HOST_GUARD_BYTE, HOST_POOL_GUARD);
+  HostPoolUsed += HOST_POOL_ALIGN + Data + HOST_POOL_GUARD;
+
+  return Block + HOST_POOL_ALIGN;
+}
+
+static inline VOID *AllocateZeroPool (UINTN Size) { VOID *Buffer = AllocatePool (Size); return Buffer ? memset (Buffer, 0, Size) : NULL; }
+static inline VOID FreePool (VOID *Buffer) { (VOID)Buffer; }
+
+/** Returns the number of blocks whose guard was overwritten. */
+static inline
+UINTN
+HostPoolCheck (
+  VOID
+) {
+  UINTN   Offset = 0, Data, i, Damaged = 0;
+
+  while (Offset < HostPoolUsed) {
+    Data = *(UINTN *)(HostPool + Offset);
+    if (Data > (HostPoolUsed - Offset - HOST_POOL_ALIGN - HOST_POOL_GUARD)) {
+      return Damaged + 1;  // the size in front of a block went too
+    }
+
+    Offset += HOST_POOL_ALIGN + Data;
+
+    for (i = 0; i < HOST_POOL_GUARD; i++) {
+      if (HostPool[Offset + i] != HOST_GUARD_BYTE) {
+        Damaged++;
+        break;
+      }
+    }
+
+    Offset += HOST_POOL_GUARD;
+  }
+
+  return Damaged;
+}
+
+static inline VOID HostPoolReset (VOID) { HostPoolUsed = 0; HostAllocations = 0; }
+
+#endif
@@ -0,0 +1,45 @@
+/*
+ * Host stand-in for the EDK2 headers Module/PngLib/PngLib.c includes, just
+ * enough of them for it to build with a host C compiler.
+ */
+
+#ifndef _HOST_UEFI_H
+#define _HOST_UEFI_H
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef uint8_t     UINT8;
+typedef int8_t      INT8;
+typedef uint16_t    UINT16;
+typedef int16_t     INT16;
+typedef uint32_t    UINT32;
+typedef int32_t     INT32;
+typedef uint64_t    UINT64;
+typedef int64_t     INT64;
+typedef size_t      UINTN;
+typedef intptr_t    INTN;
+typedef char        CHAR8;
+typedef uint16_t    CHAR16;
+typedef uint8_t     BOOLEAN;
+typedef void        VOID;
+
+#define TRUE          ((BOOLEAN)1)
+#define FALSE         ((BOOLEAN)0)
+#define IN
+#define OUT
+#define OPTIONAL
+#define CONST         const
+#define STATIC        static
+#define EFIAPI
+
+#define ARRAY_SIZE(a)     (sizeof (a) / sizeof ((a)[0]))
+#define MIN(a, b)         (((a) < (b)) ? (a) : (b))
+#define MAX(a, b)         (((a) > (b)) ? (a) : (b))
+#define IS_DIGIT(a)       (((a) >= '0') && ((a) <= '9'))
+
+#endif
@@ -0,0 +1,848 @@
+/*
+ * Host test for the inflate decoder in Module/PngLib/PngLib.c.
+ *
+ * The block decoder looks symbols up in tables (subtables for codes longer
+ * than FIRSTBITS, the tree2d walk for incomplete codes), reads the input
+ * through a 64-bit bit buffer and copies overlapping matches in chunks.
+ * PngLibRef.c keeps the old bit by bit decoder, both decode every stream.
+ *
+ * Streams are generated: stored, fixed and dynamic blocks of random
+ * literals and matches, distances reaching back across blocks and down to
+ * 1 for long overlapping copies, dynamic codes up to 15 bits long and some
+ * of them incomplete. Both decoders have to give the output the generator
+ * meant. lodepng_deflate () output of generated data (all three block
+ * types) and small images through lodepng_encode32 () go the same way.
+ *
+ * Damaged copies of each stream (bits flipped, cut short) have to give the
+ * error of the old decoder, and its output when there is none. The new
+ * decoder is run again with every pool allocation failing in turn
+ * (HostFailAfter), it has to stop with error 83 or give the same output.
+ *
+ * PNG files given on the command line are decoded with both, the old one
+ * through custom_inflate, and have to give the same pixels.
+ *
+ *   cc -I Test/PngLib/Include -I Include -o PngLibTest \
+ *     Test/PngLib/PngLibTest.c Test/PngLib/PngLibRef.c Module/PngLib/PngLib.c
+ *   ./PngLibTest [Seeds] [File.png ...]
+ */
+
+#include <Uefi.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UI/PngLib.h>
+
+unsigned
+ref_lodepng_inflate (
+  unsigned char                     **out,
+  size_t                            *outsize,
+  const unsigned char               *in,
+  size_t                            insize,
+  const LodePNGDecompressSettings   *settings
+);
+
+UINT8   *HostPool = NULL;
+UINTN   HostPoolSize = 0;
+UINTN   HostPoolUsed = 0;
+UINTN   HostAllocations = 0;
+INTN    HostFailAfter = -1;
+
+#define TEST_POOL_SIZE      0x40000000
+#define TEST_MAX_OUTPUT     0x100000
+#define TEST_MAX_STREAM     (2 * TEST_MAX_OUTPUT + 0x10000)
+#define TEST_MAX_SAMPLE     0x10000
+#define TEST_MAX_BLOCKS     6
+#define TEST_DAMAGED        4
+#define TEST_MAX_FAILS      256
+
+STATIC UINT64   mRandom;
+
+STATIC
+UINT32
+Random (
+  UINT32  Range
+) {
+  mRandom ^= mRandom << 13;
+  mRandom ^= mRandom >> 7;
+  mRandom ^= mRandom << 17;
+
+  return (UINT32)((mRandom >> 16) % Range);
+}
+
+//
+// Deflate writer
+//
+
+STATIC CONST UINT32   mLengthBase[29] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59,
+  67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+STATIC CONST UINT32   mLengthExtra[29] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+  4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+STATIC CONST UINT32   mDistanceBase[30] = {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513,
+  769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+
+STATIC CONST UINT32   mDistanceExtra[30] = {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8,
+  8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+STATIC CONST UINT32   mClclOrder[19] = {
+  16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+typedef struct {
+  UINT8   *Data;
+  UINTN   Bit;
+} BIT_WRITER;
+
+typedef struct {
+  UINT32  LitLen[288];
+  UINT32  LitLenCode[288];
+  UINT32  Dist[32];
+  UINT32  DistCode[32];
+} TEST_CODES;
+
+STATIC
+VOID
+PutBits (
+  BIT_WRITER  *Writer,
+  UINT32      Value,
+  UINT32      Count
+) {
+  UINT32  i;
+
+  for (i = 0; i < Count; i++) {
+    if ((Writer->Bit & 7) == 0) {
+      Writer->Data[Writer->Bit >> 3] = 0;
+    }
+
+    Writer->Data[Writer->Bit >> 3] |= (UINT8)(((Value >> i) & 1) << (Writer->Bit & 7));
+    Writer->Bit++;
+  }
+}
+
+/** Huffman codes go out starting with their most significant bit. */
+STATIC
+VOID
+PutCode (
+  BIT_WRITER  *Writer,
+  UINT32      Code,
+  UINT32      Len
+) {
+  while (Len-- > 0) {
+    PutBits (Writer, (Code >> Len) & 1, 1);
+  }
+}
+
+/** Canonical codes from code lengths, as RFC 1951 3.2.2 has them. */
+STATIC
+VOID
+MakeCodes (
+  CONST UINT32  *Lengths,
+  UINT32        Num,
+  UINT32        *Codes
+) {
+  UINT32  Count[16], Next[16], i, Code = 0;
+
+  ZeroMem (Count, sizeof (Count));
+  for (i = 0; i < Num; i++) {
+    Count[Lengths[i]]++;
+  }
+
+  Count[0] = 0;
+  for (i = 1; i < 16; i++) {
+    Code = (Code + Count[i - 1]) << 1;
+    Next[i] = Code;
+  }
+
+  for (i = 0; i < Num; i++) {
+    Codes[i] = Lengths[i] ? Next[Lengths[i]]++ : 0;
+  }
+}
+
+STATIC
+VOID
+FixedCodes (
+  TEST_CODES  *Codes
+) {
+  UINT32  i;
+
+  for (i = 0; i < 288; i++) {
+    Codes->LitLen[i] = (i < 144) ? 8 : (i < 256) ? 9 : (i < 280) ? 7 : 8;
+  }
+
+  for (i = 0; i < 32; i++) {
+    Codes->Dist[i] = 5;
+  }
+
+  MakeCodes (Codes->LitLen, 288, Codes->LitLenCode);
+  MakeCodes (Codes->Dist, 32, Codes->DistCode);
+}
+
+/**
+  Code lengths from random frequencies, skewed ones give codes of all lengths
+  up to 15. Every fourth table is made incomplete: a single distance code, or
+  a literal/length code one bit longer than it needs to be.
+**/
+STATIC
+VOID
+RandomCodes (
+  TEST_CODES  *Codes
+) {
+  UINT32    Freq[288], i, Skewed = Random (2);
+  UINT32    Symbol;
+
+  ZeroMem (Freq, sizeof (Freq));
+  for (i = 0; i < 286; i++) {
+    if (Random (4) != 0) {
+      Freq[i] = Skewed ? (1u << Random (20)) : (1 + Random (100));
+    }
+  }
+
+  //
+  // lodepng_huffman_code_lengths () only clears numcodes bytes of the lengths,
+  // its deflateDynamic () hands it cleared ones.
+  //
+  ZeroMem (Codes, sizeof (*Codes));
+
+  Freq[256] |= 1;
+  Freq[Random (256)] |= 1;
+  lodepng_huffman_code_lengths (Codes->LitLen, Freq, 288, 15);
+
+  ZeroMem (Freq, sizeof (Freq));
+  for (i = 0; i < 30; i++) {
+    if (Random (3) != 0) {
+      Freq[i] = Skewed ? (1u << Random (20)) : (1 + Random (100));
+    }
+  }
+
+  Freq[Random (30)] |= 1;
+  lodepng_huffman_code_lengths (Codes->Dist, Freq, 32, 15);
+
+  if (Random (4) == 0) {
+    if (Random (2) == 0) {
+      ZeroMem (Codes->Dist, sizeof (Codes->Dist));
+      Codes->Dist[Random (30)] = 1;
+    } else {
+      for (i = 0; i < 64; i++) {
+        Symbol = Random (286);
+        if ((Codes->LitLen[Symbol] != 0) && (Codes->LitLen[Symbol] < 15)) {
+          Codes->LitLen[Symbol]++;
+          break;
+        }
+      }
+    }
+  }
+
+  MakeCodes (Codes->LitLen, 288, Codes->LitLenCode);
+  MakeCodes (Codes->Dist, 32, Codes->DistCode);
+}
+
+/** The dynamic block header, code lengths with or without the 16 / 17 / 18 runs. */
+STATIC
+VOID
+PutDynamicHeader (
+  BIT_WRITER        *Writer,
+  CONST TEST_CODES  *Codes
+) {
+  UINT32  All[286 + 30], Symbols[286 + 30], Extra[286 + 30], ClFreq[19], Cl[19], ClCode[19];
+  UINT32  HLit = 286, HDist = 30, HClen = 19, Num = 0, Count = 0, Run, i;
+  BOOLEAN Rle = (BOOLEAN)Random (2);
+
+  while ((HLit > 257) && (Codes->LitLen[HLit - 1] == 0)) {
+    HLit--;
+  }
+
+  while ((HDist > 1) && (Codes->Dist[HDist - 1] == 0)) {
+    HDist--;
+  }
+
+  CopyMem (All, Codes->LitLen, HLit * sizeof (UINT32));
+  CopyMem (All + HLit, Codes->Dist, HDist * sizeof (UINT32));
+  Num = HLit + HDist;
+
+  ZeroMem (ClFreq, sizeof (ClFreq));
+  for (i = 0; i < Num; i += Run) {
+    for (Run = 1; ((i + Run) < Num) && (All[i + Run] == All[i]); Run++);
+
+    if (Rle && (All[i] == 0) && (Run >= 3)) {
+      Run = MIN (Run, 138);
+      Symbols[Count] = (Run >= 11) ? 18 : 17;
+      Extra[Count] = Run - ((Run >= 11) ? 11 : 3);
+    } else if (Rle && (i > 0) && (All[i] == All[i - 1]) && (Run >= 3)) {
+      Run = MIN (Run, 6);
+      Symbols[Count] = 16;
+      Extra[Count] = Run - 3;
+    } else {
+      Run = 1;
+      Symbols[Count] = All[i];
+    }
+
+    ClFreq[Symbols[Count++]]++;
+  }
+
+  ZeroMem (Cl, sizeof (Cl));
+  lodepng_huffman_code_lengths (Cl, ClFreq, 19, 7);
+  MakeCodes (Cl, 19, ClCode);
+
+  while ((HClen > 4) && (Cl[mClclOrder[HClen - 1]] == 0)) {
+    HClen--;
+  }
+
+  PutBits (Writer, HLit - 257, 5);
+  PutBits (Writer, HDist - 1, 5);
+  PutBits (Writer, HClen - 4, 4);
+  for (i = 0; i < HClen; i++) {
+    PutBits (Writer, Cl[mClclOrder[i]], 3);
+  }
+
+  for (i = 0; i < Count; i++) {
+    PutCode (Writer, ClCode[Symbols[i]], Cl[Symbols[i]]);
+    if (Symbols[i] >= 16) {
+      PutBits (Writer, Extra[i], (Symbols[i] == 16) ? 2 : (Symbols[i] == 17) ? 3 : 7);
+    }
+  }
+}
+
+/**
+  Random literals and matches up to the end code, into the stream and into
+  Expected as the decoder has to give them. Half of the blocks pick the
+  shortest distance they can, for long overlapping copies.
+**/
+STATIC
+VOID
+PutSymbols (
+  BIT_WRITER        *Writer,
+  CONST TEST_CODES  *Codes,
+  UINT8             *Expected,
+  UINTN             *Pos
+) {
+  UINT32  Literals[256], Lengths[29], Distances[30];
+  UINT32  NumLiterals = 0, NumLengths = 0, NumDistances, Valid, i, n, Count;
+  UINT32  Symbol, Length, Distance, Dist;
+  BOOLEAN Shortest = (BOOLEAN)Random (2);
+
+  for (i = 0; i < 256; i++) {
+    if (Codes->LitLen[i] != 0) {
+      Literals[NumLiterals++] = i;
+    }
+  }
+
+  for (i = 0; i < 29; i++) {
+    if (Codes->LitLen[257 + i] != 0) {
+      Lengths[NumLengths++] = i;
+    }
+  }
+
+  Count = Random (4) ? Random (200) : Random (5000);
+
+  for (n = 0; (n < Count) && ((*Pos + 258) <= TEST_MAX_OUTPUT); n++) {
+    // distance codes that reach no further back than the output so far
+    NumDistances = 0;
+    for (i = 0; i < 30; i++) {
+      if ((Codes->Dist[i] != 0) && (mDistanceBase[i] <= *Pos)) {
+        Distances[NumDistances++] = i;
+      }
+    }
+
+    Valid = (NumLengths > 0) && (NumDistances > 0);
+    if (!Valid || ((NumLiterals > 0) && (Random (3) == 0))) {
+      if (NumLiterals == 0) {
+        break;
+      }
+
+      Symbol = Literals[Random (NumLiterals)];
+      PutCode (Writer, Codes->LitLenCode[Symbol], Codes->LitLen[Symbol]);
+      Expected[(*Pos)++] = (UINT8)Symbol;
+      continue;
+    }
+
+    Symbol = Lengths[Random (NumLengths)];
+    Length = mLengthBase[Symbol] + Random (1u << mLengthExtra[Symbol]);
+    PutCode (Writer, Codes->LitLenCode[257 + Symbol], Codes->LitLen[257 + Symbol]);
+    PutBits (Writer, Length - mLengthBase[Symbol], mLengthExtra[Symbol]);
+
+    Dist = Shortest ? Distances[0] : Distances[Random (NumDistances)];
+    Distance = mDistanceBase[Dist] + Random (1u << mDistanceExtra[Dist]);
+    Distance = MIN (Distance, (UINT32)*Pos);
+    PutCode (Writer, Codes->DistCode[Dist], Codes->Dist[Dist]);
+    PutBits (Writer, Distance - mDistanceBase[Dist], mDistanceExtra[Dist]);
+
+    for (i = 0; i < Length; i++, (*Pos)++) {
+      Expected[*Pos] = Expected[*Pos - Distance];
+    }
+  }
+
+  PutCode (Writer, Codes->LitLenCode[256], Codes->LitLen[256]);
+}
+
+/** A raw deflate stream of 1 to TEST_MAX_BLOCKS blocks of any type, returns its length. */
+STATIC
+UINTN
+GenerateStream (
+  UINT8   *Stream,
+  UINT8   *Expected,
+  UINTN   *ExpectedLen
+) {
+  STATIC TEST_CODES   Codes;
+  BIT_WRITER          Writer;
+  UINT32              Blocks, Block, Type, Len, i;
+  UINTN               Pos = 0;
+
+  Writer.Data = Stream;
+  Writer.Bit = 0;
+
+  Blocks = 1 + Random (TEST_MAX_BLOCKS);
+  for (Block = 0; Block < Blocks; Block++) {
+    Type = Random (4);
+    Type = (Type == 3) ? 2 : Type;
+
+    PutBits (&Writer, (Block + 1) == Blocks, 1);
+    PutBits (&Writer, Type, 2);
+
+    if (Type == 0) {
+      Writer.Bit = (Writer.Bit + 7) & ~(UINTN)7;
+
+      Len = Random (4) ? Random (300) : Random (0x10000);
+      Len = (UINT32)MIN (Len, TEST_MAX_OUTPUT - Pos);
+      PutBits (&Writer, Len, 16);
+      PutBits (&Writer, ~Len & 0xFFFF, 16);
+
+      for (i = 0; i < Len; i++) {
+        Expected[Pos] = (Random (2) && (Pos > 0)) ? Expected[Pos - 1] : (UINT8)Random (256);
+        PutBits (&Writer, Expected[Pos++], 8);
+      }
+
+      continue;
+    }
+
+    if (Type == 1) {
+      FixedCodes (&Codes);
+    } else {
+      RandomCodes (&Codes);
+      PutDynamicHeader (&Writer, &Codes);
+    }
+
+    PutSymbols (&Writer, &Codes, Expected, &Pos);
+  }
+
+  *ExpectedLen = Pos;
+
+  return (Writer.Bit + 7) >> 3;
+}
+
+/** Data for lodepng_deflate (): random, runs, short periods or a small alphabet. */
+STATIC
+UINTN
+GenerateSample (
+  UINT8   *Sample
+) {
+  UINTN   Len = Random (4) ? Random (4096) : Random (TEST_MAX_SAMPLE), i;
+  UINT32  Kind = Random (4), Period = 1 + Random (12);
+
+  for (i = 0; i < Len; i++) {
+    switch (Kind) {
+      case 0:
+        Sample[i] = (UINT8)Random (256);
+        break;
+      case 1:
+        Sample[i] = ((i > 0) && Random (64)) ? Sample[i - 1] : (UINT8)Random (256);
+        break;
+      case 2:
+        Sample[i] = ((i >= Period) && Random (256)) ? Sample[i - Period] : (UINT8)Random (256);
+        break;
+      default:
+        Sample[i] = (UINT8)('a' + Random (1 + Period));
+        break;
+    }
+  }
+
+  return Len;
+}
+
+//
+// Checks
+//
+
+STATIC UINTN  mChecks = 0;
+STATIC UINTN  mFailures = 0;
+
+STATIC
+VOID
+Failed (
+  CONST CHAR8   *Name,
+  CONST CHAR8   *Format,
+  ...
+) {
+  va_list   Args;
+
+  fprintf (stderr, "%s: ", Name);
+  va_start (Args, Format);
+  vfprintf (stderr, Format, Args);
+  va_end (Args);
+  fprintf (stderr, "\n");
+
+  mFailures++;
+}
+
+/**
+  Inflates In with the new or the old decoder, on a fresh pool and from a
+  buffer of exactly InLen bytes. The output is copied out of the pool.
+**/
+STATIC
+unsigned
+Inflate (
+  CONST CHAR8   *Name,
+  BOOLEAN       Ref,
+  CONST UINT8   *In,
+  UINTN         InLen,
+  UINT8         **Out,
+  UINTN         *OutLen
+) {
+  LodePNGDecompressSettings   Settings;
+  unsigned char               *Data = NULL;
+  size_t                      Size = 0;
+  UINT8                       *Copy;
+  unsigned                    Error;
+
+  Copy = malloc (InLen ? InLen : 1);
+  memcpy (Copy, In, InLen);
+
+  lodepng_decompress_settings_init (&Settings);
+  HostPoolReset ();
+
+  Error = Ref ? ref_lodepng_inflate (&Data, &Size, Copy, InLen, &Settings) : lodepng_inflate (&Data, &Size, Copy, InLen, &Settings);
+
+  if (HostPoolCheck () != 0) {
+    Failed (Name, "%s decoder wrote past a pool block", Ref ? "old" : "new");
+  }
+
+  *Out = malloc (Size ? Size : 1);
+  *OutLen = Size;
+  if (Size != 0) {
+    memcpy (*Out, Data, Size);
+  }
+
+  free (Copy);
+
+  return Error;
+}
+
+STATIC
+VOID
+CheckOutput (
+  CONST CHAR8   *Name,
+  CONST CHAR8   *What,
+  unsigned      ExpectedError,
+  CONST UINT8   *Expected,
+  UINTN         ExpectedLen,
+  unsigned      Error,
+  CONST UINT8   *Got,
+  UINTN         GotLen
+) {
+  UINTN   i;
+
+  mChecks++;
+
+  if (Error != ExpectedError) {
+    Failed (Name, "%s: error %u, expected %u", What, Error, ExpectedError);
+    return;
+  }
+
+  // on an error the output is only as long as it got, there is no more to compare
+  if (GotLen != ExpectedLen) {
+    Failed (Name, "%s: length %lu, expected %lu", What, (unsigned long)GotLen, (unsigned long)ExpectedLen);
+    return;
+  }
+
+  if ((Error == 0) && (memcmp (Got, Expected, GotLen) != 0)) {
+    for (i = 0; Got[i] == Expected[i]; i++);
+    Failed (Name, "%s: first difference at 0x%lx", What, (unsigned long)i);
+  }
+}
+
+/**
+  Both decoders on Stream, against Expected when it is known and otherwise
+  against each other. With Faults the new one is also run out of memory.
+**/
+STATIC
+VOID
+CheckStream (
+  CONST CHAR8   *Name,
+  CONST UINT8   *Stream,
+  UINTN         StreamLen,
+  CONST UINT8   *Expected,
+  UINTN         ExpectedLen,
+  BOOLEAN       Faults
+) {
+  UINT8       *RefOut, *NewOut, *Out;
+  UINTN       RefLen, NewLen, OutLen, Allocations;
+  unsigned    RefError, NewError, Error;
+  INTN        Fail;
+
+  RefError = Inflate (Name, TRUE, Stream, StreamLen, &RefOut, &RefLen);
+  NewError = Inflate (Name, FALSE, Stream, StreamLen, &NewOut, &NewLen);
+  Allocations = HostAllocations;
+
+  if (Expected != NULL) {
+    CheckOutput (Name, "old decoder", 0, Expected, ExpectedLen, RefError, RefOut, RefLen);
+    CheckOutput (Name, "new decoder", 0, Expected, ExpectedLen, NewError, NewOut, NewLen);
+  } else {
+    CheckOutput (Name, "new decoder", RefError, RefOut, RefLen, NewError, NewOut, NewLen);
+  }
+
+  // each pool allocation failing in turn, until none is left to fail
+  for (Fail = 0; Faults && (Fail < (INTN)MIN (Allocations, TEST_MAX_FAILS)); Fail++) {
+    HostFailAfter = Fail;
+    Error = Inflate (Name, FALSE, Stream, StreamLen, &Out, &OutLen);
+    HostFailAfter = -1;
+
+    mChecks++;
+    if ((Error != 83) && ((Error != NewError) || (OutLen != NewLen) || (memcmp (Out, NewOut, OutLen) != 0))) {
+      Failed (Name, "allocation %ld failing: error %u, length %lu", (long)Fail, Error, (unsigned long)OutLen);
+    }
+
+    free (Out);
+  }
+
+  free (RefOut);
+  free (NewOut);
+}
+
+/** Bits flipped or the stream cut short, the new decoder has to fail (or not) as the old one does. */
+STATIC
+VOID
+CheckDamaged (
+  CONST CHAR8   *Name,
+  CONST UINT8   *Stream,
+  UINTN         StreamLen
+) {
+  CHAR8   Damaged[128];
+  UINT8   *Copy;
+  UINTN   Len, k, i, Flips;
+
+  if (StreamLen == 0) {
+    return;
+  }
+
+  Copy = malloc (StreamLen);
+
+  for (k = 0; k < TEST_DAMAGED; k++) {
+    memcpy (Copy, Stream, StreamLen);
+    Len = StreamLen;
+
+    if (k == 0) {
+      Len = Random ((UINT32)StreamLen);
+    } else {
+      for (Flips = 1 + Random (3); Flips > 0; Flips--) {
+        i = Random ((UINT32)StreamLen);
+        Copy[i] ^= (UINT8)(1u << Random (8));
+      }
+    }
+
+    snprintf (Damaged, sizeof (Damaged), "%s damaged %lu", Name, (unsigned long)k);
+    CheckStream (Damaged, Copy, Len, NULL, 0, FALSE);
+  }
+
+  free (Copy);
+}
+
+/** A PNG decoded with the new inflate and with the old one through custom_inflate. */
+STATIC
+VOID
+CheckPng (
+  CONST CHAR8   *Name,
+  CONST UINT8   *Png,
+  UINTN         PngLen
+) {
+  LodePNGState    State;
+  unsigned char   *Data;
+  UINT8           *Pixels[2];
+  unsigned        Width[2], Height[2], Error[2];
+  UINTN           Size[2], i;
+
+  for (i = 0; i < 2; i++) {
+    HostPoolReset ();
+    lodepng_state_init (&State);
+    if (i == 0) {
+      State.decoder.zlibsettings.custom_inflate = ref_lodepng_inflate;
+    }
+
+    Data = NULL;
+    Width[i] = Height[i] = 0;
+    Error[i] = lodepng_decode (&Data, &Width[i], &Height[i], &State, Png, PngLen);
+
+    Size[i] = (Error[i] == 0) ? (UINTN)Width[i] * Height[i] * 4 : 0;
+    Pixels[i] = malloc (Size[i] ? Size[i] : 1);
+    if (Size[i] != 0) {
+      memcpy (Pixels[i], Data, Size[i]);
+    }
+
+    if (HostPoolCheck () != 0) {
+      Failed (Name, "%s inflate: wrote past a pool block", (i == 0) ? "old" : "new");
+    }
+  }
+
+  mChecks++;
+  if ((Error[0] != Error[1]) || (Width[0] != Width[1]) || (Height[0] != Height[1])) {
+    Failed (Name, "error %u %ux%u, expected error %u %ux%u", Error[1], Width[1], Height[1], Error[0], Width[0], Height[0]);
+  } else if (memcmp (Pixels[0], Pixels[1], Size[0]) != 0) {
+    Failed (Name, "pixels differ");
+  }
+
+  free (Pixels[0]);
+  free (Pixels[1]);
+}
+
+/** A generated image through lodepng_encode32 (), then CheckPng (). */
+STATIC
+VOID
+CheckEncodedPng (
+  CONST CHAR8   *Name
+) {
+  UINT8           *Image, *Png;
+  unsigned char   *Data = NULL;
+  size_t          Size = 0;
+  unsigned        Width = 1 + Random (96), Height = 1 + Random (96), i;
+
+  Image = malloc (Width * Height * 4);
+  for (i = 0; i < (Width * Height * 4); i++) {
+    Image[i] = ((i >= 4) && Random (4)) ? Image[i - 4] : (UINT8)Random (256);
+  }
+
+  HostPoolReset ();
+  if (lodepng_encode32 (&Data, &Size, Image, Width, Height) != 0) {
+    Failed (Name, "lodepng_encode32 failed");
+    free (Image);
+    return;
+  }
+
+  Png = malloc (Size);
+  memcpy (Png, Data, Size);
+
+  CheckPng (Name, Png, Size);
+
+  free (Png);
+  free (Image);
+}
+
+STATIC
+UINT8 *
+LoadFile (
+  CONST CHAR8   *Path,
+  UINTN         *Len
+) {
+  FILE    *File;
+  UINT8   *Data;
+  long    Size;
+
+  File = fopen (Path, "rb");
+  if (File == NULL) {
+    return NULL;
+  }
+
+  fseek (File, 0, SEEK_END);
+  Size = ftell (File);
+  fseek (File, 0, SEEK_SET);
+
+  Data = malloc (Size + 1);
+  if ((Size <= 0) || (fread (Data, 1, Size, File) != (size_t)Size)) {
+    free (Data);
+    fclose (File);
+    return NULL;
+  }
+
+  fclose (File);
+  *Len = (UINTN)Size;
+
+  return Data;
+}
+
+int
+main (
+  int   argc,
+  char  **argv
+) {
+  LodePNGCompressSettings   Settings;
+  unsigned char             *Data;
+  size_t                    Size;
+  CHAR8                     Name[64];
+  UINT8                     *Stream, *Expected, *Sample, *File;
+  UINTN                     StreamLen, ExpectedLen, SampleLen, FileLen;
+  UINT32                    Seeds = 500, Seed;
+  int                       Arg = 1;
+
+  if ((argc > 1) && IS_DIGIT (argv[1][0])) {
+    Seeds = (UINT32)strtoul (argv[1], NULL, 0);
+    Arg++;
+  }
+
+  HostPoolSize = TEST_POOL_SIZE;
+  HostPool = malloc (HostPoolSize);
+  Stream = malloc (TEST_MAX_STREAM);
+  Expected = malloc (TEST_MAX_OUTPUT);
+  Sample = malloc (TEST_MAX_SAMPLE);
+
+  for (Seed = 1; Seed <= Seeds; Seed++) {
+    mRandom = 0x9E3779B97F4A7C15ULL * Seed;
+
+    snprintf (Name, sizeof (Name), "seed %u", Seed);
+    StreamLen = GenerateStream (Stream, Expected, &ExpectedLen);
+    CheckStream (Name, Stream, StreamLen, Expected, ExpectedLen, TRUE);
+    CheckDamaged (Name, Stream, StreamLen);
+
+    // the same for what the encoder makes of generated data, with each block type
+    snprintf (Name, sizeof (Name), "seed %u deflate", Seed);
+    SampleLen = GenerateSample (Sample);
+
+    lodepng_compress_settings_init (&Settings);
+    Settings.btype = Random (3);
+    Settings.windowsize = 1u << (9 + Random (7));
+    Settings.nicematch = Random (2) ? 258 : 128;
+    Settings.lazymatching = Random (2);
+
+    HostPoolReset ();
+    Data = NULL;
+    Size = 0;
+    if (lodepng_deflate (&Data, &Size, Sample, SampleLen, &Settings) != 0) {
+      Failed (Name, "lodepng_deflate failed");
+      continue;
+    }
+
+    memcpy (Stream, Data, Size);
+    CheckStream (Name, Stream, Size, Sample, SampleLen, FALSE);
+    CheckDamaged (Name, Stream, Size);
+
+    if ((Seed % 8) == 0) {
+      snprintf (Name, sizeof (Name), "seed %u png", Seed);
+      CheckEncodedPng (Name);
+    }
+  }
+
+  for (; Arg < argc; Arg++) {
+    File = LoadFile (argv[Arg], &FileLen);
+    if (File == NULL) {
+      fprintf (stderr, "%s: cannot read\n", argv[Arg]);
+      mFailures++;
+      continue;
+    }
+
+    CheckPng (argv[Arg], File, FileLen);
+    free (File);
+  }
+
+  printf ("%lu checks, %lu failed\n", (unsigned long)mChecks, (unsigned long)mFailures);
+
+  free (Stream);
+  free (Expected);
+  free (Sample);
+  free (HostPool);
+
+  return (mFailures == 0) ? 0 : 1;
+}